@@ -28,6 +28,9 @@ SOFTWARE. */
 #ifndef __ALN_H__
 #define __ALN_H__
 
+/* size_t */
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -86,6 +89,9 @@ extern "C" {
 /* minmax flags ---------------------------------------------------------- */
 #define GF_MIN      0x00000100      /* AND minmax                          */
 #define GF_MAX       0x00000200      /* OR minmax                          */
+#define GF_BOUNDS   0x00000400      /* box and bounds of subtree valid     */
+#define GF_STORED   0x00000800      /* children evaluated in stored order, */
+                                    /*   not by the routing test           */
 
 /* multi layer flags ----------------------------------------------------- */
 #define MULTILAYER_FULL 0
@@ -149,14 +155,17 @@ extern "C" {
 #define MINMAX_TYPE(pNode) ((pNode)->fNode & (GF_MIN | GF_MAX))
 #define MINMAX_ISMAX(pNode) ((pNode)->fNode & GF_MAX)
 #define MINMAX_ISMIN(pNode) ((pNode)->fNode & GF_MIN)
-#define MINMAX_LEFT(pNode) ((pNode)->DATA.MINMAX.CHILDREN.CHILDSEPARATE.pLeftChild)
-#define MINMAX_RIGHT(pNode) ((pNode)->DATA.MINMAX.CHILDREN.CHILDSEPARATE.pRightChild)
-#define MINMAX_NUMCHILDREN(pNode) (2)
-#define MINMAX_CHILDREN(pNode) ((pNode)->DATA.MINMAX.CHILDREN.CHILDARRAY.apChildren)
+#define MINMAX_NUMCHILDREN(pNode) ((pNode)->DATA.MINMAX.CHILDARRAY.nChildren)
+#define MINMAX_CHILDREN(pNode) ((pNode)->DATA.MINMAX.CHILDARRAY.apChildren)
+#define MINMAX_LEFT(pNode) (MINMAX_CHILDREN(pNode)[0])      /* first child  */
+#define MINMAX_RIGHT(pNode) (MINMAX_CHILDREN(pNode)[1])     /* second child */
 
 
 #define NODE_ISEVAL(pNode) ((pNode)->fNode & NF_EVAL)
 #define NODE_DISTANCE(pNode) ((pNode)->fltDistance)
+#ifdef ALNSTATS
+#define NODE_STATS(pNode) ((pNode)->Stats)
+#endif
 #define NODE_RESPCOUNTLASTEPOCH(pNode) ((pNode)->nRespCountLastEpoch)
 #define NODE_RESPCOUNT(pNode) ((pNode)->nRespCount)
 #define NODE_ISUSELESS(pNode, nDim) ((pNode)->nRespCountLastEpoch + (pNode)->nRespCount < (nDim))
@@ -168,14 +177,19 @@ extern "C" {
 #define LFN_SPLIT_SQERR(pNode) ((pNode)->DATA.LFN.pSplit->fltSqError)
 #define LFN_SPLIT_RESPTOTAL(pNode) ((pNode)->DATA.LFN.pSplit->fltRespTotal)
 #define LFN_SPLIT_T(pNode) ((pNode)->DATA.LFN.pSplit->afltT)
+#define LFN_SPLIT_LEARNFACTOR(pNode) ((pNode)->DATA.LFN.pSplit->fltLearnFactor)
+#define LFN_SPLIT_EPOCHMSE(pNode) ((pNode)->DATA.LFN.pSplit->fltEpochMSE)
+#define LFN_SPLIT_EPOCHCOUNT(pNode) ((pNode)->DATA.LFN.pSplit->nEpochCount)
+#define LFN_SPLIT_EPOCHSQERR(pNode) ((pNode)->DATA.LFN.pSplit->fltEpochSqError)
 
 #define MINMAX_ACTIVE(pNode) ((pNode)->DATA.MINMAX.pActiveChild)
 #define MINMAX_RESPACTIVE(pNode) ((pNode)->DATA.MINMAX.fltRespActive)
 #define MINMAX_GOAL(pNode) ((pNode)->DATA.MINMAX.pGoalChild)
 #define MINMAX_EVAL(pNode) ((pNode)->DATA.MINMAX.pEvalChild)
 #define MINMAX_CENTROID(pNode) ((pNode)->DATA.MINMAX.pCentroid)
-#define MINMAX_SIGMA(pNode)  ((pNode)->DATA.MINMAX.pSigma)
+#define MINMAX_BOUNDS(pNode)  ((pNode)->DATA.MINMAX.pBounds)
 #define MINMAX_NORMAL(pNode)  ((pNode)->DATA.MINMAX.pNormal)
+#define MINMAX_ROUTE(pNode)  ((pNode)->DATA.MINMAX.pRoute)
 #define MINMAX_THRESHOLD(pNode) ((pNode)->DATA.MINMAX.fltThreshold)
 #define MINMAX_COUNT(pNode) ((pNode)->DATA.MINMAX.SampleCount)
 /*
@@ -204,8 +218,39 @@ extern "C" {
         float fltSqError;                /* squared error                       */
         float fltRespTotal;              /* total response                      */
         float* afltT;                    /* convexity criterion on each axis	*/
+        float fltLearnFactor;            /* factor of the learning rate on the  */
+                                         /*   piece, see bLearnFactors          */
+        float fltEpochMSE;               /* mean square error on the piece in   */
+                                         /*   its last epoch, 0 if not known    */
+        int nEpochCount;                 /* adapts of the piece this epoch      */
+        float fltEpochSqError;           /*   and their squared error           */
     } ALNLFNSPLIT;
 
+    /* evaluation counters of a node, kept only by libraries built with ALNSTATS */
+    typedef struct tagALNNODESTATS
+    {
+        unsigned long nEvals;             /* times the node was evaluated        */
+        unsigned long nAlphaBetaCutoffs;  /* times skipped by an alpha-beta cutoff */
+        unsigned long nDistanceCutoffs;   /* times skipped by the bounds test    */
+        unsigned long nRouteTests;        /* times ordered by its routing test   */
+        unsigned long nRouteMisses;       /*   of those, ordered unlike the normal */
+    } ALNNODESTATS;
+
+    /* routing test of a minmax node with two children -----------------------
+       a few terms of the routing normal that order the children almost always
+       as the full normal does on the training samples, see alnroute.cpp */
+#define ALNROUTE_MAXTERMS 8
+    typedef struct tagALNROUTE
+    {
+        int nTerms;                       /* terms in the test, -1 to use the    */
+                                          /*   full normal instead               */
+        float fltThreshold;              /* constant added to the terms         */
+        float fltAgreement;              /* fraction of the training samples    */
+                                          /*   routed as by the full normal      */
+        int anVar[ALNROUTE_MAXTERMS];     /* input index of each term            */
+        float afltW[ALNROUTE_MAXTERMS];  /* weight of each term                 */
+    } ALNROUTE;
+
     /* node structure -------------------------------------------------------- */
     typedef struct tagALNNODE
     {
@@ -216,6 +261,9 @@ extern "C" {
         int nRespCount;                   /* responsibility count current epoch  */
         int nRespCountLastEpoch;          /* responsibility count previous epoch */
         float fltDistance;               /* distance to current input point     */
+#ifdef ALNSTATS
+        ALNNODESTATS Stats;               /* see ALNResetEvalStats               */
+#endif
 
         union tagDATA
         {
@@ -237,21 +285,15 @@ extern "C" {
                 struct tagALNNODE* pEvalChild;  /* first eval child on current input */
                 float* pCentroid;              /* centroid of the samples activating this node -- allocate nDim - 1 floats at split*/
                 float* pNormal;                /* normal to hyperplane between left child and centroid -- allocate as above */
-                float* pSigma;                 /* estimated half-width of a node beyond which the leaves are cut off -- allocate as above*/
+                float* pBounds;                /* bounds of the subtree over the box of its samples, see alnbounds.cpp -- allocated when computed*/
+                ALNROUTE* pRoute;              /* cheap test replacing the normal, see alnroute.cpp -- allocated when computed*/
                 float  fltThreshold;           /* a constant to which the dot product of X with the normal is to be compared*/
                 long SampleCount;               /* current count of samples under this node */
-                union tagCHILDREN
+                struct tagCHILDARRAY
                 {
-                    struct tagCHILDSEPARATE
-                    {
-                        struct tagALNNODE* pLeftChild;  /* ptr to left child             */
-                        struct tagALNNODE* pRightChild; /* ptr to right child            */
-                    } CHILDSEPARATE;
-                    struct tagCHILDARRAY
-                    {
-                        struct tagALNNODE* apChildren[2]; /* array of children           */
-                    } CHILDARRAY;
-                } CHILDREN;
+                    struct tagALNNODE** apChildren; /* array of children, malloc'd    */
+                    int nChildren;                  /* number of children, >= 2       */
+                } CHILDARRAY;
             } MINMAX;
         } DATA;
     } ALNNODE;
@@ -306,6 +348,34 @@ extern "C" {
 
 
     /* ALN struct ------------------------------------------------------------ */
+    /* growth and optimization settings of an ALN, see ALNSetTrainContext     */
+    typedef struct tagALNTRAINCONTEXT
+    {
+        BOOL bClassify2;              /* two-class classification               */
+        BOOL bConvex;                 /*   with every split a MIN, if bClassify2 */
+        BOOL bAlphaBeta;              /* alpha-beta cutoffs in evaluation       */
+        BOOL bDistanceOptimization;   /* subtree bounds cutoffs in evaluation   */
+        BOOL bStopTraining;           /* set by ALNTrain: no piece needs to     */
+                                      /*   split at the last splitting epoch    */
+        float fltWeightDecay;         /* weight factor per call, if bClassify2  */
+        float fltWeightBound;         /* bound on weights in decay              */
+        int nSplitsAllowed;           /* limit of nSplitCount                   */
+        int nSplitCount;              /* splits made, counted by ALNTrain       */
+        int nShuffleBlock;            /* rows per block of the epoch order, 0   */
+                                      /*   or 1 for a full shuffle              */
+        float fltSettle;              /* relative improvement below which the   */
+                                      /*   pieces have settled, 0 for a fixed   */
+                                      /*   schedule of epochs                   */
+        int nSplitsPerRound;          /* most leaves split at a time, the worst */
+                                      /*   fitting first, 0 for no limit        */
+        BOOL bLearnFactors;           /* each piece scales the learning rate    */
+                                      /*   by a factor of its own, set from its */
+                                      /*   samples and error trend each epoch   */
+        long nSettledSamples;         /* set by ALNTrain: training buffer an    */
+        long nSettledInsert;          /*   adaptive run settled on, see         */
+        float fltSettledMSEorF;       /*   ALNClearStopTraining                 */
+    } ALNTRAINCONTEXT;
+
     typedef struct tagALN
     {
         int nVersion;                     /* version of ALN                      */
@@ -314,6 +384,9 @@ extern "C" {
         int nRegions;                     /* number of regions for now must be 1 */
         ALNREGION* aRegions;              /* array of regions, nRegions elements */
         ALNNODE* pTree;                   /* pointer to root node of tree        */
+        long nGeneration;                 /* changed with the tree or weights    */
+        ALNTRAINCONTEXT* pTrainContext;   /* own training settings, NULL to use  */
+                                          /* the globals, see ALNSetTrainContext */
     } ALN;
 
     /*
@@ -335,6 +408,58 @@ extern "C" {
         float* afltX;	          /* input vector, can be modified               */
     } VECTORINFO;
 
+    /* lookups of an evaluation cache, see ALNCreateEvalCache                   */
+    typedef struct tagALNEVALCACHESTATS
+    {
+        long long nHits;              /* lookups answered by a cached LFN        */
+        long long nMisses;            /* lookups that evaluated the tree         */
+        long long nStale;             /*   of those, found an entry of an older  */
+                                      /*   generation of the ALN                 */
+        long long nEvictions;         /*   of those, replaced another cell       */
+    } ALNEVALCACHESTATS;
+
+    /* evaluation counts of a thread, kept only by libraries built with ALNSTATS */
+    typedef struct tagALNEVALSTATS
+    {
+        long long nEvals;             /* evaluations of a whole tree (samples)   */
+        long long nLeafEvals;         /* LFNs evaluated                          */
+        long long nMinMaxEvals;       /* minmax nodes evaluated                  */
+        long long nAlphaBetaCutoffs;  /* subtrees skipped by alpha-beta cutoffs  */
+        long long nDistanceCutoffs;   /* subtrees skipped by the bounds test     */
+        long long nRouteTests;        /* minmax nodes ordered by a routing test  */
+        long long nRouteMisses;       /*   of those, ordered unlike the normal   */
+        long long nActiveDepth;       /* sum of the depths of the active LFNs    */
+        int nMaxActiveDepth;          /* greatest depth of an active LFN         */
+    } ALNEVALSTATS;
+
+    /* pruning structure, see ALNPrune --------------------------------------- */
+    typedef struct tagALNPRUNEINFO
+    {
+        int nMinRespCount;            /* in: children responsible for fewer    */
+                                      /*   samples are removed, at least 1     */
+        float fltTolerance;           /* in: sibling LFNs differing by at most */
+                                      /*   this are merged, 0 for no merging   */
+        int nLFNsBefore;              /* LFNs before pruning                   */
+        int nLFNsAfter;               /* LFNs after pruning                    */
+        int nRemoved;                 /* LFNs removed with unused subtrees     */
+        int nMerged;                  /* LFNs merged into a sibling            */
+        float fltRMSErrBefore;        /* RMS error on the data before pruning  */
+        float fltRMSErrAfter;         /* RMS error on the data after pruning   */
+    } ALNPRUNEINFO;
+
+    /* reordering structure, see ALNReorder ---------------------------------- */
+    typedef struct tagALNREORDERINFO
+    {
+        int nReordered;               /* minmax nodes with children reordered  */
+        int nStoredOrder;             /* nodes with two children which now     */
+                                      /*   evaluate the first child first      */
+        int nRouted;                  /* nodes with two children which keep    */
+                                      /*   choosing by their routing test      */
+        float fltLeavesBefore;        /* LFNs evaluated per sample on the data */
+                                      /*   before reordering, with ALNSTATS    */
+        float fltLeavesAfter;         /* and after reordering, with ALNSTATS   */
+    } ALNREORDERINFO;
+
     /* structures used for passing info to training notification procedure     */
     typedef struct tagEPOCHINFO
     {
@@ -342,6 +467,8 @@ extern "C" {
         int nLFNs;					      /* number of LFNs in ALN                       */
         int nActiveLFNs;			    /* number of active LFNs in ALN                */
         float fltEstRMSErr;	    /* estimated RMS error                         */
+        const ALNEVALSTATS* pEvalStats; /* counts of this epoch at AN_EPOCHEND,  */
+                                    /*   NULL otherwise or without ALNSTATS    */
     } EPOCHINFO;
 
     typedef struct tagTRAININFO
@@ -352,6 +479,21 @@ extern "C" {
         float fltRMSErr;			    /* RMS error, 0 at start                       */
     } TRAININFO;
 
+    typedef struct tagPHASETIMES
+    {
+        int nEpoch;                   /* epoch number                            */
+        double dblShuffle;            /* seconds spent shuffling the samples     */
+        double dblFillInput;          /* ... filling input vectors               */
+        double dblAdaptEval;          /* ... in adapt evaluations                */
+        double dblAdapt;              /* ... adapting the tree                   */
+        double dblDecayWeights;       /* ... in weight decay                     */
+        double dblCalcRMSError;       /* ... calculating the true RMS error      */
+        double dblSplitUpdate;        /* ... gathering split statistics          */
+        double dblDoSplits;           /* ... splitting LFNs                      */
+        double dblCountLFNs;          /* ... counting LFNs                       */
+        double dblEpoch;              /* whole epoch, including notifications    */
+    } PHASETIMES;
+
     typedef struct tagADAPTINFO
     {
         int nAdapt;						    /* adaptation sequence number                  */
@@ -367,15 +509,30 @@ extern "C" {
         float fltError;          /* global error we are adapting to             */
     } LFNADAPTINFO;
 
+    /* layouts of the rows of a training buffer, see ALNDATAINFO.nTRlayout */
+#define ALN_TRLAYOUT_FULL       0
+#define ALN_TRLAYOUT_COMPACT    1
+
     typedef struct tagALNDATAINFO
     {
         float* afltTRdata;			/* data array...NULL -- initialized after ALN initialization.                   */
         long nTRmaxSamples;		/* the greatest number of samples allowed in this ALN's buffer					*/
         long nTRcurrSamples;			/* number of data samples currently in this ALN's training buffer afltTRdata	*/
         int nTRcols;			/* columns in this ALN's data buffer -- training samples + noise variance data	*/
+                                /* 2 * nDim + 1 for ALN_TRLAYOUT_FULL, nDim + 2 for ALN_TRLAYOUT_COMPACT         */
+        int nTRlayout;          /* ALN_TRLAYOUT_FULL (0): the sample, the closest sample minus it, the square    */
+                                /* distance; ALN_TRLAYOUT_COMPACT: the sample, the row of the closest sample as  */
+                                /* the bits of an int (-1 if none) and the square distance; the difference is   */
+                                /* computed from the two rows when needed                                       */
         long nTRinsert;			/* the next insertion point for a new sample in this circular buffer			*/
         float fltMSEorF;			/* split criterion:this if > 0, F-test if <= 0          MYTEST, used as fltLimit*/
         const VARINFO* aVarInfo;	/* variable info = NULL,later max partial derivatives of noise variance ??		*/
+        const float* afltTRlabels;	/* NULL, or two per row replacing columns nDim - 1 and 2 * nDim - 1: the desired */
+                                    /* output and its difference to that of the closest sample, see ALNCreateOneVsRest */
+        const void* pvTRstore;      /* NULL, or a store from ALNCreateTRStore whose rows are read in place of those  */
+                                    /* of afltTRdata, which may then be NULL                                        */
+        void* pvTRqueue;            /* NULL, or a queue from ALNCreateTRQueue whose samples ALNTrain adds to the     */
+                                    /* buffer at the start of each epoch                                            */
     } ALNDATAINFO;
 
     /*
@@ -423,6 +580,12 @@ extern "C" {
 #define AN_VECTORINFO    0x0100
     /* VECTORINFO* pVectorInfo = (VECTORINFO*)pParam                         */
 
+#define AN_PHASETIMES    0x0200
+    /* PHASETIMES* pPhaseTimes = (PHASETIMES*)pParam, sent after each epoch  */
+    /* training phases are timed only if this notification is requested or   */
+    /* a trace is open, see ALNOpenTrace; not part of AN_ALL, so timing is    */
+    /* never switched on without asking for it                                */
+
 #define AN_NONE     0
 #define AN_TRAIN    (AN_TRAINSTART|AN_TRAINEND)
 #define AN_EPOCH    (AN_EPOCHSTART|AN_EPOCHEND)
@@ -442,6 +605,10 @@ extern "C" {
 
     /*
     // seeding for ALN internal pseudo-random number generator
+    //  - each thread draws its own sequence from the seed, starting again
+    //    from the beginning when the seed is changed; the shuffle and jitter
+    //    of each epoch of ALNTrain come from streams keyed by a number of the
+    //    sequence, so they do not depend on the thread that draws them
     */
     ALNIMP void ALNAPI ALNSRand(unsigned int nSeed);
 
@@ -456,7 +623,7 @@ extern "C" {
 #define ALNRAND_MAX 0xffffffff
 
     /*
-    // quick way to get random float value in [0, 1]
+    // quick way to get random float value in [0, 1)
     */
     ALNIMP float ALNAPI ALNRandFloat(void);
 
@@ -474,6 +641,149 @@ extern "C" {
 
     ALNIMP void ALNAPI DecayWeights(const ALNNODE* pNode, const ALN* pALN, float WeightBound, float WeightDecay);
 
+    /*
+    // training context of an ALN
+    //  - the settings an ALN trains and evaluates with are the globals the
+    //    application defines (bClassify2, bConvex, bAlphaBeta,
+    //    bDistanceOptimization, WeightDecay, WeightBound, SplitsAllowed,
+    //    SplitCount and bStopTraining), unless it has a context of its own;
+    //    ALNs with their own contexts can train in parallel threads
+    //  - nShuffleBlock, fltSettle, nSplitsPerRound and bLearnFactors have no
+    //    globals, and are 0 (FALSE) for an ALN without a context; set them
+    //    through ALNSetTrainContext
+    //  - nShuffleBlock > 1 orders each epoch by blocks of that many
+    //    neighbouring rows of the training buffer, the blocks and the rows of
+    //    each in random order; fewer cache misses than a full shuffle, at
+    //    some cost in convergence when neighbouring rows are alike
+    //  - fltSettle > 0 lets ALNTrain end epochs early: the pieces have
+    //    settled when neither the estimated RMS error nor the movement of the
+    //    LFN weights over an epoch falls by more than that fraction from the
+    //    epoch before; the split is made once they settle, at the middle epoch
+    //    at the latest, and the call ends once they settle again, or when the
+    //    RMS error reaches fltMinRMSErr; bStopTraining is then set only if
+    //    the pieces settled and none split, and a later call finding
+    //    it set only starts and ends, for the callback, unless a queue of
+    //    samples is attached or the buffer (nTRcurrSamples, nTRinsert) or
+    //    fltMSEorF changed since, which clears it and trains;
+    //    0.02 is a reasonable start, smaller values run more epochs
+    //  - the buffer it settled on is kept in nSettledSamples, nSettledInsert
+    //    and fltSettledMSEorF; a caller changing rows in place, which these
+    //    do not show, calls ALNClearStopTraining before training again
+    //  - a split round splits the leaves failing to fit whose square error
+    //    exceeds the limit on the piece by the most, as many as
+    //    nSplitsAllowed - nSplitCount and nSplitsPerRound > 0 allow; with
+    //    fltSettle > 0 and nSplitsPerRound > 0 a call makes a round each time
+    //    the pieces settle, until a round splits nothing
+    //  - bLearnFactors gives each piece a factor of the learning rate of its
+    //    own, kept in its ALNLFNSPLIT and saved with the ALN; after each
+    //    epoch the factor grows while the mean square error of the piece
+    //    falls by more than its sampling error over the samples the piece
+    //    adapted to, and shrinks when the error rises by several times
+    //    that; the pieces split from one start with its factor
+    //  - ALNSetTrainContext copies *pContext into the ALN, NULL returns it to
+    //    the globals; not to be called while the ALN is training
+    //  - ALNGetTrainContext gets the settings the ALN uses, from its context
+    //    or from the globals
+    //  - ALNClearStopTraining clears bStopTraining, in the context or the
+    //    globals, and the buffer the ALN settled on, so the next ALNTrain
+    //    trains
+    //  - ALNTrain takes the settings when called, and updates nSplitCount and
+    //    bStopTraining, in the context or the globals, after each split
+    */
+    ALNIMP int ALNAPI ALNSetTrainContext(ALN* pALN, const ALNTRAINCONTEXT* pContext);
+    ALNIMP int ALNAPI ALNGetTrainContext(const ALN* pALN, ALNTRAINCONTEXT* pContext);
+    ALNIMP int ALNAPI ALNClearStopTraining(ALN* pALN);
+
+    /*
+    // one-vs-rest training of nModels two-class ALNs on one training buffer
+    //  - afltSamples holds nSamples rows of nDim values, the inputs followed
+    //    by the class; model m learns +1 where the class is afltClasses[m]
+    //    and -1 elsewhere, as for bClassify2
+    //  - the inputs and the closest sample of each row, the costly part of
+    //    the buffer, are found once and shared; each model only has its own
+    //    desired values, see afltTRlabels in ALNDATAINFO
+    //  - nThreads threads, the caller's included, train the models; each ALN
+    //    then needs its own training context, and those without one train
+    //    on a copy of the globals, removed afterwards, the globals counting
+    //    the splits of all of them; callbacks come from every thread, one at
+    //    a time
+    //  - ALNGetOneVsRestData describes the buffer of a model, eg. for
+    //    ALNCalcRMSError; it is valid until the trainer is destroyed
+    //  - ALNClassifyOneVsRest evaluates each model at afltX, the output value
+    //    being ignored, and returns the index of the greatest, or -1
+    */
+    ALNIMP int ALNAPI ALNCreateOneVsRest(int nDim, const float* afltSamples,
+        long nSamples, const float* afltClasses, int nModels, float fltMSEorF,
+        int nThreads, void** ppvOneVsRest);
+    ALNIMP int ALNAPI ALNGetOneVsRestData(void* pvOneVsRest, int nModel,
+        ALNDATAINFO* pDataInfo);
+    ALNIMP int ALNAPI ALNTrainOneVsRest(void* pvOneVsRest, ALN* const* apALN,
+        const ALNCALLBACKINFO* pCallbackInfo, int nMaxEpochs,
+        float fltMinRMSErr, float fltLearnRate, BOOL bJitter);
+    ALNIMP int ALNAPI ALNClassifyOneVsRest(ALN* const* apALN, int nModels,
+        const float* afltX, float* afltResult);
+    ALNIMP int ALNAPI ALNDestroyOneVsRest(void* pvOneVsRest);
+
+    /*
+    // column storage of a training buffer
+    //  - ALNCreateTRStore copies the nTRcurrSamples rows of the buffer of
+    //    pDataInfo into a store with an ALN_TRCOL_* type for each column;
+    //    u8 and i16 hold fltOffset + fltScale * k, fp16 is IEEE half
+    //    precision; anColType gives the type of each of the nTRcols
+    //    columns, or is NULL for ALN_TRCOL_AUTO in all
+    //  - ALN_TRCOL_AUTO chooses the smallest type holding every value of the
+    //    column exactly, eg. u8 for pixels 0 to 255; a type given is used
+    //    even if values are rounded or clipped; the row of the closest
+    //    sample in a compact buffer is always f32
+    //  - setting pvTRstore in the ALNDATAINFO makes training and evaluation
+    //    read the store; afltTRdata may then be freed and set to NULL, but
+    //    checkpoints need it; the store is a copy, made again if the buffer
+    //    changes
+    //  - ALNGetTRStoreInfo gets the type chosen for each column, and the
+    //    bytes of the rows
+    //  - ALNOpenTRFile maps a file of rows of nTRcols floats, laid out as
+    //    afltTRdata in the nTRlayout of *pDataInfo, as a store for a buffer
+    //    larger than memory, and sets the other buffer fields and pvTRstore
+    //    of *pDataInfo; training visits the
+    //    chunks of nChunkRows rows in random order, reading nWindowChunks
+    //    chunks at a time and shuffling the rows of those, and lets the
+    //    system drop the chunks it is done with; ALNDestroyTRStore unmaps it
+    */
+#define ALN_TRCOL_F32   0
+#define ALN_TRCOL_F16   1
+#define ALN_TRCOL_I16   2
+#define ALN_TRCOL_U8    3
+#define ALN_TRCOL_AUTO  4
+    ALNIMP int ALNAPI ALNCreateTRStore(const ALNDATAINFO* pDataInfo, int nDim,
+        const int* anColType, void** ppvStore);
+    ALNIMP int ALNAPI ALNGetTRStoreInfo(const void* pvStore, int* anColType,
+        size_t* pnBytes);
+    ALNIMP int ALNAPI ALNOpenTRFile(const char* pszFileName, int nTRcols,
+        long nChunkRows, long nWindowChunks, ALNDATAINFO* pDataInfo, void** ppvStore);
+    ALNIMP int ALNAPI ALNDestroyTRStore(void* pvStore);
+
+    /*
+    // ingestion of samples while training
+    //  - any number of threads add samples of nDim floats with
+    //    ALNPushTRSample, which never waits; it returns ALN_GENERIC if the
+    //    nCapacity samples (rounded up to a power of 2) not yet drained fill
+    //    the queue, and the sample is not added
+    //  - setting pvTRqueue in the ALNDATAINFO makes ALNTrain add the queued
+    //    samples to the buffer at the start of each epoch, as
+    //    CAln::addTRsample does, so an epoch sees the buffer unchanged; the
+    //    buffer must be in memory (no pvTRstore or afltTRlabels), full or
+    //    compact, and is allocated by the first sample if it is empty
+    //  - ALNDrainTRQueue adds the queued samples outside training; one thread
+    //    at a time drains a queue
+    //  - either way, the pending checkpoints of the buffer are detached
+    //    before samples are added, see ALNDetachCheckpoint
+    */
+    ALNIMP int ALNAPI ALNCreateTRQueue(int nDim, long nCapacity, void** ppvQueue);
+    ALNIMP int ALNAPI ALNPushTRSample(void* pvQueue, const float* afltX);
+    ALNIMP int ALNAPI ALNDrainTRQueue(void* pvQueue, ALNDATAINFO* pDataInfo, int nDim,
+        long* pnDrained);
+    ALNIMP int ALNAPI ALNDestroyTRQueue(void* pvQueue);
+
     /*
     // ALNCalcRMSError
     */
@@ -483,6 +793,47 @@ extern "C" {
         const ALNCALLBACKINFO* pCallbackInfo,
         float* pfltRMSErr);
 
+    /*
+    // pruning of a trained ALN on a data set
+    //  - a child of a minmax node that gives the value of the node for fewer
+    //    than nMinRespCount samples is removed with its subtree, and a node
+    //    left with one child is replaced by it; with nMinRespCount 1 only
+    //    children that are never active go, and the values on the data set
+    //    stay the same
+    //  - sibling LFNs whose difference over the bounding box of the data is
+    //    at most fltTolerance are merged into their average, weighted by the
+    //    numbers of samples they are responsible for
+    //  - the responsibility counts of the nodes are then those of the pruned
+    //    ALN on the data, the counts from training move to the last epoch
+    // returns ALN_* error code, (ALN_NOERROR on success)
+    */
+    ALNIMP int ALNAPI ALNPrune(ALN* pALN,
+        ALNDATAINFO* pDataInfo,
+        const ALNCALLBACKINFO* pCallbackInfo,
+        ALNPRUNEINFO* pPruneInfo);
+
+    /*
+    // profile-guided reordering of the children of minmax nodes
+    //  - the data set is evaluated and each child counts the samples on
+    //    which it gives the value of its parent; the children of each node
+    //    are put in order of decreasing count, so the cutoffs come sooner
+    //  - a node with two children keeps choosing the first child by its
+    //    routing test only if the test chose the winning child more often
+    //    than always taking the child that wins most would; otherwise that
+    //    child is put first and always evaluated first (GF_STORED), until
+    //    training chooses new routing tests; the routing normals and tests
+    //    are kept, so a reordered ALN can go on training
+    //  - the tree is then copied depth first, each first child after its
+    //    parent, so pointers to nodes of the ALN are invalid afterwards
+    //  - the LFNs evaluated per sample before and after are measured only
+    //    if the library is built with ALNSTATS, otherwise they are 0
+    // returns ALN_* error code, (ALN_NOERROR on success)
+    */
+    ALNIMP int ALNAPI ALNReorder(ALN* pALN,
+        ALNDATAINFO* pDataInfo,
+        const ALNCALLBACKINFO* pCallbackInfo,
+        ALNREORDERINFO* pReorderInfo);
+
     /*
     // ALN variable monotonicity type
     */
@@ -509,6 +860,99 @@ extern "C" {
     ALNIMP float ALNAPI ALNQuickEval(const ALN* pALN, const float* afltX,
         ALNNODE** ppActiveLFN);
 
+    /*
+    // quick evaluation of ALN on nVectors vectors stored one after the other
+    */
+    ALNIMP int ALNAPI ALNQuickEvalBatch(const ALN* pALN, const float* afltX,
+        int nVectors, float* afltResult, ALNNODE** apActiveLFN);
+
+    /*
+    // evaluation of ALN on one state with each of nActions values of the
+    // input variable nActionVar, as for choosing an action in Q-learning
+    //  - each LFN sums the state terms once for all the actions, and the
+    //    alpha-beta cutoffs skip a subtree when they hold for every action
+    //  - returns the index of the action of greatest value, or -1 if the
+    //    parameters are invalid
+    */
+    ALNIMP int ALNAPI ALNEvalActions(const ALN* pALN, const float* afltState,
+        int nActionVar, const float* afltActions, int nActions,
+        float* afltResult);
+
+    /*
+    // evaluation snapshots of an ALN in training
+    //  - the training thread calls ALNPublish when the tree is not being
+    //    adapted, eg. after ALNTrain returns or in an AN_EPOCHEND notification
+    //  - up to nMaxReaders threads at a time evaluate the latest snapshot
+    //    with ALNPublishedEval, or hold one between ALNAcquireSnapshot and
+    //    ALNReleaseSnapshot; readers never wait for the trainer, and a
+    //    snapshot is freed only after the last reader holding it releases it
+    //  - ALNDestroyPublisher must not be called while readers are active
+    */
+    ALNIMP int ALNAPI ALNCreatePublisher(const ALN* pALN, int nMaxReaders,
+        void** ppvPublisher);
+    ALNIMP int ALNAPI ALNPublish(void* pvPublisher, const ALN* pALN);
+    ALNIMP const ALN* ALNAPI ALNAcquireSnapshot(void* pvPublisher,
+        int* pnReader, long* pnVersion);
+    ALNIMP int ALNAPI ALNReleaseSnapshot(void* pvPublisher, int nReader);
+    ALNIMP float ALNAPI ALNPublishedEval(void* pvPublisher, const float* afltX,
+        long* pnVersion);
+    ALNIMP int ALNAPI ALNDestroyPublisher(void* pvPublisher);
+
+    /*
+    // approximate evaluation cache, for inputs evaluated again and again
+    //  - each input vector is quantised to a cell by the fltEpsilon of each
+    //    input variable in the root region; a cell holds the active LFN of
+    //    the last vector evaluated in it, and a later vector in the same cell
+    //    is evaluated on that LFN alone; the value is exact for the LFN, but
+    //    the LFN may not be the active one for the later vector if the
+    //    surface has a corner within the cell
+    //  - nEntries cells, at most, are kept, in nStripes sets that each have a
+    //    lock, so up to nStripes threads can use the cache at once
+    //  - the library changes nGeneration of the ALN when it trains, splits,
+    //    prunes or reorders the tree, which makes every cell stale; an
+    //    application changing weights itself must do the same
+    //  - the cache must be destroyed before its ALN
+    */
+    ALNIMP int ALNAPI ALNCreateEvalCache(const ALN* pALN, int nEntries,
+        int nStripes, void** ppvCache);
+    ALNIMP float ALNAPI ALNCachedEval(void* pvCache, const float* afltX,
+        ALNNODE** ppActiveLFN);
+    ALNIMP int ALNAPI ALNGetEvalCacheStats(void* pvCache,
+        ALNEVALCACHESTATS* pStats, BOOL bReset);
+    ALNIMP int ALNAPI ALNDestroyEvalCache(void* pvCache);
+
+    /*
+    // evaluation statistics, for judging how well cutoffs prune
+    //  - counted only if the library is built with ALNSTATS defined,
+    //    otherwise these return ALN_GENERIC
+    //  - the totals belong to the calling thread; ALNResetEvalStats zeroes
+    //    them, and if pALN is not NULL it also zeroes the node counters of
+    //    pALN and keeps counting per node for pALN on the calling thread
+    //    until called again; only one thread should count per node for an ALN
+    //  - leaves per sample is nLeafEvals / nEvals, the mean depth of the
+    //    active path is nActiveDepth / nEvals
+    //  - nRouteMisses / nRouteTests is how often the routing tests of the
+    //    minmax nodes put the children in another order than the full
+    //    normal would; counting evaluates the normal as well, so it slows
+    //    evaluation; the agreement on the training samples, measured when
+    //    the test was chosen, is in the ALNROUTE of each node
+    //  - during training the counts of each epoch are also passed to the
+    //    AN_EPOCHEND notification in EPOCHINFO
+    */
+    ALNIMP int ALNAPI ALNResetEvalStats(ALN* pALN);
+    ALNIMP int ALNAPI ALNGetEvalStats(ALNEVALSTATS* pStats);
+
+    /*
+    // Chrome trace-event export of training phases, viewable in
+    // chrome://tracing or Perfetto
+    //  - while a trace is open, every epoch of ALNTrain on any thread is
+    //    written to it as a span with its phases inside, the per-sample
+    //    phases are totalled in the arguments of the samples span
+    //  - ALNCloseTrace completes the file; returns ALN_* error code
+    */
+    ALNIMP int ALNAPI ALNOpenTrace(const char* pszFileName);
+    ALNIMP int ALNAPI ALNCloseTrace(void);
+
 
     /*
     /////////////////////////////////////////////////////////////////////////////
@@ -594,6 +1038,44 @@ extern "C" {
     */
     ALNIMP int ALNAPI ALNRead(const char* pszFileName, ALN** ppALN);
 
+    /*
+    // checkpoint of the full training state: tree with split statistics,
+    // training buffer, random generator and growth settings
+    //  - the nMetaBytes bytes at pvMeta, eg. the step of the caller's
+    //    training schedule, are kept with it; pvMeta may be NULL if
+    //    nMetaBytes is 0
+    //  - the labels of a one-vs-rest model, afltTRlabels, are kept with the
+    //    buffer
+    //  - if ppvCheckpoint is NULL the file is written before returning,
+    //    otherwise the tree, the labels and the metadata are copied and the
+    //    file is written on a background thread; pass *ppvCheckpoint to
+    //    ALNWaitCheckpoint
+    //  - while pending, call ALNDetachCheckpoint before changing or freeing
+    //    the training buffer in pDataInfo
+    */
+    ALNIMP int ALNAPI ALNWriteCheckpoint(const ALN* pALN,
+        const ALNDATAINFO* pDataInfo,
+        const char* pszFileName,
+        const void* pvMeta,
+        int nMetaBytes,
+        void** ppvCheckpoint);
+    ALNIMP int ALNAPI ALNDetachCheckpoint(void* pvCheckpoint);
+    ALNIMP int ALNAPI ALNWaitCheckpoint(void* pvCheckpoint);
+
+    /*
+    // resuming from a checkpoint; pDataInfo receives a new training buffer,
+    // and new labels if it had them, both freed by the caller; its aVarInfo
+    // member is left unchanged; an ALN written with a training context of
+    // its own gets it back, otherwise the globals are restored; pvMeta
+    // receives the metadata, which must be nMetaBytes long, or the file is
+    // rejected with ALN_BADFILEFORMAT
+    */
+    ALNIMP int ALNAPI ALNReadCheckpoint(const char* pszFileName,
+        ALN** ppALN,
+        ALNDATAINFO* pDataInfo,
+        void* pvMeta,
+        int nMetaBytes);
+
     /*
     // conversion to dtree
     */
@@ -72,6 +72,17 @@ SOFTWARE.*/
 #define ALNAPI __stdcall
 
 
+/*
+/////////////////////////////////////////////////////////////////////////////
+// evaluation statistics - define ALNSTATS when building the library to count
+// node evaluations and cutoffs (see ALNGetEvalStats); without it the counting
+// is compiled out of the evaluation routines, and ALNNODE has no Stats member,
+// so the library and the code using it must be built with the same setting
+*/
+
+/* #define ALNSTATS */
+
+
 /*
 /////////////////////////////////////////////////////////////////////////////
 // DLL function exports - define ALNDLL if linking to libalndll(d).DLL
@@ -127,6 +127,10 @@ public:
 
     BOOL Destroy();
 
+    // training settings of this ALN, NULL to use the globals
+    BOOL SetTrainContext(const ALNTRAINCONTEXT* pContext);
+    BOOL GetTrainContext(ALNTRAINCONTEXT* pContext) const;
+
     // training
     BOOL Train(int nMaxEpochs, float fltMinRMSErr, float fltLearnRate,
         BOOL bJitter, int nNotifyMask = AN_NONE,
@@ -144,6 +148,20 @@ public:
     // quick eval
     float QuickEval(const float* afltX, ALNNODE** ppActiveLFN = NULL);
 
+    // eval of one state with each action, returns the best action or -1
+    int EvalActions(const float* afltState, int nActionVar,
+        const float* afltActions, int nActions, float* afltResult);
+
+    // pruning of unused subtrees and merging of nearly coplanar LFNs,
+    // set nMinRespCount and fltTolerance in pPruneInfo first
+    BOOL Prune(ALNPRUNEINFO* pPruneInfo, int nNotifyMask = AN_NONE,
+        ALNDATAINFO* pData = NULL, void* pvData = NULL);
+
+    // profile-guided reordering of the children of minmax nodes on the data,
+    // pointers to nodes of the tree are invalid afterwards
+    BOOL Reorder(ALNREORDERINFO* pReorderInfo, int nNotifyMask = AN_NONE,
+        ALNDATAINFO* pData = NULL, void* pvData = NULL);
+
     // get variable monotonicicty, returns -1 on failure
     int VarMono(int nVar);
 
@@ -156,6 +174,19 @@ public:
     // read ALN from disk file... destroys any existing ALN
     BOOL Read(const char* pszFileName);
 
+    // checkpoint of ALN and training buffer, with nMetaBytes of the
+    // caller's at pvMeta; if bAsync the file is written in the background,
+    // a pending checkpoint is waited for first
+    BOOL WriteCheckpoint(const char* pszFileName, BOOL bAsync = TRUE,
+        const void* pvMeta = NULL, int nMetaBytes = 0);
+    BOOL WaitCheckpoint();
+
+    // resume from checkpoint... destroys any existing ALN and replaces
+    // the training buffer; the caller still frees the old buffer; pvMeta
+    // receives the nMetaBytes written with the checkpoint
+    BOOL ReadCheckpoint(const char* pszFileName, void* pvMeta = NULL,
+        int nMetaBytes = 0);
+
     // conversion to dtree
     DTREE* ConvertDtree(int nMaxDepth);
 
@@ -236,6 +267,10 @@ public:
     {
         return TRUE;
     }
+    virtual BOOL OnPhaseTimes(PHASETIMES* pPhaseTimes, void* pvData)
+    {
+        return TRUE;
+    }
 
     // Implementation
 public:
@@ -250,6 +285,7 @@ protected:
     ALN* m_pALN;
     ALNDATAINFO m_datainfo;
     int m_nLastError;
+    void* m_pvCheckpoint;         // pending asynchronous checkpoint
 
     static int ALNAPI ALNNotifyProc(const ALN* pALN, int nCode, void* pParam,
         void* pvData);
@@ -34,7 +34,11 @@ SOFTWARE. */
 #include <stdlib.h>
 #include <string.h>
 #include <malloc.h>
+#include <float.h>
 #include <limits>
+#include <string>
+#include <chrono>
+#include <vector>
 #define ALNAPI __stdcall
 
 
@@ -166,6 +170,108 @@ int ALNAPI ValidateALNDataInfo(const ALN* pALN,
     ALNDATAINFO* pDataInfo,
     const ALNCALLBACKINFO* pCallbackInfo);
 
+// training buffer rows are 2 * nDim + 1 columns, the sample, the closest
+// sample minus this one and the square distance to it, or nDim + 2 columns
+// in a compact buffer, the sample, the row of the closest sample (an int
+// stored in the bits of the float, -1 if none) and the square distance
+inline BOOL IsCompactTRBuffer(const ALNDATAINFO* pDataInfo)
+{
+    return (pDataInfo->nTRlayout == ALN_TRLAYOUT_COMPACT);
+}
+
+inline long GetTRClosest(const float* afltRow, int nDim)
+{
+    int nClosest;
+    memcpy(&nClosest, afltRow + nDim, sizeof(int));
+    return nClosest;
+}
+
+inline void SetTRClosest(float* afltRow, int nDim, long nClosest)
+{
+    int n = (int)nClosest;
+    memcpy(afltRow + nDim, &n, sizeof(int));
+}
+
+// adds a sample to the circular buffer, updating the closest samples
+// (alnpp.cpp)
+void ALNAPI AddTRSample(ALNDATAINFO* pDataInfo, const float* afltX, int nDim);
+
+// moves the samples queued so far into the buffer of pDataInfo, on the one
+// thread consuming the queue, after detaching the pending checkpoints of the
+// buffer; the number moved, or -1 if the queue does not suit the buffer or a
+// checkpoint could not be detached (alntrqueue.cpp)
+long ALNAPI DrainTRQueue(void* pvQueue, ALNDATAINFO* pDataInfo, int nDim);
+
+// detaches every pending checkpoint sharing the rows of the buffer of
+// pDataInfo, see ALNDetachCheckpoint; returns ALN_* error code
+// (alncheckpoint.cpp)
+int ALNAPI DetachCheckpoints(const ALNDATAINFO* pDataInfo);
+
+// rows of a training buffer store (alntrstore.cpp)
+void ALNAPI GetTRStoreRow(const void* pvStore, long nRow, int nCols, float* afltRow);
+void ALNAPI PrefetchTRStoreRow(const void* pvStore, long nRow);
+
+// the chunks and window of the epoch order of a store mapping a file, FALSE
+// if the store is in memory
+BOOL ALNAPI GetTRStoreChunks(const void* pvStore, long* pnChunkRows, long* pnWindowChunks);
+
+// which chunks of a mapped store an epoch needs: the chunks of the window
+// being trained and of the next are asked for, and those of a window are let
+// go once it is done; AdvanceTRResidency is called at each position of the
+// epoch order, StartTRResidency throws CALNMemoryException*
+struct CTRResidency
+{
+    const void* pvStore;
+    long nNextWindow;                   // position the next window starts at
+    long nNextWindowEnd;
+    std::vector<long> vecWindow;        // chunks of the window being trained
+    std::vector<long> vecNextWindow;
+};
+
+void ALNAPI StartTRResidency(CTRResidency& residency, const void* pvStore,
+    const long* anShuffle, long nSamples);
+void ALNAPI NextTRWindow(CTRResidency& residency, const long* anShuffle, long nSamples);
+
+inline void AdvanceTRResidency(CTRResidency& residency, const long* anShuffle,
+    long nSamples, long nPos)
+{
+    if (nPos == residency.nNextWindow && nPos < nSamples)
+        NextTRWindow(residency, anShuffle, nSamples);
+}
+
+// the first nCols columns of row nRow of the training buffer: a pointer into
+// afltTRdata, or afltRow filled from the store
+inline const float* GetTRRow(const ALNDATAINFO* pDataInfo, long nRow, int nCols,
+    float* afltRow)
+{
+    if (pDataInfo->pvTRstore == NULL)
+        return pDataInfo->afltTRdata + (size_t)nRow * pDataInfo->nTRcols;
+
+    GetTRStoreRow(pDataInfo->pvTRstore, nRow, nCols, afltRow);
+    return afltRow;
+}
+
+// the closest sample minus the sample of afltRow, a whole row from GetTRRow,
+// nDim values with the output last: a pointer into afltRow, or afltDiff
+// computed from the closest row of a compact buffer
+inline const float* GetTRDifference(const ALNDATAINFO* pDataInfo, int nDim,
+    const float* afltRow, float* afltDiff)
+{
+    if (!IsCompactTRBuffer(pDataInfo))
+        return afltRow + nDim;
+
+    long nClosest = GetTRClosest(afltRow, nDim);
+    if (nClosest < 0)
+    {
+        memset(afltDiff, 0, nDim * sizeof(float));
+        return afltDiff;
+    }
+    const float* afltClosest = GetTRRow(pDataInfo, nClosest, nDim, afltDiff);
+    for (int j = 0; j < nDim; j++)
+        afltDiff[j] = afltClosest[j] - afltRow[j];
+    return afltDiff;
+}
+
 // debug version ASSERTS if bad params
 #ifdef _DEBUG
 void ALNAPI DebugValidateALNDataInfo(const ALN* pALN,
@@ -219,6 +325,54 @@ struct CCutoffInfo
     float fltValue;
 };
 
+// evaluation statistics (alnevalstats.cpp)
+// the STATS_* macros are statements that do nothing unless ALNSTATS is
+// defined, so they can be the body of an if
+#ifdef ALNSTATS
+extern thread_local ALNEVALSTATS EvalStats;    // totals of this thread
+extern thread_local const ALN* pNodeStatsALN;  // ALN counted per node on this thread
+
+// a whole tree was evaluated with pActiveLFN active
+void ALNAPI CountTreeEval(const ALNNODE* pTree, const ALNNODE* pActiveLFN);
+
+// counts of an epoch: MarkEvalStats at the start, GetEvalStatsSinceMark at the end
+void ALNAPI MarkEvalStats(ALNEVALSTATS& statsMark);
+void ALNAPI GetEvalStatsSinceMark(const ALNEVALSTATS& statsMark, ALNEVALSTATS& statsSince);
+
+#define STATS_TREEEVAL(pTree, pActiveLFN) CountTreeEval(pTree, pActiveLFN)
+#define STATS_NODEEVAL(pALN, pNode, nTotal) \
+    do { EvalStats.nTotal++; if ((pALN) == pNodeStatsALN) ((ALNNODE*)(pNode))->Stats.nEvals++; } while (0)
+#define STATS_LEAFEVAL(pALN, pNode) STATS_NODEEVAL(pALN, pNode, nLeafEvals)
+#define STATS_MINMAXEVAL(pALN, pNode) STATS_NODEEVAL(pALN, pNode, nMinMaxEvals)
+#define STATS_ALPHABETACUTOFF(pALN, pSkipped) \
+    do { EvalStats.nAlphaBetaCutoffs++; if ((pALN) == pNodeStatsALN) ((ALNNODE*)(pSkipped))->Stats.nAlphaBetaCutoffs++; } while (0)
+#define STATS_DISTANCECUTOFF(pALN, pSkipped) \
+    do { EvalStats.nDistanceCutoffs++; if ((pALN) == pNodeStatsALN) ((ALNNODE*)(pSkipped))->Stats.nDistanceCutoffs++; } while (0)
+#define STATS_ROUTETEST(pALN, pNode, bAgree) \
+    do { BOOL bStatsMiss = !(bAgree); EvalStats.nRouteTests++; EvalStats.nRouteMisses += bStatsMiss; \
+      if ((pALN) == pNodeStatsALN) { ((ALNNODE*)(pNode))->Stats.nRouteTests++; ((ALNNODE*)(pNode))->Stats.nRouteMisses += bStatsMiss; } } while (0)
+#else
+#define STATS_TREEEVAL(pTree, pActiveLFN) ((void)0)
+#define STATS_LEAFEVAL(pALN, pNode) ((void)0)
+#define STATS_MINMAXEVAL(pALN, pNode) ((void)0)
+#define STATS_ALPHABETACUTOFF(pALN, pSkipped) ((void)0)
+#define STATS_DISTANCECUTOFF(pALN, pSkipped) ((void)0)
+#define STATS_ROUTETEST(pALN, pNode, bAgree) ((void)0)
+#endif
+
+// value of an LFN at afltX: the bias weight plus the dot product of the
+// other weights with afltX
+inline float LFNValue(const ALNNODE* pNode, const float* afltX, int nDim)
+{
+    const float* afltW = LFN_W(pNode);
+    float fltA = *afltW++;                 // skip past bias weight
+    for (int i = 0; i < nDim; i++)
+    {
+        fltA += afltW[i] * afltX[i];
+    }
+    return fltA;
+}
+
 // LFN specific eval - returns distance to surface
 //  - non-destructive, ie, does not change ALN structure
 float ALNAPI CutoffEvalLFN(const ALNNODE* pNode, const ALN* pALN,
@@ -341,6 +495,35 @@ float ALNAPI DoCalcRMSError(const ALN* pALN,
     ALNDATAINFO* pDataInfo,
     const ALNCALLBACKINFO* pCallbackInfo);
 
+// training context (alncontext.cpp)
+// the globals the application defines are the settings of an ALN without a
+// context of its own; ALNTrain works on a copy, see ALNGetTrainContext
+extern BOOL bClassify2;
+extern BOOL bAlphaBeta;
+extern BOOL bDistanceOptimization;
+
+// puts nSplitCount and bStopTraining of a run back where they came from
+void ALNAPI UpdateTrainContext(ALN* pALN, const ALNTRAINCONTEXT& context);
+
+// replaces the globals, for a checkpoint of an ALN without a context
+void ALNAPI SetGlobalTrainContext(const ALNTRAINCONTEXT& context);
+
+// settings read in evaluation and adaptation
+inline BOOL UseAlphaBeta(const ALN* pALN)
+{
+    return (pALN->pTrainContext != NULL) ? pALN->pTrainContext->bAlphaBeta : bAlphaBeta;
+}
+
+inline BOOL UseDistanceOptimization(const ALN* pALN)
+{
+    return (pALN->pTrainContext != NULL) ? pALN->pTrainContext->bDistanceOptimization : bDistanceOptimization;
+}
+
+inline BOOL IsClassify2(const ALN* pALN)
+{
+    return (pALN->pTrainContext != NULL) ? pALN->pTrainContext->bClassify2 : bClassify2;
+}
+
 // callback - throws CALNUserException if callback returns 0
 inline BOOL CanCallback(int nCode, ALNNOTIFYPROC pfnNotifyProc,
     int nNotifyMask)
@@ -357,11 +540,173 @@ inline void Callback(const ALN* pALN, int nCode, void* pParam,
     }
 }
 
-// jitter
-void ALNAPI Jitter(ALN* pALN, float* afltX);
+// jitter of sample nSample in the epoch of key nKey
+void ALNAPI Jitter(ALN* pALN, float* afltX, unsigned long long nKey, long nSample);
+
+// counter-based random streams (alnrand.cpp); the numbers of a stream
+// depend only on its key and two indexes, not on the thread drawing them
+typedef struct tagRANDSTREAM
+{
+    unsigned int anKey[2];
+    unsigned int anIndex[2];
+    unsigned long long nBlock;      // next block of four numbers
+    unsigned int anBlock[4];        // current block
+    int nNext;                      // next number of anBlock, 4 when used
+} RANDSTREAM;
+
+// stream purposes, the first index of the streams of an epoch
+#define RANDSTREAM_SHUFFLE 1
+#define RANDSTREAM_JITTER 2
+#define RANDSTREAM_MODEL 3
+
+void ALNAPI InitRandStream(RANDSTREAM* pStream, unsigned long long nKey,
+    unsigned int nIndex0, unsigned int nIndex1);
+unsigned int ALNAPI RandStreamNext(RANDSTREAM* pStream);
+void ALNAPI RandStreamFloats(RANDSTREAM* pStream, float* aflt, int n);
+
+// a key for the streams of an epoch, from the sequence of the thread
+unsigned long long ALNAPI RandKey();
+
+// restarts the sequence of the calling thread from nSeed, other threads and
+// the seed of ALNSRand are unchanged
+void ALNAPI SeedThreadRand(unsigned long long nSeed);
+
+// random generator state of the thread, saved in checkpoints
+void ALNAPI GetRandState(std::string& strState);
+BOOL ALNAPI SetRandState(const std::string& strState);
+
+// frees a node and its subtree (alnmem.cpp)
+int ALNAPI DestroyTree(ALNNODE* pTree);
+
+// deep copy of an ALN, throws CALNMemoryException* (alnmem.cpp)
+ALN* ALNAPI DuplicateALN(const ALN* pALN);
+
+// copies the tree of an ALN in depth first order, so each first child follows
+// its parent in memory; pointers into the old tree are invalid afterwards,
+// throws CALNMemoryException*, leaving the tree as it was (alnmem.cpp)
+void ALNAPI RelayoutTree(ALN* pALN);
+
+// marks a change to the tree or the weights of an ALN, which makes the
+// results of it kept by evaluation caches stale (alncache.cpp)
+inline void NewGeneration(ALN* pALN)
+{
+    pALN->nGeneration++;
+}
+
+// n-ary minmax nodes (alnmem.cpp)
+// allocates a zeroed child array, FALSE if out of memory
+BOOL ALNAPI AllocMinMaxChildren(ALNNODE* pNode, int nChildren);
+// splits an LFN by adding a copy of it to its parent's children
+int ALNAPI AddSiblingLFN(ALN* pALN, ALNNODE* pLFN);
+// merges minmax nodes into parents of the same type throughout a subtree
+int ALNAPI MergeMinMaxChains(ALNNODE* pNode);
+// removes a child, a node left with one child is replaced by it
+ALNNODE* ALNAPI RemoveMinMaxChild(ALN* pALN, ALNNODE* pNode, int nChild);
+
+// subtree bounds for exact distance cutoffs (alnbounds.cpp)
+// MINMAX_BOUNDS holds the least and greatest value of the subtree over a box,
+// the box, which covers the samples the subtree is responsible for, and the
+// range of each LFN weight in the subtree
+#define BOUNDS_SIZE(nDim) (4 * (nDim) + 2)
+#define BOUNDS_MIN(afltB) ((afltB)[0])
+#define BOUNDS_MAX(afltB) ((afltB)[1])
+#define BOUNDS_BOXMIN(afltB) ((afltB) + 2)
+#define BOUNDS_BOXMAX(afltB, nDim) ((afltB) + 2 + (nDim))
+#define BOUNDS_WMIN(afltB, nDim) ((afltB) + 2 + 2 * (nDim))
+#define BOUNDS_WMAX(afltB, nDim) ((afltB) + 2 + 3 * (nDim))
+// relative rounding allowance of the bounds, per dimension
+#define BOUNDS_TOLERANCE (8 * FLT_EPSILON)
+
+// computes the bounds of every minmax node; without data the boxes only cover
+// the LFN centroids, throws CALNMemoryException*
+void ALNAPI UpdateBounds(ALN* pALN, ALNDATAINFO* pDataInfo,
+    const ALNCALLBACKINFO* pCallbackInfo);
+// recomputes the bounds over the boxes the nodes have, without data, for
+// changed weights; throws CALNMemoryException*
+void ALNAPI RefreshBounds(ALN* pALN);
+
+// clears GF_BOUNDS on a node and its ancestors after a change below it;
+// a node without valid bounds never has an ancestor with them
+inline void InvalidateBounds(ALNNODE* pNode)
+{
+    for (; pNode != NULL && (pNode->fNode & GF_BOUNDS); pNode = NODE_PARENT(pNode))
+    {
+        pNode->fNode &= ~GF_BOUNDS;
+    }
+}
+
+// routing tests of minmax nodes with two children (alnroute.cpp)
+// the right child goes first where the routing value is positive; the full
+// value is the dot product with the normal, the routing test keeps only the
+// terms that decide the order on the training samples
+inline float NormalRouteValue(const ALNNODE* pNode, const float* afltX, int nDim)
+{
+    const float* afltN = MINMAX_NORMAL(pNode);
+    float flt = 0;
+    for (int i = 0; i < nDim - 1; i++)
+    {
+        flt += afltN[i] * afltX[i];
+    }
+    return flt + MINMAX_THRESHOLD(pNode);
+}
+
+inline float SparseRouteValue(const ALNROUTE* pRoute, const float* afltX)
+{
+    float flt = pRoute->fltThreshold;
+    for (int i = 0; i < pRoute->nTerms; i++)
+    {
+        flt += pRoute->afltW[i] * afltX[pRoute->anVar[i]];
+    }
+    return flt;
+}
 
-// shuffle
-void ALNAPI Shuffle(long nStart, long nEnd, long* anShuffle);
+// chooses the routing test of each minmax node with two children after doSplits
+// has set the normals; apActiveLFN holds the active LFN of each training sample
+// before the splits, throws CALNMemoryException*
+void ALNAPI UpdateRoutes(ALN* pALN, const ALNDATAINFO* pDataInfo,
+    ALNNODE* const* apActiveLFN);
+
+// order of the samples of an epoch, drawn from the stream of the epoch of key
+// nKey; a full shuffle if nBlock <= 1, else blocks of nBlock neighbouring rows
+// in random order, the rows of each window of nWindow blocks in random order
+void ALNAPI Shuffle(long nStart, long nEnd, long* anShuffle, unsigned long long nKey,
+    long nBlock, long nWindow = 1);
+
+// phase timing of training and trace export (alnphasetimes.cpp)
+BOOL ALNAPI IsTraceOpen();
+void ALNAPI TraceEvent(const char* pszName,
+    std::chrono::steady_clock::time_point timeStart,
+    std::chrono::steady_clock::time_point timeEnd,
+    const char* pszArgs = NULL);  // pszArgs is a JSON object or NULL
+
+// reads the clock only when enabled, so untimed training pays nothing;
+// Lap adds the time since the last Start or Lap to a phase total, and
+// writes a trace span for it if pszTrace is given and a trace is open
+struct CPhaseClock
+{
+    BOOL bEnabled;
+    std::chrono::steady_clock::time_point timeLast;
+
+    CPhaseClock(BOOL bEnable) : bEnabled(bEnable) {}
+
+    void Start()
+    {
+        if (bEnabled)
+            timeLast = std::chrono::steady_clock::now();
+    }
+
+    void Lap(double& dblSeconds, const char* pszTrace = NULL)
+    {
+        if (bEnabled)
+        {
+            std::chrono::steady_clock::time_point time = std::chrono::steady_clock::now();
+            dblSeconds += std::chrono::duration<double>(time - timeLast).count();
+            if (pszTrace != NULL && IsTraceOpen())
+                TraceEvent(pszTrace, timeLast, time);
+            timeLast = time;
+        }
+    }
+};
 
 // training context info
 typedef struct tagTRAINDATA
@@ -371,6 +716,7 @@ typedef struct tagTRAINDATA
     void* pvData;
     float fltLearnRate;
     float fltGlobalError;
+    BOOL bLearnFactors;       // the pieces scale fltLearnRate by their own factors
 } TRAINDATA;
 
 
@@ -391,6 +737,10 @@ void ALNAPI AdaptLFN(ALNNODE* pNode, ALN* pALN, const float* afltX,
     float fltResponse, BOOL bUsefulAdapt,
     const TRAINDATA* ptdata);
 
+// sets the learning rate factors of the pieces from their adapts in the
+// epoch just ended, and clears the counts for the next
+void ALNAPI UpdateLearnFactors(ALNNODE* pNode);
+
 // generic adapt routine
 inline void Adapt(ALNNODE* pNode, ALN* pALN, const float* afltX,
     float fltResponse, BOOL bUsefulAdapt,
@@ -402,7 +752,7 @@ inline void Adapt(ALNNODE* pNode, ALN* pALN, const float* afltX,
 }
 
 // split routines
-int ALNAPI SplitLFN(ALN* pALN, ALNNODE* pNode);
+int ALNAPI SplitLFN(ALN* pALN, ALNNODE* pNode, const ALNTRAINCONTEXT* pContext);
 
 ///////////////////////////////////////////////////////////////////////////////
 // DTREE conversion routines
@@ -45,12 +45,23 @@ SOFTWARE. */
 
 // Version 0x00030008->9 allowed trees to be of arbitrary structure not just alternating AND/OR
 // Version 0x00030009->10 changed SEy to SEE to avoid confusion.
+// Version 0x00030010->11 added the learning rate factors of the pieces and allowed minmax nodes
+// with more than two children.
 
-#define ALNVER 0x00030010
+#define ALNVER 0x00030011
 
 #endif  /* ALNVER */
 
 
+/* checkpoint format version, separate from that of the ALN files */
+
+#ifndef ALNCKPVER
+
+#define ALNCKPVER 0x00000001
+
+#endif  /* ALNCKPVER */
+
+
 /*
 ///////////////////////////////////////////////////////////////////////////////
 */
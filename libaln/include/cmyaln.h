@@ -60,6 +60,14 @@ public:
     virtual BOOL OnEpochEnd(EPOCHINFO* pEpochInfo, void* pvData)
     {
         //std::cerr << " Leaf nodes " << pEpochInfo->nLFNs << " Active leaf nodes " << pEpochInfo->nActiveLFNs;
+        const ALNEVALSTATS* pStats = pEpochInfo->pEvalStats; // NULL unless libaln is built with ALNSTATS
+        if (pStats != NULL && pStats->nEvals > 0)
+        {
+            std::cerr << " Leaves/sample " << (float)pStats->nLeafEvals / pStats->nEvals
+                << " Cutoffs AB " << pStats->nAlphaBetaCutoffs << " dist " << pStats->nDistanceCutoffs
+                << " Route misses " << pStats->nRouteMisses << "/" << pStats->nRouteTests
+                << " Depth " << (float)pStats->nActiveDepth / pStats->nEvals;
+        }
         return TRUE;
     }
 
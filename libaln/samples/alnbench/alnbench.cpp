@@ -0,0 +1,396 @@
+// Hardware counter benchmark for training and evaluation
+
+/* MIT License
+
+Copyright (c) 2020 William Ward Armstrong
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+// alnbench.cpp
+
+// This program trains a growing ALN and evaluates it while reading the processor's hardware counters
+// (cycles, instructions, L1 data cache and last level cache misses, branch misses) around named regions:
+//   Eval      filling the input vector and the adapt evaluation of each training sample (AdaptEval)
+//   Adapt     adapting the tree to each sample (Adapt, mostly AdaptLFN)
+//   Train     whole calls to ALNTrain, so the rest is the end of epoch work and splitting
+//   QuickEval ALNQuickEvalBatch over the training set (mostly CutoffEvalMinMax)
+//   Reordered the same after ALNReorder has profiled the training set, with -r
+// The sample regions are bounded by the AN_EPOCHSTART, AN_ADAPTSTART and AN_ADAPTEND notifications.
+// Counts are reported per sample and, when the library is built with ALNSTATS, per leaf evaluated.
+// Counts are of user mode only, but the seconds of Eval and Adapt include reading the counters, which is a
+// system call at every boundary.
+// Where the counters cannot be opened (other systems, containers, perf_event_paranoid) the reason is
+// printed and only times are reported.
+// The data is a file of floats whose last column is the output, or a synthetic function of nDim - 1 inputs.
+// Usage: alnbench [-f data_file | -d nDim -s samples] [-i iterations] [-e epochs] [-q eval_passes] [-r]
+
+#include "aln.h"
+#include "alnpp.h"
+#include "datafile.h"
+#include "perfcounters.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+
+BOOL bClassify2 = FALSE;
+BOOL bConvex = FALSE;
+BOOL bAlphaBeta = TRUE;
+BOOL bDistanceOptimization = FALSE;
+float WeightDecay = 1.0F;
+float WeightBound = FLT_MAX;
+int SplitsAllowed = 75;
+int SplitCount = 0;
+void setSplitAlpha(ALNDATAINFO* pdata);
+
+enum
+{
+    REGION_EVAL,
+    REGION_ADAPT,
+    REGION_TRAIN,
+    REGION_QUICKEVAL,
+    REGION_REORDERED,
+    REGION_N
+};
+
+static const char* const aszRegionName[REGION_N] = { "Eval", "Adapt", "Train", "QuickEval", "Reordered" };
+
+// totals of a region over all its passes
+struct CRegion
+{
+    long long nPasses;
+    long long nSamples;
+    double dblSeconds;
+    double adblCount[PERF_NCOUNTERS];
+    long long nLeafEvals;
+
+    CRegion() : nPasses(0), nSamples(0), dblSeconds(0), nLeafEvals(0)
+    {
+        memset(adblCount, 0, sizeof(adblCount));
+    }
+};
+
+// counters and clock at one moment
+struct CMark
+{
+    std::chrono::steady_clock::time_point time;
+    double adblCount[PERF_NCOUNTERS];
+    ALNEVALSTATS stats;
+};
+
+class CBench : public CAln
+{
+public:
+    CBench(CPerfCounters& counters) : m_counters(counters) {}
+
+    void Mark(CMark& mark)
+    {
+        m_counters.Read(mark.adblCount);
+        ALNGetEvalStats(&mark.stats);   // zeroes without ALNSTATS
+        mark.time = std::chrono::steady_clock::now();
+    }
+
+    // adds what happened since markStart to a region, and starts the next region there
+    void Accumulate(int nRegion, CMark& markStart, long long nSamples)
+    {
+        CMark markEnd;
+        Mark(markEnd);
+        CRegion& region = m_aRegion[nRegion];
+        region.nPasses++;
+        region.nSamples += nSamples;
+        region.dblSeconds += std::chrono::duration<double>(markEnd.time - markStart.time).count();
+        for (int i = 0; i < PERF_NCOUNTERS; i++)
+        {
+            region.adblCount[i] += markEnd.adblCount[i] - markStart.adblCount[i];
+        }
+        region.nLeafEvals += markEnd.stats.nLeafEvals - markStart.stats.nLeafEvals;
+        markStart = markEnd;
+    }
+
+    virtual BOOL OnEpochStart(EPOCHINFO* pEpochInfo, void* pvData)
+    {
+        Mark(m_markSample);
+        return TRUE;
+    }
+
+    virtual BOOL OnAdaptStart(ADAPTINFO* pAdaptInfo, void* pvData)
+    {
+        Accumulate(REGION_EVAL, m_markSample, 1);
+        return TRUE;
+    }
+
+    virtual BOOL OnAdaptEnd(ADAPTINFO* pAdaptInfo, void* pvData)
+    {
+        Accumulate(REGION_ADAPT, m_markSample, 1);
+        return TRUE;
+    }
+
+    CRegion m_aRegion[REGION_N];
+
+private:
+    CPerfCounters& m_counters;
+    CMark m_markSample;
+};
+
+static void PrintRate(double dblCount, long long nPer, int nWidth = 12)
+{
+    if (nPer > 0)
+        std::cout << std::setw(nWidth) << dblCount / nPer;
+    else
+        std::cout << std::setw(nWidth) << "-";
+}
+
+static void PrintReport(const CRegion* aRegion, const CPerfCounters& counters, bool bStats)
+{
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << std::endl << std::left << std::setw(12) << "region" << std::right << std::setw(10) << "passes"
+        << std::setw(12) << "samples" << std::setw(12) << "seconds" << std::setw(12) << "leaves/smp";
+    if (counters.IsOpen())
+        std::cout << std::setw(12) << "IPC";
+    std::cout << std::endl;
+    for (int r = 0; r < REGION_N; r++)
+    {
+        const CRegion& region = aRegion[r];
+        if (region.nPasses == 0)
+            continue;
+        std::cout << std::left << std::setw(12) << aszRegionName[r] << std::right << std::setw(10) << region.nPasses
+            << std::setw(12) << region.nSamples << std::setw(12) << std::setprecision(4) << region.dblSeconds
+            << std::setprecision(1);
+        PrintRate((double)region.nLeafEvals, bStats ? region.nSamples : 0);
+        if (counters.IsOpen())
+        {
+            if (region.adblCount[PERF_CYCLES] > 0)
+                std::cout << std::setw(12) << std::setprecision(2)
+                << region.adblCount[PERF_INSTRUCTIONS] / region.adblCount[PERF_CYCLES] << std::setprecision(1);
+            else
+                std::cout << std::setw(12) << "-";
+        }
+        std::cout << std::endl;
+    }
+    if (!counters.IsOpen())
+        return;
+
+    // one table of rates per sample, one per leaf evaluated
+    for (int nTable = 0; nTable < (bStats ? 2 : 1); nTable++)
+    {
+        std::cout << std::endl << std::left << std::setw(12) << (nTable == 0 ? "per sample" : "per leaf") << std::right;
+        for (int i = 0; i < PERF_NCOUNTERS; i++)
+        {
+            std::cout << std::setw(15) << aszPerfCounterName[i];
+        }
+        std::cout << std::endl;
+        for (int r = 0; r < REGION_N; r++)
+        {
+            const CRegion& region = aRegion[r];
+            if (region.nPasses == 0)
+                continue;
+            std::cout << std::left << std::setw(12) << aszRegionName[r] << std::right;
+            for (int i = 0; i < PERF_NCOUNTERS; i++)
+            {
+                if (counters.IsCounting(i))
+                    PrintRate(region.adblCount[i], (nTable == 0) ? region.nSamples : region.nLeafEvals, 15);
+                else
+                    std::cout << std::setw(15) << "-";
+            }
+            std::cout << std::endl;
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const char* pszFile = NULL;
+    int nDim = 3;
+    long nSamples = 5000;
+    int nIterations = 10;
+    int nEpochs = 10;
+    int nEvalPasses = 5;
+    bool bReorder = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) pszFile = argv[++i];
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) nDim = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) nSamples = atol(argv[++i]);
+        else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) nIterations = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) nEpochs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) nEvalPasses = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0) bReorder = true;
+        else nDim = 0, i = argc;    // unexpected argument
+    }
+    if (nDim < 2 || nSamples < 1 || nIterations < 1 || nEpochs < 1 || nEvalPasses < 0)
+    {
+        std::cout << "Usage: alnbench [-f data_file | -d nDim -s samples] [-i iterations] [-e epochs] [-q eval_passes] [-r]"
+            << std::endl;
+        return 1;
+    }
+
+    CDataFile file;
+    if (pszFile != NULL)
+    {
+        if (!file.Read(pszFile))
+        {
+            std::cout << "Reading data file " << pszFile << " failed!" << std::endl;
+            return 1;
+        }
+        nDim = file.ColumnCount();
+        nSamples = file.RowCount();
+        if (nDim < 2 || nSamples < 1)
+        {
+            std::cout << "The data file needs at least two columns and one row" << std::endl;
+            return 1;
+        }
+    }
+
+    CPerfCounters counters;
+    if (counters.Open())
+    {
+        std::cout << "Hardware counters:";
+        for (int i = 0; i < PERF_NCOUNTERS; i++)
+        {
+            if (counters.IsCounting(i))
+                std::cout << " " << aszPerfCounterName[i];
+        }
+        std::cout << std::endl;
+        if (!counters.GetError().empty())
+            std::cout << "Not counted: " << counters.GetError() << std::endl;
+    }
+    else
+    {
+        std::cout << "Hardware counters unavailable (" << counters.GetError() << "), reporting times only" << std::endl;
+    }
+    bool bStats = (ALNResetEvalStats(NULL) == ALN_NOERROR);
+    if (!bStats)
+        std::cout << "The library was built without ALNSTATS, no per leaf rates" << std::endl;
+
+    CBench aln(counters);
+    if (!aln.Create(nDim, nDim - 1))
+    {
+        std::cout << "Creating ALN failed!" << std::endl;
+        return 1;
+    }
+    aln.SetGrowable(aln.GetTree());
+    for (int m = 0; m < nDim - 1; m++)
+    {
+        aln.SetEpsilon(0.01F, m);
+    }
+
+    ALNDATAINFO* pdata = aln.GetDataInfo();
+    pdata->nTRmaxSamples = nSamples;
+    pdata->nTRcurrSamples = 0;
+    pdata->nTRcols = 2 * nDim + 1;
+    pdata->nTRinsert = 0;
+    pdata->fltMSEorF = -90;     // F-test at 90% confidence
+    setSplitAlpha(pdata);
+
+    // the synthetic function is a product of waves, so the tree keeps splitting
+    std::vector<float> vecX(nDim);
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<float> distribution(0.0F, 1.0F);
+    for (long i = 0; i < nSamples; i++)
+    {
+        if (pszFile != NULL)
+        {
+            for (int j = 0; j < nDim; j++)
+            {
+                vecX[j] = file.GetAt(i, j, 0);
+            }
+        }
+        else
+        {
+            float fltY = 1.0F;
+            for (int j = 0; j < nDim - 1; j++)
+            {
+                vecX[j] = distribution(generator);
+                fltY *= sinf(3.0F * (j + 2) * vecX[j]);
+            }
+            vecX[nDim - 1] = fltY;
+        }
+        aln.addTRsample(vecX.data(), nDim);
+    }
+    std::cout << "Training on " << pdata->nTRcurrSamples << " samples of dimension " << nDim << std::endl;
+
+    // the training samples, without the output, for evaluation
+    std::vector<float> vecEvalX((size_t)pdata->nTRcurrSamples * nDim);
+    for (long i = 0; i < pdata->nTRcurrSamples; i++)
+    {
+        memcpy(&vecEvalX[(size_t)i * nDim], pdata->afltTRdata + (size_t)i * pdata->nTRcols, nDim * sizeof(float));
+    }
+    std::vector<float> vecResult(pdata->nTRcurrSamples);
+
+    for (int nIteration = 0; nIteration < nIterations; nIteration++)
+    {
+        CMark mark;
+        aln.Mark(mark);
+        aln.Train(nEpochs, 0.0F, 0.2F, FALSE, AN_EPOCHSTART | AN_ADAPTSTART | AN_ADAPTEND);
+        aln.Accumulate(REGION_TRAIN, mark, (long long)nEpochs * pdata->nTRcurrSamples);
+
+        for (int nPass = 0; nPass < nEvalPasses; nPass++)
+        {
+            aln.Mark(mark);
+            ALNQuickEvalBatch(aln.GetALN(), vecEvalX.data(), pdata->nTRcurrSamples, vecResult.data(), NULL);
+            aln.Accumulate(REGION_QUICKEVAL, mark, pdata->nTRcurrSamples);
+        }
+
+        std::cout << "Iteration " << nIteration;
+        if (nEvalPasses > 0)
+        {
+            double dblSqErr = 0;
+            for (long i = 0; i < pdata->nTRcurrSamples; i++)
+            {
+                double dbl = vecResult[i] - pdata->afltTRdata[(size_t)i * pdata->nTRcols + nDim - 1];
+                dblSqErr += dbl * dbl;
+            }
+            std::cout << ", RMS error " << sqrt(dblSqErr / pdata->nTRcurrSamples);
+        }
+        std::cout << std::endl;
+        SplitsAllowed += 75;
+    }
+
+    // the same evaluation with the children in the order they win on the training set
+    if (bReorder)
+    {
+        ALNREORDERINFO reorderinfo;
+        if (!aln.Reorder(&reorderinfo))
+        {
+            std::cout << "Reordering failed!" << std::endl;
+            return 1;
+        }
+        std::cout << "Reordered " << reorderinfo.nReordered << " nodes, " << reorderinfo.nStoredOrder
+            << " evaluate in stored order, " << reorderinfo.nRouted << " by routing test";
+        if (bStats)
+            std::cout << ", leaves/sample " << reorderinfo.fltLeavesBefore << " -> " << reorderinfo.fltLeavesAfter;
+        std::cout << std::endl;
+
+        for (int nPass = 0; nPass < nEvalPasses; nPass++)
+        {
+            CMark mark;
+            aln.Mark(mark);
+            ALNQuickEvalBatch(aln.GetALN(), vecEvalX.data(), pdata->nTRcurrSamples, vecResult.data(), NULL);
+            aln.Accumulate(REGION_REORDERED, mark, pdata->nTRcurrSamples);
+        }
+    }
+
+    PrintReport(aln.m_aRegion, counters, bStats);
+    return 0;
+}
@@ -0,0 +1,200 @@
+// Hardware performance counters for alnbench
+
+/* MIT License
+
+Copyright (c) 2020 William Ward Armstrong
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+// perfcounters.h
+
+// A group of hardware counters of the calling thread, read through the Linux perf_event_open system call.
+// Counters the processor or the kernel does not offer are left out; in containers and on other systems,
+// where perf_event_open is refused or does not exist, Open fails and the reason is kept for the report.
+// Counts are of user mode only and are scaled up when the kernel multiplexes the counters.
+
+#ifndef __PERFCOUNTERS_H__
+#define __PERFCOUNTERS_H__
+
+#include <string.h>
+#include <string>
+
+#ifdef __linux__
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+enum
+{
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1DMISSES,
+    PERF_LLCMISSES,
+    PERF_BRANCHMISSES,
+    PERF_NCOUNTERS
+};
+
+static const char* const aszPerfCounterName[PERF_NCOUNTERS] =
+{
+    "cycles", "instructions", "L1D misses", "LLC misses", "branch misses"
+};
+
+class CPerfCounters
+{
+public:
+    CPerfCounters()
+    {
+        m_fdLeader = -1;
+        m_nOpen = 0;
+        for (int i = 0; i < PERF_NCOUNTERS; i++)
+        {
+            m_afd[i] = -1;
+            m_anSlot[i] = -1;
+        }
+    }
+
+    ~CPerfCounters()
+    {
+        Close();
+    }
+
+    // opens and starts the counters, false if none is available
+    bool Open()
+    {
+#ifdef __linux__
+        static const unsigned int anType[PERF_NCOUNTERS] =
+        {
+            PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE
+        };
+        static const unsigned long long anConfig[PERF_NCOUNTERS] =
+        {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES
+        };
+
+        for (int i = 0; i < PERF_NCOUNTERS; i++)
+        {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = anType[i];
+            attr.config = anConfig[i];
+            attr.disabled = (m_fdLeader == -1);    // the group starts together
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            int fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, m_fdLeader, 0);
+            if (fd == -1)
+            {
+                if (m_strError.empty())
+                    m_strError = std::string(aszPerfCounterName[i]) + ": " + strerror(errno);
+                continue;
+            }
+            if (m_fdLeader == -1)
+                m_fdLeader = fd;
+            m_afd[i] = fd;
+            m_anSlot[i] = m_nOpen++;
+        }
+        if (m_fdLeader == -1)
+            return false;
+
+        ioctl(m_fdLeader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(m_fdLeader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        return true;
+#else
+        m_strError = "perf_event_open is only available on Linux";
+        return false;
+#endif
+    }
+
+    void Close()
+    {
+#ifdef __linux__
+        for (int i = 0; i < PERF_NCOUNTERS; i++)
+        {
+            if (m_afd[i] != -1)
+                close(m_afd[i]);
+            m_afd[i] = -1;
+            m_anSlot[i] = -1;
+        }
+#endif
+        m_fdLeader = -1;
+        m_nOpen = 0;
+    }
+
+    bool IsOpen() const
+    {
+        return m_fdLeader != -1;
+    }
+
+    bool IsCounting(int nCounter) const
+    {
+        return m_anSlot[nCounter] != -1;
+    }
+
+    // why Open failed, or why the first missing counter is missing
+    const std::string& GetError() const
+    {
+        return m_strError;
+    }
+
+    // current counts, 0 for counters which are not available
+    bool Read(double adblCount[PERF_NCOUNTERS]) const
+    {
+        for (int i = 0; i < PERF_NCOUNTERS; i++)
+        {
+            adblCount[i] = 0;
+        }
+#ifdef __linux__
+        if (m_fdLeader == -1)
+            return false;
+
+        // nr, time enabled, time running, then a value for each counter of the group
+        unsigned long long anBuffer[3 + PERF_NCOUNTERS];
+        if (read(m_fdLeader, anBuffer, sizeof(anBuffer)) < (ssize_t)(3 * sizeof(unsigned long long)))
+            return false;
+
+        double dblScale = (anBuffer[2] > 0) ? (double)anBuffer[1] / anBuffer[2] : 0.0;
+        for (int i = 0; i < PERF_NCOUNTERS; i++)
+        {
+            if (m_anSlot[i] != -1 && m_anSlot[i] < (int)anBuffer[0])
+                adblCount[i] = anBuffer[3 + m_anSlot[i]] * dblScale;
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
+
+private:
+    int m_fdLeader;
+    int m_afd[PERF_NCOUNTERS];
+    int m_anSlot[PERF_NCOUNTERS];   // position of the counter in a group read, -1 if missing
+    int m_nOpen;
+    std::string m_strError;
+};
+
+#endif  // __PERFCOUNTERS_H__
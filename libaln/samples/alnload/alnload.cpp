@@ -0,0 +1,180 @@
+// Load generator for alnserve
+
+/* MIT License
+
+Copyright (c) 2020 William Ward Armstrong
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+// alnload.cpp
+
+// This program opens a number of connections to alnserve, each sending random input vectors one
+// request at a time, and reports the latency percentiles of the requests and the total throughput.
+// Input values are uniform in [fltMin, fltMax]. With more connections than the server's maximum
+// batch size the batches fill up; with fewer, the latency budget decides when a batch goes.
+// Usage: alnload (-u socket_path | -p port) -d nDim [-c connections] [-n requests_per_connection]
+//                [-r fltMin fltMax]
+
+#include "../alnserve/alnsock.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+struct CLoadResult
+{
+    std::vector<float> vecLatency;    // microseconds
+    long nErrors;
+    bool bFailed;
+};
+
+static void RunConnection(const char* pszPath, int nPort, int nDim, int nRequests,
+    float fltMin, float fltMax, unsigned int nSeed, CLoadResult* pResult)
+{
+    pResult->nErrors = 0;
+    pResult->bFailed = false;
+    pResult->vecLatency.reserve(nRequests);
+
+    ALNSOCKET s = OpenSocket(pszPath, nPort, false);
+    if (s == ALNSOCK_INVALID)
+    {
+        pResult->bFailed = true;
+        return;
+    }
+
+    std::mt19937 generator(nSeed);
+    std::uniform_real_distribution<float> distribution(fltMin, fltMax);
+
+    // one buffer holds the count and the vector, so a request is a single send
+    std::vector<char> vecRequest(sizeof(int) + nDim * sizeof(float));
+    memcpy(vecRequest.data(), &nDim, sizeof(int));
+    float* afltX = (float*)(vecRequest.data() + sizeof(int));
+
+    for (int i = 0; i < nRequests; i++)
+    {
+        for (int j = 0; j < nDim; j++)
+        {
+            afltX[j] = distribution(generator);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        struct
+        {
+            float fltValue;
+            int nId;
+        } reply;
+        if (!SendAll(s, vecRequest.data(), (int)vecRequest.size()) || !RecvAll(s, &reply, sizeof(reply)))
+        {
+            pResult->bFailed = true;
+            break;
+        }
+        auto finish = std::chrono::steady_clock::now();
+
+        if (reply.nId < 0)
+            pResult->nErrors++;
+        pResult->vecLatency.push_back(std::chrono::duration<float, std::micro>(finish - start).count());
+    }
+    CloseSocket(s);
+}
+
+static float Percentile(const std::vector<float>& vecSorted, double dblP)
+{
+    if (vecSorted.empty())
+        return 0;
+    size_t n = (size_t)(dblP * (vecSorted.size() - 1) + 0.5);
+    return vecSorted[n];
+}
+
+int main(int argc, char* argv[])
+{
+    const char* pszPath = NULL;
+    int nPort = 0;
+    int nDim = 0;
+    int nConnections = 8;
+    int nRequests = 10000;
+    float fltMin = 0.0F;
+    float fltMax = 1.0F;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-u") == 0 && i + 1 < argc) pszPath = argv[++i];
+        else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) nPort = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) nDim = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) nConnections = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) nRequests = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0 && i + 2 < argc)
+        {
+            fltMin = (float)atof(argv[++i]);
+            fltMax = (float)atof(argv[++i]);
+        }
+        else nDim = 0, i = argc;    // unexpected argument
+    }
+    if ((pszPath == NULL && nPort <= 0) || nDim <= 0 || nConnections <= 0 || nRequests <= 0 || fltMax < fltMin)
+    {
+        std::cout << "Usage: alnload (-u socket_path | -p port) -d nDim [-c connections] [-n requests_per_connection]"
+            << " [-r fltMin fltMax]" << std::endl;
+        return 1;
+    }
+
+    if (!SocketStartup())
+    {
+        std::cout << "Socket startup failed!" << std::endl;
+        return 1;
+    }
+
+    std::vector<CLoadResult> vecResults(nConnections);
+    std::vector<std::thread> vecThreads;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < nConnections; i++)
+    {
+        vecThreads.push_back(std::thread(RunConnection, pszPath, nPort, nDim, nRequests, fltMin, fltMax,
+            (unsigned int)(i + 1), &vecResults[i]));
+    }
+    for (size_t i = 0; i < vecThreads.size(); i++)
+    {
+        vecThreads[i].join();
+    }
+    auto finish = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = finish - start;
+
+    std::vector<float> vecLatency;
+    long nErrors = 0;
+    int nFailed = 0;
+    for (size_t i = 0; i < vecResults.size(); i++)
+    {
+        vecLatency.insert(vecLatency.end(), vecResults[i].vecLatency.begin(), vecResults[i].vecLatency.end());
+        nErrors += vecResults[i].nErrors;
+        if (vecResults[i].bFailed)
+            nFailed++;
+    }
+    std::sort(vecLatency.begin(), vecLatency.end());
+
+    std::cout << "Connections " << nConnections << " (" << nFailed << " failed), requests " << vecLatency.size()
+        << ", error replies " << nErrors << std::endl;
+    std::cout << "Latency p50 " << Percentile(vecLatency, 0.50) << " us, p99 " << Percentile(vecLatency, 0.99)
+        << " us, max " << (vecLatency.empty() ? 0 : vecLatency.back()) << " us" << std::endl;
+    std::cout << "Throughput " << vecLatency.size() / elapsed.count() << " requests per second" << std::endl;
+
+    SocketCleanup();
+    return nFailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,354 @@
+// Local inference server for ALN and DTREE files
+
+/* MIT License
+
+Copyright (c) 2020 William Ward Armstrong
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+// alnserve.cpp
+
+// This program loads an ALN (written by ALNWrite) or a DTREE file and answers evaluation requests from
+// local clients over a Unix domain socket or a TCP port on 127.0.0.1. The protocol is described in alnsock.h.
+// Each client connection has its own thread. Requests arriving together are collected into a micro-batch
+// which is evaluated at once: a batch is closed when it holds the maximum batch size or when the oldest
+// request in it has waited for the latency budget. alnload is a load generator for measuring it.
+// Usage: alnserve model_file (-u socket_path | -p port) [-b max_batch] [-l latency_budget_us]
+
+#include "aln.h"
+#include "alnsock.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <iostream>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// The library reads these switches; alpha-beta cutoffs do not change results, the distance heuristic can.
+BOOL bClassify2 = FALSE;
+BOOL bConvex = FALSE;
+BOOL bAlphaBeta = TRUE;
+BOOL bDistanceOptimization = FALSE;
+float WeightDecay = 1.0F;
+float WeightBound = 1.0e38F;
+int SplitsAllowed = 0;
+int SplitCount = 0;
+
+// model being served, either an ALN or a DTREE
+struct CModel
+{
+    ALN* pALN;
+    DTREE* pDtree;
+    int nDim;
+    std::unordered_map<const ALNNODE*, int> mapLFN; // LFN ids in depth first order
+
+    CModel() : pALN(NULL), pDtree(NULL), nDim(0) {}
+};
+
+static void NumberLFNs(CModel& model, const ALNNODE* pNode)
+{
+    if (NODE_ISLFN(pNode))
+    {
+        int nId = (int)model.mapLFN.size();
+        model.mapLFN[pNode] = nId;
+    }
+    else
+    {
+        for (int i = 0; i < MINMAX_NUMCHILDREN(pNode); i++)
+        {
+            NumberLFNs(model, MINMAX_CHILDREN(pNode)[i]);
+        }
+    }
+}
+
+static bool LoadModel(CModel& model, const char* pszFile)
+{
+    if (ALNRead(pszFile, &model.pALN) == ALN_NOERROR)
+    {
+        model.nDim = model.pALN->nDim;
+        NumberLFNs(model, model.pALN->pTree);
+        std::cout << "Loaded ALN with " << model.nDim << " inputs and " << model.mapLFN.size() << " LFNs" << std::endl;
+        return true;
+    }
+    if (ReadDtree(pszFile, &model.pDtree) == DTR_NOERROR || BinReadDtree(pszFile, &model.pDtree) == DTR_NOERROR)
+    {
+        model.nDim = model.pDtree->nDim;
+        std::cout << "Loaded DTREE with " << model.nDim << " inputs and " << model.pDtree->nLinearForms << " linear forms" << std::endl;
+        return true;
+    }
+    return false;
+}
+
+// the batch evaluator: nVectors vectors of nDim floats one after the other
+static void EvalBatch(CModel& model, float* afltX, int nVectors, float* afltResult, int* anId,
+    std::vector<ALNNODE*>& vecActive)
+{
+    if (model.pALN != NULL)
+    {
+        vecActive.resize(nVectors);
+        ALNQuickEvalBatch(model.pALN, afltX, nVectors, afltResult, vecActive.data());
+        for (int i = 0; i < nVectors; i++)
+        {
+            auto it = model.mapLFN.find(vecActive[i]);
+            anId[i] = (it != model.mapLFN.end()) ? it->second : -1;
+        }
+    }
+    else
+    {
+        for (int i = 0; i < nVectors; i++)
+        {
+            if (EvalDtree(model.pDtree, afltX + (size_t)i * model.nDim, afltResult + i, anId + i) != DTR_NOERROR)
+            {
+                afltResult[i] = NAN;
+                anId[i] = -1;
+            }
+        }
+    }
+}
+
+// request waiting in the queue, owned by the connection thread
+struct CRequest
+{
+    const float* afltX;
+    float fltResult;
+    int nId;
+    bool bDone;
+    std::chrono::steady_clock::time_point timeArrived;
+};
+
+class CBatcher
+{
+public:
+    CBatcher(CModel& model, int nMaxBatch, int nBudgetMicroseconds)
+        : m_model(model), m_nMaxBatch(nMaxBatch), m_budget(nBudgetMicroseconds),
+        m_nBatches(0), m_nRequests(0)
+    {
+    }
+
+    // called by connection threads, returns when the request is evaluated
+    void Submit(CRequest* pRequest)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        pRequest->bDone = false;
+        pRequest->timeArrived = std::chrono::steady_clock::now();
+        m_queue.push_back(pRequest);
+        m_cvQueue.notify_one();
+        m_cvDone.wait(lock, [pRequest] { return pRequest->bDone; });
+    }
+
+    // batching thread
+    void Run()
+    {
+        std::vector<CRequest*> vecBatch;
+        std::vector<float> vecX;
+        std::vector<float> vecResult;
+        std::vector<int> vecId;
+        std::vector<ALNNODE*> vecActive;
+        int nDim = m_model.nDim;
+
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cvQueue.wait(lock, [this] { return !m_queue.empty(); });
+
+                // wait for more requests until the batch is full or the oldest request is due
+                auto timeDue = m_queue.front()->timeArrived + m_budget;
+                m_cvQueue.wait_until(lock, timeDue, [this] { return (int)m_queue.size() >= m_nMaxBatch; });
+
+                int nBatch = (int)m_queue.size() < m_nMaxBatch ? (int)m_queue.size() : m_nMaxBatch;
+                vecBatch.assign(m_queue.begin(), m_queue.begin() + nBatch);
+                m_queue.erase(m_queue.begin(), m_queue.begin() + nBatch);
+            }
+
+            int nBatch = (int)vecBatch.size();
+            vecX.resize((size_t)nBatch * nDim);
+            vecResult.resize(nBatch);
+            vecId.resize(nBatch);
+            for (int i = 0; i < nBatch; i++)
+            {
+                memcpy(&vecX[(size_t)i * nDim], vecBatch[i]->afltX, nDim * sizeof(float));
+            }
+            EvalBatch(m_model, vecX.data(), nBatch, vecResult.data(), vecId.data(), vecActive);
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                for (int i = 0; i < nBatch; i++)
+                {
+                    vecBatch[i]->fltResult = vecResult[i];
+                    vecBatch[i]->nId = vecId[i];
+                    vecBatch[i]->bDone = true;
+                }
+                m_nBatches++;
+                m_nRequests += nBatch;
+            }
+            m_cvDone.notify_all();
+        }
+    }
+
+    void GetStats(long long& nBatches, long long& nRequests)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        nBatches = m_nBatches;
+        nRequests = m_nRequests;
+    }
+
+private:
+    CModel& m_model;
+    int m_nMaxBatch;
+    std::chrono::microseconds m_budget;
+    std::mutex m_mutex;
+    std::condition_variable m_cvQueue;
+    std::condition_variable m_cvDone;
+    std::deque<CRequest*> m_queue;
+    long long m_nBatches;
+    long long m_nRequests;
+};
+
+static void ServeConnection(ALNSOCKET s, CBatcher* pBatcher, int nDim)
+{
+    std::vector<float> vecX(nDim);
+    std::vector<float> vecDiscard;
+    CRequest request;
+    request.afltX = vecX.data();
+    while (true)
+    {
+        int nCount;
+        if (!RecvAll(s, &nCount, sizeof(nCount)))
+            break;
+        if (nCount < 0 || nCount > ALNSERVE_MAXFLOATS)
+            break;  // not our protocol
+
+        struct
+        {
+            float fltValue;
+            int nId;
+        } reply;
+        if (nCount == nDim)
+        {
+            if (!RecvAll(s, vecX.data(), nCount * (int)sizeof(float)))
+                break;
+            pBatcher->Submit(&request);
+            reply.fltValue = request.fltResult;
+            reply.nId = request.nId;
+        }
+        else
+        {
+            // a vector of the wrong length is answered with an error
+            vecDiscard.resize(nCount);
+            if (nCount > 0 && !RecvAll(s, vecDiscard.data(), nCount * (int)sizeof(float)))
+                break;
+            reply.fltValue = NAN;
+            reply.nId = -1;
+        }
+        if (!SendAll(s, &reply, sizeof(reply)))
+            break;
+    }
+    CloseSocket(s);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* pszModel = NULL;
+    const char* pszPath = NULL;
+    int nPort = 0;
+    int nMaxBatch = 32;
+    int nBudget = 200;     // microseconds
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-u") == 0 && i + 1 < argc) pszPath = argv[++i];
+        else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) nPort = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) nMaxBatch = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) nBudget = atoi(argv[++i]);
+        else if (pszModel == NULL) pszModel = argv[i];
+        else pszModel = NULL, i = argc;    // unexpected argument
+    }
+    if (pszModel == NULL || (pszPath == NULL && nPort <= 0) || nMaxBatch < 1 || nBudget < 0)
+    {
+        std::cout << "Usage: alnserve model_file (-u socket_path | -p port) [-b max_batch] [-l latency_budget_us]" << std::endl;
+        return 1;
+    }
+
+    CModel model;
+    if (!LoadModel(model, pszModel))
+    {
+        std::cout << "Reading model file " << pszModel << " failed!" << std::endl;
+        return 1;
+    }
+
+    if (!SocketStartup())
+    {
+        std::cout << "Socket startup failed!" << std::endl;
+        return 1;
+    }
+    ALNSOCKET sListen = OpenSocket(pszPath, nPort, true);
+    if (sListen == ALNSOCK_INVALID)
+    {
+        std::cout << "Listening failed!" << std::endl;
+        return 1;
+    }
+    if (pszPath != NULL)
+        std::cout << "Listening on " << pszPath;
+    else
+        std::cout << "Listening on 127.0.0.1:" << nPort;
+    std::cout << ", max batch " << nMaxBatch << ", latency budget " << nBudget << " us" << std::endl;
+
+    CBatcher batcher(model, nMaxBatch, nBudget);
+    std::thread threadBatcher(&CBatcher::Run, &batcher);
+    threadBatcher.detach();
+
+    long long nConnections = 0;
+    while (true)
+    {
+        ALNSOCKET s = accept(sListen, NULL, NULL);
+        if (s == ALNSOCK_INVALID)
+        {
+            // a temporary failure is retried after a pause, so one that
+            // persists does not spin; anything else ends the server, without
+            // destroying the model and batcher the connections still use
+            int nError;
+            if (!AcceptErrorIsTemporary(nError))
+            {
+                std::cout << "Accepting connections failed, error " << nError << std::endl;
+                CloseSocket(sListen);
+                exit(1);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+
+        // report how well requests were coalesced so far
+        long long nBatches, nRequests;
+        batcher.GetStats(nBatches, nRequests);
+        if (nBatches > 0)
+        {
+            std::cout << "Connection " << ++nConnections << ": " << nRequests << " requests in " << nBatches
+                << " batches, mean batch size " << (double)nRequests / nBatches << std::endl;
+        }
+
+        std::thread(ServeConnection, s, &batcher, model.nDim).detach();
+    }
+
+    // not reached, the server runs until it is killed or accept fails
+}
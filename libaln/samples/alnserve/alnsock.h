@@ -0,0 +1,202 @@
+// Socket helpers shared by alnserve and alnload
+
+/* MIT License
+
+Copyright (c) 2020 William Ward Armstrong
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+// alnsock.h
+
+// Protocol, in native byte order since both ends run on the same machine:
+//   request:  int32 nCount, then nCount floats, one value per ALN input
+//             (the output position is ignored)
+//   reply:    float value, int32 id of the responsible LFN or linear form,
+//             -1 with a NaN value if the request could not be evaluated
+// A connection carries any number of requests, one at a time.
+
+#ifndef __ALNSOCK_H__
+#define __ALNSOCK_H__
+
+#include <string.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <afunix.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib")
+#endif
+typedef SOCKET ALNSOCKET;
+#define ALNSOCK_INVALID INVALID_SOCKET
+#define CloseSocket closesocket
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+typedef int ALNSOCKET;
+#define ALNSOCK_INVALID (-1)
+#define CloseSocket close
+#endif
+
+#define ALNSERVE_MAXFLOATS 65536
+
+// a closed peer must not raise SIGPIPE
+#ifdef MSG_NOSIGNAL
+#define ALNSOCK_SENDFLAGS MSG_NOSIGNAL
+#else
+#define ALNSOCK_SENDFLAGS 0
+#endif
+
+inline bool SocketStartup()
+{
+#ifdef _WIN32
+    WSADATA wsadata;
+    return WSAStartup(MAKEWORD(2, 2), &wsadata) == 0;
+#else
+    return true;
+#endif
+}
+
+inline void SocketCleanup()
+{
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+// Unix domain socket if pszPath is not NULL, else TCP on 127.0.0.1
+inline ALNSOCKET OpenSocket(const char* pszPath, int nPort, bool bListen)
+{
+    ALNSOCKET s;
+    int nResult;
+    if (pszPath != NULL)
+    {
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        // the path and its terminator must fit; memset left the terminator
+        size_t nLen = strnlen(pszPath, sizeof(addr.sun_path));
+        if (nLen >= sizeof(addr.sun_path))
+            return ALNSOCK_INVALID;
+        memcpy(addr.sun_path, pszPath, nLen);
+
+        s = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (s == ALNSOCK_INVALID)
+            return s;
+        if (bListen)
+        {
+#ifdef _WIN32
+            _unlink(pszPath);
+#else
+            unlink(pszPath);
+#endif
+            nResult = bind(s, (sockaddr*)&addr, sizeof(addr));
+        }
+        else
+        {
+            nResult = connect(s, (sockaddr*)&addr, sizeof(addr));
+        }
+    }
+    else
+    {
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((unsigned short)nPort);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);    // local clients only
+
+        s = socket(AF_INET, SOCK_STREAM, 0);
+        if (s == ALNSOCK_INVALID)
+            return s;
+
+        // requests are small, send them at once
+        int nOne = 1;
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&nOne, sizeof(nOne));
+        if (bListen)
+        {
+            setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&nOne, sizeof(nOne));
+            nResult = bind(s, (sockaddr*)&addr, sizeof(addr));
+        }
+        else
+        {
+            nResult = connect(s, (sockaddr*)&addr, sizeof(addr));
+        }
+    }
+
+    if (nResult == 0 && bListen)
+        nResult = listen(s, SOMAXCONN);
+
+    if (nResult != 0)
+    {
+        CloseSocket(s);
+        return ALNSOCK_INVALID;
+    }
+    return s;
+}
+
+// after accept fails: true if a later accept may succeed, eg. the peer
+// reset the connection before it was accepted or a signal came; false if
+// the listener is gone or the process is out of descriptors
+inline bool AcceptErrorIsTemporary(int& nError)
+{
+#ifdef _WIN32
+    nError = WSAGetLastError();
+    return nError != WSAENOTSOCK && nError != WSAEINVAL && nError != WSAEMFILE &&
+        nError != WSANOTINITIALISED;
+#else
+    nError = errno;
+    return nError != EBADF && nError != ENOTSOCK && nError != EINVAL &&
+        nError != EMFILE && nError != ENFILE;
+#endif
+}
+
+inline bool RecvAll(ALNSOCKET s, void* pv, int nBytes)
+{
+    char* pch = (char*)pv;
+    while (nBytes > 0)
+    {
+        int n = recv(s, pch, nBytes, 0);
+        if (n <= 0)
+            return false;
+        pch += n;
+        nBytes -= n;
+    }
+    return true;
+}
+
+inline bool SendAll(ALNSOCKET s, const void* pv, int nBytes)
+{
+    const char* pch = (const char*)pv;
+    while (nBytes > 0)
+    {
+        int n = send(s, pch, nBytes, ALNSOCK_SENDFLAGS);
+        if (n <= 0)
+            return false;
+        pch += n;
+        nBytes -= n;
+    }
+    return true;
+}
+
+#endif  // __ALNSOCK_H__
@@ -52,11 +52,10 @@ float targetDigit = 3; //  Here we specify the digit to be recognized. The other
 
 BOOL bClassify2 = TRUE; // FALSE produces the usual function learning; TRUE is for two-class classification with a target class
 BOOL bConvex = FALSE;  // Used when bClassify2 is TRUE. If bConvex is TRUE, then we do convex classification, i.e. all but one split involves minima.
-extern long CountLeafevals; // Global to test optimization
 extern BOOL bStopTraining;
 // Switches for turning on/off optimizations
 BOOL bAlphaBeta = FALSE;
-BOOL bDistanceOptimization = FALSE;
+BOOL bDistanceOptimization = TRUE; // The distance cutoffs are exact, so they stay on throughout
 float fltTrainErr;
 int nMaxEpochs = 20;
 int nNumberLFNs = 0;
@@ -81,9 +80,10 @@ int main(int argc, char* argv[])
     int argCount = argc;
     int nDim = atoi(argv[2]);
 
-    if (argc != 7) // We expect arguments as listed here (argc is not counted among them)
+    // An optional seventh argument names a checkpoint file written by an earlier run (think.ckp) to resume from.
+    if (argc != 7 && argc != 8) // We expect arguments as listed here (argc is not counted among them)
     {
-        std::cout << "Bad argument list!\n" << "Usage: " << "Data_file_name nDim nMaxEpochs fltRMSEorF WeightBound Downshift  " << std::endl;
+        std::cout << "Bad argument list!\n" << "Usage: " << "Data_file_name nDim nMaxEpochs fltRMSEorF WeightBound Downshift [Checkpoint_file] " << std::endl;
         return 1;
     }
     CDataFile file;
@@ -132,6 +132,10 @@ int main(int argc, char* argv[])
         std::cout << "succeeded!" << std::endl;
     }
     CMyAln* pALN = &aln;
+    const char* pszCheckpoint = "think.ckp";
+    BOOL bResume = (argc == 8);
+    long nSchedule = 0; // The last iteration written to a checkpoint, kept in the checkpoint
+    int nFirstIteration = 1;
     ALNNODE* pTree = pALN->GetTree(); // The tree is initially just one leaf node
     pALN->SetGrowable(pTree);
 
@@ -149,15 +153,18 @@ int main(int argc, char* argv[])
         const float ConstLevel = 0.95F;  // This must be > 0, e.g. 0.95, to create an interval around 0 where ALN values will lie.
         // The following sets up the special ALN structure for pattern classification into two classes denoted by 1.0 and -1.0
         // Split the root
+        // (minmax nodes may have any number of children; a split of an LFN has two)
         ALNAddLFNs(aln, pTree, GF_MIN, 2, NULL);
-        ALNNODE* pChildR = MINMAX_RIGHT(pTree);
-        ALNNODE* pChildL = MINMAX_LEFT(pTree);
+        ASSERT(MINMAX_NUMCHILDREN(pTree) == 2);
+        ALNNODE* pChildR = MINMAX_CHILDREN(pTree)[1];
+        ALNNODE* pChildL = MINMAX_CHILDREN(pTree)[0];
         ASSERT(NODE_ISLFN(pChildR));
         ASSERT(NODE_ISLFN(pChildL));
         // Now split the left child
         ALNAddLFNs(aln, pChildL, GF_MAX, 2, NULL);
-        ALNNODE* pGChildR = MINMAX_RIGHT(pChildL);
-        ALNNODE* pGChildL = MINMAX_LEFT(pChildL);
+        ASSERT(MINMAX_NUMCHILDREN(pChildL) == 2);
+        ALNNODE* pGChildR = MINMAX_CHILDREN(pChildL)[1];
+        ALNNODE* pGChildL = MINMAX_CHILDREN(pChildL)[0];
         ASSERT(NODE_ISLFN(pGChildR));
         ASSERT(NODE_ISLFN(pGChildL));
         // The next few lines set up a maximum with 0.95 and a minimum with -0.95 for the classification problems
@@ -203,7 +210,7 @@ int main(int argc, char* argv[])
         // It uses one or several domes each doing convex classification to solve a non-convex problem.
         // This shouldn't hurt anything and additional maxes can be added following the recipe below
         ALNAddLFNs(aln, pGChildL, GF_MAX, 2, NULL);
-        ALNNODE* pGGChildL = MINMAX_LEFT(pGChildL);
+        ALNNODE* pGGChildL = MINMAX_CHILDREN(pGChildL)[0];
         ASSERT(NODE_ISLFN(pGGChildL));
         ALNAddLFNs(aln, pGGChildL, GF_MAX, 2, NULL);
         */
@@ -233,7 +240,7 @@ int main(int argc, char* argv[])
     int colno;
     long samplesAdded = 0;
     float temp;
-    for (long i = 0; i < nTRmaxSamples; i++)
+    for (long i = 0; !bResume && i < nTRmaxSamples; i++) // A resumed run gets its buffer from the checkpoint
     {
         // get the sample
         for (int j = 0; j < nDim; j++)
@@ -250,6 +257,23 @@ int main(int argc, char* argv[])
         samplesAdded++;
     }
     ASSERT(pdata->nTRcurrSamples == samplesAdded);
+    if (bResume)
+    {
+        // The tree, the training buffer and the growth settings set up above are replaced by those of the checkpoint,
+        // so training continues exactly where the earlier run wrote it.
+        std::cout << "Resuming from checkpoint " << argv[7];
+        if (!pALN->ReadCheckpoint(argv[7], &nSchedule, sizeof(nSchedule)))
+        {
+            std::cout << " failed!" << std::endl;
+            return 1;
+        }
+        std::cout << " succeeded!" << std::endl;
+        nTRmaxSamples = pdata->nTRmaxSamples;
+        fltMSEorF = pdata->fltMSEorF;
+        fltRMSEorF = fltMSEorF > 0 ? sqrt(fltMSEorF) : fltMSEorF;
+        // The splits allowed and the switch to the optimizations follow the iteration count
+        nFirstIteration = nSchedule + 1;
+    }
     std::cout << "ALNDATAINFO: " << "TRmaxSamples = " << pdata->nTRmaxSamples << "  "
         << "TRcurrSamples = " << pdata->nTRcurrSamples << "  " << "TRcols  = " << pdata->nTRcols << "  " << "TRinsert = " << pdata->nTRinsert << std::endl;
     int nDimt2 = nDim * 2;
@@ -277,10 +301,12 @@ int main(int argc, char* argv[])
     */
 
     BOOL bJitter = FALSE;
-    bStopTraining = FALSE;
-    bAlphaBeta = FALSE;
-    bDistanceOptimization = FALSE;
-    BOOL bFirstTime = TRUE;
+    if (!bResume)
+    {
+        bStopTraining = FALSE;
+        bAlphaBeta = FALSE;
+    }
+    BOOL bFirstTime = !bAlphaBeta;
     float fltLearnRate = 0.1F;
     float fltMinRMSE = 0.00000001F;// This is set small and not very useful.  fltRMSEorF is used now to stop training.
     int nNotifyMask = AN_TRAIN; // required callbacks for information or insertion of data. You can OR them together with |
@@ -292,11 +318,25 @@ int main(int argc, char* argv[])
     NormalReplaceTR.Create(file.RowCount(), file.ColumnCount());
     long rowsReplace = file.RowCount();
     std::cout << std::endl << "Starting training " << std::endl;
+    // If the environment variable ALNTRACE names a file, the training phases are written to it as a Chrome trace
+    char* pszTrace = NULL;
+#ifdef _MSC_VER
+    size_t nTraceLen = 0;
+    _dupenv_s(&pszTrace, &nTraceLen, "ALNTRACE");
+#else
+    const char* pszEnv = getenv("ALNTRACE");
+    pszTrace = (pszEnv != NULL) ? strdup(pszEnv) : NULL;
+#endif
+    if (pszTrace != NULL && ALNOpenTrace(pszTrace) != ALN_NOERROR)
+    {
+        std::cout << "Opening trace file " << pszTrace << " failed!" << std::endl;
+    }
+    free(pszTrace);
     // Record start time
     auto start_training = std::chrono::high_resolution_clock::now();
     do
     {
-        for (int iteration = 1; iteration <= iterations; iteration++)
+        for (int iteration = nFirstIteration; iteration <= iterations; iteration++)
         {
             if (iteration == 1 || iteration % 5 == 0) std::cout << "\nIteration " << iteration << " (of " << iterations << " )   ";
             flush(std::cout);
@@ -324,7 +364,6 @@ int main(int argc, char* argv[])
             if (bFirstTime && iteration == 290) // Optimization is not needed when there are few leaf nodes, e.g. < 256
             {
                 bAlphaBeta = TRUE; // Once these optimizatons are switched on, they stay on. (This is after the first split)  MYTEST
-                bDistanceOptimization = TRUE;
                 // fltRMSEorF = 10.0F; // When this is applied, there should be no more splitting!
                 //pdata->fltMSEorF = fltMSEorF = fltRMSEorF > 0 ? pow(fltRMSEorF, 2) : fltRMSEorF;
                 //WeightBound = 0.006;
@@ -337,6 +376,17 @@ int main(int argc, char* argv[])
             //if (iteration > 200) bConvex = FALSE;
 
 
+            // Write a checkpoint in the background; training goes on while it is written.
+            // The iteration goes with it, so a resumed run continues the schedule.
+            if (iteration % 10 == 0)
+            {
+                nSchedule = iteration;
+                if (!pALN->WriteCheckpoint(pszCheckpoint, TRUE, &nSchedule, sizeof(nSchedule)))
+                {
+                    std::cout << " Writing checkpoint " << pszCheckpoint << " failed!" << std::endl;
+                }
+            }
+
             auto finish_iteration = std::chrono::high_resolution_clock::now();
             std::chrono::duration<float> elapsed0 = finish_iteration - start_training;
             std::chrono::duration<float> elapsed1 = finish_iteration - start_iteration;
@@ -346,6 +396,7 @@ int main(int argc, char* argv[])
                 flush(std::cout);
             }
         }
+        nFirstIteration = 1; // Each further round counts its iterations from 1
         std::cout << "RMSEorF = " << fltRMSEorF << " Weight bound = " << WeightBound << " Weight decay  = " << WeightDecay << endl;
 
         float entry;
@@ -502,7 +553,7 @@ int main(int argc, char* argv[])
     /*
     // Speed test
     std::cout << std::endl << "Starting speed test... please wait" << std::endl;
-    CountLeafevals = 0;
+    ALNResetEvalStats(NULL); // counts only if libaln is built with ALNSTATS
     // Record start time
     auto start = std::chrono::high_resolution_clock::now();
     for (long i = 0; i < nTRmaxSamples; i++)
@@ -533,7 +584,12 @@ int main(int argc, char* argv[])
     finish = std::chrono::high_resolution_clock::now();
     std::chrono::duration<float> elapsed2 = finish - start;
     std::cout << std::endl << "Elapsed time for " << nTRmaxSamples <<  " evaluations: " << elapsed.count() - elapsed2.count() << " seconds" << std::endl;
-    std::cout << "Leaf evaluations during testing " << CountLeafevals << std::endl;
+    ALNEVALSTATS evalstats;
+    if (ALNGetEvalStats(&evalstats) == ALN_NOERROR)
+    {
+        std::cout << "Leaf evaluations during testing " << evalstats.nLeafEvals << ", alpha-beta cutoffs " << evalstats.nAlphaBetaCutoffs
+            << ", distance cutoffs " << evalstats.nDistanceCutoffs << std::endl;
+    }
     */
 
     //*********************************************************************************
@@ -559,7 +615,6 @@ int main(int argc, char* argv[])
     int nWrong = 0;
     std::cout << std::endl << "Starting evaluation" << std::endl;
     bAlphaBeta = FALSE; // Optimizations are not done in the interest of accuracy.
-    bDistanceOptimization = FALSE;
     float DesiredALNOutput, ALNoutput, label;
     for (long i = 0; i < 10000; i++)
     {
@@ -587,6 +642,8 @@ int main(int argc, char* argv[])
     }
     std::cout << "Correct: " << nCorrect << " Wrong: " << nWrong << endl;
     BadTestImages.close();
+    pALN->WaitCheckpoint();
+    ALNCloseTrace();
     free(afltX);
     free(pdata->afltTRdata);
     pALN->Destroy();
@@ -82,6 +82,7 @@ float ALNAPI AdaptEval(ALNNODE* pNode, ALN* pALN, const float* afltX,
     //flt = fltCheck; // MYTEST assumes debug version is correct (no cutoffs)
     //pActiveLFN = pLFNCheck; // MYTEST
 #endif  // MYTEST 
+    STATS_TREEEVAL(pNode, pActiveLFN);
     * ppActiveLFN = pActiveLFN;
 
     return flt;
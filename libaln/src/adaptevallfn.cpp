@@ -68,6 +68,7 @@ float ALNAPI AdaptEvalLFN(ALNNODE* pNode, ALN* pALN, const float* afltX,
     }
 
     NODE_DISTANCE(pNode) = fltA;
+    STATS_LEAFEVAL(pALN, pNode);
 
     return fltA;
 }
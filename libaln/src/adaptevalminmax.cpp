@@ -45,11 +45,18 @@ static char THIS_FILE[] = __FILE__;
 float ALNAPI AdaptEvalMinMax(ALNNODE* pNode, ALN* pALN, const float* afltX, CEvalCutoff cutoff, ALNNODE** ppActiveLFN)
 {
     ASSERT(NODE_ISMINMAX(pNode));
+    STATS_MINMAXEVAL(pALN, pNode);
+
+    int nChildren = MINMAX_NUMCHILDREN(pNode);
+    ALNNODE* const* apChildren = MINMAX_CHILDREN(pNode);
 
     // set node eval flags
     NODE_FLAGS(pNode) |= NF_EVAL;  //NODE_FLAGS(pNode) ((pNode)->fNode)
-    NODE_FLAGS(MINMAX_LEFT(pNode)) &= ~NF_EVAL;
-    NODE_FLAGS(MINMAX_RIGHT(pNode)) &= ~NF_EVAL;//((pNode)->DATA.MINMAX.CHILDREN.CHILDSEPARATE.pRightChild)
+    for (int i = 0; i < nChildren; i++)
+    {
+        NODE_FLAGS(apChildren[i]) &= ~NF_EVAL;
+    }
+
     // set first child
     ALNNODE* pChild0;
     if (MINMAX_EVAL(pNode))    // ((pNode)->DATA.MINMAX.pEvalChild)
@@ -57,51 +64,42 @@ float ALNAPI AdaptEvalMinMax(ALNNODE* pNode, ALN* pALN, const float* afltX, CEva
     else
         pChild0 = MINMAX_LEFT(pNode);
 
-    // set next child
-    ALNNODE* pChild1;
-    if (pChild0 == MINMAX_LEFT(pNode))
-        pChild1 = MINMAX_RIGHT(pNode);
-    else
-        pChild1 = MINMAX_LEFT(pNode);
-
-    // get reference to region for this node
-    ALNREGION& region = pALN->aRegions[NODE_REGION(pNode)];
-
     // eval first child
     ALNNODE* pActiveLFN0;
     float flt0 = AdaptEval(pChild0, pALN, afltX, cutoff, &pActiveLFN0);
-
-    // see if we can cutoff...
-    if (Cutoff(flt0, pNode, cutoff))
+    NODE_DISTANCE(pNode) = flt0;
+    *ppActiveLFN = pActiveLFN0;
+    MINMAX_ACTIVE(pNode) = pChild0;
+
+    // Recall that equal values are not a rare event!  They always happen after a split,
+    // however only once as the first adapt will likely destroy equality.
+    MINMAX_RESPACTIVE(pNode) = 1.0;	 // we can't have < 1 without additional evaluation
+    for (int i = 0; i < nChildren; i++)
     {
-        *ppActiveLFN = pActiveLFN0;
-        MINMAX_ACTIVE(pNode) = pChild0;
-        NODE_DISTANCE(pNode) = flt0;
-        MINMAX_RESPACTIVE(pNode) = 1.0;	 // we can't have < 1 without additional evaluation
-        return flt0;
-    }  // Removed the cutoff to see what happens, now restored
-
-    // eval second child
-    ALNNODE* pActiveLFN1;
-    float flt1 = AdaptEval(pChild1, pALN, afltX, cutoff, &pActiveLFN1);
-
-    // Recall that flt0 == flt1 is not a rare event!  It always happens after a split,
-    // however it happens then only once as the first adapt will likely destroy equality.
-    MINMAX_RESPACTIVE(pNode) = 1.0;
-    if ((MINMAX_ISMAX(pNode) > 0) == (flt1 > flt0)) // int MINMAX_ISMAX is used as a bit-vector!
-    {
-        NODE_DISTANCE(pNode) = flt1;
-        *ppActiveLFN = pActiveLFN1;
-        MINMAX_ACTIVE(pNode) = pChild1;
-    }
-    else
-    {
-        NODE_DISTANCE(pNode) = flt0;
-        *ppActiveLFN = pActiveLFN0;
-        MINMAX_ACTIVE(pNode) = pChild0;
+        ALNNODE* pChild = apChildren[i];
+        if (pChild == pChild0)
+            continue;
+
+        // see if we can cutoff...
+        if (Cutoff(NODE_DISTANCE(pNode), pNode, cutoff))
+        {
+            for (int j = i; j < nChildren; j++)
+            {
+                if (apChildren[j] != pChild0)
+                    STATS_ALPHABETACUTOFF(pALN, apChildren[j]);
+            }
+            break;
+        }  // Removed the cutoff to see what happens, now restored
+
+        // eval next child
+        ALNNODE* pActiveLFN1;
+        float flt1 = AdaptEval(pChild, pALN, afltX, cutoff, &pActiveLFN1);
+        if ((MINMAX_ISMAX(pNode) > 0) == (flt1 > NODE_DISTANCE(pNode))) // int MINMAX_ISMAX is used as a bit-vector!
+        {
+            NODE_DISTANCE(pNode) = flt1;
+            *ppActiveLFN = pActiveLFN1;
+            MINMAX_ACTIVE(pNode) = pChild;
+        }
     }
     return NODE_DISTANCE(pNode);
 }
-
-
-
@@ -36,9 +36,27 @@ SOFTWARE. */
 static char THIS_FILE[] = __FILE__;
 #endif
 
-extern BOOL bClassify2;
 // LFN specific adapt
 
+// With bLearnFactors in the training context, each piece multiplies the
+// learning rate by a factor of its own, set after each epoch from the mean
+// square error of the piece over the epoch and the one before.  The error
+// over n samples varies by about sqrt(2 / n) of itself from sampling alone,
+// so a change counts only when it is larger than that: a piece whose error
+// still falls by more is converging slowly, and its factor grows a little; a
+// piece whose error rises by several times more is oscillating, and its
+// factor shrinks.  A piece on a handful of samples needs a large change to
+// count either way.  Cutting at every rise, or whenever a piece had few
+// samples, was tried and made the pieces too slow to part after a split.
+// The factor stays in the ALNLFNSPLIT of the piece, which is saved with the
+// ALN, so later training goes on with it.
+
+static const float fltLearnFactorGrow = 1.1f;    // factor of a piece converging
+static const float fltLearnFactorCut = 0.8f;     // factor of a piece oscillating
+static const float fltLearnFactorMin = 0.0625f;
+static const float fltLearnFactorMax = 4.0f;     // at fltLearnRate 0.5, a step corrects 2/3 of the error
+static const float fltOscillation = 3.0f;        // rise, in sampling errors, of a piece oscillating
+
 void ALNAPI AdaptLFN(ALNNODE* pNode, ALN* pALN, const float* afltX,
     float fltResponse, BOOL bUsefulAdapt, const TRAINDATA* ptdata)
 {
@@ -77,6 +95,11 @@ void ALNAPI AdaptLFN(ALNNODE* pNode, ALN* pALN, const float* afltX,
     LFN_SPLIT_COUNT(pNode)++;
     LFN_SPLIT_SQERR(pNode) += fltError * fltError * fltResponse;
     LFN_SPLIT_RESPTOTAL(pNode) += fltResponse;
+    if (ptdata->bLearnFactors)
+    {
+        LFN_SPLIT_EPOCHCOUNT(pNode)++;
+        LFN_SPLIT_EPOCHSQERR(pNode) += fltError * fltError * fltResponse;
+    }
 
     // copy LFN vector pointers onto the stack for faster access
     float* afltW = LFN_W(pNode);	    // weight vector( must be shifted to use the same index as afltC, afltX 
@@ -87,12 +110,13 @@ void ALNAPI AdaptLFN(ALNNODE* pNode, ALN* pALN, const float* afltX,
 
     // set up the learning rates
     float learnBoost = 1.0F;
-    if (bClassify2 && fltError > 0.05) learnBoost = 0.1111111F;   // This attenuates the downward pull by the 9 non-target classes
+    if (IsClassify2(pALN) && fltError > 0.05) learnBoost = 0.1111111F;   // This attenuates the downward pull by the 9 non-target classes
     // If response is < 1 because of a smoothed minmax node, then the adaptation has less effect.
     // We need two learning rates.  The first is for the centroids and weights, which divides by 2*nDim -1, thus
     // putting them on an equal footing with respect to correcting a share of the error.
     float fltLearnRate = ptdata->fltLearnRate;
     float fltLearnRespParam = learnBoost * fltLearnRate * region.fltLearnFactor / (float)(2 * nDim - 1); // The region factor should be optimized out
+    if (ptdata->bLearnFactors) fltLearnRespParam *= LFN_SPLIT_LEARNFACTOR(pNode);
 
     // ADAPT THE CENTROID FOR OUTPUT BY EXPONENTIAL SMOOTHING
     // L is the value of the affine function of the linear piece at the input components of X
@@ -134,6 +158,7 @@ void ALNAPI AdaptLFN(ALNNODE* pNode, ALN* pALN, const float* afltX,
     {
         *pfltW0 -= afltW[i] * afltC[i]; // here the afltW pointer is still shifted up by one float
     }
+    InvalidateBounds(NODE_PARENT(pNode)); // the bounds above no longer hold for the new weights
     // notify end of LFN adapt
     if (CanCallback(AN_LFNADAPTEND, ptdata->pfnNotifyProc, ptdata->nNotifyMask))
     {
@@ -145,3 +170,38 @@ void ALNAPI AdaptLFN(ALNNODE* pNode, ALN* pALN, const float* afltX,
         Callback(pALN, AN_LFNADAPTEND, &lai, ptdata->pfnNotifyProc, ptdata->pvData);
     }
 }
+
+void ALNAPI UpdateLearnFactors(ALNNODE* pNode)
+{
+    ASSERT(pNode);
+    if (NODE_ISMINMAX(pNode))
+    {
+        for (int i = 0; i < MINMAX_NUMCHILDREN(pNode); i++)
+        {
+            UpdateLearnFactors(MINMAX_CHILDREN(pNode)[i]);
+        }
+        return;
+    }
+
+    ASSERT(NODE_ISLFN(pNode));
+    if (LFN_SPLIT(pNode) == NULL)
+        return;
+    int nCount = LFN_SPLIT_EPOCHCOUNT(pNode);
+    if (nCount == 0)
+        return; // no samples, no trend; the factor waits
+    float fltMSE = LFN_SPLIT_EPOCHSQERR(pNode) / (float)nCount;
+    float fltLastMSE = LFN_SPLIT_EPOCHMSE(pNode);
+    float fltSamplingError = sqrt(2.0f / (float)nCount) * fltLastMSE;
+    float& fltFactor = LFN_SPLIT_LEARNFACTOR(pNode);
+    if (fltLastMSE > 0 && fltMSE < fltLastMSE - fltSamplingError)
+    {
+        fltFactor = min(fltFactor * fltLearnFactorGrow, fltLearnFactorMax);
+    }
+    else if (fltLastMSE > 0 && fltMSE > fltLastMSE + fltOscillation * fltSamplingError)
+    {
+        fltFactor = max(fltFactor * fltLearnFactorCut, fltLearnFactorMin);
+    }
+    LFN_SPLIT_EPOCHMSE(pNode) = fltMSE;
+    LFN_SPLIT_EPOCHCOUNT(pNode) = 0;
+    LFN_SPLIT_EPOCHSQERR(pNode) = 0;
+}
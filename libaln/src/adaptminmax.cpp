@@ -59,99 +59,71 @@ void ALNAPI AdaptMinMax(ALNNODE* pNode, ALN* pALN, const float* afltX,
     // get output var constraint
     ALNCONSTRAINT* pConstrOutput = GetVarConstraint(NODE_REGION(pNode), pALN, pALN->nOutput);
 
-    // get children
-    ALNNODE* pChild0 = MINMAX_LEFT(pNode);
-    ALNNODE* pChild1 = MINMAX_RIGHT(pNode);
-    BOOL bUsefulAdapt0 = FALSE;
-    BOOL bUsefulAdapt1 = FALSE;
+    // get children: the active one, and the least responsible of the others
+    // which may be brought in to share the adaptation
+    ALNNODE* pChild0 = MINMAX_ACTIVE(pNode);
+    ASSERT(pChild0 != NULL);
+    ALNNODE* pChild1 = NULL;
+    int nResp1 = 0;
+    for (int i = 0; i < MINMAX_NUMCHILDREN(pNode); i++)
+    {
+        ALNNODE* pChild = MINMAX_CHILDREN(pNode)[i];
+        if (pChild == pChild0)
+            continue;
+
+        int nResp = NODE_RESPCOUNT(pChild) + NODE_RESPCOUNTLASTEPOCH(pChild);
+        if (pChild1 == NULL || nResp < nResp1)
+        {
+            pChild1 = pChild;
+            nResp1 = nResp;
+        }
+    }
+    ASSERT(pChild1 != NULL);
 
-    // get resp counts
+    // get resp count of the active child
     int nResp0 = NODE_RESPCOUNT(pChild0) + NODE_RESPCOUNTLASTEPOCH(pChild0);
-    int nResp1 = NODE_RESPCOUNT(pChild1) + NODE_RESPCOUNTLASTEPOCH(pChild1);
 
     // calculate the responsibilities of the children
     float fltResp0, fltResp1;
     float fltRespActive = MINMAX_RESPACTIVE(pNode);
+    float fltR;
 
-    ASSERT(MINMAX_ACTIVE(pNode) != NULL);
-    if (MINMAX_ACTIVE(pNode) == pChild0) // child 0 active
+    if ((fabs(ptdata->fltGlobalError) > pConstrOutput->fltEpsilon) &&
+        (fltRespActive > fltRespThresh) && (nResp1 < nResp0))
     {
-        bUsefulAdapt0 = bUsefulAdapt;
-
-        float fltR;
+        // bring in useless piece 1
+        fltR = fltRespThresh;
 
-        if ((fabs(ptdata->fltGlobalError) > pConstrOutput->fltEpsilon) &&
-            (fltRespActive > fltRespThresh) && (nResp1 < nResp0))
+        // eval if necessary before adapting
+        if (!NODE_ISEVAL(pChild1))
         {
-            // bring in useless piece 1
-            fltR = fltRespThresh;
-
-            // eval if necessary before adapting
-            if (!NODE_ISEVAL(pChild1))
-            {
-                ALNNODE* pActiveLFN1;
-                int nCutoffs = 0;
-                AdaptEval(pChild1, pALN, afltX, CEvalCutoff(), &pActiveLFN1);
-            }
+            ALNNODE* pActiveLFN1;
+            AdaptEval(pChild1, pALN, afltX, CEvalCutoff(), &pActiveLFN1);
         }
-        else
-        {
-            fltR = fltRespActive;
-        }
-
-        // divide each quantity by 1 - 2r(1-r)
-
-        float fltFactor = 1.0f / (1 - 2 * fltR * (1 - fltR));
-
-        fltResp0 = fltR * fltFactor;
-        fltResp1 = (1.0f - fltR) * fltFactor;
     }
-    else // child 1 is active
+    else
     {
-        bUsefulAdapt1 = bUsefulAdapt;
-
-        float fltR;
-
-        if ((fabs(ptdata->fltGlobalError) > pConstrOutput->fltEpsilon) &&
-            (fltRespActive > fltRespThresh) && (nResp0 < nResp1))
-        {
-            // bring in useless piece 0
-            fltR = fltRespThresh;
-
-            // eval child 0 if necessary before adapting
-            if (!NODE_ISEVAL(pChild0))
-            {
-                ALNNODE* pActiveLFN0;
-                int nCutoffs = 0;
-                AdaptEval(pChild0, pALN, afltX, CEvalCutoff(), &pActiveLFN0);
-            }
-        }
-        else
-        {
-            fltR = fltRespActive;
-        }
+        fltR = fltRespActive;
+    }
 
-        // divide each quantity by 1 - 2r(1-r)
+    // divide each quantity by 1 - 2r(1-r)
 
-        float fltFactor = 1.0f / (1 - 2 * fltR * (1 - fltR));
+    float fltFactor = 1.0f / (1 - 2 * fltR * (1 - fltR));
 
-        fltResp1 = fltR * fltFactor;
-        fltResp0 = (1.0f - fltR) * fltFactor;
-    }
+    fltResp0 = fltR * fltFactor;
+    fltResp1 = (1.0f - fltR) * fltFactor;
 
-    // adapt child 0
+    // adapt active child
     fltResp0 *= fltResponse;
     if (fltResp0 > fltRespMin)
     {
-        Adapt(pChild0, pALN, afltX, fltResp0, bUsefulAdapt0, ptdata);
+        Adapt(pChild0, pALN, afltX, fltResp0, bUsefulAdapt, ptdata);
     }
 
-    // adapt child 1
+    // adapt the other child
     fltResp1 *= fltResponse;
     if (fltResp1 > fltRespMin)
     {
-        Adapt(pChild1, pALN, afltX, fltResp1, bUsefulAdapt1, ptdata);
+        Adapt(pChild1, pALN, afltX, fltResp1, FALSE, ptdata);
     }
 }
-
-
@@ -0,0 +1,300 @@
+// ALN Library
+
+/* MIT License
+
+Copyright (c) 2020 William Ward Armstrong
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+
+// alnbounds.cpp
+
+#ifdef ALNDLL
+#define ALNIMP __declspec(dllexport)
+#endif
+
+#include <aln.h>
+#include "alnpriv.h"
+
+#ifdef _DEBUG
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+// The bounds let CutoffEvalMinMax skip a subtree without any loss of accuracy.
+// Each minmax node keeps a box covering the samples it is responsible for, the
+// least and greatest value of the subtree over the box, found by interval
+// arithmetic, and the least and greatest weight of its LFNs on each axis.
+// Since the surface of the subtree is a minmax of its LFNs, it cannot change
+// faster than the steepest of them, which bounds it outside the box, too.
+// The boxes only affect how often a subtree is skipped, never the result.
+// So during training, where each adapt invalidates the bounds above the LFN,
+// the bounds are recomputed each epoch over the boxes already there, without
+// a pass over the data; a subtree split since gets the box of its centroids.
+
+// helper: clears GF_BOUNDS throughout a subtree
+static void ALNAPI ClearBounds(ALNNODE* pNode)
+{
+    if (!NODE_ISMINMAX(pNode))
+        return;
+
+    pNode->fNode &= ~GF_BOUNDS;
+    for (int k = 0; k < MINMAX_NUMCHILDREN(pNode); k++)
+    {
+        ClearBounds(MINMAX_CHILDREN(pNode)[k]);
+    }
+}
+
+// helper: sets the box of every minmax node of a subtree to the box of its
+// LFN centroids and clears GF_BOUNDS
+static void ALNAPI InitBoxes(ALNNODE* pNode, int nDim)
+{
+    ASSERT(NODE_ISMINMAX(pNode));
+
+    if (MINMAX_BOUNDS(pNode) == NULL)
+    {
+        MINMAX_BOUNDS(pNode) = (float*)malloc(BOUNDS_SIZE(nDim) * sizeof(float));
+        if (MINMAX_BOUNDS(pNode) == NULL)
+            ThrowALNMemoryException();
+    }
+    pNode->fNode &= ~GF_BOUNDS;
+
+    float* afltBoxMin = BOUNDS_BOXMIN(MINMAX_BOUNDS(pNode));
+    float* afltBoxMax = BOUNDS_BOXMAX(MINMAX_BOUNDS(pNode), nDim);
+    for (int i = 0; i < nDim; i++)
+    {
+        afltBoxMin[i] = FLT_MAX;
+        afltBoxMax[i] = -FLT_MAX;
+    }
+
+    for (int k = 0; k < MINMAX_NUMCHILDREN(pNode); k++)
+    {
+        ALNNODE* pChild = MINMAX_CHILDREN(pNode)[k];
+        const float* afltChildMin;
+        const float* afltChildMax;
+        if (NODE_ISLFN(pChild))
+        {
+            afltChildMin = afltChildMax = LFN_C(pChild);
+        }
+        else
+        {
+            InitBoxes(pChild, nDim);
+            afltChildMin = BOUNDS_BOXMIN(MINMAX_BOUNDS(pChild));
+            afltChildMax = BOUNDS_BOXMAX(MINMAX_BOUNDS(pChild), nDim);
+        }
+        for (int i = 0; i < nDim; i++)
+        {
+            afltBoxMin[i] = min(afltBoxMin[i], afltChildMin[i]);
+            afltBoxMax[i] = max(afltBoxMax[i], afltChildMax[i]);
+        }
+    }
+}
+
+// helper: extends the boxes above the active LFN of a sample to cover it; a
+// box already covering the sample is inside all the boxes above it
+static void ALNAPI ExtendBoxes(const ALNNODE* pActiveLFN, const float* afltX, int nDim)
+{
+    for (ALNNODE* pNode = NODE_PARENT(pActiveLFN); pNode != NULL; pNode = NODE_PARENT(pNode))
+    {
+        float* afltBoxMin = BOUNDS_BOXMIN(MINMAX_BOUNDS(pNode));
+        float* afltBoxMax = BOUNDS_BOXMAX(MINMAX_BOUNDS(pNode), nDim);
+        BOOL bInside = TRUE;
+        for (int i = 0; i < nDim; i++)
+        {
+            if (afltX[i] < afltBoxMin[i])
+            {
+                afltBoxMin[i] = afltX[i];
+                bInside = FALSE;
+            }
+            if (afltX[i] > afltBoxMax[i])
+            {
+                afltBoxMax[i] = afltX[i];
+                bInside = FALSE;
+            }
+        }
+        if (bInside)
+            break;
+    }
+}
+
+// helper: computes the value bounds and weight ranges of a subtree whose
+// boxes are set, and sets GF_BOUNDS
+static void ALNAPI ComputeBounds(ALNNODE* pNode, int nDim)
+{
+    ASSERT(NODE_ISMINMAX(pNode));
+
+    float* afltB = MINMAX_BOUNDS(pNode);
+    const float* afltBoxMin = BOUNDS_BOXMIN(afltB);
+    const float* afltBoxMax = BOUNDS_BOXMAX(afltB, nDim);
+    float* afltWMin = BOUNDS_WMIN(afltB, nDim);
+    float* afltWMax = BOUNDS_WMAX(afltB, nDim);
+    BOOL bMax = MINMAX_ISMAX(pNode) != 0;
+    float fltTolerance = BOUNDS_TOLERANCE * nDim;
+
+    for (int k = 0; k < MINMAX_NUMCHILDREN(pNode); k++)
+    {
+        ALNNODE* pChild = MINMAX_CHILDREN(pNode)[k];
+        double dblMin, dblMax, dblAbs;
+        if (NODE_ISLFN(pChild))
+        {
+            // an LFN takes its extreme values at corners of the box
+            const float* afltW = LFN_W(pChild);
+            dblMin = dblMax = afltW[0];
+            dblAbs = fabs(afltW[0]);
+            for (int i = 0; i < nDim; i++)
+            {
+                float fltW = afltW[i + 1];
+                double dblLo = (double)fltW * afltBoxMin[i];
+                double dblHi = (double)fltW * afltBoxMax[i];
+                dblMin += min(dblLo, dblHi);
+                dblMax += max(dblLo, dblHi);
+                dblAbs += max(fabs(dblLo), fabs(dblHi));
+                if (k == 0 || fltW < afltWMin[i]) afltWMin[i] = fltW;
+                if (k == 0 || fltW > afltWMax[i]) afltWMax[i] = fltW;
+            }
+        }
+        else
+        {
+            // a subtree box lies inside this one, the bounds of the subtree
+            // widen by its steepest change out to the edges of this box
+            ComputeBounds(pChild, nDim);
+            const float* afltChildB = MINMAX_BOUNDS(pChild);
+            const float* afltChildMin = BOUNDS_BOXMIN(afltChildB);
+            const float* afltChildMax = BOUNDS_BOXMAX(afltChildB, nDim);
+            const float* afltChildWMin = BOUNDS_WMIN(afltChildB, nDim);
+            const float* afltChildWMax = BOUNDS_WMAX(afltChildB, nDim);
+            dblMin = BOUNDS_MIN(afltChildB);
+            dblMax = BOUNDS_MAX(afltChildB);
+            dblAbs = 0;
+            for (int i = 0; i < nDim; i++)
+            {
+                double dblBelow = (double)afltBoxMin[i] - afltChildMin[i];   // <= 0
+                double dblAbove = (double)afltBoxMax[i] - afltChildMax[i];   // >= 0
+                double dblDown = min(0.0, min(afltChildWMax[i] * dblBelow, afltChildWMin[i] * dblAbove));
+                double dblUp = max(0.0, max(afltChildWMin[i] * dblBelow, afltChildWMax[i] * dblAbove));
+                dblMin += dblDown;
+                dblMax += dblUp;
+                dblAbs += max(-dblDown, dblUp);
+                if (k == 0 || afltChildWMin[i] < afltWMin[i]) afltWMin[i] = afltChildWMin[i];
+                if (k == 0 || afltChildWMax[i] > afltWMax[i]) afltWMax[i] = afltChildWMax[i];
+            }
+        }
+
+        // allow for rounding in the float evaluation of the LFNs
+        float fltMin = (float)(dblMin - fltTolerance * dblAbs);
+        float fltMax = (float)(dblMax + fltTolerance * dblAbs);
+        if (k == 0)
+        {
+            BOUNDS_MIN(afltB) = fltMin;
+            BOUNDS_MAX(afltB) = fltMax;
+        }
+        else if (bMax)
+        {
+            BOUNDS_MIN(afltB) = max(BOUNDS_MIN(afltB), fltMin);
+            BOUNDS_MAX(afltB) = max(BOUNDS_MAX(afltB), fltMax);
+        }
+        else
+        {
+            BOUNDS_MIN(afltB) = min(BOUNDS_MIN(afltB), fltMin);
+            BOUNDS_MAX(afltB) = min(BOUNDS_MAX(afltB), fltMax);
+        }
+    }
+
+    pNode->fNode |= GF_BOUNDS;
+}
+
+// helper: gives each minmax node of a subtree without a box the box of its
+// LFN centroids
+static void ALNAPI AddMissingBoxes(ALNNODE* pNode, int nDim)
+{
+    ASSERT(NODE_ISMINMAX(pNode));
+
+    if (MINMAX_BOUNDS(pNode) == NULL)
+    {
+        InitBoxes(pNode, nDim);
+        return;
+    }
+
+    for (int k = 0; k < MINMAX_NUMCHILDREN(pNode); k++)
+    {
+        ALNNODE* pChild = MINMAX_CHILDREN(pNode)[k];
+        if (NODE_ISMINMAX(pChild))
+            AddMissingBoxes(pChild, nDim);
+    }
+}
+
+// recomputes the bounds of every minmax node over the boxes it has, for the
+// weights as they are now, throws CALNMemoryException*
+void ALNAPI RefreshBounds(ALN* pALN)
+{
+    ASSERT(pALN && pALN->pTree);
+
+    ALNNODE* pTree = pALN->pTree;
+    if (!NODE_ISMINMAX(pTree))
+        return;
+
+    AddMissingBoxes(pTree, pALN->nDim);
+    ComputeBounds(pTree, pALN->nDim);
+}
+
+// computes the bounds of every minmax node; without data the boxes only cover
+// the LFN centroids, throws CALNMemoryException*
+void ALNAPI UpdateBounds(ALN* pALN, ALNDATAINFO* pDataInfo,
+    const ALNCALLBACKINFO* pCallbackInfo)
+{
+    ASSERT(pALN && pALN->pTree);
+
+    ALNNODE* pTree = pALN->pTree;
+    if (!NODE_ISMINMAX(pTree))
+        return;
+
+    int nDim = pALN->nDim;
+    float* afltX = NULL;
+    try
+    {
+        InitBoxes(pTree, nDim);
+
+        // the evaluations are exact, since no node has bounds now
+        if (pDataInfo != NULL)
+        {
+            afltX = new float[nDim];
+            if (!afltX) ThrowALNMemoryException();
+            memset(afltX, 0, sizeof(float) * nDim);
+
+            for (long nSample = 0; nSample < pDataInfo->nTRcurrSamples; nSample++)
+            {
+                FillInputVector(pALN, afltX, nSample, 0, pDataInfo, pCallbackInfo);
+
+                ALNNODE* pActiveLFN = NULL;
+                CutoffEval(pTree, pALN, afltX, CEvalCutoff(), &pActiveLFN);
+                ExtendBoxes(pActiveLFN, afltX, nDim);
+            }
+        }
+    }
+    catch (...)
+    {
+        // no stale bounds may survive
+        ClearBounds(pTree);
+        delete[] afltX;
+        throw;
+    }
+    delete[] afltX;
+
+    ComputeBounds(pTree, nDim);
+}
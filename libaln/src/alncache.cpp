@@ -0,0 +1,304 @@
+// ALN Library
+
+/* MIT License
+
+Copyright (c) 2020 William Ward Armstrong
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+
+// alncache.cpp
+
+#ifdef ALNDLL
+#define ALNIMP __declspec(dllexport)
+#endif
+
+#include <aln.h>
+#include "alnpriv.h"
+#include <climits>
+#include <mutex>
+#include <vector>
+
+#ifdef _DEBUG
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+// Control loops evaluate the same or nearly the same inputs many times, and
+// most of the cost of an evaluation is finding the active LFN.  The cache
+// quantises each input to a cell a fltEpsilon wide in every input variable
+// and remembers the active LFN found for the cell, so a later input in the
+// cell is evaluated on that one LFN.
+//
+// The cells are split into stripes, each with a lock and its own counts.
+// A stripe is chosen by the high bits of the hash of the cell and a cell in
+// it by the low bits; a cell holds one key, and a new key replaces it.  The
+// tree is evaluated without holding the lock.  Cells remember the generation
+// of the ALN they were filled in, so a change to the ALN makes them all
+// stale at once without touching them.
+
+struct CCacheStripe
+{
+    std::mutex mutex;
+    ALNEVALCACHESTATS stats;
+    char acPad[64];                     // keeps the locks of stripes apart
+};
+
+struct CEvalCache
+{
+    const ALN* pALN;
+    int nOutput;                        // output variable when created
+    int nKeys;                          // input variables keyed, nDim - 1
+    std::vector<int> vecVar;            // the input variables
+    std::vector<float> vecInvEpsilon;   // 1 / fltEpsilon, 0 keys the value
+    int nStripes;
+    int nCellShift;                     // log2 of the cells per stripe
+    CCacheStripe* aStripes;
+
+    // cells of all stripes; the keys of a cell are nKeys ints
+    std::vector<ALNNODE*> vecLFN;       // NULL if the cell is empty
+    std::vector<long> vecGeneration;
+    std::vector<int> vecKey;
+
+    CEvalCache()
+    {
+        pALN = NULL;
+        nOutput = nKeys = nStripes = nCellShift = 0;
+        aStripes = NULL;
+    }
+    ~CEvalCache()
+    {
+        delete[] aStripes;
+    }
+};
+
+// the cell of an input value
+static inline int CellKey(float flt, float fltInvEpsilon)
+{
+    if (fltInvEpsilon == 0)
+    {
+        int n;
+        memcpy(&n, &flt, sizeof(int));
+        return n;
+    }
+
+    float fltCell = floorf(flt * fltInvEpsilon);
+    if (!(fltCell > (float)INT_MIN))    // NaN as well
+        return INT_MIN;
+    if (fltCell >= -(float)INT_MIN)
+        return INT_MAX;
+    return (int)fltCell;
+}
+
+static inline unsigned long long HashKey(const CEvalCache* pCache, const float* afltX)
+{
+    unsigned long long nHash = 0x9E3779B97F4A7C15ULL;
+    for (int i = 0; i < pCache->nKeys; i++)
+    {
+        nHash ^= (unsigned int)CellKey(afltX[pCache->vecVar[i]], pCache->vecInvEpsilon[i]);
+        nHash *= 0xFF51AFD7ED558CCDULL;
+        nHash ^= nHash >> 32;
+    }
+    return nHash;
+}
+
+static inline BOOL SameKey(const CEvalCache* pCache, const int* anKey, const float* afltX)
+{
+    for (int i = 0; i < pCache->nKeys; i++)
+    {
+        if (anKey[i] != CellKey(afltX[pCache->vecVar[i]], pCache->vecInvEpsilon[i]))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+// creates a cache of at most nEntries cells for evaluations of pALN
+// returns ALN_* error code, (ALN_NOERROR on success)
+ALNIMP int ALNAPI ALNCreateEvalCache(const ALN* pALN, int nEntries,
+    int nStripes, void** ppvCache)
+{
+    // parameter variance
+    if (pALN == NULL || nEntries <= 0 || nStripes <= 0 || nStripes > nEntries ||
+        ppvCache == NULL)
+        return ALN_GENERIC;
+
+    *ppvCache = NULL;
+
+    CEvalCache* pCache = NULL;
+    int nReturn = ALN_NOERROR;
+    try
+    {
+        pCache = new CEvalCache;
+        pCache->pALN = pALN;
+        pCache->nOutput = pALN->nOutput;
+        for (int i = 0; i < pALN->nDim; i++)
+        {
+            if (i == pALN->nOutput)
+                continue;
+
+            const ALNCONSTRAINT* pConstr = GetVarConstraint(0, pALN, i);
+            float fltEpsilon = (pConstr != NULL) ? pConstr->fltEpsilon : 0;
+            pCache->vecVar.push_back(i);
+            pCache->vecInvEpsilon.push_back((fltEpsilon > 0) ? 1.0f / fltEpsilon : 0);
+        }
+        pCache->nKeys = (int)pCache->vecVar.size();
+
+        // a power of two cells per stripe, no more than nEntries in all
+        pCache->nStripes = nStripes;
+        while (((long long)nStripes << (pCache->nCellShift + 1)) <= nEntries)
+        {
+            pCache->nCellShift++;
+        }
+        size_t nCells = (size_t)nStripes << pCache->nCellShift;
+
+        pCache->aStripes = new CCacheStripe[nStripes];
+        for (int i = 0; i < nStripes; i++)
+        {
+            memset(&pCache->aStripes[i].stats, 0, sizeof(ALNEVALCACHESTATS));
+        }
+        pCache->vecLFN.assign(nCells, NULL);
+        pCache->vecGeneration.assign(nCells, 0);
+        pCache->vecKey.assign(nCells * pCache->nKeys, 0);
+
+        *ppvCache = pCache;
+    }
+    catch (...)
+    {
+        nReturn = ALN_OUTOFMEM;
+    }
+
+    if (nReturn != ALN_NOERROR)
+        delete pCache;
+
+    return nReturn;
+}
+
+// evaluates the ALN of a cache on a single vector, see ALNQuickEval
+// the LFN returned in ppActiveLFN is the one the value was found on
+// NOTE: for efficiency reasons, there is _no_ parameter checking performed
+ALNIMP float ALNAPI ALNCachedEval(void* pvCache, const float* afltX,
+    ALNNODE** ppActiveLFN)
+{
+    ASSERT(pvCache);
+    ASSERT(afltX);
+
+    CEvalCache* pCache = (CEvalCache*)pvCache;
+    const ALN* pALN = pCache->pALN;
+
+    // the keys were chosen for the old output variable
+    if (pALN->nOutput != pCache->nOutput)
+        return ALNQuickEval(pALN, afltX, ppActiveLFN);
+
+    unsigned long long nHash = HashKey(pCache, afltX);
+    size_t nStripe = (size_t)((nHash >> 32) % pCache->nStripes);
+    CCacheStripe& stripe = pCache->aStripes[nStripe];
+    size_t nCell = (nStripe << pCache->nCellShift) +
+        (size_t)(nHash & ((1ULL << pCache->nCellShift) - 1));
+    int* anKey = pCache->vecKey.data() + nCell * pCache->nKeys;
+    long nGeneration = pALN->nGeneration;
+
+    ALNNODE* pActiveLFN = NULL;
+    {
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        ALNNODE* pLFN = pCache->vecLFN[nCell];
+        if (pLFN == NULL)
+        {
+            stripe.stats.nMisses++;
+        }
+        else if (pCache->vecGeneration[nCell] != nGeneration)
+        {
+            stripe.stats.nMisses++;
+            stripe.stats.nStale++;
+        }
+        else if (!SameKey(pCache, anKey, afltX))
+        {
+            stripe.stats.nMisses++;
+            stripe.stats.nEvictions++;
+        }
+        else
+        {
+            stripe.stats.nHits++;
+            pActiveLFN = pLFN;
+        }
+    }
+
+    float flt;
+    if (pActiveLFN != NULL)
+    {
+        flt = afltX[pALN->nOutput] + LFNValue(pActiveLFN, afltX, pALN->nDim);
+    }
+    else
+    {
+        flt = afltX[pALN->nOutput] + CutoffEval(pALN->pTree, pALN, afltX,
+            CEvalCutoff(), &pActiveLFN);
+        STATS_TREEEVAL(pALN->pTree, pActiveLFN);
+
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        pCache->vecLFN[nCell] = pActiveLFN;
+        pCache->vecGeneration[nCell] = nGeneration;
+        for (int i = 0; i < pCache->nKeys; i++)
+        {
+            anKey[i] = CellKey(afltX[pCache->vecVar[i]], pCache->vecInvEpsilon[i]);
+        }
+    }
+
+    if (ppActiveLFN)
+        *ppActiveLFN = pActiveLFN;
+
+    return flt;
+}
+
+// gets the lookup counts of a cache, summed over its stripes, and zeroes
+// them if bReset; the hit rate is nHits / (nHits + nMisses)
+// returns ALN_* error code, (ALN_NOERROR on success)
+ALNIMP int ALNAPI ALNGetEvalCacheStats(void* pvCache,
+    ALNEVALCACHESTATS* pStats, BOOL bReset)
+{
+    if (pvCache == NULL || pStats == NULL)
+        return ALN_GENERIC;
+
+    CEvalCache* pCache = (CEvalCache*)pvCache;
+
+    memset(pStats, 0, sizeof(ALNEVALCACHESTATS));
+    for (int i = 0; i < pCache->nStripes; i++)
+    {
+        CCacheStripe& stripe = pCache->aStripes[i];
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        pStats->nHits += stripe.stats.nHits;
+        pStats->nMisses += stripe.stats.nMisses;
+        pStats->nStale += stripe.stats.nStale;
+        pStats->nEvictions += stripe.stats.nEvictions;
+        if (bReset)
+            memset(&stripe.stats, 0, sizeof(ALNEVALCACHESTATS));
+    }
+
+    return ALN_NOERROR;
+}
+
+// destroys a cache; no thread may be using it
+// returns ALN_* error code, (ALN_NOERROR on success)
+ALNIMP int ALNAPI ALNDestroyEvalCache(void* pvCache)
+{
+    if (pvCache == NULL)
+        return ALN_GENERIC;
+
+    delete (CEvalCache*)pvCache;
+
+    return ALN_NOERROR;
+}
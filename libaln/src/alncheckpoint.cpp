@@ -0,0 +1,976 @@
+// ALN Library
+
+/* MIT License
+
+Copyright (c) 2020 William Ward Armstrong
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+// alncheckpoint.cpp
+
+#ifdef ALNDLL
+#define ALNIMP __declspec(dllexport)
+#endif
+
+#include <aln.h>
+#include "alnpriv.h"
+#include <errno.h>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+#ifdef _DEBUG
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+// A checkpoint holds everything needed to continue a run between two calls
+// to ALNTrain as if it had never stopped: the tree including the split
+// statistics and the eval route, the training buffer with its insertion
+// point, the state of the random number generator and the growth settings.
+// ALNWrite only saves what is needed for evaluation.  The labels of a
+// one-vs-rest model go with the buffer, and the caller's own state, such as
+// where it is in its training schedule, goes with the rest as a block of
+// bytes the library does not look into.
+
+// The growth and optimization settings are those of the ALN's own training
+// context, or the globals; a flag says which, and the read puts them back
+// in the same place.
+
+// following macros won't work if you pass a pointer to be written...
+// ie, treat param n as a reference to var being written
+#define _WRITE(f, n) ((int)fwrite(&(n), sizeof((n)), 1, f))
+#define _READ(f, n) ((int)fread(&(n), sizeof((n)), 1, f))
+
+#define CKPHDR "ALNCK"
+#define CKPHDRSIZE 5
+
+// rows of the training buffer written per lock of the checkpoint mutex
+#define CKPROWCHUNK 1024
+
+// checkpoint in progress
+struct CCheckpoint
+{
+    std::string strFileName;
+    const ALN* pALN;              // ALN to write, a private copy if bOwnALN
+    BOOL bOwnALN;
+    ALNDATAINFO datainfo;         // buffer description at snapshot time
+
+    // The training buffer is shared with the caller until the caller wants
+    // to change it. ALNDetachCheckpoint then copies the rows not yet
+    // written into afltPrivate and the writer continues from that copy.
+    std::mutex mutex;
+    const float* afltRows;        // rows still to be written, by row index
+    float* afltPrivate;           // private copy, NULL while shared
+    long nRowsWritten;
+
+    const float* afltLabels;      // labels of the rows, a private copy if pending
+    std::vector<float> vecLabels;
+
+    std::string strMeta;          // the caller's bytes
+    std::string strRandState;
+    ALNTRAINCONTEXT context;
+    char bOwnContext;             // context of the ALN, else the globals
+
+    std::thread thread;
+    int nResult;
+
+    CCheckpoint()
+    {
+        pALN = NULL;
+        bOwnALN = FALSE;
+        memset(&datainfo, 0, sizeof(datainfo));
+        afltRows = NULL;
+        afltPrivate = NULL;
+        nRowsWritten = 0;
+        afltLabels = NULL;
+        nResult = ALN_NOERROR;
+    }
+
+    ~CCheckpoint()
+    {
+        if (bOwnALN && pALN != NULL)
+            ALNDestroyALN((ALN*)pALN);
+        if (afltPrivate != NULL)
+            free(afltPrivate);
+    }
+};
+
+// pending checkpoints sharing the caller's training buffer, so the library
+// can detach them itself before it adds queued samples to the buffer
+static std::mutex s_mutexShared;
+static std::vector<CCheckpoint*> s_vecShared;
+
+// helper: stops tracking a checkpoint which no longer shares the buffer,
+// with s_mutexShared held
+static void ALNAPI Unshare(CCheckpoint* pCheckpoint)
+{
+    s_vecShared.erase(std::remove(s_vecShared.begin(), s_vecShared.end(), pCheckpoint),
+        s_vecShared.end());
+}
+
+// helpers
+static int ALNAPI DoCheckpointWrite(FILE* pFile, CCheckpoint* pCheckpoint);
+static int ALNAPI DoCheckpointRead(FILE* pFile, ALN** ppALN, ALNDATAINFO* pDataInfo,
+    void* pvMeta, int nMetaBytes);
+static int ALNAPI WriteCheckpointTree(FILE* pFile, const ALN* pALN, const ALNNODE* pNode);
+static int ALNAPI ReadCheckpointTree(FILE* pFile, ALN* pALN, ALNNODE* pNode);
+static int ALNAPI ChildIndex(const ALNNODE* pNode, const ALNNODE* pChild);
+
+// writes the checkpoint to a temporary file and renames it, so a crash
+// while writing never destroys the previous checkpoint
+static void ALNAPI CheckpointWriteProc(CCheckpoint* pCheckpoint)
+{
+    std::string strTemp = pCheckpoint->strFileName + ".tmp";
+
+    FILE* pFile;
+    if (fopen_s(&pFile, strTemp.c_str(), "wb") != 0)
+    {
+        pCheckpoint->nResult = ALN_ERRFILE;
+        return;
+    }
+
+    int nRet = DoCheckpointWrite(pFile, pCheckpoint);
+
+    if (fclose(pFile) != 0 && nRet == ALN_NOERROR)
+        nRet = ALN_ERRFILE;
+
+    if (nRet == ALN_NOERROR)
+    {
+        remove(pCheckpoint->strFileName.c_str());
+        if (rename(strTemp.c_str(), pCheckpoint->strFileName.c_str()) != 0)
+            nRet = ALN_ERRFILE;
+    }
+    else
+    {
+        int nErr = errno;     // save it
+        remove(strTemp.c_str());
+        errno = nErr;
+    }
+
+    pCheckpoint->nResult = nRet;
+}
+
+// writes a checkpoint of pALN and the training buffer in pDataInfo, with the
+// nMetaBytes bytes at pvMeta; if ppvCheckpoint is NULL the checkpoint is written before returning,
+// otherwise a snapshot of the tree is taken and the file is written on a
+// background thread; *ppvCheckpoint receives a handle which must be passed
+// to ALNWaitCheckpoint... the caller must call ALNDetachCheckpoint before
+// changing or freeing the training buffer while the checkpoint is pending
+// returns ALN_* error code, (ALN_NOERROR on success)
+ALNIMP int ALNAPI ALNWriteCheckpoint(const ALN* pALN,
+    const ALNDATAINFO* pDataInfo,
+    const char* pszFileName,
+    const void* pvMeta,
+    int nMetaBytes,
+    void** ppvCheckpoint)
+{
+    // parameter variance
+    if (pALN == NULL || pDataInfo == NULL || pszFileName == NULL)
+        return ALN_GENERIC;
+
+    if (pDataInfo->nTRcurrSamples > 0 && pDataInfo->afltTRdata == NULL)
+        return ALN_GENERIC;
+
+    if (nMetaBytes < 0 || (nMetaBytes > 0 && pvMeta == NULL))
+        return ALN_GENERIC;
+
+    if (ppvCheckpoint != NULL)
+        *ppvCheckpoint = NULL;
+
+    CCheckpoint* pCheckpoint = NULL;
+    int nReturn = ALN_NOERROR;
+
+    try
+    {
+        pCheckpoint = new CCheckpoint;
+        pCheckpoint->strFileName = pszFileName;
+        pCheckpoint->datainfo = *pDataInfo;
+        pCheckpoint->afltRows = pDataInfo->afltTRdata;
+        pCheckpoint->afltLabels = pDataInfo->afltTRlabels;
+        pCheckpoint->strMeta.assign((const char*)pvMeta, nMetaBytes);
+
+        // take the state which the next call to ALNTrain depends on
+        GetRandState(pCheckpoint->strRandState);
+        ALNGetTrainContext(pALN, &pCheckpoint->context);
+        pCheckpoint->bOwnContext = (pALN->pTrainContext != NULL);
+
+        if (ppvCheckpoint == NULL)
+        {
+            // synchronous, write straight from the caller's ALN
+            pCheckpoint->pALN = pALN;
+            CheckpointWriteProc(pCheckpoint);
+            nReturn = pCheckpoint->nResult;
+            delete pCheckpoint;
+        }
+        else
+        {
+            // the tree changes on every adapt, so it is copied now; the
+            // buffer only changes when samples are added
+            pCheckpoint->pALN = DuplicateALN(pALN);
+            pCheckpoint->bOwnALN = TRUE;
+            if (pCheckpoint->afltLabels != NULL)
+            {
+                pCheckpoint->vecLabels.assign(pCheckpoint->afltLabels,
+                    pCheckpoint->afltLabels + (size_t)pDataInfo->nTRcurrSamples * 2);
+                pCheckpoint->afltLabels = pCheckpoint->vecLabels.data();
+            }
+            if (pCheckpoint->afltRows != NULL)
+            {
+                std::lock_guard<std::mutex> lock(s_mutexShared);
+                s_vecShared.push_back(pCheckpoint);
+            }
+            try
+            {
+                pCheckpoint->thread = std::thread(CheckpointWriteProc, pCheckpoint);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(s_mutexShared);
+                Unshare(pCheckpoint);
+                throw;
+            }
+            *ppvCheckpoint = pCheckpoint;
+        }
+    }
+    catch (CALNMemoryException* e)
+    {
+        nReturn = ALN_OUTOFMEM;
+        e->Delete();
+        delete pCheckpoint;
+    }
+    catch (CALNException* e)
+    {
+        nReturn = ALN_GENERIC;
+        e->Delete();
+        delete pCheckpoint;
+    }
+    catch (...)
+    {
+        nReturn = ALN_GENERIC;
+        delete pCheckpoint;
+    }
+
+    return nReturn;
+}
+
+// helper: copies the rows of a checkpoint which have not been written yet,
+// with s_mutexShared held
+static int ALNAPI DetachRows(CCheckpoint* pCheckpoint)
+{
+    std::lock_guard<std::mutex> lock(pCheckpoint->mutex);
+
+    if (pCheckpoint->afltPrivate != NULL)
+        return ALN_NOERROR;   // already detached
+
+    long nRows = pCheckpoint->datainfo.nTRcurrSamples;
+    long nRemaining = nRows - pCheckpoint->nRowsWritten;
+    if (nRemaining <= 0)
+        return ALN_NOERROR;   // nothing left to share
+
+    int nCols = pCheckpoint->datainfo.nTRcols;
+    float* afltCopy = (float*)malloc(nRemaining * nCols * sizeof(float));
+    if (afltCopy == NULL)
+        return ALN_OUTOFMEM;
+
+    memcpy(afltCopy, pCheckpoint->afltRows + pCheckpoint->nRowsWritten * nCols,
+        nRemaining * nCols * sizeof(float));
+
+    // keep indexing by row number
+    pCheckpoint->afltPrivate = afltCopy;
+    pCheckpoint->afltRows = afltCopy - pCheckpoint->nRowsWritten * nCols;
+
+    return ALN_NOERROR;
+}
+
+// makes a pending checkpoint independent of the caller's training buffer
+// by copying the rows that have not been written yet... call this before
+// adding samples to or freeing the buffer
+// returns ALN_* error code, (ALN_NOERROR on success)
+ALNIMP int ALNAPI ALNDetachCheckpoint(void* pvCheckpoint)
+{
+    if (pvCheckpoint == NULL)
+        return ALN_GENERIC;
+
+    CCheckpoint* pCheckpoint = (CCheckpoint*)pvCheckpoint;
+    std::lock_guard<std::mutex> lock(s_mutexShared);
+    int nReturn = DetachRows(pCheckpoint);
+    if (nReturn == ALN_NOERROR)
+        Unshare(pCheckpoint);
+    return nReturn;
+}
+
+int ALNAPI DetachCheckpoints(const ALNDATAINFO* pDataInfo)
+{
+    ASSERT(pDataInfo);
+    std::lock_guard<std::mutex> lock(s_mutexShared);
+    for (size_t i = s_vecShared.size(); i-- > 0; )
+    {
+        CCheckpoint* pCheckpoint = s_vecShared[i];
+        if (pCheckpoint->datainfo.afltTRdata != pDataInfo->afltTRdata)
+            continue;
+        int nReturn = DetachRows(pCheckpoint);
+        if (nReturn != ALN_NOERROR)
+            return nReturn;
+        s_vecShared.erase(s_vecShared.begin() + i);
+    }
+    return ALN_NOERROR;
+}
+
+// waits for a checkpoint started by ALNWriteCheckpoint and frees it
+// returns ALN_* error code of the write, (ALN_NOERROR on success)
+ALNIMP int ALNAPI ALNWaitCheckpoint(void* pvCheckpoint)
+{
+    if (pvCheckpoint == NULL)
+        return ALN_GENERIC;
+
+    CCheckpoint* pCheckpoint = (CCheckpoint*)pvCheckpoint;
+    {
+        std::lock_guard<std::mutex> lock(s_mutexShared);
+        Unshare(pCheckpoint);
+    }
+    if (pCheckpoint->thread.joinable())
+        pCheckpoint->thread.join();
+
+    int nReturn = pCheckpoint->nResult;
+    delete pCheckpoint;
+
+    return nReturn;
+}
+
+// reads a checkpoint written by ALNWriteCheckpoint
+// the new ALN is returned in ppALN; pDataInfo receives a newly allocated
+// training buffer of nTRmaxSamples rows, and labels for as many if the
+// checkpoint has them, its aVarInfo member is unchanged; the random
+// generator of the calling thread and the growth settings, in the ALN's own
+// context or the globals, are restored; pvMeta receives the caller's bytes,
+// of which there must be nMetaBytes
+// returns ALN_* error code, (ALN_NOERROR on success)
+ALNIMP int ALNAPI ALNReadCheckpoint(const char* pszFileName,
+    ALN** ppALN,
+    ALNDATAINFO* pDataInfo,
+    void* pvMeta,
+    int nMetaBytes)
+{
+    // parameter variance
+    if (pszFileName == NULL || ppALN == NULL || pDataInfo == NULL)
+        return ALN_GENERIC;
+
+    if (nMetaBytes < 0 || (nMetaBytes > 0 && pvMeta == NULL))
+        return ALN_GENERIC;
+
+    // open a file -- binary mode
+    FILE* pFile;
+    if (fopen_s(&pFile, pszFileName, "rb") != 0)
+        return ALN_ERRFILE;
+
+    int nRet = DoCheckpointRead(pFile, ppALN, pDataInfo, pvMeta, nMetaBytes);
+
+    fclose(pFile);  // will not reset errno
+
+    return nRet;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// NOTE: byte order is a problem and is machine dependent
+
+static int ALNAPI DoCheckpointWrite(FILE* pFile, CCheckpoint* pCheckpoint)
+{
+    ASSERT(pFile);
+    ASSERT(pCheckpoint);
+
+    const ALN* pALN = pCheckpoint->pALN;
+
+    // header
+    if (fwrite(CKPHDR, CKPHDRSIZE, 1, pFile) != 1) return ALN_ERRFILE;
+    int nVersion = ALNCKPVER;
+    if (_WRITE(pFile, nVersion) != 1) return ALN_ERRFILE;
+
+    // training context
+    const ALNTRAINCONTEXT& context = pCheckpoint->context;
+    if (_WRITE(pFile, context.bClassify2) != 1) return ALN_ERRFILE;
+    if (_WRITE(pFile, context.bConvex) != 1) return ALN_ERRFILE;
+    if (_WRITE(pFile, context.bAlphaBeta) != 1) return ALN_ERRFILE;
+    if (_WRITE(pFile, context.bDistanceOptimization) != 1) return ALN_ERRFILE;
+    if (_WRITE(pFile, context.bStopTraining) != 1) return ALN_ERRFILE;
+    if (_WRITE(pFile, context.fltWeightDecay) != 1) return ALN_ERRFILE;
+    if (_WRITE(pFile, context.fltWeightBound) != 1) return ALN_ERRFILE;
+    if (_WRITE(pFile, context.nSplitsAllowed) != 1) return ALN_ERRFILE;
+    if (_WRITE(pFile, context.nSplitCount) != 1) return ALN_ERRFILE;
+    if (_WRITE(pFile, pCheckpoint->bOwnContext) != 1) return ALN_ERRFILE;
+    if (_WRITE(pFile, context.nShuffleBlock) != 1) return ALN_ERRFILE;
+    if (_WRITE(pFile, context.fltSettle) != 1) return ALN_ERRFILE;
+    if (_WRITE(pFile, context.nSplitsPerRound) != 1) return ALN_ERRFILE;
+    if (_WRITE(pFile, context.bLearnFactors) != 1) return ALN_ERRFILE;
+    if (_WRITE(pFile, context.nSettledSamples) != 1) return ALN_ERRFILE;
+    if (_WRITE(pFile, context.nSettledInsert) != 1) return ALN_ERRFILE;
+    if (_WRITE(pFile, context.fltSettledMSEorF) != 1) return ALN_ERRFILE;
+
+    // random generator
+    int nRandState = (int)pCheckpoint->strRandState.size();
+    if (_WRITE(pFile, nRandState) != 1) return ALN_ERRFILE;
+    if (nRandState > 0 &&
+        fwrite(pCheckpoint->strRandState.data(), nRandState, 1, pFile) != 1) return ALN_ERRFILE;
+
+    // the caller's bytes
+    int nMetaBytes = (int)pCheckpoint->strMeta.size();
+    if (_WRITE(pFile, nMetaBytes) != 1) return ALN_ERRFILE;
+    if (nMetaBytes > 0 &&
+        fwrite(pCheckpoint->strMeta.data(), nMetaBytes, 1, pFile) != 1) return ALN_ERRFILE;
+
+    // ALN
+    if (_WRITE(pFile, pALN->nDim) != 1) return ALN_ERRFILE;
+    if (_WRITE(pFile, pALN->nOutput) != 1) return ALN_ERRFILE;
+    if (_WRITE(pFile, pALN->nRegions) != 1) return ALN_ERRFILE;
+    for (int i = 0; i < pALN->nRegions; i++)
+    {
+        const ALNREGION* pRegion = pALN->aRegions + i;
+        if (_WRITE(pFile, pRegion->nParentRegion) != 1) return ALN_ERRFILE;
+        if (_WRITE(pFile, pRegion->fltLearnFactor) != 1) return ALN_ERRFILE;
+        if (_WRITE(pFile, pRegion->fltSmoothEpsilon) != 1) return ALN_ERRFILE;
+        if (_WRITE(pFile, pRegion->flt4SE) != 1) return ALN_ERRFILE;
+        if (_WRITE(pFile, pRegion->fltOV16SE) != 1) return ALN_ERRFILE;
+        if (_WRITE(pFile, pRegion->nConstr) != 1) return ALN_ERRFILE;
+        for (int j = 0; j < pRegion->nConstr; j++)
+        {
+            if (_WRITE(pFile, pRegion->aConstr[j]) != 1) return ALN_ERRFILE;
+        }
+    }
+
+    int nRet = WriteCheckpointTree(pFile, pALN, pALN->pTree);
+    if (nRet != ALN_NOERROR) return nRet;
+
+    // training buffer
+    const ALNDATAINFO& datainfo = pCheckpoint->datainfo;
+    if (_WRITE(pFile, datainfo.nTRmaxSamples) != 1) return ALN_ERRFILE;
+    if (_WRITE(pFile, datainfo.nTRcurrSamples) != 1) return ALN_ERRFILE;
+    if (_WRITE(pFile, datainfo.nTRcols) != 1) return ALN_ERRFILE;
+    if (_WRITE(pFile, datainfo.nTRlayout) != 1) return ALN_ERRFILE;
+    if (_WRITE(pFile, datainfo.nTRinsert) != 1) return ALN_ERRFILE;
+    if (_WRITE(pFile, datainfo.fltMSEorF) != 1) return ALN_ERRFILE;
+
+    long nRows = datainfo.nTRcurrSamples;
+    int nCols = datainfo.nTRcols;
+    while (TRUE)
+    {
+        // the mutex keeps ALNDetachCheckpoint from swapping the rows away
+        // in the middle of a chunk
+        std::lock_guard<std::mutex> lock(pCheckpoint->mutex);
+        long nRow = pCheckpoint->nRowsWritten;
+        if (nRow >= nRows)
+            break;
+
+        long nChunk = nRows - nRow;
+        if (nChunk > CKPROWCHUNK)
+            nChunk = CKPROWCHUNK;
+        if ((long)fwrite(pCheckpoint->afltRows + nRow * nCols, nCols * sizeof(float),
+            nChunk, pFile) != nChunk) return ALN_ERRFILE;
+
+        pCheckpoint->nRowsWritten = nRow + nChunk;
+    }
+
+    // labels of a one-vs-rest model, two per row
+    char bLabels = (pCheckpoint->afltLabels != NULL) ? 1 : 0;
+    if (_WRITE(pFile, bLabels) != 1) return ALN_ERRFILE;
+    if (bLabels && (long)fwrite(pCheckpoint->afltLabels, 2 * sizeof(float),
+        nRows, pFile) != nRows) return ALN_ERRFILE;
+
+    return ALN_NOERROR;
+}
+
+static int ALNAPI DoCheckpointRead(FILE* pFile, ALN** ppALN, ALNDATAINFO* pDataInfo,
+    void* pvMeta, int nMetaBytes)
+{
+    ASSERT(pFile);
+    ASSERT(ppALN);
+    ASSERT(pDataInfo);
+
+    *ppALN = NULL;
+
+    // header
+    char szHdr[CKPHDRSIZE];
+    if (fread(szHdr, CKPHDRSIZE, 1, pFile) != 1) return ALN_ERRFILE;
+    if (strncmp(szHdr, CKPHDR, CKPHDRSIZE) != 0)
+        return ALN_BADFILEFORMAT;
+
+    int nVersion;
+    if (_READ(pFile, nVersion) != 1) return ALN_ERRFILE;
+    if (nVersion != ALNCKPVER)
+        return ALN_BADFILEFORMAT;
+
+    // the training context is applied only once the whole file has been read
+    ALNTRAINCONTEXT context;
+    char bOwnContext = 0;
+    if (_READ(pFile, context.bClassify2) != 1) return ALN_ERRFILE;
+    if (_READ(pFile, context.bConvex) != 1) return ALN_ERRFILE;
+    if (_READ(pFile, context.bAlphaBeta) != 1) return ALN_ERRFILE;
+    if (_READ(pFile, context.bDistanceOptimization) != 1) return ALN_ERRFILE;
+    if (_READ(pFile, context.bStopTraining) != 1) return ALN_ERRFILE;
+    if (_READ(pFile, context.fltWeightDecay) != 1) return ALN_ERRFILE;
+    if (_READ(pFile, context.fltWeightBound) != 1) return ALN_ERRFILE;
+    if (_READ(pFile, context.nSplitsAllowed) != 1) return ALN_ERRFILE;
+    if (_READ(pFile, context.nSplitCount) != 1) return ALN_ERRFILE;
+    if (_READ(pFile, bOwnContext) != 1) return ALN_ERRFILE;
+    if (_READ(pFile, context.nShuffleBlock) != 1) return ALN_ERRFILE;
+    if (_READ(pFile, context.fltSettle) != 1) return ALN_ERRFILE;
+    if (_READ(pFile, context.nSplitsPerRound) != 1) return ALN_ERRFILE;
+    if (_READ(pFile, context.bLearnFactors) != 1) return ALN_ERRFILE;
+    if (_READ(pFile, context.nSettledSamples) != 1) return ALN_ERRFILE;
+    if (_READ(pFile, context.nSettledInsert) != 1) return ALN_ERRFILE;
+    if (_READ(pFile, context.fltSettledMSEorF) != 1) return ALN_ERRFILE;
+
+    int nRandState;
+    if (_READ(pFile, nRandState) != 1) return ALN_ERRFILE;
+    if (nRandState < 0 || nRandState > 1000000)
+        return ALN_BADFILEFORMAT;
+    std::string strRandState(nRandState, ' ');
+    if (nRandState > 0 && fread(&strRandState[0], nRandState, 1, pFile) != 1)
+        return ALN_ERRFILE;
+
+    // the caller's bytes, copied out only once the whole file has been read
+    int nMeta;
+    if (_READ(pFile, nMeta) != 1) return ALN_ERRFILE;
+    if (nMeta != nMetaBytes)
+        return ALN_BADFILEFORMAT;
+    std::string strMeta(nMeta, ' ');
+    if (nMeta > 0 && fread(&strMeta[0], nMeta, 1, pFile) != 1)
+        return ALN_ERRFILE;
+
+    // alloc aln
+    ALN* pALN = (ALN*)malloc(sizeof(ALN));
+    if (pALN == NULL) return ALN_OUTOFMEM;
+    memset(pALN, 0, sizeof(ALN));
+    pALN->nVersion = ALNVER;
+
+    if (_READ(pFile, pALN->nDim) != 1 ||
+        _READ(pFile, pALN->nOutput) != 1 ||
+        _READ(pFile, pALN->nRegions) != 1)
+    {
+        pALN->nRegions = 0;
+        ALNDestroyALN(pALN);
+        return ALN_ERRFILE;
+    }
+    if (pALN->nDim < 2 || pALN->nOutput < 0 || pALN->nOutput >= pALN->nDim ||
+        pALN->nRegions <= 0)
+    {
+        pALN->nRegions = 0;
+        ALNDestroyALN(pALN);
+        return ALN_BADFILEFORMAT;
+    }
+
+    // regions
+    int nRegions = pALN->nRegions;
+    pALN->aRegions = (ALNREGION*)malloc(nRegions * sizeof(ALNREGION));
+    if (pALN->aRegions == NULL)
+    {
+        pALN->nRegions = 0;
+        ALNDestroyALN(pALN);
+        return ALN_OUTOFMEM;
+    }
+    memset(pALN->aRegions, 0, nRegions * sizeof(ALNREGION));
+
+    int nRet = ALN_NOERROR;
+    for (int i = 0; i < nRegions && nRet == ALN_NOERROR; i++)
+    {
+        ALNREGION* pRegion = pALN->aRegions + i;
+        if (_READ(pFile, pRegion->nParentRegion) != 1 ||
+            _READ(pFile, pRegion->fltLearnFactor) != 1 ||
+            _READ(pFile, pRegion->fltSmoothEpsilon) != 1 ||
+            _READ(pFile, pRegion->flt4SE) != 1 ||
+            _READ(pFile, pRegion->fltOV16SE) != 1 ||
+            _READ(pFile, pRegion->nConstr) != 1)
+        {
+            pRegion->nConstr = 0;
+            nRet = ALN_ERRFILE;
+            break;
+        }
+        if (pRegion->nConstr <= 0 || pRegion->nConstr > pALN->nDim)
+        {
+            pRegion->nConstr = 0;
+            nRet = ALN_BADFILEFORMAT;
+            break;
+        }
+        pRegion->aConstr = (ALNCONSTRAINT*)malloc(pRegion->nConstr * sizeof(ALNCONSTRAINT));
+        if (pRegion->aConstr == NULL)
+        {
+            pRegion->nConstr = 0;
+            nRet = ALN_OUTOFMEM;
+            break;
+        }
+        for (int j = 0; j < pRegion->nConstr; j++)
+        {
+            if (_READ(pFile, pRegion->aConstr[j]) != 1)
+            {
+                nRet = ALN_ERRFILE;
+                break;
+            }
+            if (pRegion->aConstr[j].nVarIndex < 0 ||
+                pRegion->aConstr[j].nVarIndex >= pALN->nDim)
+            {
+                nRet = ALN_BADFILEFORMAT;
+                break;
+            }
+        }
+    }
+
+    // tree
+    if (nRet == ALN_NOERROR)
+    {
+        pALN->pTree = (ALNNODE*)malloc(sizeof(ALNNODE));
+        if (pALN->pTree == NULL)
+        {
+            nRet = ALN_OUTOFMEM;
+        }
+        else
+        {
+            NODE_PARENT(pALN->pTree) = NULL;
+            nRet = ReadCheckpointTree(pFile, pALN, pALN->pTree);
+        }
+    }
+
+    // training buffer
+    ALNDATAINFO datainfo;
+    memset(&datainfo, 0, sizeof(datainfo));
+    if (nRet == ALN_NOERROR)
+    {
+        if (_READ(pFile, datainfo.nTRmaxSamples) != 1 ||
+            _READ(pFile, datainfo.nTRcurrSamples) != 1 ||
+            _READ(pFile, datainfo.nTRcols) != 1 ||
+            _READ(pFile, datainfo.nTRlayout) != 1 ||
+            _READ(pFile, datainfo.nTRinsert) != 1 ||
+            _READ(pFile, datainfo.fltMSEorF) != 1)
+        {
+            nRet = ALN_ERRFILE;
+        }
+        else if (datainfo.nTRmaxSamples < 0 || datainfo.nTRcurrSamples < 0 ||
+            datainfo.nTRcurrSamples > datainfo.nTRmaxSamples ||
+            datainfo.nTRinsert < 0 || datainfo.nTRinsert > datainfo.nTRmaxSamples ||
+            datainfo.nTRcols < pALN->nDim ||
+            (datainfo.nTRlayout != ALN_TRLAYOUT_FULL &&
+                (datainfo.nTRlayout != ALN_TRLAYOUT_COMPACT || datainfo.nTRcols != pALN->nDim + 2)))
+        {
+            nRet = ALN_BADFILEFORMAT;
+        }
+    }
+
+    if (nRet == ALN_NOERROR && datainfo.nTRmaxSamples > 0)
+    {
+        size_t nSize = (size_t)datainfo.nTRmaxSamples * datainfo.nTRcols * sizeof(float);
+        datainfo.afltTRdata = (float*)malloc(nSize);
+        if (datainfo.afltTRdata == NULL)
+        {
+            nRet = ALN_OUTOFMEM;
+        }
+        else
+        {
+            memset(datainfo.afltTRdata, 0, nSize);
+            if ((long)fread(datainfo.afltTRdata, datainfo.nTRcols * sizeof(float),
+                datainfo.nTRcurrSamples, pFile) != datainfo.nTRcurrSamples)
+            {
+                nRet = ALN_ERRFILE;
+            }
+        }
+    }
+
+    // labels of a one-vs-rest model
+    float* afltLabels = NULL;
+    char bLabels = 0;
+    if (nRet == ALN_NOERROR && _READ(pFile, bLabels) != 1)
+        nRet = ALN_ERRFILE;
+    if (nRet == ALN_NOERROR && bLabels && datainfo.nTRmaxSamples > 0)
+    {
+        size_t nSize = (size_t)datainfo.nTRmaxSamples * 2 * sizeof(float);
+        afltLabels = (float*)malloc(nSize);
+        if (afltLabels == NULL)
+        {
+            nRet = ALN_OUTOFMEM;
+        }
+        else
+        {
+            memset(afltLabels, 0, nSize);
+            if ((long)fread(afltLabels, 2 * sizeof(float), datainfo.nTRcurrSamples,
+                pFile) != datainfo.nTRcurrSamples)
+            {
+                nRet = ALN_ERRFILE;
+            }
+        }
+    }
+    datainfo.afltTRlabels = afltLabels;
+
+    if (nRet != ALN_NOERROR)
+    {
+        if (datainfo.afltTRdata != NULL)
+            free(datainfo.afltTRdata);
+        if (afltLabels != NULL)
+            free(afltLabels);
+        ALNDestroyALN(pALN);
+        return nRet;
+    }
+
+    if (!SetRandState(strRandState))
+    {
+        free(datainfo.afltTRdata);
+        if (afltLabels != NULL)
+            free(afltLabels);
+        ALNDestroyALN(pALN);
+        return ALN_BADFILEFORMAT;
+    }
+
+    // everything is read, now the training state can be replaced
+    if (bOwnContext)
+    {
+        if (ALNSetTrainContext(pALN, &context) != ALN_NOERROR)
+        {
+            free(datainfo.afltTRdata);
+            if (afltLabels != NULL)
+                free(afltLabels);
+            ALNDestroyALN(pALN);
+            return ALN_OUTOFMEM;
+        }
+    }
+    else
+    {
+        SetGlobalTrainContext(context);
+    }
+
+    datainfo.aVarInfo = pDataInfo->aVarInfo;
+    *pDataInfo = datainfo;
+    if (nMeta > 0)
+        memcpy(pvMeta, strMeta.data(), nMeta);
+
+    *ppALN = pALN;
+
+    return ALN_NOERROR;
+}
+
+static int ALNAPI ChildIndex(const ALNNODE* pNode, const ALNNODE* pChild)
+{
+    for (int i = 0; i < MINMAX_NUMCHILDREN(pNode); i++)
+    {
+        if (MINMAX_CHILDREN(pNode)[i] == pChild)
+            return i;
+    }
+    return -1;
+}
+
+static int ALNAPI WriteVector(FILE* pFile, const float* aflt, int n)
+{
+    char c = (aflt != NULL) ? 1 : 0;
+    if (_WRITE(pFile, c) != 1) return ALN_ERRFILE;
+    if (aflt != NULL && (int)fwrite(aflt, sizeof(float), n, pFile) != n) return ALN_ERRFILE;
+    return ALN_NOERROR;
+}
+
+static int ALNAPI ReadVector(FILE* pFile, float*& aflt, int n)
+{
+    aflt = NULL;
+    char c;
+    if (_READ(pFile, c) != 1) return ALN_ERRFILE;
+    if (c == 0) return ALN_NOERROR;
+
+    aflt = (float*)malloc(n * sizeof(float));
+    if (aflt == NULL) return ALN_OUTOFMEM;
+    if ((int)fread(aflt, sizeof(float), n, pFile) != n) return ALN_ERRFILE;
+    return ALN_NOERROR;
+}
+
+static int ALNAPI WriteCheckpointTree(FILE* pFile, const ALN* pALN, const ALNNODE* pNode)
+{
+    ASSERT(pFile);
+    ASSERT(pNode);
+
+    int nDim = pALN->nDim;
+    int nRet;
+
+    // unlike ALNWrite, the eval flags are kept
+    if (_WRITE(pFile, pNode->nParentRegion) != 1) return ALN_ERRFILE;
+    if (_WRITE(pFile, pNode->fNode) != 1) return ALN_ERRFILE;
+    if (_WRITE(pFile, pNode->nRespCount) != 1) return ALN_ERRFILE;
+    if (_WRITE(pFile, pNode->nRespCountLastEpoch) != 1) return ALN_ERRFILE;
+    if (_WRITE(pFile, pNode->fltDistance) != 1) return ALN_ERRFILE;
+
+    if (NODE_ISLFN(pNode))
+    {
+        ASSERT(LFN_VARMAP(pNode) == NULL);      // var map not yet supported
+        ASSERT(LFN_VDIM(pNode) == nDim);        // no different sized vectors yet
+
+        if ((nRet = WriteVector(pFile, LFN_W(pNode), nDim + 1)) != ALN_NOERROR) return nRet;
+        if ((nRet = WriteVector(pFile, LFN_C(pNode), nDim)) != ALN_NOERROR) return nRet;
+        if ((nRet = WriteVector(pFile, LFN_D(pNode), nDim)) != ALN_NOERROR) return nRet;
+
+        // split statistics, including the convexity criterion
+        char c = (LFN_SPLIT(pNode) != NULL) ? 1 : 0;
+        if (_WRITE(pFile, c) != 1) return ALN_ERRFILE;
+        if (c)
+        {
+            if (_WRITE(pFile, LFN_SPLIT_COUNT(pNode)) != 1) return ALN_ERRFILE;
+            if (_WRITE(pFile, LFN_SPLIT_SQERR(pNode)) != 1) return ALN_ERRFILE;
+            if (_WRITE(pFile, LFN_SPLIT_RESPTOTAL(pNode)) != 1) return ALN_ERRFILE;
+            if ((nRet = WriteVector(pFile, LFN_SPLIT_T(pNode), nDim)) != ALN_NOERROR) return nRet;
+            if (_WRITE(pFile, LFN_SPLIT_LEARNFACTOR(pNode)) != 1) return ALN_ERRFILE;
+            if (_WRITE(pFile, LFN_SPLIT_EPOCHMSE(pNode)) != 1) return ALN_ERRFILE;
+        }
+    }
+    else
+    {
+        ASSERT(NODE_ISMINMAX(pNode));
+
+        // the eval route decides which child goes first during AdaptEval
+        int nEval = ChildIndex(pNode, MINMAX_EVAL(pNode));
+        int nActive = ChildIndex(pNode, MINMAX_ACTIVE(pNode));
+        if (_WRITE(pFile, MINMAX_RESPACTIVE(pNode)) != 1) return ALN_ERRFILE;
+        if (_WRITE(pFile, nEval) != 1) return ALN_ERRFILE;
+        if (_WRITE(pFile, nActive) != 1) return ALN_ERRFILE;
+        if ((nRet = WriteVector(pFile, MINMAX_CENTROID(pNode), nDim)) != ALN_NOERROR) return nRet;
+        if ((nRet = WriteVector(pFile, MINMAX_NORMAL(pNode), nDim)) != ALN_NOERROR) return nRet;
+        if ((nRet = WriteVector(pFile, MINMAX_BOUNDS(pNode), BOUNDS_SIZE(nDim))) != ALN_NOERROR) return nRet;
+        char c = (MINMAX_ROUTE(pNode) != NULL) ? 1 : 0;
+        if (_WRITE(pFile, c) != 1) return ALN_ERRFILE;
+        if (c && _WRITE(pFile, *MINMAX_ROUTE(pNode)) != 1) return ALN_ERRFILE;
+        if (_WRITE(pFile, MINMAX_THRESHOLD(pNode)) != 1) return ALN_ERRFILE;
+        if (_WRITE(pFile, MINMAX_COUNT(pNode)) != 1) return ALN_ERRFILE;
+
+        int nChildren = MINMAX_NUMCHILDREN(pNode);
+        if (_WRITE(pFile, nChildren) != 1) return ALN_ERRFILE;
+        for (int i = 0; i < nChildren; i++)
+        {
+            nRet = WriteCheckpointTree(pFile, pALN, MINMAX_CHILDREN(pNode)[i]);
+            if (nRet != ALN_NOERROR) return nRet;
+        }
+    }
+
+    return ALN_NOERROR;
+}
+
+static int ALNAPI ReadCheckpointTree(FILE* pFile, ALN* pALN, ALNNODE* pNode)
+{
+    ASSERT(pFile);
+    ASSERT(pALN);
+    ASSERT(pNode);
+
+    // keep the parent, set by the caller
+    ALNNODE* pParent = NODE_PARENT(pNode);
+    memset(pNode, 0, sizeof(ALNNODE));
+    NODE_PARENT(pNode) = pParent;
+
+    int nDim = pALN->nDim;
+    int nRet;
+
+    if (_READ(pFile, pNode->nParentRegion) != 1) return ALN_ERRFILE;
+    if (_READ(pFile, pNode->fNode) != 1) return ALN_ERRFILE;
+    if (_READ(pFile, pNode->nRespCount) != 1) return ALN_ERRFILE;
+    if (_READ(pFile, pNode->nRespCountLastEpoch) != 1) return ALN_ERRFILE;
+    if (_READ(pFile, pNode->fltDistance) != 1) return ALN_ERRFILE;
+    if (pNode->nParentRegion < 0 || pNode->nParentRegion >= pALN->nRegions ||
+        (pNode->fNode & (NF_MINMAX | NF_LFN)) == 0)
+    {
+        // leave an empty LFN so the tree can be destroyed
+        pNode->fNode = NF_LFN;
+        return ALN_BADFILEFORMAT;
+    }
+
+    if (NODE_ISLFN(pNode))
+    {
+        LFN_VDIM(pNode) = nDim;
+        if ((nRet = ReadVector(pFile, LFN_W(pNode), nDim + 1)) != ALN_NOERROR) return nRet;
+        if ((nRet = ReadVector(pFile, LFN_C(pNode), nDim)) != ALN_NOERROR) return nRet;
+        if ((nRet = ReadVector(pFile, LFN_D(pNode), nDim)) != ALN_NOERROR) return nRet;
+        if (LFN_W(pNode) == NULL || LFN_C(pNode) == NULL || LFN_D(pNode) == NULL)
+            return ALN_BADFILEFORMAT;
+
+        char c;
+        if (_READ(pFile, c) != 1) return ALN_ERRFILE;
+        if (c)
+        {
+            LFN_SPLIT(pNode) = (ALNLFNSPLIT*)malloc(sizeof(ALNLFNSPLIT));
+            if (LFN_SPLIT(pNode) == NULL)
+                return ALN_OUTOFMEM;
+            memset(LFN_SPLIT(pNode), 0, sizeof(ALNLFNSPLIT));
+
+            if (_READ(pFile, LFN_SPLIT_COUNT(pNode)) != 1) return ALN_ERRFILE;
+            if (_READ(pFile, LFN_SPLIT_SQERR(pNode)) != 1) return ALN_ERRFILE;
+            if (_READ(pFile, LFN_SPLIT_RESPTOTAL(pNode)) != 1) return ALN_ERRFILE;
+            if ((nRet = ReadVector(pFile, LFN_SPLIT_T(pNode), nDim)) != ALN_NOERROR) return nRet;
+            if (_READ(pFile, LFN_SPLIT_LEARNFACTOR(pNode)) != 1) return ALN_ERRFILE;
+            if (_READ(pFile, LFN_SPLIT_EPOCHMSE(pNode)) != 1) return ALN_ERRFILE;
+            if (!(LFN_SPLIT_LEARNFACTOR(pNode) > 0)) return ALN_BADFILEFORMAT;
+        }
+    }
+    else
+    {
+        int nEval, nActive;
+        if (_READ(pFile, MINMAX_RESPACTIVE(pNode)) != 1) return ALN_ERRFILE;
+        if (_READ(pFile, nEval) != 1) return ALN_ERRFILE;
+        if (_READ(pFile, nActive) != 1) return ALN_ERRFILE;
+        if ((nRet = ReadVector(pFile, MINMAX_CENTROID(pNode), nDim)) != ALN_NOERROR) return nRet;
+        if ((nRet = ReadVector(pFile, MINMAX_NORMAL(pNode), nDim)) != ALN_NOERROR) return nRet;
+        if ((nRet = ReadVector(pFile, MINMAX_BOUNDS(pNode), BOUNDS_SIZE(nDim))) != ALN_NOERROR) return nRet;
+        if (MINMAX_BOUNDS(pNode) == NULL)
+            pNode->fNode &= ~GF_BOUNDS;
+        char c = 0;
+        if (_READ(pFile, c) != 1) return ALN_ERRFILE;
+        if (c)
+        {
+            MINMAX_ROUTE(pNode) = (ALNROUTE*)malloc(sizeof(ALNROUTE));
+            if (MINMAX_ROUTE(pNode) == NULL)
+                return ALN_OUTOFMEM;
+            const ALNROUTE* pRoute = MINMAX_ROUTE(pNode);
+            if (_READ(pFile, *MINMAX_ROUTE(pNode)) != 1) return ALN_ERRFILE;
+            if (pRoute->nTerms < -1 || pRoute->nTerms > ALNROUTE_MAXTERMS || MINMAX_NORMAL(pNode) == NULL)
+                return ALN_BADFILEFORMAT;
+            for (int i = 0; i < pRoute->nTerms; i++)
+            {
+                if (pRoute->anVar[i] < 0 || pRoute->anVar[i] >= nDim - 1)
+                    return ALN_BADFILEFORMAT;
+            }
+        }
+        if (_READ(pFile, MINMAX_THRESHOLD(pNode)) != 1) return ALN_ERRFILE;
+        if (_READ(pFile, MINMAX_COUNT(pNode)) != 1) return ALN_ERRFILE;
+
+        int nChildren;
+        if (_READ(pFile, nChildren) != 1) return ALN_ERRFILE;
+        if (nChildren < 2)
+            return ALN_BADFILEFORMAT;
+
+        // init child ptr array
+        if (!AllocMinMaxChildren(pNode, nChildren))
+            return ALN_OUTOFMEM;
+
+        for (int i = 0; i < nChildren; i++)
+        {
+            ALNNODE* pChild = (ALNNODE*)malloc(sizeof(ALNNODE));
+            if (pChild == NULL)
+                return ALN_OUTOFMEM;
+            NODE_PARENT(pChild) = pNode;
+            MINMAX_CHILDREN(pNode)[i] = pChild;
+
+            nRet = ReadCheckpointTree(pFile, pALN, pChild);
+            if (nRet != ALN_NOERROR) return nRet;
+        }
+
+        if (nEval >= nChildren || nActive >= nChildren)
+            return ALN_BADFILEFORMAT;
+        MINMAX_EVAL(pNode) = (nEval >= 0) ? MINMAX_CHILDREN(pNode)[nEval] : NULL;
+        MINMAX_ACTIVE(pNode) = (nActive >= 0) ? MINMAX_CHILDREN(pNode)[nActive] : NULL;
+    }
+
+    return ALN_NOERROR;
+}
@@ -0,0 +1,175 @@
+// ALN Library
+
+/* MIT License
+
+Copyright (c) 2020 William Ward Armstrong
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+
+// alncontext.cpp
+
+#ifdef ALNDLL
+#define ALNIMP __declspec(dllexport)
+#endif
+
+#include <aln.h>
+#include "alnpriv.h"
+
+#ifdef _DEBUG
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+// The growth and optimization settings were globals of the application,
+// which the library uses for every ALN; one process could not train two
+// ALNs at once.  An ALN may now have a context of its own holding them, and
+// the globals remain the settings of ALNs without one.  ALNTrain works on a
+// copy of the settings taken when it is called and puts the split count and
+// the stop flag back after each split.
+
+// growth and optimization globals, defined by the application
+extern BOOL bConvex;
+extern BOOL bStopTraining;
+extern float WeightDecay;
+extern float WeightBound;
+extern int SplitsAllowed;
+extern int SplitCount;
+
+// copies the training context into an ALN, NULL to use the globals
+// returns ALN_* error code, (ALN_NOERROR on success)
+ALNIMP int ALNAPI ALNSetTrainContext(ALN* pALN, const ALNTRAINCONTEXT* pContext)
+{
+    // parameter variance
+    if (pALN == NULL)
+        return ALN_GENERIC;
+
+    if (pContext == NULL)
+    {
+        if (pALN->pTrainContext != NULL)
+            free(pALN->pTrainContext);
+        pALN->pTrainContext = NULL;
+        return ALN_NOERROR;
+    }
+
+    if (pALN->pTrainContext == NULL)
+    {
+        pALN->pTrainContext = (ALNTRAINCONTEXT*)malloc(sizeof(ALNTRAINCONTEXT));
+        if (pALN->pTrainContext == NULL)
+            return ALN_OUTOFMEM;
+    }
+    *pALN->pTrainContext = *pContext;
+
+    return ALN_NOERROR;
+}
+
+// gets the settings an ALN uses, from its context or from the globals
+// returns ALN_* error code, (ALN_NOERROR on success)
+ALNIMP int ALNAPI ALNGetTrainContext(const ALN* pALN, ALNTRAINCONTEXT* pContext)
+{
+    // parameter variance
+    if (pALN == NULL || pContext == NULL)
+        return ALN_GENERIC;
+
+    if (pALN->pTrainContext != NULL)
+    {
+        *pContext = *pALN->pTrainContext;
+        return ALN_NOERROR;
+    }
+
+    pContext->bClassify2 = bClassify2;
+    pContext->bConvex = bConvex;
+    pContext->bAlphaBeta = bAlphaBeta;
+    pContext->bDistanceOptimization = bDistanceOptimization;
+    pContext->bStopTraining = bStopTraining;
+    pContext->fltWeightDecay = WeightDecay;
+    pContext->fltWeightBound = WeightBound;
+    pContext->nSplitsAllowed = SplitsAllowed;
+    pContext->nSplitCount = SplitCount;
+
+    // the settings added with the context have no globals; an ALN without a
+    // context of its own trains as before they were added
+    pContext->nShuffleBlock = 0;
+    pContext->fltSettle = 0;
+    pContext->nSplitsPerRound = 0;
+    pContext->bLearnFactors = FALSE;
+    pContext->nSettledSamples = 0;
+    pContext->nSettledInsert = 0;
+    pContext->fltSettledMSEorF = 0;
+
+    return ALN_NOERROR;
+}
+
+// clears the stop flag of an ALN, in its context or the globals, and the
+// buffer it settled on, so the next call to ALNTrain trains
+// returns ALN_* error code, (ALN_NOERROR on success)
+ALNIMP int ALNAPI ALNClearStopTraining(ALN* pALN)
+{
+    // parameter variance
+    if (pALN == NULL)
+        return ALN_GENERIC;
+
+    if (pALN->pTrainContext != NULL)
+    {
+        pALN->pTrainContext->bStopTraining = FALSE;
+        pALN->pTrainContext->nSettledSamples = 0;
+        pALN->pTrainContext->nSettledInsert = 0;
+        pALN->pTrainContext->fltSettledMSEorF = 0;
+    }
+    else
+    {
+        bStopTraining = FALSE;
+    }
+
+    return ALN_NOERROR;
+}
+
+// puts the split count and stop flag of a training run back into the
+// context of the ALN, or the globals, and the buffer it settled on into the
+// context
+void ALNAPI UpdateTrainContext(ALN* pALN, const ALNTRAINCONTEXT& context)
+{
+    if (pALN->pTrainContext != NULL)
+    {
+        pALN->pTrainContext->nSplitCount = context.nSplitCount;
+        pALN->pTrainContext->bStopTraining = context.bStopTraining;
+        pALN->pTrainContext->nSettledSamples = context.nSettledSamples;
+        pALN->pTrainContext->nSettledInsert = context.nSettledInsert;
+        pALN->pTrainContext->fltSettledMSEorF = context.fltSettledMSEorF;
+    }
+    else
+    {
+        SplitCount = context.nSplitCount;
+        bStopTraining = context.bStopTraining;
+    }
+}
+
+// replaces all the globals
+void ALNAPI SetGlobalTrainContext(const ALNTRAINCONTEXT& context)
+{
+    bClassify2 = context.bClassify2;
+    bConvex = context.bConvex;
+    bAlphaBeta = context.bAlphaBeta;
+    bDistanceOptimization = context.bDistanceOptimization;
+    bStopTraining = context.bStopTraining;
+    WeightDecay = context.fltWeightDecay;
+    WeightBound = context.fltWeightBound;
+    SplitsAllowed = context.nSplitsAllowed;
+    SplitCount = context.nSplitCount;
+}
@@ -0,0 +1,305 @@
+// ALN Library
+
+/* MIT License
+
+Copyright (c) 2020 William Ward Armstrong
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+
+// alnevalactions.cpp
+
+#ifdef ALNDLL
+#define ALNIMP __declspec(dllexport)
+#endif
+
+#include <aln.h>
+#include "alnpriv.h"
+#include <vector>
+
+#ifdef _DEBUG
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+// A Q-learning query evaluates one state with each of a few actions.  Only
+// the action variable differs, so each LFN sums the terms of the state once
+// and adds the action term for each action.  The actions go down the tree
+// together: every action has its own alpha-beta window, and the rest of the
+// children of a node are skipped only when the cutoff holds for all of them.
+// A cutoff for some of the actions leaves the value of those as a bound the
+// ancestors ignore, as in CutoffEvalMinMax.
+//
+// The windows are kept as in Cutoff, with FLT_MAX for a missing bound, in
+// arrays so a node copies only the windows of the actions evaluated.  The
+// routing tests and the centroids choose one order for all the actions, at
+// the middle of the action values.  The bounds of the distance cutoffs are
+// not used.
+
+// actions evaluated together, more are done in groups
+#define ACTIONS_CHUNK 16
+
+// inputs and children kept on the stack, larger ALNs allocate them
+#define ACTIONS_STACK 64
+
+struct CActionEval
+{
+    const ALN* pALN;
+    const float* afltX;         // the state, with 0 for the action
+    const float* afltRoute;     // the state, with the middle action
+    int nActionVar;
+    const float* afltAction;
+    int nActions;
+};
+
+// alpha-beta windows of the actions, see CEvalCutoff
+struct CActionWindow
+{
+    float afltMin[ACTIONS_CHUNK];   // a MIN ancestor has this value, FLT_MAX if none
+    float afltMax[ACTIONS_CHUNK];   // a MAX ancestor has this value, -FLT_MAX if none
+};
+
+// helper: evaluation of a subtree for every action
+static void ALNAPI EvalActions(const ALNNODE* pNode, const CActionEval& eval,
+    const CActionWindow& windowParent, float* afltDist, ALNNODE** apActiveLFN)
+{
+    int nActions = eval.nActions;
+    if (NODE_ISLFN(pNode))
+    {
+        STATS_LEAFEVAL(eval.pALN, pNode);
+
+        float fltState = LFNValue(pNode, eval.afltX, eval.pALN->nDim);
+        float fltW = LFN_W(pNode)[eval.nActionVar + 1];
+        for (int a = 0; a < nActions; a++)
+        {
+            afltDist[a] = fltState + fltW * eval.afltAction[a];
+            apActiveLFN[a] = (ALNNODE*)pNode;
+        }
+        return;
+    }
+
+    STATS_MINMAXEVAL(eval.pALN, pNode);
+
+    const ALN* pALN = eval.pALN;
+    int nDim = pALN->nDim;
+    BOOL bMax = MINMAX_ISMAX(pNode) != 0;
+    int nChildren = MINMAX_NUMCHILDREN(pNode);
+    ALNNODE* const* apChildren = MINMAX_CHILDREN(pNode);
+
+    // the order of the children, as CutoffEvalMinMax finds it for one input
+    int anStack[ACTIONS_STACK];
+    std::vector<int> vecOrder;
+    int* anChild = anStack;
+    if (nChildren > ACTIONS_STACK)
+    {
+        vecOrder.resize(nChildren);
+        anChild = vecOrder.data();
+    }
+    if (nChildren == 2)
+    {
+        float fltRoute = 0;
+        const ALNROUTE* pRoute = MINMAX_ROUTE(pNode);
+        if (pNode->fNode & GF_STORED)
+            fltRoute = 0;
+        else if (pRoute != NULL && pRoute->nTerms >= 0)
+            fltRoute = SparseRouteValue(pRoute, eval.afltRoute);
+        else if (MINMAX_NORMAL(pNode))
+            fltRoute = NormalRouteValue(pNode, eval.afltRoute, nDim);
+        anChild[0] = (fltRoute > 0) ? 1 : 0;
+        anChild[1] = 1 - anChild[0];
+    }
+    else
+    {
+        // LFN children in stored order, then the subtree with the nearest
+        // centroid, then the other subtrees
+        int nOrdered = 0;
+        int nFirst = -1;
+        float fltNearest = 0;
+        for (int i = 0; i < nChildren; i++)
+        {
+            const ALNNODE* pChild = apChildren[i];
+            if (NODE_ISLFN(pChild))
+            {
+                anChild[nOrdered++] = i;
+                continue;
+            }
+
+            float fltD = 0;
+            if (MINMAX_CENTROID(pChild))
+            {
+                for (int j = 0; j < nDim - 1; j++)
+                {
+                    float flt = eval.afltRoute[j] - MINMAX_CENTROID(pChild)[j];
+                    fltD += flt * flt;
+                }
+            }
+            if (nFirst < 0 || fltD < fltNearest)
+            {
+                nFirst = i;
+                fltNearest = fltD;
+            }
+        }
+        if (nFirst >= 0)
+            anChild[nOrdered++] = nFirst;
+        for (int i = 0; i < nChildren; i++)
+        {
+            if (i != nFirst && NODE_ISMINMAX(apChildren[i]))
+                anChild[nOrdered++] = i;
+        }
+        ASSERT(nOrdered == nChildren);
+    }
+
+    CActionWindow window;
+    memcpy(window.afltMin, windowParent.afltMin, nActions * sizeof(float));
+    memcpy(window.afltMax, windowParent.afltMax, nActions * sizeof(float));
+    unsigned int fAll = (1u << nActions) - 1;
+    unsigned int fCutoff = 0;
+
+    float afltChild[ACTIONS_CHUNK];
+    ALNNODE* apActiveChild[ACTIONS_CHUNK];
+    for (int k = 0; k < nChildren; k++)
+    {
+        const ALNNODE* pChild = apChildren[anChild[k]];
+        if (k == 0)
+        {
+            EvalActions(pChild, eval, window, afltDist, apActiveLFN);
+        }
+        else
+        {
+            EvalActions(pChild, eval, window, afltChild, apActiveChild);
+            for (int a = 0; a < nActions; a++)
+            {
+                if (bMax ? afltChild[a] > afltDist[a] : afltChild[a] < afltDist[a])
+                {
+                    afltDist[a] = afltChild[a];
+                    apActiveLFN[a] = apActiveChild[a];
+                }
+            }
+        }
+
+        if (!UseAlphaBeta(pALN) || k == nChildren - 1)
+            continue;
+
+        // see if we can cutoff the rest of the children, for all the actions;
+        // otherwise narrow the windows, as Cutoff does
+        for (int a = 0; a < nActions; a++)
+        {
+            if (fCutoff & (1u << a))
+                continue;
+
+            float flt = afltDist[a];
+            if (bMax)
+            {
+                if (flt >= window.afltMin[a])
+                    fCutoff |= 1u << a;
+                else if (flt > window.afltMax[a])
+                    window.afltMax[a] = flt;
+            }
+            else
+            {
+                if (flt <= window.afltMax[a])
+                    fCutoff |= 1u << a;
+                else if (flt < window.afltMin[a])
+                    window.afltMin[a] = flt;
+            }
+        }
+        if (fCutoff == fAll)
+        {
+            for (int j = k + 1; j < nChildren; j++)
+            {
+                STATS_ALPHABETACUTOFF(pALN, apChildren[anChild[j]]);
+            }
+            return;
+        }
+    }
+}
+
+// evaluation of ALN on one state with each of nActions values of the input
+// variable nActionVar; afltState holds pALN->nDim elements, of which the
+// action and output variables are not used, and the value of each action
+// is placed in afltResult, as ALNQuickEval would find it with 0 for the
+// output variable
+// returns the index of the action with the greatest value, the first one if
+// several have it, or -1 if the parameters are invalid
+ALNIMP int ALNAPI ALNEvalActions(const ALN* pALN, const float* afltState,
+    int nActionVar, const float* afltActions, int nActions, float* afltResult)
+{
+    // parameter variance
+    if (pALN == NULL || afltState == NULL || afltActions == NULL || afltResult == NULL ||
+        nActions <= 0 || nActionVar < 0 || nActionVar >= pALN->nDim || nActionVar == pALN->nOutput)
+        return -1;
+
+    int nDim = pALN->nDim;
+    float afltX[ACTIONS_STACK];
+    float afltRoute[ACTIONS_STACK];
+    std::vector<float> vecX;
+    float* pX = afltX;
+    float* pRoute = afltRoute;
+    if (nDim > ACTIONS_STACK)
+    {
+        vecX.resize(2 * nDim);
+        pX = vecX.data();
+        pRoute = pX + nDim;
+    }
+    memcpy(pX, afltState, nDim * sizeof(float));
+    pX[nActionVar] = 0;
+    pX[pALN->nOutput] = 0;
+    memcpy(pRoute, pX, nDim * sizeof(float));
+
+    CActionEval eval;
+    eval.pALN = pALN;
+    eval.afltX = pX;
+    eval.afltRoute = pRoute;
+    eval.nActionVar = nActionVar;
+
+    CActionWindow window;
+    for (int a = 0; a < ACTIONS_CHUNK; a++)
+    {
+        window.afltMin[a] = FLT_MAX;
+        window.afltMax[a] = -FLT_MAX;
+    }
+
+    ALNNODE* apActiveLFN[ACTIONS_CHUNK];
+    int nBest = 0;
+    for (int nStart = 0; nStart < nActions; nStart += ACTIONS_CHUNK)
+    {
+        eval.afltAction = afltActions + nStart;
+        eval.nActions = min(nActions - nStart, ACTIONS_CHUNK);
+
+        float fltLow = eval.afltAction[0];
+        float fltHigh = eval.afltAction[0];
+        for (int a = 1; a < eval.nActions; a++)
+        {
+            fltLow = min(fltLow, eval.afltAction[a]);
+            fltHigh = max(fltHigh, eval.afltAction[a]);
+        }
+        pRoute[nActionVar] = 0.5f * (fltLow + fltHigh);
+
+        float* afltDist = afltResult + nStart;
+        EvalActions(pALN->pTree, eval, window, afltDist, apActiveLFN);
+        for (int a = 0; a < eval.nActions; a++)
+        {
+            STATS_TREEEVAL(pALN->pTree, apActiveLFN[a]);
+            if (afltDist[a] > afltResult[nBest])
+                nBest = nStart + a;
+        }
+    }
+
+    return nBest;
+}
@@ -0,0 +1,138 @@
+// ALN Library
+
+/* MIT License
+
+Copyright (c) 2020 William Ward Armstrong
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+// alnevalstats.cpp
+
+#ifdef ALNDLL
+#define ALNIMP __declspec(dllexport)
+#endif
+
+#include <aln.h>
+#include "alnpriv.h"
+
+#ifdef _DEBUG
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+// Counts of how the evaluation routines prune, used to decide when the
+// alpha-beta and distance optimizations pay off, and of how often the routing
+// tests order children unlike the full normal. The totals are per thread
+// since snapshots are evaluated concurrently; the node counters are only
+// written for the one ALN the thread registered with ALNResetEvalStats,
+// so other threads reading that tree never see them change.
+
+#ifdef ALNSTATS
+
+thread_local ALNEVALSTATS EvalStats;
+thread_local const ALN* pNodeStatsALN = NULL;
+
+void ALNAPI CountTreeEval(const ALNNODE* pTree, const ALNNODE* pActiveLFN)
+{
+    EvalStats.nEvals++;
+
+    // depth of the active LFN below the root of the evaluation
+    int nDepth = 0;
+    for (const ALNNODE* pNode = pActiveLFN; pNode != NULL && pNode != pTree; pNode = NODE_PARENT(pNode))
+    {
+        nDepth++;
+    }
+    EvalStats.nActiveDepth += nDepth;
+    if (nDepth > EvalStats.nMaxActiveDepth)
+        EvalStats.nMaxActiveDepth = nDepth;
+}
+
+void ALNAPI MarkEvalStats(ALNEVALSTATS& statsMark)
+{
+    statsMark = EvalStats;
+
+    // the greatest depth cannot be subtracted, so it restarts here
+    EvalStats.nMaxActiveDepth = 0;
+}
+
+void ALNAPI GetEvalStatsSinceMark(const ALNEVALSTATS& statsMark, ALNEVALSTATS& statsSince)
+{
+    statsSince.nEvals = EvalStats.nEvals - statsMark.nEvals;
+    statsSince.nLeafEvals = EvalStats.nLeafEvals - statsMark.nLeafEvals;
+    statsSince.nMinMaxEvals = EvalStats.nMinMaxEvals - statsMark.nMinMaxEvals;
+    statsSince.nAlphaBetaCutoffs = EvalStats.nAlphaBetaCutoffs - statsMark.nAlphaBetaCutoffs;
+    statsSince.nDistanceCutoffs = EvalStats.nDistanceCutoffs - statsMark.nDistanceCutoffs;
+    statsSince.nRouteTests = EvalStats.nRouteTests - statsMark.nRouteTests;
+    statsSince.nRouteMisses = EvalStats.nRouteMisses - statsMark.nRouteMisses;
+    statsSince.nActiveDepth = EvalStats.nActiveDepth - statsMark.nActiveDepth;
+    statsSince.nMaxActiveDepth = EvalStats.nMaxActiveDepth;
+
+    // the total keeps the greatest depth since the reset
+    if (statsMark.nMaxActiveDepth > EvalStats.nMaxActiveDepth)
+        EvalStats.nMaxActiveDepth = statsMark.nMaxActiveDepth;
+}
+
+static void ALNAPI ResetNodeStats(ALNNODE* pNode)
+{
+    memset(&NODE_STATS(pNode), 0, sizeof(ALNNODESTATS));
+    if (NODE_ISMINMAX(pNode))
+    {
+        for (int i = 0; i < MINMAX_NUMCHILDREN(pNode); i++)
+        {
+            ResetNodeStats(MINMAX_CHILDREN(pNode)[i]);
+        }
+    }
+}
+
+#endif  // ALNSTATS
+
+// zeroes the totals of the calling thread, and the node counters of pALN,
+// which is then counted per node on this thread; pALN may be NULL
+// returns ALN_* error code, (ALN_NOERROR on success)
+ALNIMP int ALNAPI ALNResetEvalStats(ALN* pALN)
+{
+#ifdef ALNSTATS
+    memset(&EvalStats, 0, sizeof(ALNEVALSTATS));
+    if (pALN != NULL && pALN->pTree != NULL)
+        ResetNodeStats(pALN->pTree);
+    pNodeStatsALN = pALN;
+
+    return ALN_NOERROR;
+#else
+    (void)pALN;     // nothing is counted
+    return ALN_GENERIC;
+#endif
+}
+
+// gets the totals of the calling thread since the last reset
+// returns ALN_* error code, (ALN_NOERROR on success)
+ALNIMP int ALNAPI ALNGetEvalStats(ALNEVALSTATS* pStats)
+{
+    if (pStats == NULL)
+        return ALN_GENERIC;
+
+#ifdef ALNSTATS
+    *pStats = EvalStats;
+
+    return ALN_NOERROR;
+#else
+    memset(pStats, 0, sizeof(ALNEVALSTATS));
+    return ALN_GENERIC;
+#endif
+}
@@ -61,9 +61,21 @@ ALNIMP int ALNAPI ALNInvert(ALN* pALN, int nVar)
     {
         DoInvert(pALN->pTree, pALN, nVar, nMono);
         InvertConstraints(pALN, nVar);
+        NewGeneration(pALN);
 
         ASSERT(pALN->nOutput == nVar);
 
+        // the bounds were for the old output, the new ones cover the LFN centroids
+        try
+        {
+            UpdateBounds(pALN, NULL, NULL);
+        }
+        catch (CALNMemoryException* e)
+        {
+            e->Delete();
+            return ALN_OUTOFMEM;
+        }
+
         return ALN_NOERROR;
     }
     else
@@ -113,8 +125,10 @@ void InvertMinMax(ALNNODE* pTree, ALN* pALN, int nVar, int nMono)
         pTree->fNode |= GF_MAX;
 
     // recurse to children
-    DoInvert(MINMAX_LEFT(pTree), pALN, nVar, nMono);
-    DoInvert(MINMAX_RIGHT(pTree), pALN, nVar, nMono);
+    for (int i = 0; i < MINMAX_NUMCHILDREN(pTree); i++)
+    {
+        DoInvert(MINMAX_CHILDREN(pTree)[i], pALN, nVar, nMono);
+    }
 }
 
 void InvertLFN(ALNNODE* pTree, ALN* pALN, int nVar, int nMono)
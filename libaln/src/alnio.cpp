@@ -215,6 +215,25 @@ static int ALNAPI DoALNRead(FILE* pFile, ALN** ppALN)
     }
 
     int nRet = ReadTree(pFile, pALN, pALN->pTree);
+    if (nRet == ALN_NOERROR)
+    {
+        // files written before minmax nodes had more than two children
+        // hold chains of nodes of the same type
+        nRet = MergeMinMaxChains(pALN->pTree);
+    }
+    if (nRet == ALN_NOERROR)
+    {
+        // the file has no samples, so the bounds cover the LFN centroids
+        try
+        {
+            UpdateBounds(pALN, NULL, NULL);
+        }
+        catch (CALNMemoryException* e)
+        {
+            e->Delete();
+            nRet = ALN_OUTOFMEM;
+        }
+    }
     if (nRet != ALN_NOERROR)
     {
         ALNDestroyALN(pALN);
@@ -321,7 +340,7 @@ static int ALNAPI WriteTree(FILE* pFile, const ALN* pALN, const ALNNODE* pNode)
     if (_WRITE(pFile, pNode->nParentRegion) != 1) return ALN_ERRFILE;
 
     // do not write eval flag!  
-    int fNode = pNode->fNode & ~NF_EVAL;
+    int fNode = pNode->fNode & ~(NF_EVAL | GF_BOUNDS);
     if (_WRITE(pFile, fNode) != 1) return ALN_ERRFILE;
 
     if (pNode->fNode & NF_LFN)
@@ -352,8 +371,12 @@ static int ALNAPI WriteTree(FILE* pFile, const ALN* pALN, const ALNNODE* pNode)
             if (_WRITE(pFile, LFN_SPLIT_SQERR(pNode)) != 1) return ALN_ERRFILE;
             if (_WRITE(pFile, LFN_SPLIT_RESPTOTAL(pNode)) != 1) return ALN_ERRFILE;
 
-            float unused = 0;
-            if (_WRITE(pFile, unused) != 1) return ALN_ERRFILE;  // Added in Version 0x00030009
+            // the value added in Version 0x00030009 is the learning rate factor,
+            // and the epoch error of the piece follows it since 0x00030011; both
+            // are written whether or not the factors are used, so the format
+            // depends on the version alone
+            if (_WRITE(pFile, LFN_SPLIT_LEARNFACTOR(pNode)) != 1) return ALN_ERRFILE;
+            if (_WRITE(pFile, LFN_SPLIT_EPOCHMSE(pNode)) != 1) return ALN_ERRFILE;
         }
 
         // vectors
@@ -372,7 +395,7 @@ static int ALNAPI WriteTree(FILE* pFile, const ALN* pALN, const ALNNODE* pNode)
         ASSERT(pNode->fNode & NF_MINMAX);
 
         // number of children
-        int nChildren = 2;
+        int nChildren = MINMAX_NUMCHILDREN(pNode);
         if (_WRITE(pFile, nChildren) != 1) return ALN_ERRFILE;
 
         for (int i = 0; i < MINMAX_NUMCHILDREN(pNode); i++)
@@ -396,6 +419,7 @@ static int ALNAPI ReadTree(FILE* pFile, ALN* pALN, ALNNODE* pNode)
     // read parent region, node flags
     if (_READ(pFile, pNode->nParentRegion) != 1) return ALN_ERRFILE;
     if (_READ(pFile, pNode->fNode) != 1) return ALN_ERRFILE;
+    pNode->fNode &= ~GF_BOUNDS;
     if (pNode->nParentRegion < 0 || pNode->nParentRegion >= pALN->nRegions ||
         (pNode->fNode & (NF_MINMAX | NF_LFN)) == 0)
         return ALN_BADFILEFORMAT;
@@ -439,12 +463,22 @@ static int ALNAPI ReadTree(FILE* pFile, ALN* pALN, ALNNODE* pNode)
             if (_READ(pFile, LFN_SPLIT_SQERR(pNode)) != 1) return ALN_ERRFILE;
             if (_READ(pFile, LFN_SPLIT_RESPTOTAL(pNode)) != 1) return ALN_ERRFILE;
 
+            // the value added in Version 0x00030009 was unused, and 0, until
+            // it became the learning rate factor
+            LFN_SPLIT_LEARNFACTOR(pNode) = 0;
+            LFN_SPLIT_EPOCHMSE(pNode) = 0;
             if (pALN->nVersion >= 0x00030009)
             {
-                // read and discard the value
-                float unused;
-                if (_READ(pFile, unused) != 1) return ALN_ERRFILE;
+                if (_READ(pFile, LFN_SPLIT_LEARNFACTOR(pNode)) != 1) return ALN_ERRFILE;
             }
+            if (pALN->nVersion >= 0x00030011)
+            {
+                if (_READ(pFile, LFN_SPLIT_EPOCHMSE(pNode)) != 1) return ALN_ERRFILE;
+            }
+            if (!(LFN_SPLIT_LEARNFACTOR(pNode) > 0))
+                LFN_SPLIT_LEARNFACTOR(pNode) = 1.0f;
+            LFN_SPLIT_EPOCHCOUNT(pNode) = 0;
+            LFN_SPLIT_EPOCHSQERR(pNode) = 0;
             memset(LFN_SPLIT_T(pNode), 0, sizeof(float) * pALN->nDim);
         }
 
@@ -477,23 +511,28 @@ static int ALNAPI ReadTree(FILE* pFile, ALN* pALN, ALNNODE* pNode)
         // number of children
         int nChildren;
         if (_READ(pFile, nChildren) != 1) return ALN_ERRFILE;
-        if (nChildren != 2)
+        if (nChildren < 2)
+            return ALN_BADFILEFORMAT;
+
+        // minmax nodes had two children before 0x00030011
+        if (nChildren > 2 && pALN->nVersion < 0x00030011)
             return ALN_BADFILEFORMAT;
 
         // init child ptr array
-        memset(MINMAX_CHILDREN(pNode), 0, 2 * sizeof(ALNNODE*));
+        if (!AllocMinMaxChildren(pNode, nChildren))
+            return ALN_OUTOFMEM;
 
         // read children
-        for (int i = 0; i < 2; i++)
+        for (int i = 0; i < nChildren; i++)
         {
             MINMAX_CHILDREN(pNode)[i] = (ALNNODE*)malloc(sizeof(ALNNODE));
             if (MINMAX_CHILDREN(pNode)[i] == NULL)
                 return ALN_OUTOFMEM;
 
-            // set parent
-            NODE_PARENT(MINMAX_CHILDREN(pNode)[i]) = pNode;
-
             int nRet = ReadTree(pFile, pALN, MINMAX_CHILDREN(pNode)[i]);
+
+            // set parent, ReadTree clears the node
+            NODE_PARENT(MINMAX_CHILDREN(pNode)[i]) = pNode;
             if (nRet != ALN_NOERROR) return nRet;
         }
     }
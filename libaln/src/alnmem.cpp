@@ -158,30 +158,223 @@ int ALNAPI DestroyTree(ALNNODE* pTree)
             free(LFN_D(pTree));
     }
     else
-        if (pTree->fNode & NF_MINMAX)
+    {
+        ASSERT(pTree->fNode & NF_MINMAX);
+
+        if (MINMAX_CENTROID(pTree) != NULL)
+            free(MINMAX_CENTROID(pTree));
+        if (MINMAX_NORMAL(pTree) != NULL)
+            free(MINMAX_NORMAL(pTree));
+        if (MINMAX_BOUNDS(pTree) != NULL)
+            free(MINMAX_BOUNDS(pTree));
+        if (MINMAX_ROUTE(pTree) != NULL)
+            free(MINMAX_ROUTE(pTree));
+
+        // destroy children 
+        int nChildren = MINMAX_NUMCHILDREN(pTree);
+        for (int i = 0; i < nChildren; i++)
         {
-            if (MINMAX_CENTROID(pTree) != NULL)
-                free(MINMAX_CENTROID(pTree));
-            if (MINMAX_NORMAL(pTree) != NULL)
-                free(MINMAX_NORMAL(pTree));
+            DestroyTree(MINMAX_CHILDREN(pTree)[i]);
+            MINMAX_CHILDREN(pTree)[i] = NULL;
         }
-        else
+        if (MINMAX_CHILDREN(pTree) != NULL)
+            free(MINMAX_CHILDREN(pTree));
+    }
+
+    // free node memory
+    free(pTree);
+
+    return 1;
+}
+
+// helpers for DuplicateALN
+static ALNNODE* ALNAPI DuplicateTree(const ALN* pALN, const ALNNODE* pNode, ALNNODE* pParent);
+
+static int ALNAPI ChildPosition(const ALNNODE* pNode, const ALNNODE* pChild)
+{
+    if (pChild == NULL)
+        return -1;
+
+    for (int i = 0; i < MINMAX_NUMCHILDREN(pNode); i++)
+    {
+        if (MINMAX_CHILDREN(pNode)[i] == pChild)
+            return i;
+    }
+    return -1;
+}
+
+static float* ALNAPI DuplicateVector(const float* aflt, int n)
+{
+    if (aflt == NULL)
+        return NULL;
+
+    float* afltCopy = (float*)malloc(n * sizeof(float));
+    if (afltCopy == NULL)
+        ThrowALNMemoryException();
+
+    memcpy(afltCopy, aflt, n * sizeof(float));
+    return afltCopy;
+}
+
+// deep copy of an ALN, used for snapshots of a tree in training
+// throws CALNMemoryException* on failure
+ALN* ALNAPI DuplicateALN(const ALN* pALN)
+{
+    ALN* pCopy = (ALN*)malloc(sizeof(ALN));
+    if (pCopy == NULL)
+        ThrowALNMemoryException();
+    memset(pCopy, 0, sizeof(ALN));
+
+    try
+    {
+        pCopy->nVersion = pALN->nVersion;
+        pCopy->nDim = pALN->nDim;
+        pCopy->nOutput = pALN->nOutput;
+
+        pCopy->aRegions = (ALNREGION*)malloc(pALN->nRegions * sizeof(ALNREGION));
+        if (pCopy->aRegions == NULL)
+            ThrowALNMemoryException();
+        memset(pCopy->aRegions, 0, pALN->nRegions * sizeof(ALNREGION));
+        pCopy->nRegions = pALN->nRegions;
+
+        for (int i = 0; i < pALN->nRegions; i++)
+        {
+            const ALNREGION& region = pALN->aRegions[i];
+            ALNREGION& regionCopy = pCopy->aRegions[i];
+            regionCopy = region;
+            regionCopy.afVarMap = NULL;
+            regionCopy.aConstr = NULL;
+            regionCopy.nConstr = 0;
+
+            if (region.nConstr > 0)
+            {
+                regionCopy.aConstr = (ALNCONSTRAINT*)malloc(region.nConstr * sizeof(ALNCONSTRAINT));
+                if (regionCopy.aConstr == NULL)
+                    ThrowALNMemoryException();
+                memcpy(regionCopy.aConstr, region.aConstr, region.nConstr * sizeof(ALNCONSTRAINT));
+                regionCopy.nConstr = region.nConstr;
+            }
+            if (region.afVarMap != NULL)
+            {
+                regionCopy.afVarMap = (char*)malloc(MAPBYTECOUNT(pALN->nDim));
+                if (regionCopy.afVarMap == NULL)
+                    ThrowALNMemoryException();
+                memcpy(regionCopy.afVarMap, region.afVarMap, MAPBYTECOUNT(pALN->nDim));
+            }
+        }
+
+        if (pALN->pTrainContext != NULL)
+        {
+            pCopy->pTrainContext = (ALNTRAINCONTEXT*)malloc(sizeof(ALNTRAINCONTEXT));
+            if (pCopy->pTrainContext == NULL)
+                ThrowALNMemoryException();
+            *pCopy->pTrainContext = *pALN->pTrainContext;
+        }
+
+        pCopy->pTree = DuplicateTree(pALN, pALN->pTree, NULL);
+    }
+    catch (CALNMemoryException*)
+    {
+        ALNDestroyALN(pCopy);
+        throw;
+    }
+
+    return pCopy;
+}
+
+// copies the tree of an ALN in depth first order, so each first child follows
+// its parent in memory, as DuplicateTree allocates them in that order
+// throws CALNMemoryException* on failure, leaving the tree as it was
+void ALNAPI RelayoutTree(ALN* pALN)
+{
+    ALNNODE* pTree = DuplicateTree(pALN, pALN->pTree, NULL);
+    DestroyTree(pALN->pTree);
+    pALN->pTree = pTree;
+    NewGeneration(pALN);
+}
+
+static ALNNODE* ALNAPI DuplicateTree(const ALN* pALN, const ALNNODE* pNode, ALNNODE* pParent)
+{
+    int nDim = pALN->nDim;
+
+    ALNNODE* pCopy = (ALNNODE*)malloc(sizeof(ALNNODE));
+    if (pCopy == NULL)
+        ThrowALNMemoryException();
+
+    // copy the scalars, then replace every pointer
+    memcpy(pCopy, pNode, sizeof(ALNNODE));
+    NODE_PARENT(pCopy) = pParent;
+
+    if (NODE_ISLFN(pNode))
+    {
+        LFN_VARMAP(pCopy) = NULL;
+        LFN_W(pCopy) = LFN_C(pCopy) = LFN_D(pCopy) = NULL;
+        LFN_SPLIT(pCopy) = NULL;
+
+        try
         {
-            // destroy children 
-            ASSERT(pTree->fNode & NF_MINMAX);
+            LFN_W(pCopy) = DuplicateVector(LFN_W(pNode), nDim + 1);
+            LFN_C(pCopy) = DuplicateVector(LFN_C(pNode), nDim);
+            LFN_D(pCopy) = DuplicateVector(LFN_D(pNode), nDim);
+            if (LFN_SPLIT(pNode) != NULL)
+            {
+                LFN_SPLIT(pCopy) = (ALNLFNSPLIT*)malloc(sizeof(ALNLFNSPLIT));
+                if (LFN_SPLIT(pCopy) == NULL)
+                    ThrowALNMemoryException();
+                *LFN_SPLIT(pCopy) = *LFN_SPLIT(pNode);
+                LFN_SPLIT_T(pCopy) = NULL;
+                LFN_SPLIT_T(pCopy) = DuplicateVector(LFN_SPLIT_T(pNode), nDim);
+            }
+        }
+        catch (CALNMemoryException*)
+        {
+            DestroyTree(pCopy);
+            throw;
+        }
+    }
+    else
+    {
+        ASSERT(NODE_ISMINMAX(pNode));
+        int nChildren = MINMAX_NUMCHILDREN(pNode);
+        int nEval = ChildPosition(pNode, MINMAX_EVAL(pNode));
+        int nActive = ChildPosition(pNode, MINMAX_ACTIVE(pNode));
+
+        MINMAX_CENTROID(pCopy) = MINMAX_NORMAL(pCopy) = MINMAX_BOUNDS(pCopy) = NULL;
+        MINMAX_ROUTE(pCopy) = NULL;
+        MINMAX_EVAL(pCopy) = MINMAX_ACTIVE(pCopy) = MINMAX_GOAL(pCopy) = NULL;
+        MINMAX_CHILDREN(pCopy) = NULL;
+        MINMAX_NUMCHILDREN(pCopy) = 0;
 
-            int nChildren = MINMAX_NUMCHILDREN(pTree);
+        try
+        {
+            if (!AllocMinMaxChildren(pCopy, nChildren))
+                ThrowALNMemoryException();
+            MINMAX_CENTROID(pCopy) = DuplicateVector(MINMAX_CENTROID(pNode), nDim);
+            MINMAX_NORMAL(pCopy) = DuplicateVector(MINMAX_NORMAL(pNode), nDim);
+            MINMAX_BOUNDS(pCopy) = DuplicateVector(MINMAX_BOUNDS(pNode), BOUNDS_SIZE(nDim));
+            if (MINMAX_ROUTE(pNode) != NULL)
+            {
+                MINMAX_ROUTE(pCopy) = (ALNROUTE*)malloc(sizeof(ALNROUTE));
+                if (MINMAX_ROUTE(pCopy) == NULL)
+                    ThrowALNMemoryException();
+                *MINMAX_ROUTE(pCopy) = *MINMAX_ROUTE(pNode);
+            }
             for (int i = 0; i < nChildren; i++)
             {
-                DestroyTree(MINMAX_CHILDREN(pTree)[i]);
-                MINMAX_CHILDREN(pTree)[i] = NULL;
+                MINMAX_CHILDREN(pCopy)[i] = DuplicateTree(pALN, MINMAX_CHILDREN(pNode)[i], pCopy);
             }
         }
+        catch (CALNMemoryException*)
+        {
+            DestroyTree(pCopy);
+            throw;
+        }
 
-    // free node memory
-    free(pTree);
+        if (nEval >= 0) MINMAX_EVAL(pCopy) = MINMAX_CHILDREN(pCopy)[nEval];
+        if (nActive >= 0) MINMAX_ACTIVE(pCopy) = MINMAX_CHILDREN(pCopy)[nActive];
+    }
 
-    return 1;
+    return pCopy;
 }
 
 // destroys an ALN
@@ -208,6 +401,10 @@ ALNIMP int ALNAPI ALNDestroyALN(ALN* pALN)
     if (pALN->pTree)
         DestroyTree(pALN->pTree);
 
+    // training context
+    if (pALN->pTrainContext)
+        free(pALN->pTrainContext);
+
     // ALN
     free(pALN);
 
@@ -329,6 +526,125 @@ ALNIMP int ALNAPI ALNAddRegion(ALN* pALN, int nParentRegion,
 
 #endif /* ENABLE_REGIONS */
 
+// helper: allocates an LFN child of pParent; when bSplit, the child is a copy
+// of the splitting LFN pSource, shifted by the i-th small step in the direction
+// of the operator so the pieces differentiate, otherwise it is zeroed
+// throws CALNMemoryException* on failure
+static ALNNODE* ALNAPI NewChildLFN(ALN* pALN, ALNNODE* pParent, const ALNNODE* pSource,
+    BOOL bSplit, int nMinMaxType, int i)
+{
+    ALNNODE* pChild = (ALNNODE*)malloc(sizeof(ALNNODE));
+    if (pChild == NULL) ThrowALNMemoryException();
+
+    memset(pChild, 0, sizeof(ALNNODE));
+    pChild->pParent = pParent;
+    pChild->fNode |= NF_LFN;
+
+    pChild->nParentRegion = pParent->nParentRegion;
+    pChild->nRespCount = 0;
+    pChild->nRespCountLastEpoch = 0;
+    pChild->fltDistance = 0;
+
+    try
+    {
+        // allocate vectors
+        LFN_SPLIT(pChild) = NULL;
+        LFN_VARMAP(pChild) = NULL;
+        LFN_VDIM(pChild) = pALN->nDim;
+        LFN_W(pChild) = (float*)malloc((pALN->nDim + 1) * sizeof(float));
+        LFN_C(pChild) = (float*)malloc(pALN->nDim * sizeof(float));
+        LFN_D(pChild) = (float*)malloc(pALN->nDim * sizeof(float));
+        if (LFN_W(pChild) == NULL || LFN_C(pChild) == NULL || LFN_D(pChild) == NULL)
+        {
+            ThrowALNMemoryException();
+        }
+
+        // set split
+        if (bSplit)
+        {
+            LFN_SPLIT(pChild) = (ALNLFNSPLIT*)malloc(sizeof(ALNLFNSPLIT));
+            if (LFN_SPLIT(pChild) == NULL)
+                ThrowALNMemoryException();
+
+            LFN_SPLIT_T(pChild) = (float*)malloc(sizeof(float) * pALN->nDim);
+            if (LFN_SPLIT_T(pChild) == NULL)
+                ThrowALNMemoryException();
+
+            pChild->fNode |= LF_SPLIT;
+            LFN_SPLIT_COUNT(pChild) = 0;
+            LFN_SPLIT_SQERR(pChild) = 0.0;
+            LFN_SPLIT_RESPTOTAL(pChild) = 0.0;
+            memset(LFN_SPLIT_T(pChild), 0, sizeof(float) * pALN->nDim);
+
+            // the pieces start with the learning rate factor of the one split
+            LFN_SPLIT_LEARNFACTOR(pChild) = LFN_SPLIT_LEARNFACTOR(pSource);
+            LFN_SPLIT_EPOCHMSE(pChild) = 0.0;
+            LFN_SPLIT_EPOCHCOUNT(pChild) = 0;
+            LFN_SPLIT_EPOCHSQERR(pChild) = 0.0;
+
+            // copy parent vectors
+            memcpy(LFN_W(pChild), LFN_W(pSource), (pALN->nDim + 1) * sizeof(float));
+            memcpy(LFN_C(pChild), LFN_C(pSource), pALN->nDim * sizeof(float));
+            memcpy(LFN_D(pChild), LFN_D(pSource), pALN->nDim * sizeof(float));
+            // shift LFN output value up or down depending on parent minmax type
+                    // the shifts are different but close so the two children differentiate
+                    // and the combined effect is not to change the value of the single LFN
+            float fltSE = pALN->aRegions[pChild->nParentRegion].fltSmoothEpsilon;
+            int nOutput = pALN->nOutput;
+            // The following avoids a crash due to wrongly picking the active leaf node when there is a tie 
+            float fltChange;
+            // 2009.11.19  This change has to be tiny because it affects the fillets!
+            //fltChange = (0.9343727 + i * 0.1334818) * fltSE; old values where did they come from?
+            // When a piece splits into two equal leaf nodes, there is a fillet inserted so both pieces have to move
+            // in the output direction to leave the function unchanged
+            // THE FOLLOWING CURES A BUG WHEN TWO LFN's ARE EQUAL
+            fltChange = i * 0.00001F + fltSE; // only one child get the tiny increment so equality of LFNs is very rare for training points
+
+            if (nMinMaxType == GF_MIN)
+            {
+                *LFN_W(pChild) += fltChange;
+                LFN_C(pChild)[nOutput] += fltChange;
+            }
+            else
+            {
+                *LFN_W(pChild) -= fltChange;
+                LFN_C(pChild)[nOutput] -= fltChange;
+            }
+
+            // set LFN initialized
+            NODE_FLAGS(pChild) |= LF_INIT;
+        }
+        else
+        {
+            // zero vectors
+            memset(LFN_W(pChild), 0, (pALN->nDim + 1) * sizeof(float));
+            memset(LFN_C(pChild), 0, pALN->nDim * sizeof(float));
+            memset(LFN_D(pChild), 0, pALN->nDim * sizeof(float));
+        }
+    }
+    catch (CALNMemoryException*)
+    {
+        DestroyTree(pChild);
+        throw;
+    }
+
+    return pChild;
+}
+
+// allocates a zeroed array of nChildren child pointers for minmax node pNode
+// returns FALSE if out of memory, leaving the node without children
+BOOL ALNAPI AllocMinMaxChildren(ALNNODE* pNode, int nChildren)
+{
+    ASSERT(nChildren >= 2);
+    MINMAX_NUMCHILDREN(pNode) = 0;
+    MINMAX_CHILDREN(pNode) = (ALNNODE**)calloc(nChildren, sizeof(ALNNODE*));
+    if (MINMAX_CHILDREN(pNode) == NULL)
+        return FALSE;
+
+    MINMAX_NUMCHILDREN(pNode) = nChildren;
+    return TRUE;
+}
+
 // adding LFNs to a tree
 //   - pALN
 //   - pParent = parent node, must be an LFN 
@@ -338,6 +654,7 @@ ALNIMP int ALNAPI ALNAddRegion(ALN* pALN, int nParentRegion,
 // LFN parent automatically converted to minmax (and vectors freed)
 // all new children are LFNs... vectors are automatically allocated, child
 // parent regions are the same as the parent node
+// the nLFNs children all belong to the one new minmax node
 ALNIMP int ALNAPI ALNAddLFNs(ALN* pALN, ALNNODE* pParent,
     int nParentMinMaxType, int nLFNs,
     ALNNODE** apLFNs)
@@ -366,144 +683,33 @@ ALNIMP int ALNAPI ALNAddLFNs(ALN* pALN, ALNNODE* pParent,
       // are we splitting?
     ASSERT(NODE_ISLFN(pParent));  // This is temporary and will change below to a MINMAX, at which point we can refer to MINMAX data
     BOOL bSplit = LFN_CANSPLIT(pParent);
-    long Count = (pParent->DATA.LFN.pSplit)->nCount;
+    long Count = bSplit ? (pParent->DATA.LFN.pSplit)->nCount : 0;
 
     // add children
-    ALNNODE* apChildren[2];
-    apChildren[0] = apChildren[1] = NULL;
+    ALNNODE** apChildren = (ALNNODE**)calloc(nLFNs, sizeof(ALNNODE*));
+    if (apChildren == NULL)
+        return ALN_OUTOFMEM;
 
     // allocate new children for this node and convert to LFNs
-    for (int i = 0; i < 2; i++)
+    try
     {
-        // alloc new child
-        ALNNODE*& pChild = apChildren[i];
-        try
+        for (int i = 0; i < nLFNs; i++)
         {
-            pChild = (ALNNODE*)malloc(sizeof(ALNNODE));
-            if (pChild == NULL) ThrowALNMemoryException();
-
-            memset(pChild, 0, sizeof(ALNNODE));
-            pChild->pParent = pParent;
-            pChild->fNode |= NF_LFN;
-
-            pChild->nParentRegion = pParent->nParentRegion;
-            pChild->nRespCount = 0;
-            pChild->nRespCountLastEpoch = 0;
-            pChild->fltDistance = 0;
-
-            // allocate vectors
-            LFN_SPLIT(pChild) = NULL;
-            LFN_VARMAP(pChild) = NULL;
-            LFN_VDIM(pChild) = pALN->nDim;
-            LFN_W(pChild) = (float*)malloc((pALN->nDim + 1) * sizeof(float));
-            LFN_C(pChild) = (float*)malloc(pALN->nDim * sizeof(float));
-            LFN_D(pChild) = (float*)malloc(pALN->nDim * sizeof(float));
-            if (LFN_W(pChild) == NULL || LFN_C(pChild) == NULL || LFN_D(pChild) == NULL)
-            {
-                ThrowALNMemoryException();
-            }
-
-            // set split
-            if (bSplit)
-            {
-                LFN_SPLIT(pChild) = (ALNLFNSPLIT*)malloc(sizeof(ALNLFNSPLIT));
-                if (LFN_SPLIT(pChild) == NULL)
-                    ThrowALNMemoryException();
-
-                LFN_SPLIT_T(pChild) = (float*)malloc(sizeof(float) * pALN->nDim);
-                if (LFN_SPLIT_T(pChild) == NULL)
-                {
-                    free(LFN_SPLIT(pChild));
-                    ThrowALNMemoryException();
-                }
-
-                pChild->fNode |= LF_SPLIT;
-                LFN_SPLIT_COUNT(pChild) = 0;
-                LFN_SPLIT_SQERR(pChild) = 0.0;
-                LFN_SPLIT_RESPTOTAL(pChild) = 0.0;
-                memset(LFN_SPLIT_T(pChild), 0, sizeof(float) * pALN->nDim);
-
-                // copy parent vectors
-                memcpy(LFN_W(pChild), LFN_W(pParent), (pALN->nDim + 1) * sizeof(float));
-                memcpy(LFN_C(pChild), LFN_C(pParent), pALN->nDim * sizeof(float));
-                memcpy(LFN_D(pChild), LFN_D(pParent), pALN->nDim * sizeof(float));
-                // shift LFN output value up or down depending on parent minmax type
-                        // the shifts are different but close so the two children differentiate
-                        // and the combined effect is not to change the value of the single LFN
-                float fltSE = pALN->aRegions[pChild->nParentRegion].fltSmoothEpsilon;
-                int nOutput = pALN->nOutput;
-                // The following avoids a crash due to wrongly picking the active leaf node when there is a tie 
-                float fltChange;
-                // 2009.11.19  This change has to be tiny because it affects the fillets!
-                //fltChange = (0.9343727 + i * 0.1334818) * fltSE; old values where did they come from?
-                // When a piece splits into two equal leaf nodes, there is a fillet inserted so both pieces have to move
-                // in the output direction to leave the function unchanged
-                // THE FOLLOWING CURES A BUG WHEN TWO LFN's ARE EQUAL
-                fltChange = i * 0.00001F + fltSE; // only one child get the tiny increment so equality of LFNs is very rare for training points
-
-                if (nParentMinMaxType == GF_MIN)
-                {
-                    *LFN_W(pChild) += fltChange;
-                    LFN_C(pChild)[nOutput] += fltChange;
-                }
-                else
-                {
-                    *LFN_W(pChild) -= fltChange;
-                    LFN_C(pChild)[nOutput] -= fltChange;
-                }
-
-                // set LFN initialized
-                NODE_FLAGS(pChild) |= LF_INIT;
-            }
-            else
-            {
-                if (LFN_SPLIT(pChild))
-                {
-                    if (LFN_SPLIT_T(pChild))
-                        free(LFN_SPLIT_T(pChild));
-
-                    free(LFN_SPLIT(pChild));
-                }
-                LFN_SPLIT(pChild) = NULL;
-
-                // zero vectors
-                memset(LFN_W(pChild), 0, (pALN->nDim + 1) * sizeof(float));
-                memset(LFN_C(pChild), 0, pALN->nDim * sizeof(float));
-                memset(LFN_D(pChild), 0, pALN->nDim * sizeof(float));
-            }
-
-
+            apChildren[i] = NewChildLFN(pALN, pParent, pParent, bSplit, nParentMinMaxType, i);
         }
-        catch (CALNMemoryException* e)
-        {
-            e->Delete();
-
-            // free any successful new child allocations
-            for (i = 0; i < 2; i++)
-            {
-                pChild = apChildren[i];
-
-                if (pChild)
-                {
-                    ASSERT(pChild->fNode & NF_LFN);
-                    if (LFN_VARMAP(pChild)) free(LFN_VARMAP(pChild));
-                    if (LFN_SPLIT(pChild))
-                    {
-                        if (LFN_SPLIT_T(pChild))
-                            free(LFN_SPLIT_T(pChild));
-
-                        free(LFN_SPLIT(pChild));
-                    }
-                    if (LFN_W(pChild)) free(LFN_W(pChild));
-                    if (LFN_C(pChild)) free(LFN_C(pChild));
-                    if (LFN_D(pChild)) free(LFN_D(pChild));
-                    free(pChild);
-                    pChild = NULL;
-                }
-            }
+    }
+    catch (CALNMemoryException* e)
+    {
+        e->Delete();
 
-            return NULL;
+        // free any successful new child allocations
+        for (int i = 0; i < nLFNs; i++)
+        {
+            DestroyTree(apChildren[i]);
         }
+        free(apChildren);
+
+        return ALN_OUTOFMEM;
     }
 
     // pParent is unmodified at this point
@@ -512,22 +718,18 @@ ALNIMP int ALNAPI ALNAddLFNs(ALN* pALN, ALNNODE* pParent,
 
     ASSERT(NODE_ISLFN(pParent));
     float* pCentroidTemp;
-    float* pSigmaTemp;
     float* pNormalTemp;
     float fltThresholdTemp = 0;
     int nDim = pALN->nDim;
     pCentroidTemp = (float*)malloc((nDim) * sizeof(float)); // The centroid could have a meaningful value which is not used in a MINMAX
     pNormalTemp = (float*)malloc(nDim * sizeof(float)); // We spend an extra float on this array, but only for a short time.
-    pSigmaTemp = (float*)malloc(nDim * sizeof(float));
     for (int i = 0; i < nDim - 1; i++)
     {
         pCentroidTemp[i] = LFN_C(pParent)[i];
         pNormalTemp[i] = 0;  // since the child centroids are equal
-        pSigmaTemp[i] = 4.0f * (float)sqrt(LFN_D(pParent)[i]);  // Larger values help to prevent optimization failures. See also split-ops.cpp line 304
     }
     pCentroidTemp[nDim - 1] = LFN_C(pParent)[nDim - 1]; // Probably useless
     pNormalTemp[nDim - 1] = 0;
-    pSigmaTemp[nDim - 1] = 0;
     // free existing vectors
     if (LFN_VARMAP(pParent)) free(LFN_VARMAP(pParent));
     if (LFN_SPLIT(pParent))
@@ -549,46 +751,227 @@ ALNIMP int ALNAPI ALNAddLFNs(ALN* pALN, ALNNODE* pParent,
     // trace the effects of any split algorithms
 
     // assign children
-    memset(MINMAX_CHILDREN(pParent), 0, 2 * sizeof(ALNNODE*));
-    MINMAX_LEFT(pParent) = apChildren[0];
-    MINMAX_RIGHT(pParent) = apChildren[1];
+    MINMAX_CHILDREN(pParent) = apChildren;
+    MINMAX_NUMCHILDREN(pParent) = nLFNs;
     MINMAX_EVAL(pParent) = NULL; // Since we have equal centroids of the children we set to NULL
     MINMAX_ACTIVE(pParent) = NULL; // MYTEST this and the above line could be NULL, was that the bug?
     MINMAX_GOAL(pParent) = NULL;
     MINMAX_COUNT(pParent) = Count; //This is the old count of the LFN that has been replaced.
     MINMAX_CENTROID(pParent) = pCentroidTemp; // This is the centroid of the split LFN now tansferred to the new MINMAX node.
     MINMAX_NORMAL(pParent) = pNormalTemp; // we are attaching the allocated arrays to the places in the parent which is now a MINMAX
-    MINMAX_SIGMA(pParent) = pSigmaTemp;
+    MINMAX_BOUNDS(pParent) = NULL; // computed after training, see alnbounds.cpp
+    MINMAX_ROUTE(pParent) = NULL; // chosen at the next splits, see alnroute.cpp
     MINMAX_THRESHOLD(pParent) = 0;
+    InvalidateBounds(NODE_PARENT(pParent));
+    NewGeneration(pALN);
 
     ASSERT(NODE_ISMINMAX(pParent) && MINMAX_TYPE(pParent) == nParentMinMaxType);
 
-    int nResult = ALN_NOERROR;
+    // add all children to array of LFNs
+    if (apLFNs != NULL)
+    {
+        memcpy(apLFNs, apChildren, nLFNs * sizeof(ALNNODE*));
+    }
+    return ALN_NOERROR;
+}
+
+// splits a growable LFN into two pieces under its parent's operator: the LFN
+// stays where it is, restarted like a new child of a split, and a copy of it is
+// added to the parent's children; this replaces a split into a new minmax node
+// of the same type as the parent, which would compute the same function one
+// level deeper
+// returns ALN_* error code, (ALN_NOERROR on success)
+int ALNAPI AddSiblingLFN(ALN* pALN, ALNNODE* pLFN)
+{
+    ALNNODE* pParent = NODE_PARENT(pLFN);
+    ASSERT(pParent != NULL && NODE_ISMINMAX(pParent));
+    ASSERT(NODE_ISLFN(pLFN) && LFN_CANSPLIT(pLFN));
+
+    int nChildren = MINMAX_NUMCHILDREN(pParent);
+    ALNNODE** apChildren = (ALNNODE**)realloc(MINMAX_CHILDREN(pParent), (nChildren + 1) * sizeof(ALNNODE*));
+    if (apChildren == NULL)
+        return ALN_OUTOFMEM;
+    MINMAX_CHILDREN(pParent) = apChildren;
 
-    if (nLFNs > 2)
+    // the copy is made before the LFN moves
+    int nMinMaxType = MINMAX_TYPE(pParent);
+    ALNNODE* pSibling;
+    try
     {
-        // add left child to array of LFNs 
-        if (apLFNs != NULL)
+        pSibling = NewChildLFN(pALN, pParent, pLFN, TRUE, nMinMaxType, 1);
+    }
+    catch (CALNMemoryException* e)
+    {
+        e->Delete();
+        return ALN_OUTOFMEM;
+    }
+
+    // the LFN takes the place of the first child of a split
+    float fltChange = pALN->aRegions[pLFN->nParentRegion].fltSmoothEpsilon;
+    if (nMinMaxType == GF_MIN)
+    {
+        *LFN_W(pLFN) += fltChange;
+        LFN_C(pLFN)[pALN->nOutput] += fltChange;
+    }
+    else
+    {
+        *LFN_W(pLFN) -= fltChange;
+        LFN_C(pLFN)[pALN->nOutput] -= fltChange;
+    }
+    LFN_SPLIT_COUNT(pLFN) = 0;
+    LFN_SPLIT_SQERR(pLFN) = 0.0;
+    LFN_SPLIT_RESPTOTAL(pLFN) = 0.0;
+    memset(LFN_SPLIT_T(pLFN), 0, sizeof(float) * pALN->nDim);
+    LFN_SPLIT_EPOCHMSE(pLFN) = 0.0;
+    LFN_SPLIT_EPOCHCOUNT(pLFN) = 0;
+    LFN_SPLIT_EPOCHSQERR(pLFN) = 0.0;
+    NODE_RESPCOUNT(pLFN) = 0;
+    NODE_RESPCOUNTLASTEPOCH(pLFN) = 0;
+
+    apChildren[nChildren] = pSibling;
+    MINMAX_NUMCHILDREN(pParent) = nChildren + 1;
+    InvalidateBounds(pParent);
+    NewGeneration(pALN);
+
+    return ALN_NOERROR;
+}
+
+// helper: frees a minmax node whose children have been taken over
+static void ALNAPI FreeMinMaxNode(ALNNODE* pNode)
+{
+    ASSERT(NODE_ISMINMAX(pNode));
+    if (MINMAX_CENTROID(pNode) != NULL)
+        free(MINMAX_CENTROID(pNode));
+    if (MINMAX_NORMAL(pNode) != NULL)
+        free(MINMAX_NORMAL(pNode));
+    if (MINMAX_BOUNDS(pNode) != NULL)
+        free(MINMAX_BOUNDS(pNode));
+    if (MINMAX_ROUTE(pNode) != NULL)
+        free(MINMAX_ROUTE(pNode));
+    if (MINMAX_CHILDREN(pNode) != NULL)
+        free(MINMAX_CHILDREN(pNode));
+    free(pNode);
+}
+
+// merges every minmax node that has the same operator as its parent into the
+// parent, so a chain like max(max(a, b), c) becomes the single node max(a, b, c)
+// returns ALN_* error code, (ALN_NOERROR on success)
+int ALNAPI MergeMinMaxChains(ALNNODE* pNode)
+{
+    ASSERT(pNode);
+    if (!NODE_ISMINMAX(pNode))
+        return ALN_NOERROR;
+
+    // children first, so a merged child has no children of its own type left
+    int nChildren = MINMAX_NUMCHILDREN(pNode);
+    int nTotal = 0;
+    for (int i = 0; i < nChildren; i++)
+    {
+        ALNNODE* pChild = MINMAX_CHILDREN(pNode)[i];
+        int nRet = MergeMinMaxChains(pChild);
+        if (nRet != ALN_NOERROR)
+            return nRet;
+
+        if (NODE_ISMINMAX(pChild) && MINMAX_TYPE(pChild) == MINMAX_TYPE(pNode))
+            nTotal += MINMAX_NUMCHILDREN(pChild);
+        else
+            nTotal++;
+    }
+    if (nTotal == nChildren)
+        return ALN_NOERROR;
+
+    ALNNODE** apChildren = (ALNNODE**)malloc(nTotal * sizeof(ALNNODE*));
+    if (apChildren == NULL)
+        return ALN_OUTOFMEM;
+
+    int n = 0;
+    for (int i = 0; i < nChildren; i++)
+    {
+        ALNNODE* pChild = MINMAX_CHILDREN(pNode)[i];
+        if (!(NODE_ISMINMAX(pChild) && MINMAX_TYPE(pChild) == MINMAX_TYPE(pNode)))
         {
-            // add at the end of the array, so recursive calls with fewer children
-            // have empty slots near the beginning of the array
-            apLFNs[nLFNs - 1] = apChildren[0];
+            apChildren[n++] = pChild;
+            continue;
         }
 
-        // recurse, adding more LFNs to right child  // We son't need this, do we?
-        nResult = ALNAddLFNs(pALN, apChildren[1], nParentMinMaxType,
-            nLFNs - 1, apLFNs);
+        for (int j = 0; j < MINMAX_NUMCHILDREN(pChild); j++)
+        {
+            ALNNODE* pGrandChild = MINMAX_CHILDREN(pChild)[j];
+            NODE_PARENT(pGrandChild) = pNode;
+            apChildren[n++] = pGrandChild;
+        }
+
+        // routes through the merged node continue to its own eval and active children
+        if (MINMAX_EVAL(pNode) == pChild)
+            MINMAX_EVAL(pNode) = MINMAX_EVAL(pChild);
+        if (MINMAX_ACTIVE(pNode) == pChild)
+            MINMAX_ACTIVE(pNode) = MINMAX_ACTIVE(pChild);
+        if (MINMAX_GOAL(pNode) == pChild)
+            MINMAX_GOAL(pNode) = MINMAX_GOAL(pChild);
+        FreeMinMaxNode(pChild);
+    }
+    ASSERT(n == nTotal);
+
+    free(MINMAX_CHILDREN(pNode));
+    MINMAX_CHILDREN(pNode) = apChildren;
+    MINMAX_NUMCHILDREN(pNode) = nTotal;
+
+    return ALN_NOERROR;
+}
+
+// removes child nChild of a minmax node and frees its subtree; a node left
+// with one child is replaced by that child, in its parent or as the root
+// returns the node now in the place of pNode
+ALNNODE* ALNAPI RemoveMinMaxChild(ALN* pALN, ALNNODE* pNode, int nChild)
+{
+    ASSERT(NODE_ISMINMAX(pNode));
+    ASSERT(nChild >= 0 && nChild < MINMAX_NUMCHILDREN(pNode));
+
+    ALNNODE** apChildren = MINMAX_CHILDREN(pNode);
+    ALNNODE* pChild = apChildren[nChild];
+    int nChildren = MINMAX_NUMCHILDREN(pNode) - 1;
+    memmove(apChildren + nChild, apChildren + nChild + 1,
+        (nChildren - nChild) * sizeof(ALNNODE*));
+    MINMAX_NUMCHILDREN(pNode) = nChildren;
+    InvalidateBounds(pNode);
+    NewGeneration(pALN);
+    if (MINMAX_EVAL(pNode) == pChild)
+        MINMAX_EVAL(pNode) = NULL;
+    if (MINMAX_ACTIVE(pNode) == pChild)
+        MINMAX_ACTIVE(pNode) = NULL;
+    if (MINMAX_GOAL(pNode) == pChild)
+        MINMAX_GOAL(pNode) = NULL;
+    DestroyTree(pChild);
+
+    if (nChildren > 1)
+        return pNode;
+
+    // the last child takes the place of the node
+    ALNNODE* pLast = apChildren[0];
+    ALNNODE* pParent = NODE_PARENT(pNode);
+    NODE_PARENT(pLast) = pParent;
+    if (pParent == NULL)
+    {
+        ASSERT(pALN->pTree == pNode);
+        pALN->pTree = pLast;
     }
     else
     {
-        // add both children to array of LFNs
-        if (apLFNs != NULL)
+        for (int i = 0; i < MINMAX_NUMCHILDREN(pParent); i++)
         {
-            apLFNs[0] = apChildren[0];
-            apLFNs[1] = apChildren[1];
+            if (MINMAX_CHILDREN(pParent)[i] == pNode)
+                MINMAX_CHILDREN(pParent)[i] = pLast;
         }
+        if (MINMAX_EVAL(pParent) == pNode)
+            MINMAX_EVAL(pParent) = pLast;
+        if (MINMAX_ACTIVE(pParent) == pNode)
+            MINMAX_ACTIVE(pParent) = pLast;
+        if (MINMAX_GOAL(pParent) == pNode)
+            MINMAX_GOAL(pParent) = pLast;
     }
-    return nResult;
+    FreeMinMaxNode(pNode);
+
+    return pLast;
 }
 
 // adding multiple layers tree to a tree
@@ -765,6 +1148,10 @@ ALNIMP int ALNAPI ALNSetGrowable(ALN* pALN, ALNNODE* pParent)
     LFN_SPLIT_SQERR(pParent) = 0.0;
     LFN_SPLIT_RESPTOTAL(pParent) = 0.0;
     memset(LFN_SPLIT_T(pParent), 0, sizeof(float) * pALN->nDim);
+    LFN_SPLIT_LEARNFACTOR(pParent) = 1.0;
+    LFN_SPLIT_EPOCHMSE(pParent) = 0.0;
+    LFN_SPLIT_EPOCHCOUNT(pParent) = 0;
+    LFN_SPLIT_EPOCHSQERR(pParent) = 0.0;
 
     return 1;
 }
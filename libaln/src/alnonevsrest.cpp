@@ -0,0 +1,480 @@
+// ALN Library
+
+/* MIT License
+
+Copyright (c) 2020 William Ward Armstrong
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+
+// alnonevsrest.cpp
+
+#ifdef ALNDLL
+#define ALNIMP __declspec(dllexport)
+#endif
+
+#include <aln.h>
+#include "alnpriv.h"
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _DEBUG
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+// Recognising one of several classes takes one two-class ALN per class, and
+// every one of them used to load a training buffer of its own from the same
+// samples.  Loading is the costly part: the closest sample to each row, which
+// the F-test uses for the noise variance, takes a pass over the whole buffer
+// per sample.  Only the desired output and its difference to that of the
+// closest sample depend on the class, so the trainer builds the rows once and
+// gives each model two floats per row, afltTRlabels, which FillInputVector and
+// splitUpdateValues read in place of the output columns.
+//
+// The models are trained by a pool of threads.  Each model restarts the
+// random sequence of its thread from a seed of its own, derived from a key
+// drawn by the caller and the model number, so the result does not depend on
+// the number of threads or the order the models are trained in.
+
+struct COneVsRest
+{
+    int nDim;
+    long nSamples;
+    int nModels;
+    float fltMSEorF;
+    std::vector<float> vecTRdata;       // shared rows of 2 * nDim + 1 columns
+    std::vector<float> vecLabels;       // nModels sets of 2 per row
+
+    // pool; the caller is thread 0 and vecThreads are 1 to nThreads - 1
+    int nThreads;
+    std::vector<std::thread> vecThreads;
+    std::mutex mutex;
+    std::condition_variable cvStart;
+    std::condition_variable cvDone;
+    std::function<void(int)> fnJob;
+    long nJob;                          // counts the jobs started
+    int nPending;                       // pool threads still on the job
+    BOOL bQuit;
+
+    COneVsRest()
+    {
+        nDim = nModels = nThreads = nPending = 0;
+        nSamples = nJob = 0;
+        fltMSEorF = 0;
+        bQuit = FALSE;
+    }
+    ~COneVsRest()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            bQuit = TRUE;
+        }
+        cvStart.notify_all();
+        for (size_t i = 0; i < vecThreads.size(); i++)
+        {
+            vecThreads[i].join();
+        }
+    }
+};
+
+static void PoolProc(COneVsRest* pTrainer, int nThread)
+{
+    long nJobDone = 0;
+    while (TRUE)
+    {
+        std::function<void(int)> fnJob;
+        {
+            std::unique_lock<std::mutex> lock(pTrainer->mutex);
+            pTrainer->cvStart.wait(lock, [&] { return pTrainer->bQuit || pTrainer->nJob != nJobDone; });
+            if (pTrainer->bQuit)
+                return;
+            nJobDone = pTrainer->nJob;
+            fnJob = pTrainer->fnJob;
+        }
+
+        fnJob(nThread);
+
+        std::lock_guard<std::mutex> lock(pTrainer->mutex);
+        if (--pTrainer->nPending == 0)
+            pTrainer->cvDone.notify_one();
+    }
+}
+
+// runs fnJob(nThread) on every thread of the pool and waits for them all
+static void RunJob(COneVsRest* pTrainer, const std::function<void(int)>& fnJob)
+{
+    int nPool = (int)pTrainer->vecThreads.size();
+    if (nPool > 0)
+    {
+        std::lock_guard<std::mutex> lock(pTrainer->mutex);
+        pTrainer->fnJob = fnJob;
+        pTrainer->nPending = nPool;
+        pTrainer->nJob++;
+    }
+    pTrainer->cvStart.notify_all();
+
+    fnJob(0);
+
+    if (nPool > 0)
+    {
+        std::unique_lock<std::mutex> lock(pTrainer->mutex);
+        pTrainer->cvDone.wait(lock, [&] { return pTrainer->nPending == 0; });
+        pTrainer->fnJob = nullptr;
+    }
+}
+
+// fills the difference columns of the rows of thread nThread, as
+// CAln::addTRsample does: the closest other sample in the inputs minus this
+// one, and the square distance
+static void FindClosest(COneVsRest* pTrainer, int nThread, std::vector<long>& vecClosest)
+{
+    int nDim = pTrainer->nDim;
+    int nDimm1 = nDim - 1;
+    int nCols = 2 * nDim + 1;
+    long nSamples = pTrainer->nSamples;
+    float* afltTRdata = pTrainer->vecTRdata.data();
+
+    for (long i = nThread; i < nSamples; i += pTrainer->nThreads)
+    {
+        float* afltRow = afltTRdata + i * nCols;
+        float fltClosest = FLT_MAX;
+        long nClosest = -1;
+        for (long j = 0; j < nSamples; j++)
+        {
+            if (j == i)
+                continue;
+
+            const float* afltOther = afltTRdata + j * nCols;
+            float sum = 0;
+            for (int k = 0; k < nDimm1; k++)
+            {
+                float flt = afltOther[k] - afltRow[k];
+                sum += flt * flt;
+            }
+            if (sum < fltClosest)
+            {
+                fltClosest = sum;
+                nClosest = j;
+            }
+        }
+
+        vecClosest[i] = nClosest;
+        if (nClosest >= 0)
+        {
+            const float* afltOther = afltTRdata + nClosest * nCols;
+            for (int k = 0; k < nDim; k++)
+            {
+                afltRow[nDim + k] = afltOther[k] - afltRow[k];
+            }
+        }
+        afltRow[2 * nDim] = fltClosest;
+    }
+}
+
+// builds the shared buffer of nSamples rows of nDim values and the desired
+// values of nModels models, each learning +1 on its class in afltClasses
+// returns ALN_* error code, (ALN_NOERROR on success)
+ALNIMP int ALNAPI ALNCreateOneVsRest(int nDim, const float* afltSamples,
+    long nSamples, const float* afltClasses, int nModels, float fltMSEorF,
+    int nThreads, void** ppvOneVsRest)
+{
+    // parameter variance
+    if (nDim < 2 || afltSamples == NULL || nSamples <= 0 || afltClasses == NULL ||
+        nModels <= 0 || nThreads <= 0 || ppvOneVsRest == NULL)
+        return ALN_GENERIC;
+
+    *ppvOneVsRest = NULL;
+
+    COneVsRest* pTrainer = NULL;
+    int nReturn = ALN_NOERROR;
+    try
+    {
+        pTrainer = new COneVsRest;
+        pTrainer->nDim = nDim;
+        pTrainer->nSamples = nSamples;
+        pTrainer->nModels = nModels;
+        pTrainer->fltMSEorF = fltMSEorF;
+
+        // the samples, with zero differences unless there is an F-test
+        int nCols = 2 * nDim + 1;
+        pTrainer->vecTRdata.assign((size_t)nSamples * nCols, 0);
+        for (long i = 0; i < nSamples; i++)
+        {
+            memcpy(pTrainer->vecTRdata.data() + i * nCols, afltSamples + i * nDim,
+                nDim * sizeof(float));
+        }
+
+        pTrainer->nThreads = nThreads;
+        for (int t = 1; t < nThreads; t++)
+        {
+            pTrainer->vecThreads.push_back(std::thread(PoolProc, pTrainer, t));
+        }
+
+        std::vector<long> vecClosest(nSamples, -1);
+        if (fltMSEorF < 0)
+        {
+            RunJob(pTrainer, [&](int nThread) { FindClosest(pTrainer, nThread, vecClosest); });
+        }
+
+        // the desired value of each model is +1 on its class, -1 elsewhere
+        pTrainer->vecLabels.assign((size_t)nModels * nSamples * 2, 0);
+        for (int m = 0; m < nModels; m++)
+        {
+            float* afltLabels = pTrainer->vecLabels.data() + (size_t)m * nSamples * 2;
+            for (long i = 0; i < nSamples; i++)
+            {
+                float fltClass = afltSamples[i * nDim + nDim - 1];
+                afltLabels[2 * i] = (fabs(fltClass - afltClasses[m]) < 0.1) ? 1.0f : -1.0f;
+            }
+            for (long i = 0; i < nSamples; i++)
+            {
+                if (vecClosest[i] >= 0)
+                    afltLabels[2 * i + 1] = afltLabels[2 * vecClosest[i]] - afltLabels[2 * i];
+            }
+        }
+
+        *ppvOneVsRest = pTrainer;
+    }
+    catch (...)
+    {
+        nReturn = ALN_OUTOFMEM;
+    }
+
+    if (nReturn != ALN_NOERROR)
+        delete pTrainer;
+
+    return nReturn;
+}
+
+// describes the training buffer of model nModel
+// returns ALN_* error code, (ALN_NOERROR on success)
+ALNIMP int ALNAPI ALNGetOneVsRestData(void* pvOneVsRest, int nModel,
+    ALNDATAINFO* pDataInfo)
+{
+    COneVsRest* pTrainer = (COneVsRest*)pvOneVsRest;
+
+    // parameter variance
+    if (pTrainer == NULL || nModel < 0 || nModel >= pTrainer->nModels ||
+        pDataInfo == NULL)
+        return ALN_GENERIC;
+
+    memset(pDataInfo, 0, sizeof(ALNDATAINFO));
+    pDataInfo->afltTRdata = pTrainer->vecTRdata.data();
+    pDataInfo->nTRmaxSamples = pTrainer->nSamples;
+    pDataInfo->nTRcurrSamples = pTrainer->nSamples;
+    pDataInfo->nTRcols = 2 * pTrainer->nDim + 1;
+    pDataInfo->nTRinsert = 0;
+    pDataInfo->fltMSEorF = pTrainer->fltMSEorF;
+    pDataInfo->afltTRlabels = pTrainer->vecLabels.data() + (size_t)nModel * pTrainer->nSamples * 2;
+
+    return ALN_NOERROR;
+}
+
+// the callback of the caller, and the lock the threads make it under
+struct CALLBACKLOCK
+{
+    std::mutex mutex;
+    ALNNOTIFYPROC pfnNotifyProc;
+    void* pvData;
+};
+
+// helper: passes a notification on to the caller's callback, one thread at
+// a time
+static int ALNAPI LockedNotifyProc(const ALN* pALN, int nCode, void* pParam, void* pvData)
+{
+    CALLBACKLOCK* pLock = (CALLBACKLOCK*)pvData;
+    std::lock_guard<std::mutex> lock(pLock->mutex);
+    return pLock->pfnNotifyProc(pALN, nCode, pParam, pLock->pvData);
+}
+
+// trains the ALN of each model with ALNTrain, apALN[m] for model m
+// returns ALN_* error code of the first model that failed, (ALN_NOERROR on success)
+ALNIMP int ALNAPI ALNTrainOneVsRest(void* pvOneVsRest, ALN* const* apALN,
+    const ALNCALLBACKINFO* pCallbackInfo, int nMaxEpochs,
+    float fltMinRMSErr, float fltLearnRate, BOOL bJitter)
+{
+    COneVsRest* pTrainer = (COneVsRest*)pvOneVsRest;
+
+    // parameter variance
+    if (pTrainer == NULL || apALN == NULL)
+        return ALN_GENERIC;
+
+    int nModels = pTrainer->nModels;
+    for (int m = 0; m < nModels; m++)
+    {
+        if (apALN[m] == NULL || apALN[m]->nDim != pTrainer->nDim ||
+            apALN[m]->nOutput != pTrainer->nDim - 1)
+            return ALN_GENERIC;
+    }
+
+    // the models must not share the globals when on different threads; the
+    // ALNs using them get a copy for the run, and the globals then get the
+    // splits of all of them
+    std::vector<int> vecReturn;
+    std::vector<BOOL> vecGlobal;
+    try
+    {
+        vecReturn.assign(nModels, ALN_NOERROR);
+        vecGlobal.assign(nModels, FALSE);
+    }
+    catch (...)
+    {
+        return ALN_OUTOFMEM;
+    }
+
+    ALNTRAINCONTEXT contextGlobal;
+    ALN* pGlobalALN = NULL;
+    int nReturn = ALN_NOERROR;
+    if (pTrainer->nThreads > 1)
+    {
+        for (int m = 0; m < nModels && nReturn == ALN_NOERROR; m++)
+        {
+            if (apALN[m]->pTrainContext != NULL)
+                continue;
+
+            ALNGetTrainContext(apALN[m], &contextGlobal);
+            nReturn = ALNSetTrainContext(apALN[m], &contextGlobal);
+            vecGlobal[m] = (nReturn == ALN_NOERROR);
+            if (vecGlobal[m])
+                pGlobalALN = apALN[m];
+        }
+    }
+
+    // the callbacks of the threads are made one at a time
+    CALLBACKLOCK lock;
+    ALNCALLBACKINFO callbackinfo;
+    const ALNCALLBACKINFO* pModelCallbackInfo = pCallbackInfo;
+    if (pTrainer->nThreads > 1 && pCallbackInfo != NULL && pCallbackInfo->pfnNotifyProc != NULL)
+    {
+        lock.pfnNotifyProc = pCallbackInfo->pfnNotifyProc;
+        lock.pvData = pCallbackInfo->pvData;
+        callbackinfo.nNotifyMask = pCallbackInfo->nNotifyMask;
+        callbackinfo.pfnNotifyProc = LockedNotifyProc;
+        callbackinfo.pvData = &lock;
+        pModelCallbackInfo = &callbackinfo;
+    }
+
+    if (nReturn == ALN_NOERROR)
+    {
+        unsigned long long nKey = RandKey();
+        RunJob(pTrainer, [&](int nThread)
+        {
+            std::string strState;
+            GetRandState(strState);
+            for (int m = nThread; m < nModels; m += pTrainer->nThreads)
+            {
+                RANDSTREAM stream;
+                InitRandStream(&stream, nKey, RANDSTREAM_MODEL, m);
+                unsigned long long nSeed = RandStreamNext(&stream);
+                SeedThreadRand(nSeed | ((unsigned long long)RandStreamNext(&stream) << 32));
+
+                ALNDATAINFO datainfo;
+                ALNGetOneVsRestData(pTrainer, m, &datainfo);
+                vecReturn[m] = ALNTrain(apALN[m], &datainfo, pModelCallbackInfo,
+                    nMaxEpochs, fltMinRMSErr, fltLearnRate, bJitter);
+            }
+            SetRandState(strState);
+        });
+    }
+
+    // the copies go; the globals count the splits of every model that used
+    // them, and stop once all of those have stopped
+    if (pGlobalALN != NULL)
+    {
+        int nSplitCount = contextGlobal.nSplitCount;
+        BOOL bStopTraining = TRUE;
+        for (int m = 0; m < nModels; m++)
+        {
+            if (!vecGlobal[m])
+                continue;
+
+            nSplitCount += apALN[m]->pTrainContext->nSplitCount - contextGlobal.nSplitCount;
+            bStopTraining = bStopTraining && apALN[m]->pTrainContext->bStopTraining;
+            ALNSetTrainContext(apALN[m], NULL);
+        }
+        contextGlobal.nSplitCount = nSplitCount;
+        contextGlobal.bStopTraining = bStopTraining;
+        UpdateTrainContext(pGlobalALN, contextGlobal);
+    }
+    if (nReturn != ALN_NOERROR)
+        return nReturn;
+
+    for (int m = 0; m < nModels; m++)
+    {
+        if (vecReturn[m] != ALN_NOERROR)
+            return vecReturn[m];
+    }
+    return ALN_NOERROR;
+}
+
+// evaluates the ALN of each model at afltX, into afltResult if not NULL
+// returns the model of greatest value, or -1 if the parameters are invalid
+ALNIMP int ALNAPI ALNClassifyOneVsRest(ALN* const* apALN, int nModels,
+    const float* afltX, float* afltResult)
+{
+    // parameter variance
+    if (apALN == NULL || nModels <= 0 || afltX == NULL || apALN[0] == NULL)
+        return -1;
+
+    int nDim = apALN[0]->nDim;
+    for (int m = 1; m < nModels; m++)
+    {
+        if (apALN[m] == NULL || apALN[m]->nDim != nDim)
+            return -1;
+    }
+
+    float* afltXm = (float*)malloc(nDim * sizeof(float));
+    if (afltXm == NULL)
+        return -1;
+
+    int nBest = -1;
+    float fltBest = 0;
+    for (int m = 0; m < nModels; m++)
+    {
+        memcpy(afltXm, afltX, nDim * sizeof(float));
+        afltXm[apALN[m]->nOutput] = 0;
+        float flt = ALNQuickEval(apALN[m], afltXm, NULL);
+        if (afltResult != NULL)
+            afltResult[m] = flt;
+        if (nBest < 0 || flt > fltBest)
+        {
+            nBest = m;
+            fltBest = flt;
+        }
+    }
+
+    free(afltXm);
+    return nBest;
+}
+
+// destroys a trainer made by ALNCreateOneVsRest
+// returns ALN_* error code, (ALN_NOERROR on success)
+ALNIMP int ALNAPI ALNDestroyOneVsRest(void* pvOneVsRest)
+{
+    if (pvOneVsRest == NULL)
+        return ALN_GENERIC;
+
+    delete (COneVsRest*)pvOneVsRest;
+
+    return ALN_NOERROR;
+}
@@ -0,0 +1,127 @@
+// ALN Library
+
+/* MIT License
+
+Copyright (c) 2020 William Ward Armstrong
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+// alnphasetimes.cpp
+
+#ifdef ALNDLL
+#define ALNIMP __declspec(dllexport)
+#endif
+
+#include <aln.h>
+#include "alnpriv.h"
+#include <atomic>
+#include <mutex>
+
+#ifdef _DEBUG
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+// Training phases can be written as Chrome trace events, in the JSON array
+// form of the Trace Event Format. Each event is a complete span ("ph":"X")
+// with times in microseconds since the trace was opened. An array which is
+// not closed still loads, so a trace of a run which was killed is usable.
+
+static std::mutex mutexTrace;
+static std::atomic<bool> bTraceOpen(false);
+static FILE* pTraceFile = NULL;
+static BOOL bTraceEmpty = TRUE;
+static std::chrono::steady_clock::time_point timeTraceOrigin;
+static std::atomic<int> nTraceThreads(0);
+
+BOOL ALNAPI IsTraceOpen()
+{
+    return bTraceOpen.load(std::memory_order_relaxed);
+}
+
+// small id of the calling thread for the trace viewer
+static int ALNAPI TraceThreadId()
+{
+    static thread_local int nThread = 0;
+    if (nThread == 0)
+        nThread = ++nTraceThreads;
+    return nThread;
+}
+
+void ALNAPI TraceEvent(const char* pszName,
+    std::chrono::steady_clock::time_point timeStart,
+    std::chrono::steady_clock::time_point timeEnd,
+    const char* pszArgs)
+{
+    int nThread = TraceThreadId();
+
+    std::lock_guard<std::mutex> lock(mutexTrace);
+    if (pTraceFile == NULL)
+        return;
+
+    double dblStart = std::chrono::duration<double, std::micro>(timeStart - timeTraceOrigin).count();
+    double dblDuration = std::chrono::duration<double, std::micro>(timeEnd - timeStart).count();
+    fprintf(pTraceFile, "%s{\"name\":\"%s\",\"cat\":\"aln\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d",
+        bTraceEmpty ? "" : ",\n", pszName, dblStart, dblDuration, nThread);
+    if (pszArgs != NULL)
+        fprintf(pTraceFile, ",\"args\":%s", pszArgs);
+    fputc('}', pTraceFile);
+    bTraceEmpty = FALSE;
+}
+
+// starts writing training phases to a trace file, closing any open trace
+// returns ALN_* error code, (ALN_NOERROR on success)
+ALNIMP int ALNAPI ALNOpenTrace(const char* pszFileName)
+{
+    if (pszFileName == NULL)
+        return ALN_GENERIC;
+
+    ALNCloseTrace();
+
+    std::lock_guard<std::mutex> lock(mutexTrace);
+    FILE* pFile;
+    if (fopen_s(&pFile, pszFileName, "w") != 0)
+        return ALN_ERRFILE;
+
+    fputs("[\n", pFile);
+    pTraceFile = pFile;
+    bTraceEmpty = TRUE;
+    timeTraceOrigin = std::chrono::steady_clock::now();
+    bTraceOpen.store(true);
+
+    return ALN_NOERROR;
+}
+
+// completes and closes the trace file
+// returns ALN_* error code, (ALN_NOERROR on success)
+ALNIMP int ALNAPI ALNCloseTrace(void)
+{
+    std::lock_guard<std::mutex> lock(mutexTrace);
+    if (pTraceFile == NULL)
+        return ALN_NOERROR;
+
+    bTraceOpen.store(false);
+    fputs("\n]\n", pTraceFile);
+    int nReturn = ferror(pTraceFile) ? ALN_ERRFILE : ALN_NOERROR;
+    if (fclose(pTraceFile) != 0)
+        nReturn = ALN_ERRFILE;
+    pTraceFile = NULL;
+
+    return nReturn;
+}
@@ -32,6 +32,7 @@ SOFTWARE. */
 #include <memory.h>
 #include <limits>
 #include "alnpp.h"
+#include "alnpriv.h"
 
 #ifdef _DEBUG
 #undef THIS_FILE
@@ -50,15 +51,118 @@ CAln::CAln()
     m_pALN = NULL;
     memset(&m_datainfo, 0, sizeof(m_datainfo));
     m_nLastError = ALN_GENERIC; // no ALN pointer yet!
+    m_pvCheckpoint = NULL;
 }
 
 CAln::~CAln()
 {
+    WaitCheckpoint();
     Destroy();
     ASSERT(m_pALN == NULL);
 }
 
-void ALNAPI CAln::addTRsample(float* afltX, const int nDim)
+// A compact buffer row holds the row of the closest sample in place of the
+// difference to it, see IsCompactTRBuffer.  When the buffer is full the new
+// sample replaces the oldest, and the rows whose closest that was look for
+// their closest again among all the rows.
+
+// sets the closest of row i among the first nRows rows
+static void FindTRClosest(float* afltTRdata, int nDim, long nRows, long i)
+{
+    int nCols = nDim + 2;
+    float* afltRow = afltTRdata + i * nCols;
+    long nClosest = -1;
+    float fltClosest = FLT_MAX;
+    for (long k = 0; k < nRows; k++)
+    {
+        if (k == i)
+            continue;
+        const float* afltOther = afltTRdata + k * nCols;
+        float sum = 0;
+        for (int j = 0; j < nDim - 1; j++)
+        {
+            float diff = afltOther[j] - afltRow[j];
+            sum += diff * diff;
+        }
+        if (sum < fltClosest)
+        {
+            nClosest = k;
+            fltClosest = sum;
+        }
+    }
+    SetTRClosest(afltRow, nDim, nClosest);
+    afltRow[nDim + 1] = fltClosest;
+}
+
+static void AddCompactTRsample(ALNDATAINFO* pDataInfo, const float* afltX, int nDim)
+{
+    int nCols = nDim + 2;
+    long nTRmaxSamples = pDataInfo->nTRmaxSamples;
+    long nTRcurrSamples = pDataInfo->nTRcurrSamples;
+    long nTRinsert = pDataInfo->nTRinsert;
+
+    if (nTRcurrSamples == 0)
+    {
+        size_t nSize = (size_t)nTRmaxSamples * nCols * sizeof(float);
+        pDataInfo->afltTRdata = (float*)malloc(nSize);
+        if (pDataInfo->afltTRdata == NULL)
+            return;
+        memset(pDataInfo->afltTRdata, 0, nSize);
+    }
+    float* afltTRdata = pDataInfo->afltTRdata;
+    float* afltNew = afltTRdata + nTRinsert * nCols;
+    BOOL bReplace = (nTRcurrSamples == nTRmaxSamples);   // the oldest goes
+    long nRows = bReplace ? nTRcurrSamples : nTRcurrSamples + 1;
+
+    memcpy(afltNew, afltX, nDim * sizeof(float));
+    if (pDataInfo->fltMSEorF >= 0)
+    {
+        // no F-test, so no closest samples
+        SetTRClosest(afltNew, nDim, -1);
+        afltNew[nDim + 1] = 0;
+    }
+    else
+    {
+        long nClosest = -1;
+        float fltClosest = FLT_MAX;
+        for (long i = 0; i < nRows; i++)
+        {
+            if (i == nTRinsert)
+                continue;
+            float* afltRow = afltTRdata + i * nCols;
+            float sum = 0;
+            for (int j = 0; j < nDim - 1; j++)
+            {
+                float diff = afltX[j] - afltRow[j];
+                sum += diff * diff;
+            }
+            if (bReplace && GetTRClosest(afltRow, nDim) == nTRinsert)
+            {
+                FindTRClosest(afltTRdata, nDim, nRows, i);
+            }
+            else if (sum < afltRow[nDim + 1])
+            {
+                SetTRClosest(afltRow, nDim, nTRinsert);
+                afltRow[nDim + 1] = sum;
+            }
+            if (sum < fltClosest)
+            {
+                nClosest = i;
+                fltClosest = sum;
+            }
+        }
+        SetTRClosest(afltNew, nDim, nClosest);
+        afltNew[nDim + 1] = fltClosest;
+    }
+
+    pDataInfo->nTRcurrSamples = nRows;
+    if (++nTRinsert == nTRmaxSamples) nTRinsert = 0;
+    pDataInfo->nTRinsert = nTRinsert;
+}
+
+// adds a sample to the circular buffer of pDataInfo, replacing the oldest
+// when it is full; CAln::addTRsample and the ingestion queue use it
+void ALNAPI AddTRSample(ALNDATAINFO* pDataInfo, const float* afltX, int nDim)
 {
     float sum;
     int nDimm1 = nDim - 1;
@@ -73,15 +177,20 @@ void ALNAPI CAln::addTRsample(float* afltX, const int nDim)
     // 3. the difference of desired output values: add  nDimt2m1;
     // 4. the squared distance between two closest samples: add nDimt2
 
-    ALNDATAINFO* thisDataInfo = this->GetDataInfo();
+    if (IsCompactTRBuffer(pDataInfo))
+    {
+        AddCompactTRsample(pDataInfo, afltX, nDim);
+        return;
+    }
+
     // Put some items on the stack
-    long nTRmaxSamples = thisDataInfo->nTRmaxSamples;
-    long nTRcurrSamples = thisDataInfo->nTRcurrSamples;
-    int nTRcols = thisDataInfo->nTRcols;
-    long nTRinsert = thisDataInfo->nTRinsert;
-    float fltMSEorF = thisDataInfo->fltMSEorF;
+    long nTRmaxSamples = pDataInfo->nTRmaxSamples;
+    long nTRcurrSamples = pDataInfo->nTRcurrSamples;
+    int nTRcols = pDataInfo->nTRcols;
+    long nTRinsert = pDataInfo->nTRinsert;
+    float fltMSEorF = pDataInfo->fltMSEorF;
     float* afltTRdata; // This is a pointer to the buffer on the stack
-    ASSERT(nTRcols == nDimt2p1); // Check
+    ASSERT(nTRcols == nDimt2p1); // Check, unless compact as above
 
     // The new sample afltX will be placed here
     long nDimt2p1tTRinsert = nDimt2p1 * nTRinsert;
@@ -91,9 +200,9 @@ void ALNAPI CAln::addTRsample(float* afltX, const int nDim)
     {
         long bufferSize = nTRmaxSamples * nTRcols;
         //Allocate the buffer on first use 
-        thisDataInfo->afltTRdata = (float*)malloc(bufferSize * sizeof(float));
+        pDataInfo->afltTRdata = (float*)malloc(bufferSize * sizeof(float));
         // make the stack pointer point to the allocated space
-        afltTRdata = thisDataInfo->afltTRdata;
+        afltTRdata = pDataInfo->afltTRdata;
         // First we fill TRbuff with 0's and an FLT_MAX
         memset(afltTRdata, 0, bufferSize * sizeof(float));
         /*
@@ -113,8 +222,8 @@ void ALNAPI CAln::addTRsample(float* afltX, const int nDim)
             afltTRdata[j] = afltX[j];
         }
         // update the buffer values in the ALN
-        thisDataInfo->nTRcurrSamples = 1;
-        thisDataInfo->nTRinsert++;
+        pDataInfo->nTRcurrSamples = 1;
+        pDataInfo->nTRinsert++;
         return;
     }// End of initializing the data buffer
 
@@ -127,7 +236,7 @@ void ALNAPI CAln::addTRsample(float* afltX, const int nDim)
     // 1. what other samples it is closest to
     // 2. what other sample is closest to it.	(N.B. "closest" means * among * the closest if it is not unique)
 
-    afltTRdata = thisDataInfo->afltTRdata; // restore the stack-based pointer.
+    afltTRdata = pDataInfo->afltTRdata; // restore the stack-based pointer.
     if (fltMSEorF < 0)
     {
         float* afltYtemp = (float*)malloc((nDim + 1) * sizeof(float)); // stores the difference vector and square distance 
@@ -194,18 +303,30 @@ void ALNAPI CAln::addTRsample(float* afltX, const int nDim)
     {
         nTRcurrSamples++; // This will stay at the max if it gets to it
     }
-    thisDataInfo->nTRcurrSamples = nTRcurrSamples;
+    pDataInfo->nTRcurrSamples = nTRcurrSamples;
     if (++nTRinsert == nTRmaxSamples) nTRinsert = 0; // Too TRICKY!!! See if it works!
-    thisDataInfo->nTRinsert = nTRinsert; // Pass the information back to the ALN.
+    pDataInfo->nTRinsert = nTRinsert; // Pass the information back to the ALN.
 
     return;
 }
 
+void ALNAPI CAln::addTRsample(float* afltX, const int nDim)
+{
+    // a pending checkpoint must not see the buffer change
+    if (m_pvCheckpoint != NULL)
+        ALNDetachCheckpoint(m_pvCheckpoint);
+
+    AddTRSample(GetDataInfo(), afltX, nDim);
+}
+
 void ALNAPI CAln::reduceNoiseVariance()
 {
     // This routine should only be used when there are many samples in afltTRdata since
     // the closest other sample to a sample should have a close value of the ideal function
     // In that case we replace all sample values by the average of two and get 1/2 the noise variance.
+    if (m_pvCheckpoint != NULL)
+        ALNDetachCheckpoint(m_pvCheckpoint);
+
     ALNDATAINFO* thisDataInfo = this->GetDataInfo();
     float* afltTRdata = thisDataInfo->afltTRdata;
     //int nTRmaxSamples = thisDataInfo->nTRmaxSamples;
@@ -215,6 +336,24 @@ void ALNAPI CAln::reduceNoiseVariance()
     //float fltMSEorF = thisDataInfo->fltMSEorF;
     if (!afltTRdata) return; // this avoids a crash
     if (thisDataInfo->fltMSEorF > 0) return; // we are not using noise variance
+    if (m_pALN != NULL && IsCompactTRBuffer(thisDataInfo))
+    {
+        // the differences come from the rows being changed, so they are
+        // all taken first
+        int nDim = m_pALN->nDim;
+        float* afltOutDiff = (float*)malloc(nTRcurrSamples * sizeof(float));
+        float* afltDiff = (float*)malloc(nDim * sizeof(float));
+        if (afltOutDiff != NULL && afltDiff != NULL)
+        {
+            for (long i = 0; i < nTRcurrSamples; i++)
+                afltOutDiff[i] = GetTRDifference(thisDataInfo, nDim, afltTRdata + nTRcols * i, afltDiff)[nDim - 1];
+            for (long i = 0; i < nTRcurrSamples; i++)
+                afltTRdata[nTRcols * i + nDim - 1] -= 0.5f * afltOutDiff[i];
+        }
+        free(afltDiff);
+        free(afltOutDiff);
+        return;
+    }
     int nDim = (nTRcols - 1) / 2;
     int nDimm1 = nDim - 1;
     int nDimt2m1 = nDim * 2 - 1;
@@ -443,6 +582,17 @@ BOOL CAln::Destroy()
     return b;
 }
 
+BOOL CAln::SetTrainContext(const ALNTRAINCONTEXT* pContext)
+{
+    m_nLastError = ALNSetTrainContext(m_pALN, pContext);
+    return (m_nLastError == ALN_NOERROR);
+}
+
+BOOL CAln::GetTrainContext(ALNTRAINCONTEXT* pContext) const
+{
+    return (ALNGetTrainContext(m_pALN, pContext) == ALN_NOERROR);
+}
+
 // private callback data struct
 struct CALLBACKDATA
 {
@@ -526,6 +676,62 @@ float CAln::QuickEval(const float* afltX, ALNNODE** ppActiveLFN /*= NULL*/)
     return ALNQuickEval(m_pALN, afltX, ppActiveLFN);
 }
 
+// eval of one state with each action
+int CAln::EvalActions(const float* afltState, int nActionVar,
+    const float* afltActions, int nActions, float* afltResult)
+{
+    int nBest = ALNEvalActions(m_pALN, afltState, nActionVar, afltActions,
+        nActions, afltResult);
+    m_nLastError = (nBest < 0) ? ALN_GENERIC : ALN_NOERROR;
+    return nBest;
+}
+
+// pruning of unused subtrees and merging of nearly coplanar LFNs
+BOOL CAln::Prune(ALNPRUNEINFO* pPruneInfo,
+    int nNotifyMask /*= AN_NONE*/,
+    ALNDATAINFO* pData /*= NULL*/,
+    void* pvData /*= NULL*/)
+{
+    if (pData == NULL)
+        pData = &m_datainfo;
+
+    CALLBACKDATA data;
+    data.pALN = this;
+    data.pvData = pvData;
+
+    ALNCALLBACKINFO callback;
+    callback.nNotifyMask = nNotifyMask;
+    callback.pvData = &data;
+    callback.pfnNotifyProc = ALNNotifyProc;
+
+    m_nLastError = ALNPrune(m_pALN, pData, &callback, pPruneInfo);
+
+    return m_nLastError == ALN_NOERROR;
+}
+
+// profile-guided reordering of the children of minmax nodes
+BOOL CAln::Reorder(ALNREORDERINFO* pReorderInfo,
+    int nNotifyMask /*= AN_NONE*/,
+    ALNDATAINFO* pData /*= NULL*/,
+    void* pvData /*= NULL*/)
+{
+    if (pData == NULL)
+        pData = &m_datainfo;
+
+    CALLBACKDATA data;
+    data.pALN = this;
+    data.pvData = pvData;
+
+    ALNCALLBACKINFO callback;
+    callback.nNotifyMask = nNotifyMask;
+    callback.pvData = &data;
+    callback.pfnNotifyProc = ALNNotifyProc;
+
+    m_nLastError = ALNReorder(m_pALN, pData, &callback, pReorderInfo);
+
+    return m_nLastError == ALN_NOERROR;
+}
+
 // get variable monotonicicty, returns -1 on failure
 int CAln::VarMono(int nVar)
 {
@@ -558,6 +764,43 @@ BOOL CAln::Read(const char* pszFileName)
     return m_nLastError == ALN_NOERROR;
 }
 
+// checkpoint of ALN and training buffer
+BOOL CAln::WriteCheckpoint(const char* pszFileName, BOOL bAsync,
+    const void* pvMeta, int nMetaBytes)
+{
+    // only one checkpoint at a time
+    if (!WaitCheckpoint())
+        return FALSE;
+
+    m_nLastError = ALNWriteCheckpoint(m_pALN, &m_datainfo, pszFileName,
+        pvMeta, nMetaBytes, bAsync ? &m_pvCheckpoint : NULL);
+    return m_nLastError == ALN_NOERROR;
+}
+
+// waits for a pending checkpoint, returns its result
+BOOL CAln::WaitCheckpoint()
+{
+    m_nLastError = ALN_NOERROR;
+    if (m_pvCheckpoint != NULL)
+    {
+        m_nLastError = ALNWaitCheckpoint(m_pvCheckpoint);
+        m_pvCheckpoint = NULL;
+    }
+    return m_nLastError == ALN_NOERROR;
+}
+
+// resume from checkpoint... destroys any existing ALN
+BOOL CAln::ReadCheckpoint(const char* pszFileName, void* pvMeta, int nMetaBytes)
+{
+    WaitCheckpoint();
+    Destroy();
+    ASSERT(m_pALN == NULL);
+
+    m_nLastError = ALNReadCheckpoint(pszFileName, &m_pALN, &m_datainfo,
+        pvMeta, nMetaBytes);
+    return m_nLastError == ALN_NOERROR;
+}
+
 // conversion to dtree
 DTREE* CAln::ConvertDtree(int nMaxDepth)
 {
@@ -707,6 +950,10 @@ int ALNAPI CAln::ALNNotifyProc(const ALN* pALN, int nCode, void* pParam,
     case AN_VECTORINFO:
         bContinue = pALNObj->OnVectorInfo((VECTORINFO*)pParam, pData->pvData);
         break;
+
+    case AN_PHASETIMES:
+        bContinue = pALNObj->OnPhaseTimes((PHASETIMES*)pParam, pData->pvData);
+        break;
     }
 
     return bContinue;
@@ -0,0 +1,341 @@
+// ALN Library
+
+/* MIT License
+
+Copyright (c) 2020 William Ward Armstrong
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+
+// alnprune.cpp
+
+#ifdef ALNDLL
+#define ALNIMP __declspec(dllexport)
+#endif
+
+#include <aln.h>
+#include "alnpriv.h"
+
+#ifdef _DEBUG
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+// helper: sets the responsibility counts of a subtree to zero, if bShift
+// after moving them to the last epoch counts
+static void ALNAPI ClearRespCounts(ALNNODE* pNode, BOOL bShift)
+{
+    if (bShift)
+        NODE_RESPCOUNTLASTEPOCH(pNode) = NODE_RESPCOUNT(pNode);
+    NODE_RESPCOUNT(pNode) = 0;
+    if (NODE_ISMINMAX(pNode))
+    {
+        for (int i = 0; i < MINMAX_NUMCHILDREN(pNode); i++)
+        {
+            ClearRespCounts(MINMAX_CHILDREN(pNode)[i], bShift);
+        }
+    }
+}
+
+// helper: evaluation of every node, without cutoffs, counting the child which
+// gives the value of each minmax node
+static float ALNAPI PruneEval(ALNNODE* pNode, const ALN* pALN, const float* afltX)
+{
+    if (NODE_ISLFN(pNode))
+        return LFNValue(pNode, afltX, pALN->nDim);
+
+    BOOL bMax = MINMAX_ISMAX(pNode) != 0;
+    ALNNODE* pActive = NULL;
+    float fltDist = 0;
+    for (int i = 0; i < MINMAX_NUMCHILDREN(pNode); i++)
+    {
+        ALNNODE* pChild = MINMAX_CHILDREN(pNode)[i];
+        float flt = PruneEval(pChild, pALN, afltX);
+        if (pActive == NULL || (bMax ? flt > fltDist : flt < fltDist))
+        {
+            fltDist = flt;
+            pActive = pChild;
+        }
+    }
+    NODE_RESPCOUNT(pActive)++;
+
+    return fltDist;
+}
+
+// helper: counts responsibilities on the data set and returns the RMS error;
+// if afltMin and afltMax are not NULL they receive the bounds of the data
+static float ALNAPI PrunePass(ALN* pALN, ALNDATAINFO* pDataInfo,
+    const ALNCALLBACKINFO* pCallbackInfo, float* afltX,
+    float* afltMin, float* afltMax)
+{
+    long nSamples = pDataInfo->nTRcurrSamples;
+    int nDim = pALN->nDim;
+    double dblSqErrorSum = 0;
+    for (long nSample = 0; nSample < nSamples; nSample++)
+    {
+        FillInputVector(pALN, afltX, nSample, 0, pDataInfo, pCallbackInfo);
+        if (afltMin != NULL)
+        {
+            for (int i = 0; i < nDim; i++)
+            {
+                if (nSample == 0 || afltX[i] < afltMin[i])
+                    afltMin[i] = afltX[i];
+                if (nSample == 0 || afltX[i] > afltMax[i])
+                    afltMax[i] = afltX[i];
+            }
+        }
+
+        float flt = PruneEval(pALN->pTree, pALN, afltX);
+        dblSqErrorSum += flt * flt;
+    }
+    NODE_RESPCOUNT(pALN->pTree) = nSamples;
+
+    return (float)sqrt(dblSqErrorSum / nSamples);
+}
+
+// helper: removes the children responsible for too few samples, keeping the
+// one responsible for most
+static void ALNAPI RemoveUnused(ALN* pALN, ALNNODE* pNode, int nMinRespCount,
+    ALNPRUNEINFO* pPruneInfo)
+{
+    if (!NODE_ISMINMAX(pNode))
+        return;
+
+    ALNNODE* pKeep = MINMAX_CHILDREN(pNode)[0];
+    for (int i = 1; i < MINMAX_NUMCHILDREN(pNode); i++)
+    {
+        if (NODE_RESPCOUNT(MINMAX_CHILDREN(pNode)[i]) > NODE_RESPCOUNT(pKeep))
+            pKeep = MINMAX_CHILDREN(pNode)[i];
+    }
+
+    for (int i = MINMAX_NUMCHILDREN(pNode) - 1; i >= 0; i--)
+    {
+        ALNNODE* pChild = MINMAX_CHILDREN(pNode)[i];
+        if (pChild == pKeep || NODE_RESPCOUNT(pChild) >= nMinRespCount)
+            continue;
+
+        int nLFNs = 0, nAdapted = 0;
+        CountLFNs(pChild, nLFNs, nAdapted);
+        pPruneInfo->nRemoved += nLFNs;
+        if (RemoveMinMaxChild(pALN, pNode, i) == pKeep)
+        {
+            // the node is gone, its last child took its place
+            RemoveUnused(pALN, pKeep, nMinRespCount, pPruneInfo);
+            return;
+        }
+    }
+
+    for (int i = 0; i < MINMAX_NUMCHILDREN(pNode); i++)
+    {
+        RemoveUnused(pALN, MINMAX_CHILDREN(pNode)[i], nMinRespCount, pPruneInfo);
+    }
+}
+
+// helper: greatest difference of two LFNs over the box of the data
+static float ALNAPI MaxDifference(const ALNNODE* pLFN0, const ALNNODE* pLFN1,
+    const ALN* pALN, const float* afltMin, const float* afltMax)
+{
+    const float* afltW0 = LFN_W(pLFN0);
+    const float* afltW1 = LFN_W(pLFN1);
+    int nOutput = pALN->nOutput;
+    if (afltW0[nOutput + 1] != afltW1[nOutput + 1])
+        return FLT_MAX;     // not measured along the same axis
+
+    // the difference is linear, so it is greatest at a corner of the box
+    float fltCenter = afltW0[0] - afltW1[0];
+    float fltSpread = 0;
+    for (int i = 0; i < pALN->nDim; i++)
+    {
+        if (i == nOutput)
+            continue;
+
+        float fltDW = afltW0[i + 1] - afltW1[i + 1];
+        fltCenter += fltDW * 0.5f * (afltMin[i] + afltMax[i]);
+        fltSpread += (float)fabs(fltDW) * 0.5f * (afltMax[i] - afltMin[i]);
+    }
+
+    return (float)fabs(fltCenter) + fltSpread;
+}
+
+// helper: replaces pLFN by the average of it and pOther, weighted by their
+// responsibility counts
+static void ALNAPI MergeLFN(ALNNODE* pLFN, const ALNNODE* pOther, const ALN* pALN)
+{
+    ASSERT(LFN_VDIM(pLFN) == pALN->nDim && LFN_VDIM(pOther) == pALN->nDim);
+
+    float flt0 = (float)NODE_RESPCOUNT(pLFN);
+    float flt1 = (float)NODE_RESPCOUNT(pOther);
+    if (flt0 + flt1 == 0)
+        flt0 = flt1 = 1;
+    float fltF0 = flt0 / (flt0 + flt1);
+    float fltF1 = 1.0f - fltF0;
+
+    float* afltW = LFN_W(pLFN);
+    float* afltC = LFN_C(pLFN);
+    float* afltD = LFN_D(pLFN);
+    const float* afltWOther = LFN_W(pOther);
+    const float* afltCOther = LFN_C(pOther);
+    const float* afltDOther = LFN_D(pOther);
+    int nOutput = pALN->nOutput;
+
+    afltW[0] = fltF0 * afltW[0] + fltF1 * afltWOther[0];
+    float fltOutput = afltW[0];
+    for (int i = 0; i < pALN->nDim; i++)
+    {
+        if (i == nOutput)
+            continue;
+
+        afltW[i + 1] = fltF0 * afltW[i + 1] + fltF1 * afltWOther[i + 1];
+        afltC[i] = fltF0 * afltC[i] + fltF1 * afltCOther[i];
+        afltD[i] = fltF0 * afltD[i] + fltF1 * afltDOther[i];
+        fltOutput += afltW[i + 1] * afltC[i];
+    }
+
+    // the output centroid lies on the merged LFN, as W[0] requires
+    afltC[nOutput] = fltOutput;
+    afltD[nOutput] = fltF0 * afltD[nOutput] + fltF1 * afltDOther[nOutput];
+
+    NODE_RESPCOUNT(pLFN) += NODE_RESPCOUNT(pOther);
+    NODE_RESPCOUNTLASTEPOCH(pLFN) += NODE_RESPCOUNTLASTEPOCH(pOther);
+}
+
+// helper: merges nearly coplanar sibling LFNs throughout a subtree
+static void ALNAPI MergeSiblings(ALN* pALN, ALNNODE* pNode, float fltTolerance,
+    const float* afltMin, const float* afltMax, ALNPRUNEINFO* pPruneInfo)
+{
+    if (!NODE_ISMINMAX(pNode))
+        return;
+
+    // a child left with a single LFN is replaced by it in the same position
+    for (int i = 0; i < MINMAX_NUMCHILDREN(pNode); i++)
+    {
+        MergeSiblings(pALN, MINMAX_CHILDREN(pNode)[i], fltTolerance, afltMin, afltMax, pPruneInfo);
+    }
+
+    for (int i = 0; i < MINMAX_NUMCHILDREN(pNode); i++)
+    {
+        ALNNODE* pLFN = MINMAX_CHILDREN(pNode)[i];
+        if (!NODE_ISLFN(pLFN) || NODE_ISCONSTANT(pLFN))
+            continue;
+
+        for (int j = MINMAX_NUMCHILDREN(pNode) - 1; j > i; j--)
+        {
+            ALNNODE* pOther = MINMAX_CHILDREN(pNode)[j];
+            if (!NODE_ISLFN(pOther) || NODE_ISCONSTANT(pOther) ||
+                MaxDifference(pLFN, pOther, pALN, afltMin, afltMax) > fltTolerance)
+                continue;
+
+            MergeLFN(pLFN, pOther, pALN);
+            pPruneInfo->nMerged++;
+            if (RemoveMinMaxChild(pALN, pNode, j) != pNode)
+                return;     // the node is gone, the merged LFN took its place
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pruning of unused subtrees and merging of nearly coplanar sibling LFNs
+
+ALNIMP int ALNAPI ALNPrune(ALN* pALN,
+    ALNDATAINFO* pDataInfo,
+    const ALNCALLBACKINFO* pCallbackInfo,
+    ALNPRUNEINFO* pPruneInfo)
+{
+    int nReturn = ValidateALNDataInfo(pALN, pDataInfo, pCallbackInfo);
+    if (nReturn != ALN_NOERROR)
+        return nReturn;
+
+    if (pPruneInfo == NULL || pPruneInfo->nMinRespCount < 1 ||
+        pPruneInfo->fltTolerance < 0 || pDataInfo->nTRcurrSamples <= 0)
+        return ALN_GENERIC;
+
+#ifdef _DEBUG
+    DebugValidateALNDataInfo(pALN, pDataInfo, pCallbackInfo);
+#endif
+
+    int nDim = pALN->nDim;
+    float* afltX = NULL;
+    float* afltMin = NULL;
+    float* afltMax = NULL;
+
+    try
+    {
+        afltX = new float[nDim];
+        afltMin = new float[nDim];
+        afltMax = new float[nDim];
+        if (!afltX || !afltMin || !afltMax) ThrowALNMemoryException();
+
+        int nAdapted = 0;
+        pPruneInfo->nLFNsBefore = 0;
+        CountLFNs(pALN->pTree, pPruneInfo->nLFNsBefore, nAdapted);
+        pPruneInfo->nRemoved = 0;
+        pPruneInfo->nMerged = 0;
+
+        ClearRespCounts(pALN->pTree, TRUE);
+        pPruneInfo->fltRMSErrBefore = PrunePass(pALN, pDataInfo, pCallbackInfo,
+            afltX, afltMin, afltMax);
+
+        RemoveUnused(pALN, pALN->pTree, pPruneInfo->nMinRespCount, pPruneInfo);
+
+        // removals may leave nodes under parents of the same type, merging
+        // them first makes more LFNs siblings
+        nReturn = MergeMinMaxChains(pALN->pTree);
+        if (nReturn == ALN_NOERROR && pPruneInfo->fltTolerance > 0)
+        {
+            MergeSiblings(pALN, pALN->pTree, pPruneInfo->fltTolerance,
+                afltMin, afltMax, pPruneInfo);
+            nReturn = MergeMinMaxChains(pALN->pTree);
+        }
+
+        pPruneInfo->nLFNsAfter = 0;
+        CountLFNs(pALN->pTree, pPruneInfo->nLFNsAfter, nAdapted);
+
+        ClearRespCounts(pALN->pTree, FALSE);
+        pPruneInfo->fltRMSErrAfter = PrunePass(pALN, pDataInfo, pCallbackInfo,
+            afltX, NULL, NULL);
+
+        // the removals and merges changed the subtrees
+        UpdateBounds(pALN, pDataInfo, pCallbackInfo);
+    }
+    catch (CALNUserException* e)	  // user abort exception
+    {
+        nReturn = ALN_USERABORT;
+        e->Delete();
+    }
+    catch (CALNMemoryException* e)	// memory specific exceptions
+    {
+        nReturn = ALN_OUTOFMEM;
+        e->Delete();
+    }
+    catch (CALNException* e)	      // anything other exception we recognize
+    {
+        nReturn = ALN_GENERIC;
+        e->Delete();
+    }
+    catch (...)		                  // anything else, including FP errs
+    {
+        nReturn = ALN_GENERIC;
+    }
+
+    delete[] afltX;
+    delete[] afltMin;
+    delete[] afltMax;
+
+    return nReturn;
+}
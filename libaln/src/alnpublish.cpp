@@ -0,0 +1,325 @@
+// ALN Library
+
+/* MIT License
+
+Copyright (c) 2020 William Ward Armstrong
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+// alnpublish.cpp
+
+#ifdef ALNDLL
+#define ALNIMP __declspec(dllexport)
+#endif
+
+#include <aln.h>
+#include "alnpriv.h"
+#include <atomic>
+#include <climits>
+#include <thread>
+#include <vector>
+
+#ifdef _DEBUG
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+// Training changes the weights of every LFN it adapts and splits replace
+// leaves by minmax nodes, so evaluating the ALN being trained from another
+// thread is unsafe. Instead the trainer publishes copies of the ALN which
+// are never changed, and readers evaluate those.
+//
+// The current snapshot is reached through an atomic pointer. Old snapshots
+// are freed by epoch based reclamation: a reader announces the epoch it
+// started in by claiming a slot, the publisher swaps the pointer, advances
+// the epoch and retires the old snapshot with the epoch it was current in.
+// A retired snapshot is freed once no slot holds that epoch or an earlier
+// one; any reader which started later can only have seen a newer snapshot.
+// All operations on the pointer, epoch and slots are sequentially
+// consistent, which is what makes that last argument hold.
+
+// published snapshot
+struct CSnapshot
+{
+    ALN* pALN;                    // private copy, never changed
+    long nVersion;                // 1 for the first snapshot
+};
+
+// retired snapshot waiting for its readers
+struct CRetired
+{
+    CSnapshot* pSnapshot;
+    unsigned long long nEpoch;    // last epoch in which it was current
+};
+
+struct CPublisher
+{
+    std::atomic<CSnapshot*> pCurrent;
+    std::atomic<unsigned long long> nEpoch;
+
+    // reader slots hold the epoch a reader started in, 0 when free
+    int nMaxReaders;
+    std::atomic<unsigned long long>* anReaderEpoch;
+
+    // only touched by the publishing thread
+    std::vector<CRetired> vecRetired;
+    long nVersion;
+
+    CPublisher()
+        : pCurrent(NULL), nEpoch(1)
+    {
+        nMaxReaders = 0;
+        anReaderEpoch = NULL;
+        nVersion = 0;
+    }
+};
+
+static void ALNAPI DestroySnapshot(CSnapshot* pSnapshot)
+{
+    if (pSnapshot == NULL)
+        return;
+
+    ALNDestroyALN(pSnapshot->pALN);
+    delete pSnapshot;
+}
+
+// copies the ALN, throws CALNMemoryException*
+static CSnapshot* ALNAPI CreateSnapshot(const ALN* pALN, long nVersion)
+{
+    CSnapshot* pSnapshot = new CSnapshot;
+    try
+    {
+        pSnapshot->pALN = DuplicateALN(pALN);
+    }
+    catch (CALNMemoryException*)
+    {
+        delete pSnapshot;
+        throw;
+    }
+    pSnapshot->nVersion = nVersion;
+
+    return pSnapshot;
+}
+
+// frees retired snapshots no reader can still hold
+static void ALNAPI Reclaim(CPublisher* pPublisher)
+{
+    if (pPublisher->vecRetired.empty())
+        return;
+
+    // oldest epoch any reader started in
+    unsigned long long nOldest = ULLONG_MAX;
+    for (int i = 0; i < pPublisher->nMaxReaders; i++)
+    {
+        unsigned long long n = pPublisher->anReaderEpoch[i].load();
+        if (n != 0 && n < nOldest)
+            nOldest = n;
+    }
+
+    size_t nKept = 0;
+    for (size_t i = 0; i < pPublisher->vecRetired.size(); i++)
+    {
+        CRetired& retired = pPublisher->vecRetired[i];
+        if (retired.nEpoch < nOldest)
+            DestroySnapshot(retired.pSnapshot);
+        else
+            pPublisher->vecRetired[nKept++] = retired;
+    }
+    pPublisher->vecRetired.resize(nKept);
+}
+
+// creates a publisher with a first snapshot of pALN
+// returns ALN_* error code, (ALN_NOERROR on success)
+ALNIMP int ALNAPI ALNCreatePublisher(const ALN* pALN, int nMaxReaders,
+    void** ppvPublisher)
+{
+    // parameter variance
+    if (pALN == NULL || nMaxReaders <= 0 || ppvPublisher == NULL)
+        return ALN_GENERIC;
+
+    *ppvPublisher = NULL;
+
+    CPublisher* pPublisher = NULL;
+    int nReturn = ALN_NOERROR;
+    try
+    {
+        pPublisher = new CPublisher;
+        pPublisher->anReaderEpoch = new std::atomic<unsigned long long>[nMaxReaders];
+        pPublisher->nMaxReaders = nMaxReaders;
+        for (int i = 0; i < nMaxReaders; i++)
+        {
+            pPublisher->anReaderEpoch[i].store(0);
+        }
+
+        pPublisher->nVersion = 1;
+        pPublisher->pCurrent.store(CreateSnapshot(pALN, pPublisher->nVersion));
+
+        *ppvPublisher = pPublisher;
+    }
+    catch (CALNMemoryException* e)
+    {
+        nReturn = ALN_OUTOFMEM;
+        e->Delete();
+    }
+    catch (...)
+    {
+        nReturn = ALN_OUTOFMEM;
+    }
+
+    if (nReturn != ALN_NOERROR && pPublisher != NULL)
+    {
+        delete[] pPublisher->anReaderEpoch;
+        delete pPublisher;
+    }
+
+    return nReturn;
+}
+
+// publishes a new snapshot of pALN; call from the training thread
+// returns ALN_* error code, (ALN_NOERROR on success)
+ALNIMP int ALNAPI ALNPublish(void* pvPublisher, const ALN* pALN)
+{
+    // parameter variance
+    if (pvPublisher == NULL || pALN == NULL)
+        return ALN_GENERIC;
+
+    CPublisher* pPublisher = (CPublisher*)pvPublisher;
+
+    int nReturn = ALN_NOERROR;
+    try
+    {
+        // retire capacity first, so nothing can fail after the swap
+        pPublisher->vecRetired.reserve(pPublisher->vecRetired.size() + 1);
+        CSnapshot* pSnapshot = CreateSnapshot(pALN, pPublisher->nVersion + 1);
+        pPublisher->nVersion++;
+
+        CSnapshot* pOld = pPublisher->pCurrent.exchange(pSnapshot);
+        CRetired retired;
+        retired.pSnapshot = pOld;
+        retired.nEpoch = pPublisher->nEpoch.fetch_add(1);
+        pPublisher->vecRetired.push_back(retired);
+
+        Reclaim(pPublisher);
+    }
+    catch (CALNMemoryException* e)
+    {
+        nReturn = ALN_OUTOFMEM;
+        e->Delete();
+    }
+    catch (...)
+    {
+        nReturn = ALN_OUTOFMEM;
+    }
+
+    return nReturn;
+}
+
+// gets the current snapshot and holds it until ALNReleaseSnapshot is
+// called with the reader slot returned in pnReader; the snapshot and
+// the LFNs of it returned by ALNQuickEval stay valid until then
+// waits only if all nMaxReaders slots are in use
+ALNIMP const ALN* ALNAPI ALNAcquireSnapshot(void* pvPublisher,
+    int* pnReader, long* pnVersion)
+{
+    ASSERT(pvPublisher);
+    ASSERT(pnReader);
+
+    CPublisher* pPublisher = (CPublisher*)pvPublisher;
+
+    // claim a free slot with the current epoch
+    int nReader = 0;
+    while (TRUE)
+    {
+        unsigned long long nEpoch = pPublisher->nEpoch.load();
+        unsigned long long nFree = 0;
+        if (pPublisher->anReaderEpoch[nReader].compare_exchange_strong(nFree, nEpoch))
+            break;
+
+        if (++nReader == pPublisher->nMaxReaders)
+        {
+            nReader = 0;
+            std::this_thread::yield();
+        }
+    }
+
+    CSnapshot* pSnapshot = pPublisher->pCurrent.load();
+
+    *pnReader = nReader;
+    if (pnVersion != NULL)
+        *pnVersion = pSnapshot->nVersion;
+
+    return pSnapshot->pALN;
+}
+
+// releases a snapshot held by a reader
+// returns ALN_* error code, (ALN_NOERROR on success)
+ALNIMP int ALNAPI ALNReleaseSnapshot(void* pvPublisher, int nReader)
+{
+    CPublisher* pPublisher = (CPublisher*)pvPublisher;
+    if (pPublisher == NULL || nReader < 0 || nReader >= pPublisher->nMaxReaders)
+        return ALN_GENERIC;
+
+    pPublisher->anReaderEpoch[nReader].store(0);
+
+    return ALN_NOERROR;
+}
+
+// evaluates the current snapshot on a single vector, see ALNQuickEval
+// the version of the snapshot used is returned in pnVersion if not NULL
+ALNIMP float ALNAPI ALNPublishedEval(void* pvPublisher, const float* afltX,
+    long* pnVersion)
+{
+    ASSERT(pvPublisher);
+    ASSERT(afltX);
+
+    int nReader;
+    const ALN* pALN = ALNAcquireSnapshot(pvPublisher, &nReader, pnVersion);
+    float flt = ALNQuickEval(pALN, afltX, NULL);
+    ALNReleaseSnapshot(pvPublisher, nReader);
+
+    return flt;
+}
+
+// destroys a publisher and all its snapshots
+// returns ALN_* error code, (ALN_NOERROR on success)
+ALNIMP int ALNAPI ALNDestroyPublisher(void* pvPublisher)
+{
+    if (pvPublisher == NULL)
+        return ALN_GENERIC;
+
+    CPublisher* pPublisher = (CPublisher*)pvPublisher;
+
+#ifdef _DEBUG
+    for (int i = 0; i < pPublisher->nMaxReaders; i++)
+    {
+        ASSERT(pPublisher->anReaderEpoch[i].load() == 0);
+    }
+#endif
+
+    for (size_t i = 0; i < pPublisher->vecRetired.size(); i++)
+    {
+        DestroySnapshot(pPublisher->vecRetired[i].pSnapshot);
+    }
+    DestroySnapshot(pPublisher->pCurrent.load());
+
+    delete[] pPublisher->anReaderEpoch;
+    delete pPublisher;
+
+    return ALN_NOERROR;
+}
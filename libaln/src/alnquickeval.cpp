@@ -61,8 +61,36 @@ ALNIMP float ALNAPI ALNQuickEval(const ALN* pALN, const float* afltX,
 
     float flt = afltX[pALN->nOutput] + CutoffEval(pALN->pTree, pALN, afltX,
         CEvalCutoff(), &pActiveLFN);
+    STATS_TREEEVAL(pALN->pTree, pActiveLFN);
     if (ppActiveLFN)
         *ppActiveLFN = pActiveLFN;
 
     return flt;
 }
+
+// evaluation of ALN on a batch of vectors
+// afltX holds nVectors input vectors of pALN->nDim elements one after the
+//   other; the results are placed in afltResult, and if apActiveLFN is not
+//   NULL, the responsible LFNs in apActiveLFN
+// returns ALN_* error code, (ALN_NOERROR on success)
+ALNIMP int ALNAPI ALNQuickEvalBatch(const ALN* pALN, const float* afltX,
+    int nVectors, float* afltResult, ALNNODE** apActiveLFN)
+{
+    // parameter variance
+    if (pALN == NULL || afltX == NULL || afltResult == NULL || nVectors < 0)
+        return ALN_GENERIC;
+
+    int nDim = pALN->nDim;
+    for (int i = 0; i < nVectors; i++)
+    {
+        const float* afltVector = afltX + (size_t)i * nDim;
+        ALNNODE* pActiveLFN;
+        afltResult[i] = afltVector[pALN->nOutput] + CutoffEval(pALN->pTree, pALN,
+            afltVector, CEvalCutoff(), &pActiveLFN);
+        STATS_TREEEVAL(pALN->pTree, pActiveLFN);
+        if (apActiveLFN)
+            apActiveLFN[i] = pActiveLFN;
+    }
+
+    return ALN_NOERROR;
+}
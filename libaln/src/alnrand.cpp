@@ -70,35 +70,234 @@ ALNIMP float ALNAPI ALNRandFloat()
 }
 */
 
-#include <random>
+#include <atomic>
+#include <string>
+#include <sstream>
 
-unsigned long DoFastRand();
-ALNIMP unsigned long ALNAPI ALNRand();
-ALNIMP float ALNAPI ALNRandFloat();
-ALNIMP void ALNAPI ALNSRand(unsigned int nSeed);
+// The generator is Philox4x32-10 (Salmon et al., "Parallel random numbers:
+// as easy as 1, 2, 3").  A number is a function of a 64 bit key and a 128 bit
+// counter, with no state in between, so a stream is a key and two indexes,
+// eg. the epoch and the sample, and any thread can draw any stream in any
+// order with the same result.  ALNRand and ALNRandFloat draw the sequence of
+// the calling thread: the key is the seed given to ALNSRand and the counter
+// counts the numbers drawn.
 
-std::mt19937_64 generator;
-std::uniform_int_distribution<int> distribution1(0, 1474836UL);
-std::uniform_real_distribution<float> distribution2(0.0, 1.0);
+#define PHILOX_M0 0xD2511F53
+#define PHILOX_M1 0xCD9E8D57
+#define PHILOX_W0 0x9E3779B9
+#define PHILOX_W1 0xBB67AE85
+#define PHILOX_ROUNDS 10
 
+// stream indexes of the sequence of a thread
+#define RANDSTREAM_SEQUENCE 0xFFFFFFFF
 
-unsigned long DoFastRand()
+// the blocks of a bulk draw computed side by side
+#define RANDLANES 8
+
+#define RANDDEFAULTSEED 5489ULL
+
+static std::atomic<unsigned long long> g_nRandSeed(RANDDEFAULTSEED);
+static std::atomic<long> g_nRandSeedGeneration(0);
+
+// sequence of a thread, restarted when ALNSRand changes the seed
+struct CRandSequence
+{
+    RANDSTREAM stream;
+    unsigned long long nSeed;
+    long nSeedGeneration;
+    BOOL bInit;
+};
+static thread_local CRandSequence t_sequence = { };
+
+static inline void PhiloxRound(unsigned int anCtr[4], const unsigned int anKey[2])
+{
+    unsigned long long n0 = (unsigned long long)PHILOX_M0 * anCtr[0];
+    unsigned long long n1 = (unsigned long long)PHILOX_M1 * anCtr[2];
+    unsigned int nHi0 = (unsigned int)(n0 >> 32), nLo0 = (unsigned int)n0;
+    unsigned int nHi1 = (unsigned int)(n1 >> 32), nLo1 = (unsigned int)n1;
+    anCtr[0] = nHi1 ^ anCtr[1] ^ anKey[0];
+    anCtr[1] = nLo1;
+    anCtr[2] = nHi0 ^ anCtr[3] ^ anKey[1];
+    anCtr[3] = nLo0;
+}
+
+// the four numbers of block nBlock of a stream
+static inline void PhiloxBlock(const RANDSTREAM* pStream, unsigned long long nBlock,
+    unsigned int anOut[4])
+{
+    unsigned int anKey[2] = { pStream->anKey[0], pStream->anKey[1] };
+    anOut[0] = (unsigned int)nBlock;
+    anOut[1] = (unsigned int)(nBlock >> 32);
+    anOut[2] = pStream->anIndex[0];
+    anOut[3] = pStream->anIndex[1];
+    for (int r = 0; r < PHILOX_ROUNDS; r++)
+    {
+        PhiloxRound(anOut, anKey);
+        anKey[0] += PHILOX_W0;
+        anKey[1] += PHILOX_W1;
+    }
+}
+
+static inline float RandToFloat(unsigned int n)
+{
+    return (float)(n >> 8) * (1.0f / 16777216.0f);    // [0, 1)
+}
+
+void ALNAPI InitRandStream(RANDSTREAM* pStream, unsigned long long nKey,
+    unsigned int nIndex0, unsigned int nIndex1)
+{
+    ASSERT(pStream);
+    pStream->anKey[0] = (unsigned int)nKey;
+    pStream->anKey[1] = (unsigned int)(nKey >> 32);
+    pStream->anIndex[0] = nIndex0;
+    pStream->anIndex[1] = nIndex1;
+    pStream->nBlock = 0;
+    pStream->nNext = 4;
+}
+
+unsigned int ALNAPI RandStreamNext(RANDSTREAM* pStream)
+{
+    if (pStream->nNext == 4)
+    {
+        PhiloxBlock(pStream, pStream->nBlock++, pStream->anBlock);
+        pStream->nNext = 0;
+    }
+    return pStream->anBlock[pStream->nNext++];
+}
+
+// draws n floats in [0, 1); whole blocks are computed RANDLANES at a time,
+// lane by lane in each round, which the compiler can vectorise
+void ALNAPI RandStreamFloats(RANDSTREAM* pStream, float* aflt, int n)
 {
-    return distribution1(generator);
+    ASSERT(pStream && (aflt || n == 0));
+
+    int i = 0;
+    while (i < n && pStream->nNext < 4)
+    {
+        aflt[i++] = RandToFloat(pStream->anBlock[pStream->nNext++]);
+    }
+
+    while (n - i >= 4 * RANDLANES)
+    {
+        unsigned int an0[RANDLANES], an1[RANDLANES], an2[RANDLANES], an3[RANDLANES];
+        for (int l = 0; l < RANDLANES; l++)
+        {
+            unsigned long long nBlock = pStream->nBlock + l;
+            an0[l] = (unsigned int)nBlock;
+            an1[l] = (unsigned int)(nBlock >> 32);
+            an2[l] = pStream->anIndex[0];
+            an3[l] = pStream->anIndex[1];
+        }
+        unsigned int nKey0 = pStream->anKey[0], nKey1 = pStream->anKey[1];
+        for (int r = 0; r < PHILOX_ROUNDS; r++)
+        {
+            for (int l = 0; l < RANDLANES; l++)
+            {
+                unsigned long long n0 = (unsigned long long)PHILOX_M0 * an0[l];
+                unsigned long long n1 = (unsigned long long)PHILOX_M1 * an2[l];
+                unsigned int nCtr1 = an1[l], nCtr3 = an3[l];
+                an0[l] = (unsigned int)(n1 >> 32) ^ nCtr1 ^ nKey0;
+                an1[l] = (unsigned int)n1;
+                an2[l] = (unsigned int)(n0 >> 32) ^ nCtr3 ^ nKey1;
+                an3[l] = (unsigned int)n0;
+            }
+            nKey0 += PHILOX_W0;
+            nKey1 += PHILOX_W1;
+        }
+        for (int l = 0; l < RANDLANES; l++)
+        {
+            aflt[i + 4 * l] = RandToFloat(an0[l]);
+            aflt[i + 4 * l + 1] = RandToFloat(an1[l]);
+            aflt[i + 4 * l + 2] = RandToFloat(an2[l]);
+            aflt[i + 4 * l + 3] = RandToFloat(an3[l]);
+        }
+        pStream->nBlock += RANDLANES;
+        i += 4 * RANDLANES;
+    }
+
+    while (i < n)
+    {
+        aflt[i++] = RandToFloat(RandStreamNext(pStream));
+    }
+}
+
+// the sequence of the calling thread, restarted if the seed has changed
+static inline RANDSTREAM* ThreadSequence()
+{
+    CRandSequence& sequence = t_sequence;
+    long nSeedGeneration = g_nRandSeedGeneration.load(std::memory_order_acquire);
+    if (!sequence.bInit || sequence.nSeedGeneration != nSeedGeneration)
+    {
+        sequence.nSeed = g_nRandSeed.load(std::memory_order_relaxed);
+        sequence.nSeedGeneration = nSeedGeneration;
+        sequence.bInit = TRUE;
+        InitRandStream(&sequence.stream, sequence.nSeed, RANDSTREAM_SEQUENCE, RANDSTREAM_SEQUENCE);
+    }
+    return &sequence.stream;
+}
+
+unsigned long long ALNAPI RandKey()
+{
+    RANDSTREAM* pStream = ThreadSequence();
+    unsigned long long nLo = RandStreamNext(pStream);
+    return (nLo | ((unsigned long long)RandStreamNext(pStream) << 32));
 }
 
 ALNIMP unsigned long ALNAPI ALNRand()
 {
-    return DoFastRand(); // this does a random int
+    return RandStreamNext(ThreadSequence());
 }
 
 ALNIMP float ALNAPI ALNRandFloat()
 {
-    return distribution2(generator);
+    return RandToFloat(RandStreamNext(ThreadSequence()));
 }
 
-
+// every thread restarts its sequence from the new seed before its next number
 ALNIMP void ALNAPI ALNSRand(unsigned int nSeed)
 {
-    return; // not used here
+    g_nRandSeed.store(nSeed, std::memory_order_relaxed);
+    g_nRandSeedGeneration.fetch_add(1, std::memory_order_release);
+}
+
+// restarts the sequence of the calling thread alone from nSeed
+void ALNAPI SeedThreadRand(unsigned long long nSeed)
+{
+    CRandSequence& sequence = t_sequence;
+    ThreadSequence();
+    sequence.nSeed = nSeed;
+    InitRandStream(&sequence.stream, nSeed, RANDSTREAM_SEQUENCE, RANDSTREAM_SEQUENCE);
+}
+
+// state of the sequence of the calling thread, used by checkpoints
+void ALNAPI GetRandState(std::string& strState)
+{
+    CRandSequence& sequence = t_sequence;
+    RANDSTREAM* pStream = ThreadSequence();
+    unsigned long long nDrawn = pStream->nBlock * 4 - (4 - pStream->nNext);
+    std::ostringstream os;
+    os << sequence.nSeed << ' ' << nDrawn;
+    strState = os.str();
+}
+
+BOOL ALNAPI SetRandState(const std::string& strState)
+{
+    std::istringstream is(strState);
+    unsigned long long nSeed, nDrawn;
+    is >> nSeed >> nDrawn;
+    if (is.fail())
+        return FALSE;
+
+    CRandSequence& sequence = t_sequence;
+    ThreadSequence();
+    sequence.nSeed = nSeed;
+    RANDSTREAM* pStream = &sequence.stream;
+    InitRandStream(pStream, nSeed, RANDSTREAM_SEQUENCE, RANDSTREAM_SEQUENCE);
+    pStream->nBlock = nDrawn / 4;
+    if (nDrawn % 4 != 0)
+    {
+        PhiloxBlock(pStream, pStream->nBlock++, pStream->anBlock);
+        pStream->nNext = (int)(nDrawn % 4);
+    }
+    return TRUE;
 }
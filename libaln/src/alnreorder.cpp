@@ -0,0 +1,279 @@
+// ALN Library
+
+/* MIT License
+
+Copyright (c) 2020 William Ward Armstrong
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+
+// alnreorder.cpp
+
+#ifdef ALNDLL
+#define ALNIMP __declspec(dllexport)
+#endif
+
+#include <aln.h>
+#include "alnpriv.h"
+#include <algorithm>
+#include <new>
+#include <unordered_map>
+
+#ifdef _DEBUG
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+// The alpha-beta cutoffs prune most when the child giving the value of a
+// node is evaluated first.  A profile of the data set counts, for each child,
+// the samples on which it gives the value of its parent, and, for each node
+// with two children, how often its routing test picked that child.  Every
+// node is counted on every sample, not only those on the path to the active
+// LFN: most of the nodes evaluated are off that path, where the child giving
+// the value is the one that ends the evaluation with a cutoff soonest.  The
+// children are then sorted by their counts, and the tree is copied so that
+// the nodes lie in memory in the order the evaluation visits them.
+
+typedef std::unordered_map<const ALNNODE*, long> CCountMap;
+
+// helper: the count of a node in a map, 0 if it has none
+static long ALNAPI Count(const CCountMap& map, const ALNNODE* pNode)
+{
+    CCountMap::const_iterator it = map.find(pNode);
+    return (it == map.end()) ? 0 : it->second;
+}
+
+// helper: the child of a node with two children that CutoffEvalMinMax
+// evaluates first at afltX
+static const ALNNODE* ALNAPI RoutedChild(const ALNNODE* pNode, const float* afltX, int nDim)
+{
+    float flt = 0;
+    const ALNROUTE* pRoute = MINMAX_ROUTE(pNode);
+    if (pRoute != NULL && pRoute->nTerms >= 0)
+        flt = SparseRouteValue(pRoute, afltX);
+    else if (MINMAX_NORMAL(pNode))
+        flt = NormalRouteValue(pNode, afltX, nDim);
+    return MINMAX_CHILDREN(pNode)[(flt > 0) ? 1 : 0];
+}
+
+// helper: evaluation of every node, without cutoffs, counting the wins of
+// each child and the routing tests that chose the winner
+static float ALNAPI ProfileEval(const ALNNODE* pNode, const ALN* pALN, const float* afltX,
+    CCountMap& mapWins, CCountMap& mapRouted)
+{
+    if (NODE_ISLFN(pNode))
+        return LFNValue(pNode, afltX, pALN->nDim);
+
+    BOOL bMax = MINMAX_ISMAX(pNode) != 0;
+    const ALNNODE* pWinner = NULL;
+    float fltDist = 0;
+    for (int i = 0; i < MINMAX_NUMCHILDREN(pNode); i++)
+    {
+        const ALNNODE* pChild = MINMAX_CHILDREN(pNode)[i];
+        float flt = ProfileEval(pChild, pALN, afltX, mapWins, mapRouted);
+        if (pWinner == NULL || (bMax ? flt > fltDist : flt < fltDist))
+        {
+            fltDist = flt;
+            pWinner = pChild;
+        }
+    }
+    mapWins[pWinner]++;
+    if (MINMAX_NUMCHILDREN(pNode) == 2 && RoutedChild(pNode, afltX, pALN->nDim) == pWinner)
+        mapRouted[pNode]++;
+
+    return fltDist;
+}
+
+// helper: evaluates the data set with cutoffs, and without them to count the
+// wins when pmapWins is not NULL; returns the LFNs evaluated with cutoffs,
+// counted only with ALNSTATS
+static long long ALNAPI ProfilePass(const ALN* pALN, ALNDATAINFO* pDataInfo,
+    const ALNCALLBACKINFO* pCallbackInfo, float* afltX,
+    CCountMap* pmapWins, CCountMap* pmapRouted)
+{
+#ifdef ALNSTATS
+    ALNEVALSTATS statsMark, statsPass;
+    MarkEvalStats(statsMark);
+#endif
+
+    for (long nSample = 0; nSample < pDataInfo->nTRcurrSamples; nSample++)
+    {
+        FillInputVector(pALN, afltX, nSample, 0, pDataInfo, pCallbackInfo);
+
+        ALNNODE* pActiveLFN = NULL;
+        CutoffEval(pALN->pTree, pALN, afltX, CEvalCutoff(), &pActiveLFN);
+        if (pmapWins != NULL)
+            ProfileEval(pALN->pTree, pALN, afltX, *pmapWins, *pmapRouted);
+    }
+
+#ifdef ALNSTATS
+    GetEvalStatsSinceMark(statsMark, statsPass);
+    return statsPass.nLeafEvals;
+#else
+    return 0;
+#endif
+}
+
+// helper: turns the routing test of a node with two children around after
+// they are swapped, so it still picks the same child; the normal and the
+// test stay for training, which uses them at the next split
+static void ALNAPI FlipRoute(ALNNODE* pNode, int nDim)
+{
+    if (MINMAX_NORMAL(pNode) != NULL)
+    {
+        for (int i = 0; i < nDim - 1; i++)
+        {
+            MINMAX_NORMAL(pNode)[i] = -MINMAX_NORMAL(pNode)[i];
+        }
+    }
+    MINMAX_THRESHOLD(pNode) = -MINMAX_THRESHOLD(pNode);
+
+    ALNROUTE* pRoute = MINMAX_ROUTE(pNode);
+    if (pRoute != NULL)
+    {
+        for (int i = 0; i < pRoute->nTerms; i++)
+        {
+            pRoute->afltW[i] = -pRoute->afltW[i];
+        }
+        pRoute->fltThreshold = -pRoute->fltThreshold;
+    }
+}
+
+// helper: sorts the children of every minmax node by their wins
+static void ALNAPI ReorderChildren(ALNNODE* pNode, int nDim, const CCountMap& mapWins,
+    const CCountMap& mapRouted, ALNREORDERINFO* pReorderInfo)
+{
+    if (!NODE_ISMINMAX(pNode))
+        return;
+
+    int nChildren = MINMAX_NUMCHILDREN(pNode);
+    ALNNODE** apChildren = MINMAX_CHILDREN(pNode);
+
+    // a node with two children keeps its routing test if the test picks the
+    // winner more often than always taking the child winning most would
+    long nMostWins = 0;
+    for (int i = 0; i < nChildren; i++)
+    {
+        nMostWins = max(nMostWins, Count(mapWins, apChildren[i]));
+    }
+    if (nChildren == 2 && nMostWins <= Count(mapRouted, pNode))
+    {
+        pNode->fNode &= ~GF_STORED;
+        pReorderInfo->nRouted++;
+    }
+    else
+    {
+        // LFN children are reduced in stored order, and the subtrees after
+        // the one nearest afltX as well
+        auto MoreWins = [&](const ALNNODE* pA, const ALNNODE* pB)
+        {
+            return Count(mapWins, pA) > Count(mapWins, pB);
+        };
+        if (!std::is_sorted(apChildren, apChildren + nChildren, MoreWins))
+        {
+            std::stable_sort(apChildren, apChildren + nChildren, MoreWins);
+            if (nChildren == 2)
+                FlipRoute(pNode, nDim);
+            pReorderInfo->nReordered++;
+        }
+        if (nChildren == 2)
+        {
+            pNode->fNode |= GF_STORED;
+            pReorderInfo->nStoredOrder++;
+        }
+    }
+
+    for (int i = 0; i < nChildren; i++)
+    {
+        ReorderChildren(apChildren[i], nDim, mapWins, mapRouted, pReorderInfo);
+    }
+}
+
+// reorders the children of minmax nodes by how often they win on a data set
+// returns ALN_* error code, (ALN_NOERROR on success)
+ALNIMP int ALNAPI ALNReorder(ALN* pALN,
+    ALNDATAINFO* pDataInfo,
+    const ALNCALLBACKINFO* pCallbackInfo,
+    ALNREORDERINFO* pReorderInfo)
+{
+    int nReturn = ValidateALNDataInfo(pALN, pDataInfo, pCallbackInfo);
+    if (nReturn != ALN_NOERROR)
+        return nReturn;
+
+    if (pReorderInfo == NULL || pDataInfo->nTRcurrSamples <= 0)
+        return ALN_GENERIC;
+
+#ifdef _DEBUG
+    DebugValidateALNDataInfo(pALN, pDataInfo, pCallbackInfo);
+#endif
+
+    memset(pReorderInfo, 0, sizeof(ALNREORDERINFO));
+    if (!NODE_ISMINMAX(pALN->pTree))
+        return ALN_NOERROR;
+
+    int nDim = pALN->nDim;
+    long nSamples = pDataInfo->nTRcurrSamples;
+    float* afltX = NULL;
+
+    try
+    {
+        afltX = new float[nDim];
+        if (!afltX) ThrowALNMemoryException();
+
+        CCountMap mapWins, mapRouted;
+        long long nLeafEvals = ProfilePass(pALN, pDataInfo, pCallbackInfo, afltX,
+            &mapWins, &mapRouted);
+        pReorderInfo->fltLeavesBefore = (float)nLeafEvals / nSamples;
+
+        ReorderChildren(pALN->pTree, nDim, mapWins, mapRouted, pReorderInfo);
+        RelayoutTree(pALN);
+
+#ifdef ALNSTATS
+        nLeafEvals = ProfilePass(pALN, pDataInfo, pCallbackInfo, afltX, NULL, NULL);
+        pReorderInfo->fltLeavesAfter = (float)nLeafEvals / nSamples;
+#endif
+    }
+    catch (CALNUserException* e)	  // user abort exception
+    {
+        nReturn = ALN_USERABORT;
+        e->Delete();
+    }
+    catch (CALNMemoryException* e)	// memory specific exceptions
+    {
+        nReturn = ALN_OUTOFMEM;
+        e->Delete();
+    }
+    catch (CALNException* e)	      // anything other exception we recognize
+    {
+        nReturn = ALN_GENERIC;
+        e->Delete();
+    }
+    catch (std::bad_alloc&)        // the profile maps
+    {
+        nReturn = ALN_OUTOFMEM;
+    }
+    catch (...)		                  // anything else, including FP errs
+    {
+        nReturn = ALN_GENERIC;
+    }
+
+    delete[] afltX;
+
+    return nReturn;
+}
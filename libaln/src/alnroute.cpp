@@ -0,0 +1,324 @@
+// ALN Library
+
+/* MIT License
+
+Copyright (c) 2020 William Ward Armstrong
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+
+// alnroute.cpp
+
+#ifdef ALNDLL
+#define ALNIMP __declspec(dllexport)
+#endif
+
+#include <aln.h>
+#include "alnpriv.h"
+#include <algorithm>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _DEBUG
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+// A minmax node with two children evaluates first the child on the side of the
+// hyperplane with the routing normal that afltX lies on.  The full dot product
+// costs as much as an LFN, so after each round of splits a routing test keeps
+// only the few inputs contributing most to it on the training samples of the
+// node, the dropped ones fixed at their mean there.  The fewest terms routing
+// nearly all those samples as the full normal does are kept; if none do, the
+// normal stays in use.  The samples of a node are those whose active LFN lies
+// below it, since the order matters most on the path to the active LFN.  The
+// order only affects how much the cutoffs prune, never the value.
+
+// a routing test keeps the fewest terms that route at least this fraction of
+// the samples of the node as the full normal does
+static const float fltRouteAgreement = 0.95f;
+
+// numbers of terms tried, fewest first
+static const int anRouteTerms[] = { 1, 2, 4, ALNROUTE_MAXTERMS };
+#define ROUTE_CANDIDATES ((int)(sizeof(anRouteTerms) / sizeof(anRouteTerms[0])))
+
+// what a node collects from its samples
+struct CRouteNode
+{
+    ALNNODE* pNode;
+    long nSamples;
+    std::vector<double> vecSum;     // sums of the inputs
+    std::vector<double> vecSumSq;   // sums of the squared inputs
+    int anOrder[ALNROUTE_MAXTERMS]; // inputs contributing most, first
+    int nNonZero;                   // nonzero components of the normal
+    int nCandidates;                // numbers of terms tried
+    float afltThreshold[ROUTE_CANDIDATES];
+    long anAgree[ROUTE_CANDIDATES];
+};
+
+typedef std::unordered_map<const ALNNODE*, CRouteNode*> CRouteMap;
+
+// helper: collects the minmax nodes with two children and a normal; any other
+// minmax node loses its routing test, which it does not use
+static void ALNAPI CollectRouteNodes(ALNNODE* pNode, std::vector<CRouteNode>& vecNodes)
+{
+    if (!NODE_ISMINMAX(pNode))
+        return;
+
+    if (MINMAX_NUMCHILDREN(pNode) == 2 && MINMAX_NORMAL(pNode) != NULL)
+    {
+        // a new routing test replaces the order ALNReorder left
+        pNode->fNode &= ~GF_STORED;
+        vecNodes.push_back(CRouteNode());
+        vecNodes.back().pNode = pNode;
+    }
+    else if (MINMAX_ROUTE(pNode) != NULL)
+    {
+        free(MINMAX_ROUTE(pNode));
+        MINMAX_ROUTE(pNode) = NULL;
+    }
+
+    for (int k = 0; k < MINMAX_NUMCHILDREN(pNode); k++)
+    {
+        CollectRouteNodes(MINMAX_CHILDREN(pNode)[k], vecNodes);
+    }
+}
+
+// helper: ranks the inputs of a node by how much their terms of the normal
+// vary over its samples, and sets the threshold of each candidate test
+static void ALNAPI RankTerms(CRouteNode& route, int nDim)
+{
+    const ALNNODE* pNode = route.pNode;
+    const float* afltN = MINMAX_NORMAL(pNode);
+    int nInputs = nDim - 1;
+
+    // the mean of the samples, or the centroid of the node without any
+    std::vector<double> vecMean(nInputs), vecKey(nInputs);
+    for (int i = 0; i < nInputs; i++)
+    {
+        double dblSpread = 1;
+        if (route.nSamples > 0)
+        {
+            vecMean[i] = route.vecSum[i] / route.nSamples;
+            double dblVar = route.vecSumSq[i] / route.nSamples - vecMean[i] * vecMean[i];
+            dblSpread = sqrt(max(dblVar, 0.0));
+        }
+        else
+        {
+            vecMean[i] = MINMAX_CENTROID(pNode)[i];
+        }
+        vecKey[i] = fabs(afltN[i]) * dblSpread;
+    }
+
+    // the greatest variation first, then the greatest weight; a zero component
+    // of the normal comes last and drops out without changing the test
+    std::vector<int> vecOrder(nInputs);
+    for (int i = 0; i < nInputs; i++)
+    {
+        vecOrder[i] = i;
+    }
+    int nRanked = min(nInputs, ALNROUTE_MAXTERMS);
+    std::partial_sort(vecOrder.begin(), vecOrder.begin() + nRanked, vecOrder.end(),
+        [&](int i, int j)
+        {
+            if (vecKey[i] != vecKey[j])
+                return vecKey[i] > vecKey[j];
+            return fabs(afltN[i]) > fabs(afltN[j]);
+        });
+
+    route.nNonZero = 0;
+    for (int i = 0; i < nInputs; i++)
+    {
+        if (afltN[i] != 0)
+            route.nNonZero++;
+    }
+    for (int k = 0; k < nRanked; k++)
+    {
+        route.anOrder[k] = vecOrder[k];
+    }
+
+    // a term of the test costs about twice one of the normal, which is read in
+    // order, so a test with more than half as many terms is not tried
+    route.nCandidates = 0;
+    while (route.nCandidates < ROUTE_CANDIDATES && 2 * anRouteTerms[route.nCandidates] <= nInputs)
+    {
+        route.nCandidates++;
+    }
+
+    // the dropped terms are fixed at their mean
+    double dblThreshold = MINMAX_THRESHOLD(pNode);
+    for (int i = 0; i < nInputs; i++)
+    {
+        dblThreshold += afltN[i] * vecMean[i];
+    }
+    int nKept = 0;
+    for (int c = 0; c < route.nCandidates; c++)
+    {
+        for (; nKept < anRouteTerms[c] && nKept < nRanked; nKept++)
+        {
+            int i = route.anOrder[nKept];
+            dblThreshold -= afltN[i] * vecMean[i];
+        }
+        route.afltThreshold[c] = (float)dblThreshold;
+        route.anAgree[c] = 0;
+    }
+}
+
+// helper: counts for each candidate test of the nodes above the active LFN of
+// a sample whether it routes the sample as the full normal does
+static void ALNAPI CountAgreement(const CRouteMap& mapNodes, const ALNNODE* pActiveLFN,
+    const float* afltX, int nDim)
+{
+    for (const ALNNODE* pNode = NODE_PARENT(pActiveLFN); pNode != NULL; pNode = NODE_PARENT(pNode))
+    {
+        CRouteMap::const_iterator it = mapNodes.find(pNode);
+        if (it == mapNodes.end())
+            continue;
+
+        CRouteNode& route = *it->second;
+        const float* afltN = MINMAX_NORMAL(pNode);
+        BOOL bRight = NormalRouteValue(pNode, afltX, nDim) > 0;
+        float flt = 0;
+        int nKept = 0;
+        for (int c = 0; c < route.nCandidates; c++)
+        {
+            for (; nKept < anRouteTerms[c] && nKept < route.nNonZero; nKept++)
+            {
+                int i = route.anOrder[nKept];
+                flt += afltN[i] * afltX[i];
+            }
+            if ((flt + route.afltThreshold[c] > 0) == bRight)
+                route.anAgree[c]++;
+        }
+    }
+}
+
+// helper: sets the routing test of a node to the first candidate routing
+// enough of its samples as the normal does, or to the normal itself
+static void ALNAPI SetRoute(const CRouteNode& route)
+{
+    ALNNODE* pNode = route.pNode;
+    if (MINMAX_ROUTE(pNode) == NULL)
+    {
+        MINMAX_ROUTE(pNode) = (ALNROUTE*)malloc(sizeof(ALNROUTE));
+        if (MINMAX_ROUTE(pNode) == NULL)
+            ThrowALNMemoryException();
+    }
+    ALNROUTE* pRoute = MINMAX_ROUTE(pNode);
+    memset(pRoute, 0, sizeof(ALNROUTE));
+    pRoute->nTerms = -1;
+    pRoute->fltAgreement = 1;
+
+    for (int c = 0; c < route.nCandidates; c++)
+    {
+        // without samples, only a test equal to the normal will do
+        BOOL bExact = route.nNonZero <= anRouteTerms[c];
+        float fltAgreement = bExact ? 1.0f : 0.0f;
+        if (route.nSamples > 0)
+            fltAgreement = (float)route.anAgree[c] / route.nSamples;
+        if (fltAgreement >= fltRouteAgreement || bExact)
+        {
+            pRoute->nTerms = min(anRouteTerms[c], route.nNonZero);
+            pRoute->fltThreshold = route.afltThreshold[c];
+            pRoute->fltAgreement = fltAgreement;
+            for (int k = 0; k < pRoute->nTerms; k++)
+            {
+                pRoute->anVar[k] = route.anOrder[k];
+                pRoute->afltW[k] = MINMAX_NORMAL(pNode)[route.anOrder[k]];
+            }
+            break;
+        }
+    }
+}
+
+// chooses the routing test of each minmax node with two children after doSplits
+// has set the normals; apActiveLFN holds the active LFN of each training sample
+// before the splits, throws CALNMemoryException*
+void ALNAPI UpdateRoutes(ALN* pALN, const ALNDATAINFO* pDataInfo,
+    ALNNODE* const* apActiveLFN)
+{
+    ASSERT(pALN && pALN->pTree);
+    ASSERT(pDataInfo && apActiveLFN);
+
+    int nDim = pALN->nDim;
+    int nDimm1 = nDim - 1;
+    long nrows = pDataInfo->nTRcurrSamples;
+
+    try
+    {
+        std::vector<CRouteNode> vecNodes;
+        CollectRouteNodes(pALN->pTree, vecNodes);
+        if (vecNodes.empty())
+            return;
+
+        std::vector<float> vecRow(nDim);    // a row, if in a store
+        CRouteMap mapNodes;
+        for (size_t n = 0; n < vecNodes.size(); n++)
+        {
+            CRouteNode& route = vecNodes[n];
+            route.nSamples = 0;
+            route.vecSum.assign(nDimm1, 0);
+            route.vecSumSq.assign(nDimm1, 0);
+            mapNodes[route.pNode] = &route;
+        }
+
+        // the mean and spread of the samples of each node, for ranking the terms
+        for (long i = 0; i < nrows; i++)
+        {
+            if (apActiveLFN[i] == NULL)
+                continue;
+
+            const float* afltX = GetTRRow(pDataInfo, i, nDim, vecRow.data());
+            for (const ALNNODE* pNode = NODE_PARENT(apActiveLFN[i]); pNode != NULL; pNode = NODE_PARENT(pNode))
+            {
+                CRouteMap::iterator it = mapNodes.find(pNode);
+                if (it == mapNodes.end())
+                    continue;
+
+                CRouteNode& route = *it->second;
+                route.nSamples++;
+                for (int j = 0; j < nDimm1; j++)
+                {
+                    route.vecSum[j] += afltX[j];
+                    route.vecSumSq[j] += (double)afltX[j] * afltX[j];
+                }
+            }
+        }
+        for (size_t n = 0; n < vecNodes.size(); n++)
+        {
+            RankTerms(vecNodes[n], nDim);
+        }
+
+        // how well each candidate agrees with the normal
+        for (long i = 0; i < nrows; i++)
+        {
+            if (apActiveLFN[i] != NULL)
+                CountAgreement(mapNodes, apActiveLFN[i], GetTRRow(pDataInfo, i, nDim, vecRow.data()), nDim);
+        }
+        for (size_t n = 0; n < vecNodes.size(); n++)
+        {
+            SetRoute(vecNodes[n]);
+        }
+    }
+    catch (std::bad_alloc&)
+    {
+        ThrowALNMemoryException();
+    }
+}
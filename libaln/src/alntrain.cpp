@@ -34,6 +34,7 @@ SOFTWARE. */
 #include "alnpriv.h"
 #include "alnpp.h"
 #include ".\cmyaln.h"
+#include <xmmintrin.h>
 
 #ifdef _DEBUG
 #undef THIS_FILE
@@ -41,13 +42,74 @@ static char THIS_FILE[] = __FILE__;
 #endif
 
 // Helper declarations relating to ALN tree growth
-void splitControl(ALN*, ALNDATAINFO*); // This does a test to see if a piece fits well or must be split.
+void splitControl(ALN*, ALNDATAINFO*, ALNTRAINCONTEXT*, PHASETIMES*); // This does a test to see if a piece fits well or must be split.
 extern BOOL bALNgrowable = TRUE; //If FALSE, no splitting happens, e.g. for linear regression.
 BOOL bStopTraining = FALSE; // This causes training to stop when all leaf nodes have stopped splitting. This means all linear regression resultss will not change.
-extern BOOL bDistanceOptimization; // This prevents considering leaf nodes so far away from the current input sample that they must be cut off in the max-min structure.
-extern BOOL bClassify2; // We don't want to do weight decay if this is not a classification problem
-extern float WeightBound; // This is a maximum and minimum bound on weights.
-extern float WeightDecay; //  This is a factor close to 1.0. It is used during classification into two classes when lower weights give better generalization.
+// The other growth settings (weight decay and bound, distance optimization, splits allowed)
+// are globals of the application, or the ALN's own ALNTRAINCONTEXT, see alncontext.cpp
+
+// samples ahead of the one training whose rows are prefetched; about the
+// time a row takes to arrive from memory over the time a sample takes
+#define ALNPREFETCHAHEAD 4
+
+// The adaptive schedule, used when the training context has fltSettle > 0,
+// watches two things over the epochs: the estimated RMS error and how far
+// the LFN weights move in an epoch.  While either falls by more than
+// fltSettle of its value in the epoch before, the pieces are still fitting;
+// once neither does they have settled, and more epochs would only move them
+// about the same place.  The split is then made at once rather than at the
+// middle epoch, and after it the call ends as soon as the pieces, old and
+// new, settle again.  With nSplitsPerRound > 0 the splits come in smaller
+// rounds instead, one each time the pieces settle, until a round splits
+// nothing.
+
+// appends the weights of the LFNs below pNode to vecW
+static void GetLFNWeights(const ALNNODE* pNode, std::vector<float>& vecW)
+{
+    if (NODE_ISLFN(pNode))
+    {
+        vecW.insert(vecW.end(), LFN_W(pNode), LFN_W(pNode) + LFN_WDIM(pNode));
+        return;
+    }
+    for (int i = 0; i < MINMAX_NUMCHILDREN(pNode); i++)
+    {
+        GetLFNWeights(MINMAX_CHILDREN(pNode)[i], vecW);
+    }
+}
+
+// mean absolute change of the LFN weights since vecStart, which becomes the
+// weights now; the tree must not have changed in between
+static float LFNMovement(const ALNNODE* pTree, std::vector<float>& vecStart,
+    std::vector<float>& vecNow)
+{
+    vecNow.clear();
+    GetLFNWeights(pTree, vecNow);
+    ASSERT(vecNow.size() == vecStart.size());
+    double dblSum = 0;
+    for (size_t i = 0; i < vecNow.size(); i++)
+        dblSum += fabs(vecNow[i] - vecStart[i]);
+    vecStart.swap(vecNow);
+    return vecStart.empty() ? 0 : (float)(dblSum / vecStart.size());
+}
+
+// prefetches the part of a training buffer row FillInputVector reads
+static inline void PrefetchRow(const ALNDATAINFO* pDataInfo, int nDim, long nSample)
+{
+    if (pDataInfo->pvTRstore != NULL)
+    {
+        PrefetchTRStoreRow(pDataInfo->pvTRstore, nSample);
+        return;
+    }
+    if (pDataInfo->afltTRdata == NULL)
+        return;
+    const char* pRow = (const char*)(pDataInfo->afltTRdata + (size_t)nSample * pDataInfo->nTRcols);
+    const char* pRowEnd = pRow + nDim * sizeof(float);
+    for (const char* p = pRow; p < pRowEnd; p += 64)
+        _mm_prefetch(p, _MM_HINT_T0);
+    _mm_prefetch(pRowEnd - 1, _MM_HINT_T0);
+    if (pDataInfo->afltTRlabels != NULL)
+        _mm_prefetch((const char*)(pDataInfo->afltTRlabels + 2 * nSample), _MM_HINT_T0);
+}
 
 
 // Train calls ALNTrain, which expects data in a monolithic array, row major order, ie,
@@ -86,7 +148,8 @@ static int ALNAPI DoTrainALN(ALN* pALN,
     int nMaxEpochs,
     float fltMinRMSErr,
     float fltLearnRate,
-    BOOL bJitter);
+    BOOL bJitter,
+    ALNTRAINCONTEXT& context);
 
 
 
@@ -106,9 +169,13 @@ ALNIMP int ALNAPI ALNTrain(ALN* pALN,
         // train if the ALN is successfully prepped
         if (PrepALN(pALN))
         {
+            // the settings are fixed for the call; the split count and stop
+            // flag go back to where they came from after each split
+            ALNTRAINCONTEXT context;
+            ALNGetTrainContext(pALN, &context);
             nReturn = DoTrainALN(pALN, pDataInfo, pCallbackInfo,
                 nMaxEpochs, fltMinRMSErr, fltLearnRate,
-                bJitter);
+                bJitter, context);
         }
         else
         {
@@ -119,6 +186,38 @@ ALNIMP int ALNAPI ALNTrain(ALN* pALN,
 }
 
 
+// helper: a call to train a settled ALN does nothing, but it still starts
+// and ends for the callback
+static int ALNAPI NotifySettled(ALN* pALN, ALNNOTIFYPROC pfnNotifyProc,
+    int nNotifyMask, void* pvData)
+{
+    TRAININFO traininfo;
+    traininfo.nEpochs = 0;
+    traininfo.nLFNs = 0;
+    traininfo.nActiveLFNs = 0;
+    traininfo.fltRMSErr = 0.0;
+    CountLFNs(pALN->pTree, traininfo.nLFNs, traininfo.nActiveLFNs);
+
+    try
+    {
+        if (CanCallback(AN_TRAINSTART, pfnNotifyProc, nNotifyMask))
+        {
+            TRAININFO ti(traininfo);  // make copy to send!
+            Callback(pALN, AN_TRAINSTART, &ti, pfnNotifyProc, pvData);
+        }
+        if (CanCallback(AN_TRAINEND, pfnNotifyProc, nNotifyMask))
+        {
+            Callback(pALN, AN_TRAINEND, &traininfo, pfnNotifyProc, pvData);
+        }
+    }
+    catch (CALNUserException* e)	  // user abort exception
+    {
+        e->Delete();
+        return ALN_USERABORT;
+    }
+    return ALN_NOERROR;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // workhorse of TrainALN 
 static int ALNAPI DoTrainALN(ALN* pALN,
@@ -127,7 +226,8 @@ static int ALNAPI DoTrainALN(ALN* pALN,
     int nMaxEpochs,
     float fltMinRMSErr,
     float fltLearnRate,
-    BOOL bJitter)
+    BOOL bJitter,
+    ALNTRAINCONTEXT& context)
 {
     //#ifdef _DEBUG
     // DebugValidateALNTrainInfo(pALN, pDataInfo, pCallbackInfo, nMaxEpochs, 
@@ -145,6 +245,7 @@ static int ALNAPI DoTrainALN(ALN* pALN,
     TRAININFO traininfo;					    // training info
     EPOCHINFO epochinfo;					    // epoch info
     TRAINDATA traindata;              // training data
+    PHASETIMES phasetimes;            // time spent in each phase of an epoch
 
     int nNotifyMask = (pCallbackInfo == NULL) ? AN_NONE : pCallbackInfo->nNotifyMask;
     void* pvData = (pCallbackInfo == NULL) ? NULL : pCallbackInfo->pvData;
@@ -155,6 +256,27 @@ static int ALNAPI DoTrainALN(ALN* pALN,
     traindata.nNotifyMask = nNotifyMask;
     traindata.pvData = pvData;
     traindata.pfnNotifyProc = pfnNotifyProc;
+    traindata.bLearnFactors = context.bLearnFactors;
+
+    // phases are timed only when someone looks at the times
+    BOOL bTimed = CanCallback(AN_PHASETIMES, pfnNotifyProc, nNotifyMask) || IsTraceOpen();
+    CPhaseClock clock(bTimed);
+
+    // an adaptive run which ended settled, with no piece needing to split,
+    // would only be repeated until samples are added to the buffer or the
+    // error target changes; samples arriving by a queue can change it in any
+    // epoch
+    if (context.fltSettle > 0 && context.bStopTraining && pDataInfo->pvTRqueue == NULL)
+    {
+        if (pDataInfo->nTRcurrSamples == context.nSettledSamples &&
+            pDataInfo->nTRinsert == context.nSettledInsert &&
+            pDataInfo->fltMSEorF == context.fltSettledMSEorF)
+        {
+            return NotifySettled(pALN, pfnNotifyProc, nNotifyMask, pvData);
+        }
+        context.bStopTraining = FALSE;
+        UpdateTrainContext(pALN, context);
+    }
 
     // calc start and end points of training
     long nStart, nEnd;
@@ -169,19 +291,30 @@ static int ALNAPI DoTrainALN(ALN* pALN,
         if (!afltX) ThrowALNMemoryException();
         memset(afltX, 0, sizeof(float) * nDim); // this has space for all the inputs and the output value
 
-        // allocate and init shuffle array
-        anShuffle = new long[nEnd - nStart + 1L];
+        // samples queued during training join the buffer at the start of
+        // an epoch, so the arrays have room for all the buffer can hold
+        void* pvQueue = pDataInfo->pvTRqueue;
+        long nRows = nEnd - nStart + 1L;
+        if (pvQueue != NULL)
+            nRows = max(nRows, pDataInfo->nTRmaxSamples);
+
+        // allocate shuffle array, filled by Shuffle each epoch
+        anShuffle = new long[nRows];
         if (!anShuffle) ThrowALNMemoryException();
-        for (long i = nStart; i <= nEnd; i++)
-            anShuffle[i - nStart] = i - nStart;
+
+        // a buffer mapped from a file is ordered by its chunks
+        long nChunkRows = 0, nWindowChunks = 0;
+        BOOL bMapped = (pDataInfo->pvTRstore != NULL &&
+            GetTRStoreChunks(pDataInfo->pvTRstore, &nChunkRows, &nWindowChunks));
+        CTRResidency residency;
 
         // allocate and init cutoff info array
         // pLFN will contain a pointer to the active LFN of a piece
         // when the input is on that piece.  It will speed up cutoffs in evaluation.
-        aCutoffInfo = new CCutoffInfo[nEnd - nStart + 1L];
+        aCutoffInfo = new CCutoffInfo[nRows];
         if (!aCutoffInfo) ThrowALNMemoryException();
-        for (int i = nStart; i <= nEnd; i++)
-            aCutoffInfo[i - nStart].pLFN = NULL;
+        for (long i = 0; i < nRows; i++)
+            aCutoffInfo[i].pLFN = NULL;
         // count total number of LFNs in ALN
         int nLFNs = 0;
         int nAdaptedLFNs = 0;
@@ -197,6 +330,7 @@ static int ALNAPI DoTrainALN(ALN* pALN,
         epochinfo.nLFNs = nLFNs;
         epochinfo.nActiveLFNs = nAdaptedLFNs;
         epochinfo.fltEstRMSErr = 0.0;
+        epochinfo.pEvalStats = NULL;
 
         // notify beginning of training
         if (CanCallback(AN_TRAINSTART, pfnNotifyProc, nNotifyMask))
@@ -205,6 +339,17 @@ static int ALNAPI DoTrainALN(ALN* pALN,
             Callback(pALN, AN_TRAINSTART, &ti, pfnNotifyProc, pvData);
         }
 
+        // adaptive schedule: the epochs adapted since the start or the last
+        // split which changed the tree, and the error and movement of the
+        // epoch before
+        BOOL bAdaptive = (context.fltSettle > 0);
+        BOOL bRounds = (bAdaptive && context.nSplitsPerRound > 0);  // a split round each time they settle
+        BOOL bSplitDone = FALSE;
+        BOOL bSettled = FALSE;
+        int nPhaseEpochs = 0;
+        float fltLastRMSErr = 0, fltLastMovement = 0;
+        std::vector<float> vecWeights, vecWeightsNow;
+
         ///// begin epoch loop
         // We reset counters for splitting when adaptation has had a chance to adjust pieces very
         // closely to the training samples, e.g. the limited number of pieces fits well.
@@ -212,8 +357,15 @@ static int ALNAPI DoTrainALN(ALN* pALN,
         // We must set nMaxEpochs considering epochsize, learning rate,  prescribed RMS error, etc.
         for (int nEpoch = 0; nEpoch < nMaxEpochs; nEpoch++)
         {
-            if (nEpoch == nMaxEpochs / 2) bDistanceOptimization = FALSE; // MYTEST Turn optimization off until the end of the splitting epoch; see if necessary later MYTEST
             int nCutoffs = 0;
+            memset(&phasetimes, 0, sizeof(PHASETIMES));
+            phasetimes.nEpoch = nEpoch;
+            clock.Start();
+            std::chrono::steady_clock::time_point timeEpochStart = clock.timeLast;
+#ifdef ALNSTATS
+            ALNEVALSTATS statsEpochStart;
+            MarkEvalStats(statsEpochStart);
+#endif
             // notify beginning of epoch
             epochinfo.nEpoch = nEpoch;
             if (CanCallback(AN_EPOCHSTART, pfnNotifyProc, nNotifyMask))
@@ -222,11 +374,41 @@ static int ALNAPI DoTrainALN(ALN* pALN,
                 Callback(pALN, AN_EPOCHSTART, &ei, pfnNotifyProc, pvData);
             }
 
+            // the samples queued since the last epoch are added, and the
+            // epoch trains on the buffer as it is then
+            if (pvQueue != NULL)
+            {
+                if (DrainTRQueue(pvQueue, pDataInfo, nDim) < 0)
+                    ThrowALNException();
+                nTRcurrSamples = pDataInfo->nTRcurrSamples;
+                nEnd = nTRcurrSamples - 1;
+            }
+
             // track squared error
             float fltSqErrorSum = 0;
 
+            if (bAdaptive)
+            {
+                vecWeights.clear();
+                GetLFNWeights(pALN->pTree, vecWeights);
+            }
+
             // We prepare a random reordering of the training data for the next epoch
-            Shuffle(nStart, nEnd, anShuffle);
+            // The shuffle and the jitter of the epoch are drawn from streams of a key
+            // taken from the sequence of this thread
+            unsigned long long nEpochKey = RandKey();
+            clock.Start();
+            if (bMapped)
+            {
+                Shuffle(nStart, nEnd, anShuffle, nEpochKey, nChunkRows, nWindowChunks);
+                StartTRResidency(residency, pDataInfo->pvTRstore, anShuffle, nEnd - nStart + 1);
+            }
+            else
+            {
+                Shuffle(nStart, nEnd, anShuffle, nEpochKey, context.nShuffleBlock);
+            }
+            clock.Lap(phasetimes.dblShuffle, "Shuffle");
+            std::chrono::steady_clock::time_point timeSamplesStart = clock.timeLast;
 
             long nSample; // The number of training samples may be huge.
                 // this does all the samples in an epoch in a randomized order.
@@ -235,7 +417,15 @@ static int ALNAPI DoTrainALN(ALN* pALN,
             {
                 long nTrainSample = anShuffle[nSample - nStart]; // A sample is picked for training
                 ASSERT((nTrainSample + nStart) <= nEnd);
+                clock.Start();
+
+                // the chunks of a mapped buffer are read a window ahead
+                if (bMapped)
+                    AdvanceTRResidency(residency, anShuffle, nEnd - nStart + 1, nSample - nStart);
 
+                // the row of a sample a few ahead is fetched while this one trains
+                if (nSample + ALNPREFETCHAHEAD <= nEnd)
+                    PrefetchRow(pDataInfo, nDim, anShuffle[nSample + ALNPREFETCHAHEAD - nStart]);
 
                 // fill input vector
                 FillInputVector(pALN, afltX, nTrainSample, nStart, pDataInfo, pCallbackInfo);
@@ -246,7 +436,8 @@ static int ALNAPI DoTrainALN(ALN* pALN,
 
 
                 // jitter the data point
-                if (bJitter) Jitter(pALN, afltX);
+                if (bJitter) Jitter(pALN, afltX, nEpochKey, nTrainSample);
+                clock.Lap(phasetimes.dblFillInput);
 
                 // do an adapt eval to get active LFN and distance, and to prepare
                 // tree for adaptation
@@ -260,6 +451,7 @@ static int ALNAPI DoTrainALN(ALN* pALN,
                 // END MYTEST
 
                 float flt = AdaptEval(pTree, pALN, afltX, &cutoffinfo, &pActiveLFN);
+                clock.Lap(phasetimes.dblAdaptEval);
 
                 // track squared error before adapt, since adapt routines
                 // do not relcalculate value of adapted surface
@@ -277,7 +469,9 @@ static int ALNAPI DoTrainALN(ALN* pALN,
 
                 // do a useful adapt to correct any error
                 traindata.fltGlobalError = flt;
+                clock.Start();
                 if (nEpoch > 0) Adapt(pTree, pALN, afltX, 1.0, TRUE, &traindata);// we should not adapt in the epoch when counting hits!!
+                clock.Lap(phasetimes.dblAdapt);
                 // notify end of adapt
                 if (CanCallback(AN_ADAPTEND, pfnNotifyProc, nNotifyMask))
                 {
@@ -288,23 +482,67 @@ static int ALNAPI DoTrainALN(ALN* pALN,
                     Callback(pALN, AN_ADAPTEND, &adaptinfo, pfnNotifyProc, pvData);
                 }
             }	// end for each point in data set
-            if (bClassify2 && WeightDecay != 1.0F)
+            clock.Start();
+            if (bTimed && IsTraceOpen())
+            {
+                char szArgs[200];
+                sprintf(szArgs, "{\"FillInput ms\":%.3f,\"AdaptEval ms\":%.3f,\"Adapt ms\":%.3f}",
+                    phasetimes.dblFillInput * 1000, phasetimes.dblAdaptEval * 1000, phasetimes.dblAdapt * 1000);
+                TraceEvent("Samples", timeSamplesStart, clock.timeLast, szArgs);
+            }
+
+            if (context.bClassify2 && context.fltWeightDecay != 1.0F)
             {
-                DecayWeights(pTree, pALN, WeightBound, WeightDecay); //We decay weights only when there are a few samples on the piece at the end of training
+                DecayWeights(pTree, pALN, context.fltWeightBound, context.fltWeightDecay); //We decay weights only when there are a few samples on the piece at the end of training
+                clock.Lap(phasetimes.dblDecayWeights, "DecayWeights");
             }
 
+            // the pieces set their learning rate factors from this epoch
+            if (context.bLearnFactors)
+                UpdateLearnFactors(pTree);
+
+            // the adapts of the epoch invalidated the bounds above the LFNs;
+            // recomputing them over the boxes there is no pass over the data,
+            // and keeps the distance cutoffs working until the next epoch
+            if (context.bDistanceOptimization)
+                RefreshBounds(pALN);
+
             // estimate RMS error on training set for this epoch
             epochinfo.fltEstRMSErr = sqrt(fltSqErrorSum / nTRcurrSamples);
 
             // calc true RMS if estimate below min, or if last epoch, or every 10 epochs when jittering
+            BOOL bMinRMSErr = FALSE;
             if (epochinfo.fltEstRMSErr <= fltMinRMSErr || nEpoch == nMaxEpochs)
             {
+                clock.Start();
                 epochinfo.fltEstRMSErr = DoCalcRMSError(pALN, pDataInfo, pCallbackInfo);
+                clock.Lap(phasetimes.dblCalcRMSError, "CalcRMSError");
+                bMinRMSErr = (epochinfo.fltEstRMSErr <= fltMinRMSErr);
+            }
+
+            // the first epoch only counts hits, so the schedule starts with
+            // the second
+            BOOL bLastEpoch = (nEpoch == nMaxEpochs - 1);
+            bSettled = FALSE;
+            if (bAdaptive && nEpoch > 0)
+            {
+                float fltMovement = LFNMovement(pALN->pTree, vecWeights, vecWeightsNow);
+                if (++nPhaseEpochs > 1)
+                {
+                    bSettled = (fltLastRMSErr - epochinfo.fltEstRMSErr <= context.fltSettle * fltLastRMSErr &&
+                        fltLastMovement - fltMovement <= context.fltSettle * fltLastMovement);
+                }
+                fltLastRMSErr = epochinfo.fltEstRMSErr;
+                fltLastMovement = fltMovement;
+                if ((bSplitDone && bSettled && (!bRounds || context.bStopTraining)) || bMinRMSErr)
+                    bLastEpoch = TRUE;
             }
 
             // notify end of epoch
             nLFNs = nAdaptedLFNs = 0;
+            clock.Start();
             CountLFNs(pALN->pTree, nLFNs, nAdaptedLFNs);
+            clock.Lap(phasetimes.dblCountLFNs, "CountLFNs");
             epochinfo.nLFNs = nLFNs;
             epochinfo.nActiveLFNs = nAdaptedLFNs;
 
@@ -314,21 +552,81 @@ static int ALNAPI DoTrainALN(ALN* pALN,
             traininfo.nActiveLFNs = epochinfo.nActiveLFNs;
             traininfo.fltRMSErr = epochinfo.fltEstRMSErr;	// used to terminate epoch loop
 
-            if (nEpoch == nMaxEpochs - 1 && CanCallback(AN_EPOCHEND, pfnNotifyProc, nNotifyMask))
+            // the weights adapted this epoch make cached results stale
+            NewGeneration(pALN);
+
+#ifdef ALNSTATS
+            ALNEVALSTATS statsEpoch;
+            GetEvalStatsSinceMark(statsEpochStart, statsEpoch);
+#endif
+            if (bLastEpoch && CanCallback(AN_EPOCHEND, pfnNotifyProc, nNotifyMask))
             {
                 EPOCHINFO ei(epochinfo);  // make copy to send!
+#ifdef ALNSTATS
+                ei.pEvalStats = &statsEpoch;
+#endif
                 Callback(pALN, AN_EPOCHEND, &ei, pfnNotifyProc, pvData);
             }
 
-            // Split candidate LFNs in a middle epoch in this call to ALNTrain.
-            if (nEpoch == nMaxEpochs / 2)
+            // Split candidate LFNs in a middle epoch in this call to ALNTrain,
+            // or as soon as the pieces settle in the adaptive schedule.
+            if (bAdaptive ? (!bMinRMSErr && ((bSettled && (!bSplitDone || (bRounds && !bLastEpoch))) ||
+                (!bSplitDone && nEpoch >= nMaxEpochs / 2)))
+                : (nEpoch == nMaxEpochs / 2))
             {
-                bStopTraining = TRUE;  // this will be set to FALSE by any leaf node needing further training after splitControl()
-                splitControl(pALN, pDataInfo);  // This leads to leaf nodes splitting
-                bDistanceOptimization = TRUE;
+                context.bStopTraining = TRUE;  // this will be set to FALSE by any leaf node needing further training after splitControl()
+                splitControl(pALN, pDataInfo, &context, bTimed ? &phasetimes : NULL);  // This leads to leaf nodes splitting
+                UpdateTrainContext(pALN, context);
+                bSplitDone = TRUE;
+
+                // new pieces start a new phase; if none split, the pieces
+                // stay settled and the next epoch can end the call
+                if (!context.bStopTraining)
+                    nPhaseEpochs = 0;
+            }
+
+            // report the phase times of the epoch
+            if (bTimed)
+            {
+                clock.Start();
+                phasetimes.dblEpoch = std::chrono::duration<double>(clock.timeLast - timeEpochStart).count();
+                if (IsTraceOpen())
+                {
+                    char szArgs[40];
+                    sprintf(szArgs, "{\"epoch\":%d}", nEpoch);
+                    TraceEvent("Epoch", timeEpochStart, clock.timeLast, szArgs);
+                }
+                if (CanCallback(AN_PHASETIMES, pfnNotifyProc, nNotifyMask))
+                {
+                    PHASETIMES pt(phasetimes);  // make copy to send!
+                    Callback(pALN, AN_PHASETIMES, &pt, pfnNotifyProc, pvData);
+                }
             }
+
+            if (bAdaptive && bLastEpoch)
+                break;
         } // end epoch loop
 
+        // a run which stopped before the pieces settled has more to do;
+        // one which settled keeps the buffer it settled on
+        if (bAdaptive && context.bStopTraining && !bSettled)
+        {
+            context.bStopTraining = FALSE;
+            UpdateTrainContext(pALN, context);
+        }
+        else if (bAdaptive && context.bStopTraining)
+        {
+            context.nSettledSamples = pDataInfo->nTRcurrSamples;
+            context.nSettledInsert = pDataInfo->nTRinsert;
+            context.fltSettledMSEorF = pDataInfo->fltMSEorF;
+            UpdateTrainContext(pALN, context);
+        }
+
+        // fit the boxes to the samples the subtrees are now responsible for;
+        // a pass over the data, so once at the end and only when switched on
+        if (context.bDistanceOptimization)
+            UpdateBounds(pALN, pDataInfo, pCallbackInfo);
+
         // notify end of training
 
         if (CanCallback(AN_TRAINEND, pfnNotifyProc, nNotifyMask))
@@ -0,0 +1,236 @@
+// ALN Library
+
+/* MIT License
+
+Copyright (c) 2020 William Ward Armstrong
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+
+// alntrqueue.cpp
+
+#ifdef ALNDLL
+#define ALNIMP __declspec(dllexport)
+#endif
+
+#include <aln.h>
+#include "alnpriv.h"
+#include <atomic>
+#include <vector>
+
+#ifdef _DEBUG
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+// Adding a sample to the training buffer updates the closest samples of the
+// rows, which training reads, so samples cannot be added during an epoch.
+// Instead producers push samples into a queue, and the trainer moves them
+// into the buffer at the start of each epoch; an epoch then trains on the
+// rows and the number of samples it started with.
+//
+// The queue is a bounded ring of slots, each with a sequence number
+// (Vyukov).  A producer claims a position with a compare and swap of the
+// enqueue counter when the sequence of its slot says the slot is free,
+// writes the sample and publishes it by setting the sequence to the position
+// plus one.  The one consumer reads the slots in order, up to the position
+// claimed last when it starts, and frees a slot by setting its sequence to
+// the position of the next lap.  No thread waits for another: a full queue
+// refuses the sample, and a slot still being written ends the drain until the
+// next one.
+
+// a cache line between the counters of the producers and the consumer
+#define TRQUEUEPAD 64
+
+struct CTRQueue
+{
+    int nDim;
+    unsigned long long nCapacity;   // a power of 2
+    unsigned long long nMask;
+    std::atomic<unsigned long long>* anSequence;
+    float* afltSlots;               // nDim floats per slot
+
+    char acPad0[TRQUEUEPAD];
+    std::atomic<unsigned long long> nEnqueue;
+    char acPad1[TRQUEUEPAD];
+
+    // only touched by the consumer
+    unsigned long long nDequeue;
+    std::vector<float> vecSample;
+
+    CTRQueue()
+        : nEnqueue(0)
+    {
+        nDim = 0;
+        nCapacity = nMask = 0;
+        anSequence = NULL;
+        afltSlots = NULL;
+        nDequeue = 0;
+    }
+
+    ~CTRQueue()
+    {
+        delete[] anSequence;
+        delete[] afltSlots;
+    }
+};
+
+// takes the oldest sample into afltX, FALSE if there is none ready
+static BOOL ALNAPI PopTRSample(CTRQueue* pQueue, float* afltX)
+{
+    unsigned long long nPos = pQueue->nDequeue;
+    std::atomic<unsigned long long>& nSequence = pQueue->anSequence[nPos & pQueue->nMask];
+    if (nSequence.load(std::memory_order_acquire) != nPos + 1)
+        return FALSE;
+
+    memcpy(afltX, pQueue->afltSlots + (size_t)(nPos & pQueue->nMask) * pQueue->nDim,
+        pQueue->nDim * sizeof(float));
+    nSequence.store(nPos + pQueue->nCapacity, std::memory_order_release);
+    pQueue->nDequeue = nPos + 1;
+    return TRUE;
+}
+
+long ALNAPI DrainTRQueue(void* pvQueue, ALNDATAINFO* pDataInfo, int nDim)
+{
+    ASSERT(pvQueue && pDataInfo);
+    CTRQueue* pQueue = (CTRQueue*)pvQueue;
+
+    // samples go into rows of floats in memory, laid out either way, and
+    // labels of other rows would not match them
+    if (pQueue->nDim != nDim || pDataInfo->nTRmaxSamples <= 0 ||
+        pDataInfo->pvTRstore != NULL || pDataInfo->afltTRlabels != NULL ||
+        pDataInfo->nTRcols != (IsCompactTRBuffer(pDataInfo) ? nDim + 2 : 2 * nDim + 1))
+    {
+        return -1;
+    }
+
+    // a pending checkpoint must not see the buffer change
+    if (pDataInfo->afltTRdata != NULL && DetachCheckpoints(pDataInfo) != ALN_NOERROR)
+        return -1;
+
+    // only the samples claimed before the drain began, so producers which
+    // keep up with it cannot keep it going
+    unsigned long long nLast = pQueue->nEnqueue.load(std::memory_order_relaxed);
+    float* afltX = pQueue->vecSample.data();
+    long nDrained = 0;
+    while (pQueue->nDequeue != nLast && PopTRSample(pQueue, afltX))
+    {
+        AddTRSample(pDataInfo, afltX, nDim);
+        nDrained++;
+    }
+    return nDrained;
+}
+
+ALNIMP int ALNAPI ALNCreateTRQueue(int nDim, long nCapacity, void** ppvQueue)
+{
+    // parameter variance
+    if (nDim < 1 || nCapacity <= 0 || ppvQueue == NULL)
+        return ALN_GENERIC;
+
+    *ppvQueue = NULL;
+
+    unsigned long long nSlots = 1;
+    while (nSlots < (unsigned long long)nCapacity)
+        nSlots <<= 1;
+
+    CTRQueue* pQueue = NULL;
+    int nReturn = ALN_NOERROR;
+    try
+    {
+        pQueue = new CTRQueue;
+        pQueue->nDim = nDim;
+        pQueue->nCapacity = nSlots;
+        pQueue->nMask = nSlots - 1;
+        pQueue->anSequence = new std::atomic<unsigned long long>[(size_t)nSlots];
+        pQueue->afltSlots = new float[(size_t)nSlots * nDim];
+        pQueue->vecSample.resize(nDim);
+        for (unsigned long long i = 0; i < nSlots; i++)
+        {
+            pQueue->anSequence[i].store(i, std::memory_order_relaxed);
+        }
+
+        *ppvQueue = pQueue;
+    }
+    catch (...)
+    {
+        nReturn = ALN_OUTOFMEM;
+        delete pQueue;
+    }
+
+    return nReturn;
+}
+
+ALNIMP int ALNAPI ALNPushTRSample(void* pvQueue, const float* afltX)
+{
+    if (pvQueue == NULL || afltX == NULL)
+        return ALN_GENERIC;
+
+    CTRQueue* pQueue = (CTRQueue*)pvQueue;
+    unsigned long long nPos = pQueue->nEnqueue.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        std::atomic<unsigned long long>& nSequence = pQueue->anSequence[nPos & pQueue->nMask];
+        long long nDiff = (long long)(nSequence.load(std::memory_order_acquire) - nPos);
+        if (nDiff == 0)
+        {
+            // the slot is free on this lap; claim the position
+            if (pQueue->nEnqueue.compare_exchange_weak(nPos, nPos + 1, std::memory_order_relaxed))
+            {
+                memcpy(pQueue->afltSlots + (size_t)(nPos & pQueue->nMask) * pQueue->nDim,
+                    afltX, pQueue->nDim * sizeof(float));
+                nSequence.store(nPos + 1, std::memory_order_release);
+                return ALN_NOERROR;
+            }
+            // nPos now holds the position another producer left
+        }
+        else if (nDiff < 0)
+        {
+            // the consumer has not freed the slot of the last lap: full
+            return ALN_GENERIC;
+        }
+        else
+        {
+            nPos = pQueue->nEnqueue.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+ALNIMP int ALNAPI ALNDrainTRQueue(void* pvQueue, ALNDATAINFO* pDataInfo, int nDim,
+    long* pnDrained)
+{
+    if (pvQueue == NULL || pDataInfo == NULL)
+        return ALN_GENERIC;
+
+    long nDrained = DrainTRQueue(pvQueue, pDataInfo, nDim);
+    if (nDrained < 0)
+        return ALN_GENERIC;
+
+    if (pnDrained != NULL)
+        *pnDrained = nDrained;
+    return ALN_NOERROR;
+}
+
+ALNIMP int ALNAPI ALNDestroyTRQueue(void* pvQueue)
+{
+    if (pvQueue == NULL)
+        return ALN_GENERIC;
+
+    delete (CTRQueue*)pvQueue;
+    return ALN_NOERROR;
+}
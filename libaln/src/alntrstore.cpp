@@ -0,0 +1,808 @@
+// ALN Library
+
+/* MIT License
+
+Copyright (c) 2020 William Ward Armstrong
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+// alntrstore.cpp
+
+#ifdef ALNDLL
+#define ALNIMP __declspec(dllexport)
+#endif
+
+#include <aln.h>
+#include "alnpriv.h"
+#include <algorithm>
+#include <vector>
+
+// SSE2 is part of every x64 target, and of x86 targets built for it; other
+// targets dequantise with the scalar loops alone
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ALNTRSTORE_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef _WIN32
+#define WIN32_EXTRA_LEAN
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _DEBUG
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+// A training buffer of floats is four times the size of the data when the
+// data are bytes, eg. the pixels of images, and an epoch over a large buffer
+// takes as long as it takes to read it from memory.  A store holds the rows
+// of a buffer with a type for each column: u8 or i16, the value being
+// fltOffset + fltScale * k, fp16 or f32.  The type of a column is the
+// smallest that holds all its values exactly, unless the caller chooses.
+// Rows keep their columns in order, so the columns of a run of one type are
+// contiguous and dequantised together, 16 or 8 at a time for u8 and i16.
+//
+// A store may instead map a file of f32 rows, for a buffer larger than
+// memory.  The epochs of a mapped store visit its chunks of nChunkRows rows
+// in random order, nWindowChunks at a time with the rows of those chunks in
+// random order (see Shuffle), so the file is read a chunk at a time.  The
+// training loop tells the system which chunks it will need next and which
+// it is done with (see CTRResidency).
+
+struct CTRRun
+{
+    int nType;
+    int nFirstCol;
+    int nCols;
+    size_t nByte;                   // offset of the first column in a row
+};
+
+struct CTRStore
+{
+    int nCols;
+    long nRows;
+    size_t nRowBytes;
+    std::vector<int> vecType;
+    std::vector<float> vecScale;
+    std::vector<float> vecOffset;
+    std::vector<CTRRun> vecRuns;
+    std::vector<unsigned char> vecRows;
+    const unsigned char* pRows;     // vecRows, or the mapped file
+
+    // mapped file
+    long nChunkRows;                // 0 if not mapped
+    long nWindowChunks;
+    size_t nMapBytes;
+#ifdef _WIN32
+    HANDLE hFile;
+    HANDLE hMapping;
+#else
+    int nFile;
+#endif
+
+    CTRStore()
+    {
+        nCols = 0;
+        nRows = 0;
+        nRowBytes = 0;
+        pRows = NULL;
+        nChunkRows = 0;
+        nWindowChunks = 0;
+        nMapBytes = 0;
+#ifdef _WIN32
+        hFile = INVALID_HANDLE_VALUE;
+        hMapping = NULL;
+#else
+        nFile = -1;
+#endif
+    }
+
+    ~CTRStore()
+    {
+        if (nChunkRows == 0)
+            return;
+#ifdef _WIN32
+        if (pRows != NULL)
+            UnmapViewOfFile(pRows);
+        if (hMapping != NULL)
+            CloseHandle(hMapping);
+        if (hFile != INVALID_HANDLE_VALUE)
+            CloseHandle(hFile);
+#else
+        if (pRows != NULL)
+            munmap((void*)pRows, nMapBytes);
+        if (nFile >= 0)
+            close(nFile);
+#endif
+    }
+};
+
+static const int s_anTypeBytes[] = { 4, 2, 2, 1 };   // by ALN_TRCOL_*
+
+///////////////////////////////////////////////////////////////////////////////
+// conversions
+
+// IEEE half precision, rounded to nearest even
+static unsigned short FloatToHalf(float flt)
+{
+    unsigned int n;
+    memcpy(&n, &flt, sizeof(n));
+    unsigned int nSign = (n >> 16) & 0x8000;
+    unsigned int nAbs = n & 0x7FFFFFFF;
+
+    if (nAbs >= 0x7F800000)                     // inf or nan
+        return (unsigned short)(nSign | 0x7C00 | ((nAbs > 0x7F800000) ? 0x200 : 0));
+    if (nAbs >= 0x477FF000)                     // rounds beyond 65504
+        return (unsigned short)(nSign | 0x7C00);
+    if (nAbs < 0x38800000)                      // subnormal half
+    {
+        if (nAbs < 0x33000000)
+            return (unsigned short)nSign;
+        unsigned int nShift = 126 - (nAbs >> 23);  // 14 to 24
+        unsigned int nMant = (nAbs & 0x7FFFFF) | 0x800000;
+        unsigned int nHalf = nMant >> nShift;
+        unsigned int nRest = nMant & ((1u << nShift) - 1);
+        unsigned int nMid = 1u << (nShift - 1);
+        if (nRest > nMid || (nRest == nMid && (nHalf & 1)))
+            nHalf++;
+        return (unsigned short)(nSign | nHalf);
+    }
+    unsigned int nHalf = ((nAbs - 0x38000000) >> 13);
+    unsigned int nRest = nAbs & 0x1FFF;
+    if (nRest > 0x1000 || (nRest == 0x1000 && (nHalf & 1)))
+        nHalf++;
+    return (unsigned short)(nSign | nHalf);
+}
+
+static inline float HalfToFloat(unsigned short nHalf)
+{
+    unsigned int nSign = (unsigned int)(nHalf & 0x8000) << 16;
+    unsigned int nExp = (nHalf >> 10) & 0x1F;
+    unsigned int nMant = nHalf & 0x3FF;
+    unsigned int n;
+    if (nExp == 0x1F)
+        n = nSign | 0x7F800000 | (nMant << 13);
+    else if (nExp != 0)
+        n = nSign | ((nExp + 112) << 23) | (nMant << 13);
+    else
+    {
+        float flt = (float)nMant * (1.0f / 16777216.0f);    // 2^-24
+        return nSign ? -flt : flt;
+    }
+    float flt;
+    memcpy(&flt, &n, sizeof(flt));
+    return flt;
+}
+
+static inline float Dequantise(float fltOffset, float fltScale, int k)
+{
+    return fltOffset + fltScale * (float)k;
+}
+
+static int Quantise(float flt, float fltOffset, float fltScale, int nMin, int nMax)
+{
+    double dbl = (fltScale != 0) ? ((double)flt - fltOffset) / fltScale : 0;
+    if (!(dbl >= nMin)) return nMin;            // also nan
+    if (dbl > nMax) return nMax;
+    return (int)floor(dbl + 0.5);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// choosing the column types
+
+// whether every value of column nCol is exactly fltOffset + fltScale * k for
+// some k in [nMin, nMax]
+static BOOL IsExactGrid(const ALNDATAINFO* pDataInfo, int nCol, float fltOffset,
+    float fltScale, int nMin, int nMax)
+{
+    const float* afltTRdata = pDataInfo->afltTRdata;
+    for (long i = 0; i < pDataInfo->nTRcurrSamples; i++)
+    {
+        float flt = afltTRdata[i * pDataInfo->nTRcols + nCol];
+        if (Dequantise(fltOffset, fltScale, Quantise(flt, fltOffset, fltScale, nMin, nMax)) != flt)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static BOOL IsExactHalf(const ALNDATAINFO* pDataInfo, int nCol)
+{
+    const float* afltTRdata = pDataInfo->afltTRdata;
+    for (long i = 0; i < pDataInfo->nTRcurrSamples; i++)
+    {
+        float flt = afltTRdata[i * pDataInfo->nTRcols + nCol];
+        if (HalfToFloat(FloatToHalf(flt)) != flt)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+// the scale and offset of an integer type over [fltMin, fltMax]: the
+// integers themselves if they fit, else the range divided into equal steps
+static void GridOf(float fltMin, float fltMax, int nMin, int nMax,
+    float& fltOffset, float& fltScale, BOOL bIntegers)
+{
+    if (bIntegers && fltMin >= nMin && fltMax <= nMax)
+    {
+        fltOffset = 0;
+        fltScale = 1;
+    }
+    else if (bIntegers && fltMax - fltMin <= (float)(nMax - nMin))
+    {
+        fltOffset = fltMin - nMin;
+        fltScale = 1;
+    }
+    else
+    {
+        fltScale = (fltMax > fltMin) ? (fltMax - fltMin) / (float)(nMax - nMin) : 1;
+        fltOffset = fltMin - fltScale * nMin;
+    }
+}
+
+// the type, scale and offset of column nCol; nType is ALN_TRCOL_AUTO for the
+// smallest exact type
+static void ChooseColumn(const ALNDATAINFO* pDataInfo, int nCol, int nType,
+    int& nChosen, float& fltOffset, float& fltScale)
+{
+    const float* afltTRdata = pDataInfo->afltTRdata;
+    float fltMin = FLT_MAX, fltMax = -FLT_MAX;
+    BOOL bIntegers = TRUE;
+    BOOL bFinite = TRUE;
+    for (long i = 0; i < pDataInfo->nTRcurrSamples; i++)
+    {
+        float flt = afltTRdata[i * pDataInfo->nTRcols + nCol];
+        if (!(flt >= -FLT_MAX && flt <= FLT_MAX))
+        {
+            bFinite = FALSE;
+            continue;
+        }
+        fltMin = min(fltMin, flt);
+        fltMax = max(fltMax, flt);
+        if (flt != floorf(flt))
+            bIntegers = FALSE;
+    }
+    if (fltMin > fltMax)
+        fltMin = fltMax = 0;
+
+    // only f32 and fp16 hold infinities and nans
+    fltOffset = 0;
+    fltScale = 1;
+    nChosen = ALN_TRCOL_F32;
+    if (!bFinite && nType == ALN_TRCOL_AUTO)
+    {
+        if (IsExactHalf(pDataInfo, nCol))
+            nChosen = ALN_TRCOL_F16;
+        return;
+    }
+
+    if (nType == ALN_TRCOL_U8 || nType == ALN_TRCOL_AUTO)
+    {
+        GridOf(fltMin, fltMax, 0, 255, fltOffset, fltScale, bIntegers);
+        if (nType == ALN_TRCOL_U8 || IsExactGrid(pDataInfo, nCol, fltOffset, fltScale, 0, 255))
+        {
+            nChosen = ALN_TRCOL_U8;
+            return;
+        }
+    }
+    if (nType == ALN_TRCOL_I16 || nType == ALN_TRCOL_AUTO)
+    {
+        GridOf(fltMin, fltMax, -32768, 32767, fltOffset, fltScale, bIntegers);
+        if (nType == ALN_TRCOL_I16 || IsExactGrid(pDataInfo, nCol, fltOffset, fltScale, -32768, 32767))
+        {
+            nChosen = ALN_TRCOL_I16;
+            return;
+        }
+    }
+    fltOffset = 0;
+    fltScale = 1;
+    if (nType == ALN_TRCOL_F16 || (nType == ALN_TRCOL_AUTO && IsExactHalf(pDataInfo, nCol)))
+        nChosen = ALN_TRCOL_F16;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// reading rows
+
+// dequantises the columns [nFirst, nFirst + n) of a run
+static void DequantiseRun(const CTRStore* pStore, const CTRRun& run,
+    const unsigned char* pRow, int nFirst, int n, float* afltRow)
+{
+    const float* afltScale = pStore->vecScale.data();
+    const float* afltOffset = pStore->vecOffset.data();
+    const unsigned char* p = pRow + run.nByte + (size_t)(nFirst - run.nFirstCol) * s_anTypeBytes[run.nType];
+    int c = nFirst;
+    int nEnd = nFirst + n;
+
+    switch (run.nType)
+    {
+    case ALN_TRCOL_F32:
+        memcpy(afltRow + c, p, n * sizeof(float));
+        break;
+
+    case ALN_TRCOL_F16:
+        for (; c < nEnd; c++, p += 2)
+        {
+            unsigned short nHalf;
+            memcpy(&nHalf, p, sizeof(nHalf));
+            afltRow[c] = HalfToFloat(nHalf);
+        }
+        break;
+
+    case ALN_TRCOL_I16:
+#ifdef ALNTRSTORE_SSE2
+        for (; c + 8 <= nEnd; c += 8, p += 16)
+        {
+            __m128i n16 = _mm_loadu_si128((const __m128i*)p);
+            __m128i nLo = _mm_srai_epi32(_mm_unpacklo_epi16(n16, n16), 16);
+            __m128i nHi = _mm_srai_epi32(_mm_unpackhi_epi16(n16, n16), 16);
+            _mm_storeu_ps(afltRow + c, _mm_add_ps(_mm_loadu_ps(afltOffset + c),
+                _mm_mul_ps(_mm_loadu_ps(afltScale + c), _mm_cvtepi32_ps(nLo))));
+            _mm_storeu_ps(afltRow + c + 4, _mm_add_ps(_mm_loadu_ps(afltOffset + c + 4),
+                _mm_mul_ps(_mm_loadu_ps(afltScale + c + 4), _mm_cvtepi32_ps(nHi))));
+        }
+#endif
+        for (; c < nEnd; c++, p += 2)
+        {
+            short k;
+            memcpy(&k, p, sizeof(k));
+            afltRow[c] = Dequantise(afltOffset[c], afltScale[c], k);
+        }
+        break;
+
+    case ALN_TRCOL_U8:
+#ifdef ALNTRSTORE_SSE2
+        {
+            __m128i nZero = _mm_setzero_si128();
+            for (; c + 16 <= nEnd; c += 16, p += 16)
+            {
+                __m128i n8 = _mm_loadu_si128((const __m128i*)p);
+                __m128i n16Lo = _mm_unpacklo_epi8(n8, nZero);
+                __m128i n16Hi = _mm_unpackhi_epi8(n8, nZero);
+                __m128i an32[4] = { _mm_unpacklo_epi16(n16Lo, nZero), _mm_unpackhi_epi16(n16Lo, nZero),
+                    _mm_unpacklo_epi16(n16Hi, nZero), _mm_unpackhi_epi16(n16Hi, nZero) };
+                for (int q = 0; q < 4; q++)
+                {
+                    int cq = c + 4 * q;
+                    _mm_storeu_ps(afltRow + cq, _mm_add_ps(_mm_loadu_ps(afltOffset + cq),
+                        _mm_mul_ps(_mm_loadu_ps(afltScale + cq), _mm_cvtepi32_ps(an32[q]))));
+                }
+            }
+        }
+#endif
+        for (; c < nEnd; c++, p++)
+        {
+            afltRow[c] = Dequantise(afltOffset[c], afltScale[c], *p);
+        }
+        break;
+    }
+}
+
+void ALNAPI GetTRStoreRow(const void* pvStore, long nRow, int nCols, float* afltRow)
+{
+    const CTRStore* pStore = (const CTRStore*)pvStore;
+    ASSERT(pStore && afltRow);
+    ASSERT(nRow >= 0 && nRow < pStore->nRows && nCols <= pStore->nCols);
+
+    const unsigned char* pRow = pStore->pRows + (size_t)nRow * pStore->nRowBytes;
+    for (size_t r = 0; r < pStore->vecRuns.size(); r++)
+    {
+        const CTRRun& run = pStore->vecRuns[r];
+        if (run.nFirstCol >= nCols)
+            break;
+        DequantiseRun(pStore, run, pRow, run.nFirstCol, min(run.nCols, nCols - run.nFirstCol), afltRow);
+    }
+}
+
+void ALNAPI PrefetchTRStoreRow(const void* pvStore, long nRow)
+{
+    const CTRStore* pStore = (const CTRStore*)pvStore;
+    const char* pRow = (const char*)pStore->pRows + (size_t)nRow * pStore->nRowBytes;
+    const char* pRowEnd = pRow + pStore->nRowBytes;
+#if defined(ALNTRSTORE_SSE2)
+    for (const char* p = pRow; p < pRowEnd; p += 64)
+        _mm_prefetch(p, _MM_HINT_T0);
+    _mm_prefetch(pRowEnd - 1, _MM_HINT_T0);
+#elif defined(__GNUC__)
+    for (const char* p = pRow; p < pRowEnd; p += 64)
+        __builtin_prefetch(p);
+    __builtin_prefetch(pRowEnd - 1);
+#else
+    (void)pRowEnd;  // no prefetch on this target
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// store API
+
+// builds a store of the rows of the training buffer of pDataInfo; anColType
+// holds an ALN_TRCOL_* for each of the nTRcols columns, or is NULL for
+// ALN_TRCOL_AUTO in all
+// returns ALN_* error code, (ALN_NOERROR on success)
+ALNIMP int ALNAPI ALNCreateTRStore(const ALNDATAINFO* pDataInfo, int nDim,
+    const int* anColType, void** ppvStore)
+{
+    // parameter variance
+    if (pDataInfo == NULL || ppvStore == NULL || pDataInfo->afltTRdata == NULL ||
+        pDataInfo->nTRcurrSamples < 0 || pDataInfo->nTRcols < nDim || nDim < 2)
+        return ALN_GENERIC;
+    if (anColType != NULL)
+    {
+        for (int c = 0; c < pDataInfo->nTRcols; c++)
+        {
+            if (anColType[c] < ALN_TRCOL_F32 || anColType[c] > ALN_TRCOL_AUTO)
+                return ALN_GENERIC;
+        }
+    }
+
+    *ppvStore = NULL;
+
+    CTRStore* pStore = NULL;
+    int nReturn = ALN_NOERROR;
+    try
+    {
+        pStore = new CTRStore;
+        int nCols = pDataInfo->nTRcols;
+        long nRows = pDataInfo->nTRcurrSamples;
+        pStore->nCols = nCols;
+        pStore->nRows = nRows;
+        pStore->vecType.resize(nCols);
+        pStore->vecScale.resize(nCols);
+        pStore->vecOffset.resize(nCols);
+
+        // the row of the closest sample in a compact buffer is an int
+        BOOL bCompact = IsCompactTRBuffer(pDataInfo);
+        std::vector<size_t> vecByte(nCols);
+        size_t nByte = 0;
+        for (int c = 0; c < nCols; c++)
+        {
+            int nType = (anColType != NULL) ? anColType[c] : ALN_TRCOL_AUTO;
+            if (bCompact && c == nDim)
+                nType = ALN_TRCOL_F32;
+            if (nType == ALN_TRCOL_F32)
+            {
+                pStore->vecType[c] = ALN_TRCOL_F32;
+                pStore->vecOffset[c] = 0;
+                pStore->vecScale[c] = 1;
+            }
+            else
+            {
+                ChooseColumn(pDataInfo, c, nType, pStore->vecType[c], pStore->vecOffset[c],
+                    pStore->vecScale[c]);
+            }
+
+            int nChosen = pStore->vecType[c];
+            vecByte[c] = nByte;
+            nByte += s_anTypeBytes[nChosen];
+            if (pStore->vecRuns.empty() || pStore->vecRuns.back().nType != nChosen)
+            {
+                CTRRun run = { nChosen, c, 0, vecByte[c] };
+                pStore->vecRuns.push_back(run);
+            }
+            pStore->vecRuns.back().nCols++;
+        }
+        pStore->nRowBytes = nByte;
+
+        pStore->vecRows.resize((size_t)nRows * nByte);
+        for (long i = 0; i < nRows; i++)
+        {
+            const float* afltRow = pDataInfo->afltTRdata + i * nCols;
+            unsigned char* pRow = pStore->vecRows.data() + (size_t)i * nByte;
+            for (int c = 0; c < nCols; c++)
+            {
+                unsigned char* p = pRow + vecByte[c];
+                float fltOffset = pStore->vecOffset[c], fltScale = pStore->vecScale[c];
+                switch (pStore->vecType[c])
+                {
+                case ALN_TRCOL_F32:
+                    memcpy(p, afltRow + c, sizeof(float));
+                    break;
+                case ALN_TRCOL_F16:
+                    {
+                        unsigned short nHalf = FloatToHalf(afltRow[c]);
+                        memcpy(p, &nHalf, sizeof(nHalf));
+                    }
+                    break;
+                case ALN_TRCOL_I16:
+                    {
+                        short k = (short)Quantise(afltRow[c], fltOffset, fltScale, -32768, 32767);
+                        memcpy(p, &k, sizeof(k));
+                    }
+                    break;
+                case ALN_TRCOL_U8:
+                    *p = (unsigned char)Quantise(afltRow[c], fltOffset, fltScale, 0, 255);
+                    break;
+                }
+            }
+        }
+
+        pStore->pRows = pStore->vecRows.data();
+
+        *ppvStore = pStore;
+    }
+    catch (...)
+    {
+        nReturn = ALN_OUTOFMEM;
+    }
+
+    if (nReturn != ALN_NOERROR)
+        delete pStore;
+
+    return nReturn;
+}
+
+// maps the file of rows of nTRcols floats for reading
+static int MapTRFile(CTRStore* pStore, const char* pszFileName, int nTRcols)
+{
+    unsigned long long nFileBytes;
+#ifdef _WIN32
+    pStore->hFile = CreateFileA(pszFileName, GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+    if (pStore->hFile == INVALID_HANDLE_VALUE)
+        return ALN_ERRFILE;
+    LARGE_INTEGER nSize;
+    if (!GetFileSizeEx(pStore->hFile, &nSize))
+        return ALN_ERRFILE;
+    nFileBytes = (unsigned long long)nSize.QuadPart;
+#else
+    pStore->nFile = open(pszFileName, O_RDONLY);
+    if (pStore->nFile < 0)
+        return ALN_ERRFILE;
+    struct stat st;
+    if (fstat(pStore->nFile, &st) != 0)
+        return ALN_ERRFILE;
+    nFileBytes = (unsigned long long)st.st_size;
+#endif
+
+    unsigned long long nRows = nFileBytes / ((unsigned long long)nTRcols * sizeof(float));
+    if (nRows == 0 || nRows > (unsigned long long)(std::numeric_limits<long>::max)() ||
+        nFileBytes % (nTRcols * sizeof(float)) != 0)
+        return ALN_BADFILEFORMAT;
+    pStore->nRows = (long)nRows;
+    pStore->nMapBytes = (size_t)nFileBytes;
+
+#ifdef _WIN32
+    pStore->hMapping = CreateFileMappingA(pStore->hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (pStore->hMapping == NULL)
+        return ALN_ERRFILE;
+    pStore->pRows = (const unsigned char*)MapViewOfFile(pStore->hMapping, FILE_MAP_READ, 0, 0, 0);
+    if (pStore->pRows == NULL)
+        return ALN_OUTOFMEM;
+#else
+    void* pv = mmap(NULL, pStore->nMapBytes, PROT_READ, MAP_SHARED, pStore->nFile, 0);
+    if (pv == MAP_FAILED)
+        return ALN_OUTOFMEM;
+    pStore->pRows = (const unsigned char*)pv;
+    madvise(pv, pStore->nMapBytes, MADV_RANDOM);    // chunks are asked for
+#endif
+    return ALN_NOERROR;
+}
+
+// maps a file of rows of nTRcols floats, as afltTRdata, as the training
+// buffer of pDataInfo; epochs read it by chunks of nChunkRows rows, with
+// nWindowChunks chunks in memory
+// returns ALN_* error code, (ALN_NOERROR on success)
+ALNIMP int ALNAPI ALNOpenTRFile(const char* pszFileName, int nTRcols,
+    long nChunkRows, long nWindowChunks, ALNDATAINFO* pDataInfo, void** ppvStore)
+{
+    // parameter variance
+    if (pszFileName == NULL || nTRcols <= 0 || nChunkRows <= 0 || nWindowChunks <= 0 ||
+        pDataInfo == NULL || ppvStore == NULL)
+        return ALN_GENERIC;
+
+    *ppvStore = NULL;
+
+    CTRStore* pStore = NULL;
+    int nReturn = ALN_NOERROR;
+    try
+    {
+        pStore = new CTRStore;
+        pStore->nCols = nTRcols;
+        pStore->nRowBytes = nTRcols * sizeof(float);
+        pStore->nChunkRows = nChunkRows;
+        pStore->nWindowChunks = nWindowChunks;
+        pStore->vecType.assign(nTRcols, ALN_TRCOL_F32);
+        pStore->vecScale.assign(nTRcols, 1.0f);
+        pStore->vecOffset.assign(nTRcols, 0.0f);
+        CTRRun run = { ALN_TRCOL_F32, 0, nTRcols, 0 };
+        pStore->vecRuns.push_back(run);
+
+        nReturn = MapTRFile(pStore, pszFileName, nTRcols);
+    }
+    catch (...)
+    {
+        nReturn = ALN_OUTOFMEM;
+    }
+
+    if (nReturn != ALN_NOERROR)
+    {
+        delete pStore;
+        return nReturn;
+    }
+
+    pDataInfo->afltTRdata = NULL;
+    pDataInfo->nTRmaxSamples = pStore->nRows;
+    pDataInfo->nTRcurrSamples = pStore->nRows;
+    pDataInfo->nTRcols = nTRcols;
+    pDataInfo->nTRinsert = 0;
+    pDataInfo->pvTRstore = pStore;
+    *ppvStore = pStore;
+
+    return ALN_NOERROR;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// residency of the chunks of a mapped store
+
+BOOL ALNAPI GetTRStoreChunks(const void* pvStore, long* pnChunkRows, long* pnWindowChunks)
+{
+    const CTRStore* pStore = (const CTRStore*)pvStore;
+    if (pStore == NULL || pStore->nChunkRows == 0)
+        return FALSE;
+
+    *pnChunkRows = pStore->nChunkRows;
+    *pnWindowChunks = pStore->nWindowChunks;
+    return TRUE;
+}
+
+// helper: size of a memory page
+static size_t GetPageSize()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+// asks the system to read the chunks in, or lets it drop them
+static void AdviseChunks(const CTRStore* pStore, const std::vector<long>& vecChunks,
+    BOOL bWillNeed)
+{
+    // initialised once, even when several trainers get here at a time
+    static const size_t s_nPage = GetPageSize();
+    size_t nPage = s_nPage;
+    size_t nChunkBytes = (size_t)pStore->nChunkRows * pStore->nRowBytes;
+    for (size_t n = 0; n < vecChunks.size(); n++)
+    {
+        // whole pages; a page shared with a neighbouring chunk is kept
+        size_t nBegin = (size_t)vecChunks[n] * nChunkBytes;
+        size_t nEnd = min(nBegin + nChunkBytes, pStore->nMapBytes);
+        if (bWillNeed)
+        {
+            nBegin -= nBegin % nPage;
+        }
+        else
+        {
+            nBegin += (nPage - nBegin % nPage) % nPage;
+            if (nEnd < pStore->nMapBytes)
+                nEnd -= nEnd % nPage;
+        }
+        if (nEnd <= nBegin)
+            continue;
+
+        char* p = (char*)pStore->pRows + nBegin;
+#ifdef _WIN32
+        if (bWillNeed)
+        {
+            WIN32_MEMORY_RANGE_ENTRY range = { p, nEnd - nBegin };
+            PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+        }
+        else
+        {
+            // removes the pages from the working set, see VirtualUnlock
+            VirtualUnlock(p, nEnd - nBegin);
+        }
+#else
+        madvise(p, nEnd - nBegin, bWillNeed ? MADV_WILLNEED : MADV_DONTNEED);
+#endif
+    }
+}
+
+// the chunks of the window starting at position nPos of the epoch order,
+// which ends where a row of another chunk follows nWindowChunks chunks
+static long ScanWindow(const CTRStore* pStore, const long* anShuffle, long nSamples,
+    long nPos, std::vector<long>& vecChunks)
+{
+    vecChunks.clear();
+    for (; nPos < nSamples; nPos++)
+    {
+        long nChunk = anShuffle[nPos] / pStore->nChunkRows;
+        if (std::find(vecChunks.begin(), vecChunks.end(), nChunk) == vecChunks.end())
+        {
+            if ((long)vecChunks.size() == pStore->nWindowChunks)
+                break;
+            vecChunks.push_back(nChunk);
+        }
+    }
+    return nPos;
+}
+
+void ALNAPI StartTRResidency(CTRResidency& residency, const void* pvStore,
+    const long* anShuffle, long nSamples)
+{
+    const CTRStore* pStore = (const CTRStore*)pvStore;
+    ASSERT(pStore && pStore->nChunkRows > 0);
+    try
+    {
+        residency.pvStore = pvStore;
+        residency.vecWindow.reserve(pStore->nWindowChunks);
+        residency.vecNextWindow.reserve(pStore->nWindowChunks);
+    }
+    catch (std::bad_alloc&)
+    {
+        ThrowALNMemoryException();
+    }
+
+    residency.nNextWindow = ScanWindow(pStore, anShuffle, nSamples, 0, residency.vecWindow);
+    AdviseChunks(pStore, residency.vecWindow, TRUE);
+    residency.nNextWindowEnd = ScanWindow(pStore, anShuffle, nSamples,
+        residency.nNextWindow, residency.vecNextWindow);
+    AdviseChunks(pStore, residency.vecNextWindow, TRUE);
+}
+
+void ALNAPI NextTRWindow(CTRResidency& residency, const long* anShuffle, long nSamples)
+{
+    const CTRStore* pStore = (const CTRStore*)residency.pvStore;
+    AdviseChunks(pStore, residency.vecWindow, FALSE);
+    residency.vecWindow.swap(residency.vecNextWindow);
+    residency.nNextWindow = residency.nNextWindowEnd;
+    residency.nNextWindowEnd = ScanWindow(pStore, anShuffle, nSamples,
+        residency.nNextWindow, residency.vecNextWindow);
+    AdviseChunks(pStore, residency.vecNextWindow, TRUE);
+}
+
+// the type of each column into anColType if not NULL, and the bytes of the
+// rows into pnBytes if not NULL
+// returns ALN_* error code, (ALN_NOERROR on success)
+ALNIMP int ALNAPI ALNGetTRStoreInfo(const void* pvStore, int* anColType, size_t* pnBytes)
+{
+    const CTRStore* pStore = (const CTRStore*)pvStore;
+
+    // parameter variance
+    if (pStore == NULL)
+        return ALN_GENERIC;
+
+    if (anColType != NULL)
+        memcpy(anColType, pStore->vecType.data(), pStore->nCols * sizeof(int));
+    if (pnBytes != NULL)
+        *pnBytes = (size_t)pStore->nRows * pStore->nRowBytes;
+
+    return ALN_NOERROR;
+}
+
+// destroys a store made by ALNCreateTRStore
+// returns ALN_* error code, (ALN_NOERROR on success)
+ALNIMP int ALNAPI ALNDestroyTRStore(void* pvStore)
+{
+    if (pvStore == NULL)
+        return ALN_GENERIC;
+
+    delete (CTRStore*)pvStore;
+
+    return ALN_NOERROR;
+}
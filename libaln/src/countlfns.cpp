@@ -57,8 +57,10 @@ void ALNAPI CountLFNs(const ALNNODE* pNode, int& nTotal, int& nAdapted)
         // we're a minmax... iterate over children
         ASSERT(NODE_ISMINMAX(pNode));
 
-        CountLFNs(MINMAX_LEFT(pNode), nTotal, nAdapted);
-        CountLFNs(MINMAX_RIGHT(pNode), nTotal, nAdapted);
+        for (int i = 0; i < MINMAX_NUMCHILDREN(pNode); i++)
+        {
+            CountLFNs(MINMAX_CHILDREN(pNode)[i], nTotal, nAdapted);
+        }
     }
 }
 
@@ -88,6 +88,7 @@ float ALNAPI CutoffEval(const ALNNODE* pNode, const ALN* pALN,
    // ASSERT (flt == fltCheck && pLFNCheck == pActiveLFN); MYTEST
 #endif
 
+    STATS_TREEEVAL(pNode, pActiveLFN);
     * ppActiveLFN = pActiveLFN;
 
     return flt;
@@ -36,8 +36,6 @@ SOFTWARE. */
 static char THIS_FILE[] = __FILE__;
 #endif
 
-long CountLeafevals;
-
 ///////////////////////////////////////////////////////////////////////////////
 // LFN specific eval - returns distance to surface
 //  - returns distance of LFN from point
@@ -57,14 +55,8 @@ float ALNAPI CutoffEvalLFN(const ALNNODE* pNode, const ALN* pALN,
     *ppActiveLFN = (ALNNODE*)pNode;         // cast away the const...
 
     // calc dist of point from line
-    int nDim = pALN->nDim;
-    const float* afltW = LFN_W(pNode);
-    float fltA = *afltW++;                 // skip past bias weight       
-    for (int i = 0; i < nDim; i++)     // Go to nDim - 1 instead, then use this for quickeval.
-    {
-        fltA += afltW[i] * afltX[i];
-    }
-    CountLeafevals++;
+    float fltA = LFNValue(pNode, afltX, pALN->nDim);
+    STATS_LEAFEVAL(pALN, pNode);
     // NODE_DISTANCE(pNode) = fltA; optional?
     return fltA;
 }
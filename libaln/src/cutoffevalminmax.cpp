@@ -36,22 +36,49 @@ SOFTWARE. */
 static char THIS_FILE[] = __FILE__;
 #endif
 
-// Switches for turning on/off optimizations
-extern BOOL bAlphaBeta;
-extern BOOL bDistanceOptimization;
 
+// helper: TRUE if the subtree pChild cannot beat fltLimit at afltX, so the
+// minmax parent need not evaluate it.  fltLimit is the value of a sibling or
+// the alpha-beta limit, past which a value is irrelevant as well.  The bounds
+// of pChild hold over its box; away from the box, the value can change at most
+// as fast as the steepest LFN in the subtree along each axis.  The result is
+// exact, up to the rounding allowance of the bounds.
+static BOOL ALNAPI BoundsCutoff(const ALNNODE* pChild, const ALN* pALN,
+    const float* afltX, float fltLimit, BOOL bMax)
+{
+    if (!NODE_ISMINMAX(pChild) || !(pChild->fNode & GF_BOUNDS))
+        return FALSE;
 
-///////////////////////////////////////////////////////////////////////////////
-// minmax node specific eval - returns distance to surface
-//  - non-destructive, ie, does not change ALN structure
-// NOTE: cutoff always passed on stack!
+    int nDim = pALN->nDim;
+    const float* afltB = MINMAX_BOUNDS(pChild);
+    const float* afltBoxMin = BOUNDS_BOXMIN(afltB);
+    const float* afltBoxMax = BOUNDS_BOXMAX(afltB, nDim);
 
-float ALNAPI CutoffEvalMinMax(const ALNNODE* pNode, const ALN* pALN,
+    // a max parent needs the greatest value of the child, a min parent the least,
+    // which is the weight range end that gains most going out of the box
+    const float* afltWBelow = bMax ? BOUNDS_WMIN(afltB, nDim) : BOUNDS_WMAX(afltB, nDim);
+    const float* afltWAbove = bMax ? BOUNDS_WMAX(afltB, nDim) : BOUNDS_WMIN(afltB, nDim);
+    float fltBound = bMax ? BOUNDS_MAX(afltB) : BOUNDS_MIN(afltB);
+    float fltAbs = 0;
+    for (int i = 0; i < nDim; i++)
+    {
+        // at most one of these is non-zero
+        float fltBelow = min(afltX[i] - afltBoxMin[i], 0.0f);
+        float fltAbove = max(afltX[i] - afltBoxMax[i], 0.0f);
+        float fltTerm = afltWBelow[i] * fltBelow + afltWAbove[i] * fltAbove;
+        fltBound += fltTerm;
+        fltAbs += (float)fabs(fltTerm);
+    }
+
+    float fltTolerance = BOUNDS_TOLERANCE * nDim * fltAbs;
+    return bMax ? (fltBound + fltTolerance < fltLimit) : (fltBound - fltTolerance > fltLimit);
+}
+
+// helper: evaluation of a node with two children
+static float ALNAPI CutoffEvalPair(const ALNNODE* pNode, const ALN* pALN,
     const float* afltX, CEvalCutoff cutoff,
     ALNNODE** ppActiveLFN)
 {
-    ASSERT(NODE_ISMINMAX(pNode));
-
     // We use the sample counts and centroids of the child nodes to generate a hyperplane H roughly separating the child samples.
     // The branch to take first during an evaluation is the one representing the side of H afltX lies on.
     const ALNNODE* pChild0;
@@ -59,12 +86,21 @@ float ALNAPI CutoffEvalMinMax(const ALNNODE* pNode, const ALN* pALN,
     int nDim = pALN->nDim;
     // We take the dot product of the normal vector, in direction left centroid to right centroid, with afltX - H to find the branch which goes first.
     // Note that this handles the case where the normal is zero length as after a split and child centroids are equal.
+    // Where the routing test keeps only a few terms of the normal, those replace the dot product; see alnroute.cpp
+    // A tree read from a file has no routing vectors, then the left child goes first.
+    // A node ALNReorder has put in stored order takes the left child first as well.
     float dotproduct = 0;
-    for (int i = 0; i < nDim - 1; i++)
+    const ALNROUTE* pRoute = MINMAX_ROUTE(pNode);
+    BOOL bRouted = !(pNode->fNode & GF_STORED);
+    if (bRouted && pRoute != NULL && pRoute->nTerms >= 0)
     {
-        dotproduct += MINMAX_NORMAL(pNode)[i] * afltX[i];
+        dotproduct = SparseRouteValue(pRoute, afltX);
+        STATS_ROUTETEST(pALN, pNode, (dotproduct > 0) == (NormalRouteValue(pNode, afltX, nDim) > 0));
+    }
+    else if (bRouted && MINMAX_NORMAL(pNode))
+    {
+        dotproduct = NormalRouteValue(pNode, afltX, nDim); // the threshold is a constant stored for speed; see split_ops.cpp
     }
-    dotproduct += MINMAX_THRESHOLD(pNode); // add constant stored for speed; see split_ops.cpp
     if (dotproduct > 0)
     {
         pChild0 = MINMAX_RIGHT(pNode);
@@ -89,8 +125,6 @@ float ALNAPI CutoffEvalMinMax(const ALNNODE* pNode, const ALN* pALN,
     else
         pChild1 = MINMAX_LEFT(pNode);
     */
-    // get reference to region for this node
-    const ALNREGION& region = pALN->aRegions[NODE_REGION(pNode)];
     float fltDist;
 
     // eval first child
@@ -98,24 +132,27 @@ float ALNAPI CutoffEvalMinMax(const ALNNODE* pNode, const ALN* pALN,
     float flt0 = CutoffEval(pChild0, pALN, afltX, cutoff, &pActiveLFN0);
 
     // see if we can cutoff...
-    if (bAlphaBeta && Cutoff(flt0, pNode, cutoff))
+    if (UseAlphaBeta(pALN) && Cutoff(flt0, pNode, cutoff))
     {
+        STATS_ALPHABETACUTOFF(pALN, pChild1);
         *ppActiveLFN = pActiveLFN0;
         return flt0;
     }
-    // Check if second child is too far from sibling in any axis j; in which case
-    // the tree of the second child is cut off and we return the value from the first child
+    // Check if the bounds of the second child show it cannot beat the first child at afltX,
+    // or the limit the ancestors have set, which Cutoff has just combined with the first child;
+    // in which case the tree of the second child is cut off and we return the value from the first child
+    // (only minmax nodes have bounds)
 
     ASSERT(pChild1);
-    if (bDistanceOptimization && MINMAX_SIGMA(pChild1))
+    BOOL bMax = MINMAX_ISMAX(pNode) != 0;
+    float fltLimit = flt0;
+    if (UseAlphaBeta(pALN))
+        fltLimit = bMax ? cutoff.fltMax : cutoff.fltMin;
+    if (UseDistanceOptimization(pALN) && BoundsCutoff(pChild1, pALN, afltX, fltLimit, bMax))
     {
-        for (int j = 0; j < nDim - 1; j++)
-        {
-            if (fabs(afltX[j] - MINMAX_CENTROID(pChild1)[j]) > MINMAX_SIGMA(pChild1)[j]) // Do we need a safety factor?
-            {
-                return flt0;
-            }
-        }
+        STATS_DISTANCECUTOFF(pALN, pChild1);
+        *ppActiveLFN = pActiveLFN0;
+        return flt0;
     }
 
     // eval second child
@@ -137,3 +174,128 @@ float ALNAPI CutoffEvalMinMax(const ALNNODE* pNode, const ALN* pALN,
     return fltDist;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// minmax node specific eval - returns distance to surface
+//  - non-destructive, ie, does not change ALN structure
+// NOTE: cutoff always passed on stack!
+// A node with more than two children, made by merging nodes of the same type,
+// first reduces its LFN children in one flat loop, without recursion or copies
+// of the cutoff; the minmax children follow, nearest centroid first, each one
+// after the first subject to the alpha-beta and bounds cutoffs as in the two
+// child case.
+
+float ALNAPI CutoffEvalMinMax(const ALNNODE* pNode, const ALN* pALN,
+    const float* afltX, CEvalCutoff cutoff,
+    ALNNODE** ppActiveLFN)
+{
+    ASSERT(NODE_ISMINMAX(pNode));
+    STATS_MINMAXEVAL(pALN, pNode);
+
+    int nChildren = MINMAX_NUMCHILDREN(pNode);
+    if (nChildren == 2)
+        return CutoffEvalPair(pNode, pALN, afltX, cutoff, ppActiveLFN);
+
+    ALNNODE* const* apChildren = MINMAX_CHILDREN(pNode);
+    int nDim = pALN->nDim;
+    BOOL bMax = MINMAX_ISMAX(pNode) != 0;
+
+    // reduce the LFN children to the greatest or least value
+    ALNNODE* pActiveLFN = NULL;
+    float fltDist = 0;
+    for (int i = 0; i < nChildren; i++)
+    {
+        ALNNODE* pChild = apChildren[i];
+        if (!NODE_ISLFN(pChild))
+            continue;
+
+        float flt = LFNValue(pChild, afltX, nDim);
+        STATS_LEAFEVAL(pALN, pChild);
+        if (pActiveLFN == NULL || (bMax ? flt > fltDist : flt < fltDist))
+        {
+            fltDist = flt;
+            pActiveLFN = pChild;
+
+            // see if we can cutoff the rest of the children
+            if (UseAlphaBeta(pALN) && Cutoff(fltDist, pNode, cutoff))
+            {
+                for (int j = 0; j < nChildren; j++)
+                {
+                    if (j > i || NODE_ISMINMAX(apChildren[j]))
+                        STATS_ALPHABETACUTOFF(pALN, apChildren[j]);
+                }
+                *ppActiveLFN = pActiveLFN;
+                return fltDist;
+            }
+        }
+    }
+
+    // then the subtrees, starting with the one whose centroid is nearest to
+    // afltX, which takes the place of the first child in the two child case
+    int nFirst = -1;
+    float fltNearest = 0;
+    for (int i = 0; i < nChildren; i++)
+    {
+        const ALNNODE* pChild = apChildren[i];
+        if (NODE_ISLFN(pChild))
+            continue;
+
+        float fltD = 0;
+        if (MINMAX_CENTROID(pChild))
+        {
+            for (int j = 0; j < nDim - 1; j++)
+            {
+                float flt = afltX[j] - MINMAX_CENTROID(pChild)[j];
+                fltD += flt * flt;
+            }
+        }
+        if (nFirst < 0 || fltD < fltNearest)
+        {
+            nFirst = i;
+            fltNearest = fltD;
+        }
+    }
+
+    for (int k = -1; k < nChildren && nFirst >= 0; k++)
+    {
+        int i = (k < 0) ? nFirst : k;
+        const ALNNODE* pChild = apChildren[i];
+        if ((k >= 0 && i == nFirst) || NODE_ISLFN(pChild))
+            continue;
+
+        if (pActiveLFN != NULL)
+        {
+            // see if we can cutoff the remaining subtrees...
+            if (UseAlphaBeta(pALN) && Cutoff(fltDist, pNode, cutoff))
+            {
+                for (int j = (k < 0) ? 0 : k; j < nChildren; j++)
+                {
+                    if (NODE_ISMINMAX(apChildren[j]) && (j != nFirst || k < 0))
+                        STATS_ALPHABETACUTOFF(pALN, apChildren[j]);
+                }
+                break;
+            }
+
+            // ...or this one, if its bounds show it cannot beat the value so far,
+            // or the limit set by the ancestors
+            float fltLimit = fltDist;
+            if (UseAlphaBeta(pALN))
+                fltLimit = bMax ? cutoff.fltMax : cutoff.fltMin;
+            if (UseDistanceOptimization(pALN) && BoundsCutoff(pChild, pALN, afltX, fltLimit, bMax))
+            {
+                STATS_DISTANCECUTOFF(pALN, pChild);
+                continue;
+            }
+        }
+
+        ALNNODE* pActiveLFNChild;
+        float flt = CutoffEval(pChild, pALN, afltX, cutoff, &pActiveLFNChild);
+        if (pActiveLFN == NULL || (bMax ? flt > fltDist : flt < fltDist))
+        {
+            fltDist = flt;
+            pActiveLFN = pActiveLFNChild;
+        }
+    }
+
+    *ppActiveLFN = pActiveLFN;
+    return fltDist;
+}
@@ -51,37 +51,31 @@ float ALNAPI DebugEvalMinMax(const ALNNODE* pNode, const ALN* pALN,
     else
         pChild0 = MINMAX_LEFT(pNode);
 
-    // set next child
-    ALNNODE* pChild1;
-    if (pChild0 == MINMAX_LEFT(pNode))
-        pChild1 = MINMAX_RIGHT(pNode);
-    else
-        pChild1 = MINMAX_LEFT(pNode);
-
     // eval first child
     ALNNODE* pActiveLFN0;
-    float flt0 = DebugEval(pChild0, pALN, afltX, &pActiveLFN0);
-
-    // eval second child
-    ALNNODE* pActiveLFN1;
-    float flt1 = DebugEval(pChild1, pALN, afltX, &pActiveLFN1);
-
-    // get reference to region for this node
-    const ALNREGION& region = pALN->aRegions[NODE_REGION(pNode)];
+    float fltDist = DebugEval(pChild0, pALN, afltX, &pActiveLFN0);
+    *ppActiveLFN = pActiveLFN0;
 
-    // calc active child, active child response, and distance
-    float fltDist, fltRespActive;
-    int nActive = CalcActiveChild(fltRespActive,
-        fltDist,
-        flt0, flt1, pNode);
-
-    if (nActive == 0)
-    {
-        *ppActiveLFN = pActiveLFN0;
-    }
-    else
+    // fold in the other children
+    for (int i = 0; i < MINMAX_NUMCHILDREN(pNode); i++)
     {
-        *ppActiveLFN = pActiveLFN1;
+        ALNNODE* pChild1 = MINMAX_CHILDREN(pNode)[i];
+        if (pChild1 == pChild0)
+            continue;
+
+        ALNNODE* pActiveLFN1;
+        float flt1 = DebugEval(pChild1, pALN, afltX, &pActiveLFN1);
+
+        // calc active child, active child response, and distance
+        float fltRespActive;
+        int nActive = CalcActiveChild(fltRespActive,
+            fltDist,
+            fltDist, flt1, pNode);
+
+        if (nActive != 0)
+        {
+            *ppActiveLFN = pActiveLFN1;
+        }
     }
 
     return fltDist;
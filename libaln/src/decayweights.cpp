@@ -28,15 +28,16 @@ SOFTWARE. */
 #include "alnpriv.h"
 #include <iostream>
 #include <algorithm>
-extern BOOL bClassify2;
 
 ALNIMP void ALNAPI DecayWeights(const ALNNODE* pNode, const ALN* pALN, float WeightBound, float WeightDecay)
 {
     // This routine should not be called except for classification tasks
     if (NODE_ISMINMAX(pNode))
     {
-        DecayWeights(MINMAX_RIGHT(pNode), pALN, WeightBound, WeightDecay);
-        DecayWeights(MINMAX_LEFT(pNode), pALN, WeightBound, WeightDecay);
+        for (int i = MINMAX_NUMCHILDREN(pNode) - 1; i >= 0; i--)
+        {
+            DecayWeights(MINMAX_CHILDREN(pNode)[i], pALN, WeightBound, WeightDecay);
+        }
     }
     else
     {
@@ -76,6 +77,7 @@ ALNIMP void ALNAPI DecayWeights(const ALNNODE* pNode, const ALN* pALN, float Wei
         }
         pW = LFN_W(pNode); // Get the unshifted weight vector
         *pW = Wtemp;
+        InvalidateBounds(NODE_PARENT(pNode));
         //There is some inaccuracy if some weight changes hit the bound, the WeightDecay is assumed to be close to 1.0
         // std::cout << "\n  Output centroid value before DecayWeights = " << priorC << " and after = " << pC[nDimm1] << std::endl;
     }
@@ -147,6 +147,7 @@ int ALNAPI EvalTree(const ALNNODE* pNode,
             // get the distance from the point to the surface defined by the ALN
             afltResult[i] = CutoffEval(pTree, pALN, afltX, CEvalCutoff(),
                 &pActiveLFN);
+            STATS_TREEEVAL(pTree, pActiveLFN);
 
             // save the active LFN
             if (apActiveLFNs != NULL)
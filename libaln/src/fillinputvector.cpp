@@ -54,10 +54,19 @@ void ALNAPI FillInputVector(const ALN* pALN,
     // fill input vector
     VECTORINFO vectorinfo;
     vectorinfo.bNeedData = FALSE;
-    if (afltTRdata != NULL)
+    if (pDataInfo->pvTRstore != NULL)
+    {
+        ASSERT(nStart == 0);
+        GetTRStoreRow(pDataInfo->pvTRstore, nSample, nDim, afltX);
+        if (pDataInfo->afltTRlabels != NULL)
+            afltX[nDim - 1] = pDataInfo->afltTRlabels[2 * nSample];
+    }
+    else if (afltTRdata != NULL)
     {
         ASSERT(nStart == 0);	// we must start at zero, since no aVarInfo
-        memcpy(afltX, afltTRdata + (nSample * nCols), sizeof(float) * nDim);
+        memcpy(afltX, afltTRdata + ((size_t)nSample * nCols), sizeof(float) * nDim);
+        if (pDataInfo->afltTRlabels != NULL)
+            afltX[nDim - 1] = pDataInfo->afltTRlabels[2 * nSample];
     }
     // send vector info message
     if (pCallbackInfo && CanCallback(AN_VECTORINFO, pCallbackInfo->pfnNotifyProc,
@@ -75,6 +75,7 @@ void ALNAPI InitLFNs(ALNNODE* pNode, ALN* pALN, const float* afltX)
 
           // successfully initialized
             LFN_FLAGS(pNode) |= LF_INIT;
+            InvalidateBounds(NODE_PARENT(pNode));
         }
     }
     else
@@ -82,7 +83,9 @@ void ALNAPI InitLFNs(ALNNODE* pNode, ALN* pALN, const float* afltX)
         // we're a minmax... iterate over children
         ASSERT(NODE_ISMINMAX(pNode));
 
-        InitLFNs(MINMAX_LEFT(pNode), pALN, afltX);
-        InitLFNs(MINMAX_RIGHT(pNode), pALN, afltX);
+        for (int i = 0; i < MINMAX_NUMCHILDREN(pNode); i++)
+        {
+            InitLFNs(MINMAX_CHILDREN(pNode)[i], pALN, afltX);
+        }
     }
 }
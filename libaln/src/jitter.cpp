@@ -36,15 +36,13 @@ SOFTWARE. */
 static char THIS_FILE[] = __FILE__;
 #endif
 
-inline
-float ALNAPI Noise()
-{
-    //   This generates a random value with a triangular distribution from -1 to 1
-    //   This by subtracting two random uniformly distributed values in (0, 1).
-    return ALNRandFloat() - ALNRandFloat();
-}
+// uniform numbers drawn at once, two for each component
+#define JITTERCHUNK 32
+
+// The noise of a sample comes from its own stream of the epoch, so it is the
+// same whatever the order or the thread the samples are trained in.
 
-void ALNAPI Jitter(ALN* pALN, float* afltX)
+void ALNAPI Jitter(ALN* pALN, float* afltX, unsigned long long nKey, long nSample)
 {
     ASSERT(pALN);
     ASSERT(afltX);
@@ -52,6 +50,10 @@ void ALNAPI Jitter(ALN* pALN, float* afltX)
     int nDim = pALN->nDim;
     int nOutput = pALN->nOutput;
 
+    RANDSTREAM stream;
+    InitRandStream(&stream, nKey, RANDSTREAM_JITTER, (unsigned int)nSample);
+    float afltU[2 * JITTERCHUNK];
+
     // save output value
     float fltOutput = afltX[nOutput];
 
@@ -60,8 +62,19 @@ void ALNAPI Jitter(ALN* pALN, float* afltX)
 #ifdef _DEBUG
         float flt = afltX[i];
 #endif
-
-        afltX[i] += Noise() * pALN->aRegions[0].aConstr[i].fltEpsilon;
+        if (i % JITTERCHUNK == 0)
+        {
+            int n = nDim - i;
+            if (n > JITTERCHUNK)
+                n = JITTERCHUNK;
+            RandStreamFloats(&stream, afltU, 2 * n);
+        }
+
+        // This generates a random value with a triangular distribution from -1 to 1
+        // by subtracting two random uniformly distributed values in [0, 1).
+        int k = 2 * (i % JITTERCHUNK);
+        float fltNoise = afltU[k] - afltU[k + 1];
+        afltX[i] += fltNoise * pALN->aRegions[0].aConstr[i].fltEpsilon;
 
 #ifdef _DEBUG
         float fltEps = pALN->aRegions[0].aConstr[i].fltEpsilon;
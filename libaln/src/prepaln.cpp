@@ -98,8 +98,10 @@ BOOL ALNAPI DoPrepNode(ALN* pALN, ALNNODE* pNode)
     else
     {
       ASSERT(NODE_ISMINMAX(pNode));
-          DoPrepNode(MINMAX_LEFT(pNode));
-      DoPrepNode(MINMAX_RIGHT(pNode));
+      for (int i = 0; i < MINMAX_NUMCHILDREN(pNode); i++)
+      {
+          DoPrepNode(MINMAX_CHILDREN(pNode)[i]);
+      }
     }
 
     return TRUE;
@@ -66,8 +66,10 @@ void ALNAPI ResetCounters(ALNNODE* pNode, ALN* pALN, BOOL bMarkAsUseful /*= FALS
     if (NODE_ISMINMAX(pNode))
     {
         // iterate over children
-        ResetCounters(MINMAX_LEFT(pNode), pALN, bMarkAsUseful);
-        ResetCounters(MINMAX_RIGHT(pNode), pALN, bMarkAsUseful);
+        for (int i = 0; i < MINMAX_NUMCHILDREN(pNode); i++)
+        {
+            ResetCounters(MINMAX_CHILDREN(pNode)[i], pALN, bMarkAsUseful);
+        }
     }
     else
     {
@@ -39,23 +39,92 @@ static char THIS_FILE[] = __FILE__;
 ///////////////////////////////////////////////////////////////////////////////
 // shuffle
 
-void ALNAPI Shuffle(long nStart, long nEnd, long* anShuffle)
+// The order of an epoch is made afresh from the key of the epoch, so it
+// depends on nothing else.  A full shuffle is Fisher-Yates.  It sends each
+// sample to a random row of the buffer, a cache miss and often a TLB miss on
+// a large buffer; with nBlock > 1 rows the shuffle is in two levels instead,
+// a random order of the blocks of nBlock neighbouring rows and a random order
+// of the rows within each block, so the rows of a block are read close
+// together in time.  With nWindow > 1 the rows are shuffled within windows
+// of nWindow consecutive blocks of that order rather than within each block;
+// a memory mapped buffer is read a window of chunks at a time this way.
+
+// a random number in [0, n), from the top of the product so there is no
+// modulo, with the rejection that makes it unbiased (Lemire)
+static inline unsigned long RandBelow(RANDSTREAM* pStream, unsigned long n)
+{
+    unsigned long long m = (unsigned long long)RandStreamNext(pStream) * n;
+    unsigned int nLow = (unsigned int)m;
+    if (nLow < n)
+    {
+        unsigned int nThreshold = (0u - (unsigned int)n) % (unsigned int)n;
+        while (nLow < nThreshold)
+        {
+            m = (unsigned long long)RandStreamNext(pStream) * n;
+            nLow = (unsigned int)m;
+        }
+    }
+    return (unsigned long)(m >> 32);
+}
+
+// Fisher-Yates shuffle of n indexes
+static void FisherYates(RANDSTREAM* pStream, long* an, long n)
+{
+    for (long i = n - 1; i > 0; i--)
+    {
+        long j = (long)RandBelow(pStream, (unsigned long)i + 1);
+        long nTemp = an[i];
+        an[i] = an[j];
+        an[j] = nTemp;
+    }
+}
+
+void ALNAPI Shuffle(long nStart, long nEnd, long* anShuffle, unsigned long long nKey,
+    long nBlock, long nWindow)
 {
     ASSERT(anShuffle);
 
-    if ((nEnd - nStart) > 1)
+    RANDSTREAM stream;
+    InitRandStream(&stream, nKey, RANDSTREAM_SHUFFLE, 0);
+
+    long nSamples = nEnd - nStart + 1;
+    if (nSamples <= 0)
+        return;
+
+    if (nBlock <= 1 || nBlock >= nSamples)
     {
-        for (int nSwap = nStart; nSwap <= nEnd; nSwap++)
+        for (long i = 0; i < nSamples; i++)
+            anShuffle[i] = i;
+        FisherYates(&stream, anShuffle, nSamples);
+        return;
+    }
+
+    // order of the blocks, put in the last entries so the rows can be
+    // written from the front; the rows of blocks 0 to b never reach the
+    // entry of block b + 1
+    long nBlocks = (nSamples + nBlock - 1) / nBlock;
+    long* anBlocks = anShuffle + (nSamples - nBlocks);
+    for (long b = 0; b < nBlocks; b++)
+        anBlocks[b] = b;
+    FisherYates(&stream, anBlocks, nBlocks);
+
+    if (nWindow < 1)
+        nWindow = 1;
+    long i = 0;
+    long nWindowStart = 0;
+    for (long b = 0; b < nBlocks; b++)
+    {
+        long nFirst = anBlocks[b] * nBlock;
+        long nRows = min(nBlock, nSamples - nFirst);
+        for (long r = 0; r < nRows; r++)
+            anShuffle[i + r] = nFirst + r;
+        i += nRows;
+
+        if ((b + 1) % nWindow == 0 || b + 1 == nBlocks)
         {
-            // calc swap indexes
-            int a, b;
-            a = ALNRand() % (nEnd - nStart + 1);
-            do { b = ALNRand() % (nEnd - nStart + 1); } while (a == b);
-
-            // swap indexes
-#define _SWAP(a, b) (a) = (a)^(b); (b) = (a)^(b); (a) = (a)^(b)
-            _SWAP(anShuffle[a], anShuffle[b]);
-#undef _SWAP
-        } // end shuffle    
+            FisherYates(&stream, anShuffle + nWindowStart, i - nWindowStart);
+            nWindowStart = i;
+        }
     }
+    ASSERT(i == nSamples);
 }
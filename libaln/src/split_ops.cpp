@@ -39,6 +39,10 @@ static char THIS_FILE[] = __FILE__;
 // include classes
 #include ".\cmyaln.h"
 #include "aln.h"
+#include "alnpriv.h"
+#include <algorithm>
+#include <chrono>
+#include <vector>
 
 #ifndef ASSERT
 
@@ -53,19 +57,28 @@ static char THIS_FILE[] = __FILE__;
 // We use fltRespTotal in two ways and the following definition helps.
 #define NOISEVARIANCE fltRespTotal
 
-extern BOOL bStopTraining; // This becomes TRUE and stops training when pieces are no longer splitting.
 void setSplitAlpha(ALNDATAINFO* pDataInfo);
-void splitControl(ALN* pALN, ALNDATAINFO* pDataInfo);
+void splitControl(ALN* pALN, ALNDATAINFO* pDataInfo, ALNTRAINCONTEXT* pContext, PHASETIMES* pPhaseTimes);
 void zeroSplitValues(ALN* pALN, ALNNODE* pNode);
-void splitUpdateValues(ALN* pALN, ALNDATAINFO* pDataInfo);
-void doSplits(ALN* pALN, ALNNODE* pNode, float fltLimit);
-int ALNAPI SplitLFN(ALN* pALN, ALNNODE* pNode);
-extern float WeightDecay;
-extern float WeightBound;
-extern BOOL bClassify2;
-extern BOOL bConvex;
-extern int SplitsAllowed;
-extern int SplitCount;
+void splitUpdateValues(ALN* pALN, ALNDATAINFO* pDataInfo, ALNNODE** apActiveLFN);
+// a leaf which fails to fit, with its square training error in excess of the split limit
+struct CSplitCandidate
+{
+    ALNNODE* pLFN;
+    float fltExcess;
+    long nOrder;            // place in the tree order of the leaves
+};
+void doSplits(ALN* pALN, ALNNODE* pNode, float fltLimit, const float* afltAlpha, ALNTRAINCONTEXT* pContext,
+    std::vector<CSplitCandidate>& vecCandidates);
+static void splitBestFirst(ALN* pALN, std::vector<CSplitCandidate>& vecCandidates, ALNTRAINCONTEXT* pContext);
+
+// The leaves which fail to fit are split best first: when the split budget,
+// or the splits of a round (nSplitsPerRound), do not cover them all, those
+// whose square training error exceeds the limit on the piece by the most are
+// split, and the rest wait for a later round.  Splitting a leaf changes no
+// centroid the other leaves or their parents use, so the chosen leaves are
+// split after the pass over the tree, in tree order; with the budget to
+// split them all, the tree grows as when each was split as it was reached.
 
 
 // We use the first three fields in ALNLFNSPLIT (declared in aln.h)
@@ -100,41 +113,84 @@ static const float afltFconstant50[13]{ 1,1,1,1,1,1,1,1,1,1,1,1,1 };
 // static const float afltFconstant35[13]{ 0.58, 0.65, 0.70, 0.73, 0.75, 0.77, 0.78, 0.79, 0.80, 0.86, 0.88, 0.90, 0.92 };
 static const float afltFconstant25[13]{ 0.333f, 0.424f, 0.485f, 0.529f, 0.562f, 0.588f, 0.610f, 0.629f, 0.645f, 0.735f, 0.781f, 0.806f, 0.840f };
 static const float afltFconstant10[13]{ 0.111f, 0.185f, 0.243f, 0.290f, 0.327f, 0.359f, 0.386f, 0.410f, 0.431f, 0.558f, 0.621f, 0.662f, 0.714f };
-static float afltF_Alpha[13]{ 1,1,1,1,1,1,1,1,1,1,1,1,1 };
 
-void setSplitAlpha(ALNDATAINFO* pDataInfo)
+// the F-test limits for the percentage -fltLimit
+static void getSplitAlpha(float fltLimit, float* afltAlpha)
 {
-    // If fltMSEorF < 0, this routine is called once before any training.
-    float fltLimit = pDataInfo->fltMSEorF;
+    for (int i = 0; i < 13; i++)
+    {
+        afltAlpha[i] = 1.0f;
+    }
     if (fltLimit >= 0) return;
     if (-fltLimit == 50)
     {
         for (int i = 0; i < 13; i++) // We are doing an F-test
         {
-            afltF_Alpha[i] = afltFconstant50[i];
+            afltAlpha[i] = afltFconstant50[i];
         }
     }
     else  // this is according to tables for 25, 50, 75 and rest is approximate
     {
         for (int i = 0; i < 13; i++) // We are doing an F-test
         {
-            afltF_Alpha[i] = (float)pow(afltFconstant75[i], (-fltLimit - 50) / 25.0);
+            afltAlpha[i] = (float)pow(afltFconstant75[i], (-fltLimit - 50) / 25.0);
         }
     }
 }
 
-void splitControl(ALN* pALN, ALNDATAINFO* pDataInfo)  // routine
+// The table used to be set here, once before training, in a static array shared
+// by every ALN.  splitControl now works it out from pDataInfo->fltMSEorF so that
+// ALNs can be trained on several threads; this remains for the applications
+// that call it.
+void setSplitAlpha(ALNDATAINFO* pDataInfo)
+{
+}
+
+void splitControl(ALN* pALN, ALNDATAINFO* pDataInfo, ALNTRAINCONTEXT* pContext, PHASETIMES* pPhaseTimes)  // routine
 {
-    if (SplitCount >= SplitsAllowed) return; // 
+    if (pContext->nSplitCount >= pContext->nSplitsAllowed) return; // 
     float fltLimit = pDataInfo->fltMSEorF;
+    float afltAlpha[13];
+    getSplitAlpha(fltLimit, afltAlpha);
     ASSERT(pALN);
     ASSERT(pALN->pTree);
+    // the two parts are timed if pPhaseTimes is not NULL
+    std::chrono::steady_clock::time_point time0, time1, time2;
+    if (pPhaseTimes) time0 = std::chrono::steady_clock::now();
     // initialize all the SPLIT values to zero
     zeroSplitValues(pALN, pALN->pTree);
-    // get square errors of pieces on training set and the noise variance estimates
-    splitUpdateValues(pALN, pDataInfo);
+    // get square errors of pieces on training set and the noise variance estimates,
+    // keeping the active LFN of each sample for choosing the routing tests
+    ALNNODE** apActiveLFN = (ALNNODE**)malloc(pDataInfo->nTRcurrSamples * sizeof(ALNNODE*));
+    if (apActiveLFN == NULL && pDataInfo->nTRcurrSamples > 0) ThrowALNMemoryException();
+    splitUpdateValues(pALN, pDataInfo, apActiveLFN);
+    if (pPhaseTimes) time1 = std::chrono::steady_clock::now();
     // With the above statistics, doSplits recursively determines splits of eligible pieces.
-    doSplits(pALN, pALN->pTree, fltLimit);
+    // The new routing normals are then compressed to tests of a few inputs.
+    try
+    {
+        std::vector<CSplitCandidate> vecCandidates;
+        doSplits(pALN, pALN->pTree, fltLimit, afltAlpha, pContext, vecCandidates);
+        splitBestFirst(pALN, vecCandidates, pContext);
+        UpdateRoutes(pALN, pDataInfo, apActiveLFN);
+    }
+    catch (...)
+    {
+        free(apActiveLFN);
+        throw;
+    }
+    free(apActiveLFN);
+    if (pPhaseTimes)
+    {
+        time2 = std::chrono::steady_clock::now();
+        pPhaseTimes->dblSplitUpdate += std::chrono::duration<double>(time1 - time0).count();
+        pPhaseTimes->dblDoSplits += std::chrono::duration<double>(time2 - time1).count();
+        if (IsTraceOpen())
+        {
+            TraceEvent("SplitUpdateValues", time0, time1, NULL);
+            TraceEvent("DoSplits", time1, time2, NULL);
+        }
+    }
     // Resetting the SPLIT components to zero by zeroSplitValues is done in alntrain.
 }
 
@@ -146,8 +202,10 @@ void zeroSplitValues(ALN* pALN, ALNNODE* pNode) // routine
     ASSERT(pNode);
     if (NODE_ISMINMAX(pNode))
     {
-        zeroSplitValues(pALN, MINMAX_LEFT(pNode));
-        zeroSplitValues(pALN, MINMAX_RIGHT(pNode));
+        for (int i = 0; i < MINMAX_NUMCHILDREN(pNode); i++)
+        {
+            zeroSplitValues(pALN, MINMAX_CHILDREN(pNode)[i]);
+        }
     }
     else
     {
@@ -163,37 +221,36 @@ void zeroSplitValues(ALN* pALN, ALNNODE* pNode) // routine
 
 // Routines that get the training errors and noise variance values.
 
-void splitUpdateValues(ALN* pALN, ALNDATAINFO* pDataInfo) // routine
+void splitUpdateValues(ALN* pALN, ALNDATAINFO* pDataInfo, ALNNODE** apActiveLFN) // routine
 {
     // Assign the square errors on the training set and the noise variance
-    // sample values to the leaf nodes of the ALN.
+    // sample values to the leaf nodes of the ALN, and the active LFN of each sample to apActiveLFN.
 
     float desired = 0;
     float alnval = 0;
     int nDim = pALN->nDim;
     int nDimm1 = nDim - 1;
-    int nDimt2 = nDim * 2;
-    int nDimt2m1 = nDimt2 - 1;
-
-    int nDimt2p1 = nDimt2 + 1;
-    int nDimt2p1ti;
+    int nTRcols = pDataInfo->nTRcols; // 2 * nDim + 1, or nDim + 2 for a compact buffer
     float* afltX = (float*)malloc(nDim * sizeof(float));
+    float* afltDiff = (float*)malloc(nDim * sizeof(float)); // closest minus sample, if compact
+    float* afltRowBuf = (float*)malloc(nTRcols * sizeof(float)); // the row, if in a store
     ALNNODE* pActiveLFN;
-    float* afltTRdata = pDataInfo->afltTRdata;
+    const float* afltTRlabels = pDataInfo->afltTRlabels; // if not NULL, the desired values of a shared buffer
     long nrows = pDataInfo->nTRcurrSamples;
     float fltMSEorF = pDataInfo->fltMSEorF;
     for (long i = 0; i < nrows; i++)
     {
-        nDimt2p1ti = nDimt2p1 * i;
+        const float* afltRow = GetTRRow(pDataInfo, i, nTRcols, afltRowBuf);
         for (int j = 0; j < nDimm1; j++) // just the domain values of the sample
         {
-            afltX[j] = afltTRdata[nDimt2p1ti + j];
+            afltX[j] = afltRow[j];
         }
         afltX[nDimm1] = 0; // set to zero to get value of the aln on the output
         alnval = ALNQuickEval(pALN, afltX, &pActiveLFN); // the current ALN value
+        apActiveLFN[i] = pActiveLFN;
         if (LFN_CANSPLIT(pActiveLFN)) // Skip this leaf node if it can't split anyway.//READ ACCESS VIOLATION pActiveLFN was 0x4E210
         {
-            desired = afltTRdata[nDimt2p1ti + nDimm1];
+            desired = afltTRlabels ? afltTRlabels[2 * i] : afltRow[nDimm1];
             float error = alnval - desired;
 
             (pActiveLFN->DATA.LFN.pSplit)->nCount++;
@@ -220,13 +277,14 @@ void splitUpdateValues(ALN* pALN, ALNDATAINFO* pDataInfo) // routine
             float noiseSampleTemp;
             if (fltMSEorF <= 0)
             {
-                noiseSampleTemp = afltTRdata[nDimt2p1ti + nDimt2m1]; // Get the difference of desired sample values in the tool
+                const float* afltClosestDiff = GetTRDifference(pDataInfo, nDim, afltRow, afltDiff);
+                noiseSampleTemp = afltTRlabels ? afltTRlabels[2 * i + 1] : afltClosestDiff[nDimm1]; // Get the difference of desired sample values in the tool
                 // This has to be corrected for the slopes of the LFN
                 for (int kk = 0; kk < nDim - 1; kk++) // Just do the domain dimensions.
                 {
                     // get the weights for the LFN and correct the sample for slope
                     // Adding 1 in kk + 1 skips the bias weight.
-                    noiseSampleTemp -= LFN_W(pActiveLFN)[kk + 1] * afltTRdata[nDimt2p1ti + nDim + kk];
+                    noiseSampleTemp -= LFN_W(pActiveLFN)[kk + 1] * afltClosestDiff[kk];
                 }
                 // The following should be a sample for the noise variance of the piece
                 // which is paired with data sample i in case fltMSEorF is negative and we are doing an F-test.
@@ -235,12 +293,15 @@ void splitUpdateValues(ALN* pALN, ALNDATAINFO* pDataInfo) // routine
         }
     } // end loop over both files
     free(afltX);
+    free(afltDiff);
+    free(afltRowBuf);
 } // END of splitUpdateValues
 
-void doSplits(ALN* pALN, ALNNODE* pNode, float fltMSEorF) // routine
+void doSplits(ALN* pALN, ALNNODE* pNode, float fltMSEorF, const float* afltAlpha, ALNTRAINCONTEXT* pContext,
+    std::vector<CSplitCandidate>& vecCandidates) // routine
 {
     int nDim = pALN->nDim;
-    int  CanSplitAbove = bClassify2 ? 1 : (int)(1.2F * (float)nDim + 1.0F);
+    int  CanSplitAbove = pContext->bClassify2 ? 1 : (int)(1.2F * (float)nDim + 1.0F);
     // This routine visits all the leaf nodes and determines whether or not to split.
     // If fltLimit < 0, it uses an F test with d.o.f. based on the number of samples counted,
     // but if fltLimit >= 0 it uses the actual fltLimit value to compare to the square training error.
@@ -251,17 +312,21 @@ void doSplits(ALN* pALN, ALNNODE* pNode, float fltMSEorF) // routine
     ALNNODE* pParent = NODE_PARENT(pNode);
     if (NODE_ISMINMAX(pNode))
     {
-        // The following is the WWA optimization, which tries to avoid evaluating nodes not in the neighborhood of sample afltX
-        // In preparation, we zero the count, centroid and sigma of this node, which will be changed in the children
+        // The centroids route evaluation towards the child nearer to sample afltX
+        // In preparation, we zero the count and centroid of this node, which will be changed in the children
         MINMAX_COUNT(pNode) = 0;
         for (int i = 0; i < nDim - 1; i++)
         {
             MINMAX_CENTROID(pNode)[i] = 0; // zero the centroid of the subtree on the depth-first path down the tree
-            MINMAX_SIGMA(pNode)[i] = 0; // zero the half-width of the subtree on the way down
         }
-        // Now do the children
-        doSplits(pALN, MINMAX_LEFT(pNode), fltMSEorF); // N.B. left and right subtrees have centroids whose differences of components can be positive or negative
-        doSplits(pALN, MINMAX_RIGHT(pNode), fltMSEorF);// i.e. the subtrees have no particular order in the nDim -1 coordinates of the domain
+        // Now do the children. N.B. the subtrees have centroids whose differences of components can be positive or negative
+        // i.e. the subtrees have no particular order in the nDim -1 coordinates of the domain
+        // A child splitting into this node adds a child at the end, which is left for the next time.
+        int nChildren = MINMAX_NUMCHILDREN(pNode);
+        for (int i = 0; i < nChildren; i++)
+        {
+            doSplits(pALN, MINMAX_CHILDREN(pNode)[i], fltMSEorF, afltAlpha, pContext, vecCandidates);
+        }
         // and pop back up here
         for (int i = 0; i < nDim - 1; i++)
         {
@@ -280,53 +345,45 @@ void doSplits(ALN* pALN, ALNNODE* pNode, float fltMSEorF) // routine
             }
         }
 
-        ALNNODE* pRightChild = MINMAX_RIGHT(pNode);
-        ALNNODE* pLeftChild = MINMAX_LEFT(pNode);
-        // Now get the left and right domain centroids of the children
+        // Now get the domain centroids of the first two children
         float* afltCL = (float*)malloc((nDim - 1) * sizeof(float));
         float* afltCR = (float*)malloc((nDim - 1) * sizeof(float));
         float* afltH = (float*)malloc((nDim - 1) * sizeof(float)); // This is a point on the hyperplane roughly dividing the points belonging to the two branches
-        if (NODE_ISMINMAX(pRightChild))
-        {
-            for (int i = 0; i < nDim - 1; i++)
-            {
-                afltCR[i] = MINMAX_CENTROID(pRightChild)[i];
-            }
-        }
-        else
+        for (int k = 0; k < 2; k++)
         {
-            ASSERT(NODE_ISLFN(pRightChild));
-            for (int i = 0; i < nDim - 1; i++)
+            ALNNODE* pChild = MINMAX_CHILDREN(pNode)[k];
+            const float* afltC;
+            if (NODE_ISMINMAX(pChild))
             {
-                afltCR[i] = LFN_C(pRightChild)[i];
+                afltC = MINMAX_CENTROID(pChild);
             }
-        }
-
-        if (NODE_ISMINMAX(pLeftChild))
-        {
-            for (int i = 0; i < nDim - 1; i++)
+            else
             {
-                afltCL[i] = MINMAX_CENTROID(pLeftChild)[i];
+                ASSERT(NODE_ISLFN(pChild));
+                afltC = LFN_C(pChild);
             }
-        }
-        else
-        {
-            ASSERT(NODE_ISLFN(pLeftChild));
             for (int i = 0; i < nDim - 1; i++)
             {
-                afltCL[i] = LFN_C(pLeftChild)[i];
+                if (k == 0) afltCL[i] = afltC[i];
+                if (k == 1) afltCR[i] = afltC[i];
             }
         }
 
         //Now we use the left and right *domain* centroids of the children of this node to generate other needed items
+        // The hyperplane only routes a node with two children; with more there is no left and right.
         MINMAX_THRESHOLD(pNode) = 0;
         for (int i = 0; i < nDim - 1; i++)
         {
-            MINMAX_NORMAL(pNode)[i] = MINMAX_CENTROID(pNode)[i] - afltCL[i];
-            afltH[i] = afltCR[i] - MINMAX_NORMAL(pNode)[i]; // changed the sign of H, Jan 28
-            MINMAX_THRESHOLD(pNode) += -afltH[i] * MINMAX_NORMAL(pNode)[i];
-            MINMAX_SIGMA(pNode)[i] += 0.5f * fabs(afltCR[i] - afltCL[i]); // there are already two contributions from children as below
-            if (pParent) MINMAX_SIGMA(pParent)[i] += 0.5f * MINMAX_SIGMA(pNode)[i]; // we add half of one of two child values to the parent sigma
+            if (nChildren == 2)
+            {
+                MINMAX_NORMAL(pNode)[i] = MINMAX_CENTROID(pNode)[i] - afltCL[i];
+                afltH[i] = afltCR[i] - MINMAX_NORMAL(pNode)[i]; // changed the sign of H, Jan 28
+                MINMAX_THRESHOLD(pNode) += -afltH[i] * MINMAX_NORMAL(pNode)[i];
+            }
+            else
+            {
+                MINMAX_NORMAL(pNode)[i] = 0;
+            }
         }
         free(afltCR);
         free(afltCL);
@@ -344,8 +401,6 @@ void doSplits(ALN* pALN, ALNNODE* pNode, float fltMSEorF) // routine
             {
                 MINMAX_CENTROID(pParent)[i] += Count * LFN_C(pNode)[i]; // This is the weighted contribution of this leaf to the centroid of the parent
                                                                 // It has to be divided by the Count of the parent on the way up
-                MINMAX_SIGMA(pParent)[i] += 4.0f * sqrt(LFN_D(pNode)[i]); // We have to add the absolute value of the difference of centroid components on the way up
-                // one-sided probabilities at various sigmas: sigma = 2.0 0.0227; 2.5 0.0062; 3.0 0.0013; 3.5 0.0002; 3.88 0.0001 Seelalso alnmem.cpp line 497
             }
         }
         if (Count > CanSplitAbove) // added July 29,2020 to try for better classification, adapted for regression use August 10, 2020
@@ -366,7 +421,7 @@ void doSplits(ALN* pALN, ALNNODE* pNode, float fltMSEorF) // routine
                     if (Count > 30) dofIndex = 10;
                     if (Count > 40) dofIndex = 11;
                     if (Count > 60) dofIndex = 12; // MYTEST  encourage splitting worked, now it's too much
-                    fltSplitLimit = afltF_Alpha[dofIndex]; // One can reject the H0 of a good fit with various percentages
+                    fltSplitLimit = afltAlpha[dofIndex]; // One can reject the H0 of a good fit with various percentages
                     // 90, 75, 50, 35, 25. E.g. 90% says that if the training error is greater than the fltSplitLimit prescribes
                     // it is 90% sure that the fit is bad.  A higher percentage needs less training time.
                     // Note that when there are few hits on the piece, the fltSplitLimit is larger and 
@@ -389,13 +444,14 @@ void doSplits(ALN* pALN, ALNNODE* pNode, float fltMSEorF) // routine
                         // The piece doesn't fit and needs to split; then training must continue.
                         // We want to choose the same way of splitting, max or min, as the parent. This may need some experimentation
                         //if (fabs(LFN_SPLIT_T(pNode)) * Count * 20 < fltPieceSquareTrainError) LFN_SPLIT_T(pNode) = 0; MYTEST fix this!!!!!!!!!!!!!!!!!
-                        if (SplitCount < SplitsAllowed)
-                        {
-                            SplitLFN(pALN, pNode); // We split *every* leaf node that reaches this point.
-                            SplitCount++;
-                        }
+                        // Every leaf node that reaches this point is a candidate; splitBestFirst splits those that fit the budget.
+                        CSplitCandidate candidate;
+                        candidate.pLFN = pNode;
+                        candidate.fltExcess = fltPieceSquareTrainError - fltPieceNoiseVariance * fltSplitLimit;
+                        candidate.nOrder = (long)vecCandidates.size();
+                        vecCandidates.push_back(candidate);
                         // We start an epoch with bStopTraining == TRUE, but if any leaf node might still split,
-                        bStopTraining = FALSE; //  we set it to FALSE and continue to another epoch of training.
+                        pContext->bStopTraining = FALSE; //  we set it to FALSE and continue to another epoch of training.
                     }
                     // else the piece doesn't have enough samples to split, but it doesn't fit well -- continue training
                 }
@@ -413,12 +469,65 @@ void doSplits(ALN* pALN, ALNNODE* pNode, float fltMSEorF) // routine
     }
 }
 
-int ALNAPI SplitLFN(ALN* pALN, ALNNODE* pNode)
+// the candidate of less excess error is lower in the heap; of equal ones,
+// the later in the tree
+static bool LessExcess(const CSplitCandidate& a, const CSplitCandidate& b)
+{
+    if (a.fltExcess != b.fltExcess)
+        return a.fltExcess < b.fltExcess;
+    return a.nOrder > b.nOrder;
+}
+
+static bool TreeOrder(const CSplitCandidate& a, const CSplitCandidate& b)
+{
+    return a.nOrder < b.nOrder;
+}
+
+// splits the candidates of greatest excess error that the budget allows
+static void splitBestFirst(ALN* pALN, std::vector<CSplitCandidate>& vecCandidates, ALNTRAINCONTEXT* pContext)
+{
+    long nSplits = pContext->nSplitsAllowed - pContext->nSplitCount;
+    if (pContext->nSplitsPerRound > 0 && pContext->nSplitsPerRound < nSplits)
+        nSplits = pContext->nSplitsPerRound;
+    if (nSplits <= 0 || vecCandidates.empty())
+        return;
+
+    if ((size_t)nSplits < vecCandidates.size())
+    {
+        // the worst fitting come off the top of the heap into the end
+        std::make_heap(vecCandidates.begin(), vecCandidates.end(), LessExcess);
+        for (long i = 0; i < nSplits; i++)
+        {
+            std::pop_heap(vecCandidates.begin(), vecCandidates.end() - i, LessExcess);
+        }
+        vecCandidates.erase(vecCandidates.begin(), vecCandidates.end() - nSplits);
+        std::sort(vecCandidates.begin(), vecCandidates.end(), TreeOrder);
+    }
+
+    for (size_t i = 0; i < vecCandidates.size(); i++)
+    {
+        SplitLFN(pALN, vecCandidates[i].pLFN, pContext);
+        pContext->nSplitCount++;
+    }
+}
+
+// splits an LFN into a MIN or a MAX of two pieces; when the parent already has
+// that type, the new piece is added to the parent instead of a new level
+static int ALNAPI SplitLFNAs(ALN* pALN, ALNNODE* pNode, int nMinMaxType)
+{
+    ALNNODE* pParent = NODE_PARENT(pNode);
+    if (pParent != NULL && MINMAX_TYPE(pParent) == nMinMaxType)
+        return AddSiblingLFN(pALN, pNode);
+
+    return ALNAddLFNs(pALN, pNode, nMinMaxType, 2, NULL);
+}
+
+int ALNAPI SplitLFN(ALN* pALN, ALNNODE* pNode, const ALNTRAINCONTEXT* pContext)
 {
-    if (bClassify2 && bConvex)
+    if (pContext->bClassify2 && pContext->bConvex)
     {
         // This is for convex classification
-        return ALNAddLFNs(pALN, pNode, GF_MIN, 2, NULL);
+        return SplitLFNAs(pALN, pNode, GF_MIN);
     }
     else
     {
@@ -437,12 +546,12 @@ int ALNAPI SplitLFN(ALN* pALN, ALNNODE* pNode)
 
             if (MINMAX_ISMAX(NODE_PARENT(pNode)))
             {
-                return ALNAddLFNs(pALN, pNode, GF_MAX, 2, NULL);
+                return SplitLFNAs(pALN, pNode, GF_MAX);
                 // A max is convex down:  \/,  \_/ etc.
             }
             else
             {
-                return ALNAddLFNs(pALN, pNode, GF_MIN, 2, NULL);
+                return SplitLFNAs(pALN, pNode, GF_MIN);
                 // A min of several LFNs is like a dome.
             }
 
@@ -452,12 +561,12 @@ int ALNAPI SplitLFN(ALN* pALN, ALNNODE* pNode)
             // in the training data are higher than the LFN surface some distance from the centroid.
             // This causes the LFN to split into a MAX of two LFNs.
         {
-            return ALNAddLFNs(pALN, pNode, GF_MAX, 2, NULL);
+            return SplitLFNAs(pALN, pNode, GF_MAX);
             // A max is convex down:  \/,  \_/ etc.
         }
         else
         {
-            return ALNAddLFNs(pALN, pNode, GF_MIN, 2, NULL);
+            return SplitLFNAs(pALN, pNode, GF_MIN);
             // A min of several LFNs is like a dome.
         }
     }
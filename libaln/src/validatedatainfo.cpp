@@ -50,6 +50,19 @@ int ALNAPI ValidateALNDataInfo(const ALN* pALN,
     {
         return ALN_GENERIC;
     }
+
+    // a compact buffer has nDim + 2 columns, the closest row in place of the
+    // difference to it
+    if (pDataInfo->nTRlayout != ALN_TRLAYOUT_FULL &&
+        pDataInfo->nTRlayout != ALN_TRLAYOUT_COMPACT)
+    {
+        return ALN_GENERIC;
+    }
+    if (IsCompactTRBuffer(pDataInfo) &&
+        (pALN->nDim < 2 || pDataInfo->nTRcols != pALN->nDim + 2))
+    {
+        return ALN_GENERIC;
+    }
     /*
     // must have at least one training point or not have a training set
       if ((pDataInfo->nTRcurrSamples <= 0) && (pDataInfo->fltMSEorF <= 0))
@@ -95,22 +108,30 @@ void ALNAPI DebugValidateALNDataInfo(const ALN* pALN,
     // valid aln pointer
     ASSERT(pALN != NULL);
 
-    // valid number of points
-    ASSERT(pDataInfo->nTRcurrSamples > 0);
+    // valid layout
+    ASSERT(pDataInfo->nTRlayout == ALN_TRLAYOUT_FULL ||
+        (pDataInfo->nTRlayout == ALN_TRLAYOUT_COMPACT && pDataInfo->nTRcols == pALN->nDim + 2));
+
+    // valid number of points; a buffer with a queue may start empty and
+    // fill from it
+    ASSERT(pDataInfo->nTRcurrSamples > 0 || pDataInfo->pvTRqueue != NULL);
 
     // valid data cols
     ASSERT((pDataInfo->afltTRdata != NULL && pDataInfo->nTRcols > 0) ||
         pDataInfo->afltTRdata == NULL);
 
-    // valid notify proc
-    ASSERT(pDataInfo->afltTRdata != NULL ||
+    // valid notify proc; the rows of a store attached to the buffer are
+    // read through it, and the array may be gone
+    BOOL bStore = (pDataInfo->pvTRstore != NULL);
+    ASSERT(pDataInfo->afltTRdata != NULL || bStore ||
         (pCallbackInfo != NULL &&
             pCallbackInfo->pfnNotifyProc != NULL &&
             (pCallbackInfo->nNotifyMask & AN_VECTORINFO)));
 
-    // valid varinfo
-    ASSERT(pDataInfo->aVarInfo != NULL || pDataInfo->nTRcols >= (2 * pALN->nDim + 1));
-    if (pDataInfo->aVarInfo != NULL)
+    // valid varinfo; a compact buffer has nDim + 2 columns
+    ASSERT(pDataInfo->aVarInfo != NULL || pDataInfo->nTRcols >= (2 * pALN->nDim + 1) ||
+        IsCompactTRBuffer(pDataInfo));
+    if (pDataInfo->aVarInfo != NULL && !bStore)
     {
         for (int i = 0; i < pALN->nDim; i++)
         {